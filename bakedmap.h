@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BAKEDMAP_H
+#define BAKEDMAP_H
+
+#include "blindguide.h"
+
+// Version of the baked map headers written by guideBakeMap() (see mapfile.h), a baked map only compiles with the same version
+#define BAKED_MAP_FORMAT 2
+
+/*
+ * A map that was baked into the program as static const tables by guideBakeMap() (see mapfile.h),
+ * with the vertices of the border lines and the structure of arrays mirror already computed, and optionally the grid.
+ * sections: the tables of the map (see MapSections)
+ * gridCellSize: the GRID_CELL_SIZE the grid was built for (the grid is only used with the same GRID_CELL_SIZE)
+ * minX, minY, maxX, maxY: bounding box of the border lines of the map (all 0 for an empty map)
+ * tables, size: the object holding all tables, and its size in bytes
+ */
+typedef struct BakedMap {
+    MapSections sections;
+    double gridCellSize;
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    const void * tables;
+    size_t size;
+} BakedMap;
+
+/*
+ * Replaces the map of the given guide by the baked map.
+ * The tables are used in place in read-only memory, so loading does not depend on the number of border lines
+ * (except for copying the states of the border lines, and building the grid when the map was baked without it or for another GRID_CELL_SIZE).
+ * Every guide that loads the same baked map has its own states, so they can remove, enable and disable borders independently:
+ * the first such change copies the map of that guide into memory of its own, like adding a border does.
+ * Marks the borderlines array of the guide with the current borderMapVersion.
+ * Returns 1 on success, or 0 when the memory is exhausted (the guide is then unchanged, or without a map when the grid did not fit).
+ */
+int guideLoadBakedMap(BlindGuide * guide, const BakedMap * map);
+
+/*
+ * Loads the baked map into the default guide (see guideLoadBakedMap()), after which getResistance() can be used.
+ */
+int loadBakedMap(const BakedMap * map);
+
+
+/*
+ * Releases a baked map, which is not needed as its tables are static.
+ */
+static void releaseBakedMap(void * tables, size_t size) {
+    (void) tables;
+    (void) size;
+}
+
+int guideLoadBakedMap(BlindGuide * guide, const BakedMap * map) {
+    MapSections sections = map->sections;
+    if (map->gridCellSize != GRID_CELL_SIZE) {
+        // The baked grid has other cells, so build the grid instead
+        sections.numBuckets = 0;
+        sections.numEntries = 0;
+    }
+    return guideUseMapSections(guide, &sections, (void *) map->tables, map->size, releaseBakedMap, 1);
+}
+
+int loadBakedMap(const BakedMap * map) {
+    return guideLoadBakedMap(&defaultGuide, map);
+}
+
+#endif
@@ -0,0 +1,389 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mapfile.h"
+
+#if BORDER_KERNEL_X86
+    #include <x86intrin.h>
+#endif
+
+// Number of distinct queries per query distribution
+#define NUM_QUERIES 4096
+// Minimum time in seconds that every measurement runs
+#define MIN_TIME 0.05
+// Default size of the largest synthetic map
+#define MAX_SEGMENTS 1000000
+// Size of a room of the synthetic maps in meter
+#define ROOM_SIZE 4
+// Number of robots in a query block of getResistanceBatch()
+#define BATCH_SIZE 256
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+enum distribution {OPEN, NEAR_WALLS, ACROSS_BORDERS};
+const char * distributionNames[] = {"open", "near", "across"};
+
+/*
+ * A set of queries of one distribution.
+ * For query i: (x[i], y[i]) is the position, phi[i] the rotation and (forceX[i], forceY[i]) the force,
+ * and border[i] a border line near the query, taken out of the map beforehand (used for approachingBorder()).
+ */
+typedef struct QuerySet {
+    double x[NUM_QUERIES];
+    double y[NUM_QUERIES];
+    double phi[NUM_QUERIES];
+    double forceX[NUM_QUERIES];
+    double forceY[NUM_QUERIES];
+    Borderline border[NUM_QUERIES];
+} QuerySet;
+
+// Prevents the compiler from removing the benchmarked calls
+volatile double sink;
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Returns the time stamp counter, or 0 when it is not available.
+ */
+unsigned long long cycles() {
+    #if BORDER_KERNEL_X86
+        return __rdtsc();
+    #else
+        return 0;
+    #endif
+}
+
+/*
+ * Fills the map of guide with a synthetic building of numSegments border lines of one meter:
+ * square rooms of ROOM_SIZE meter, where one in eight wall segments is left out as a door.
+ */
+void createBuilding(BlindGuide * guide, size_t numSegments) {
+    // Every wall line holds about 2 * size * 7 / 8 segments, and there are size / ROOM_SIZE wall lines
+    long size = (long) ceil(sqrt(numSegments * 4.0 * ROOM_SIZE / 7));
+    long line, position;
+    size_t count = 0;
+    srand(1);
+    for (line = 0; count < numSegments; line += ROOM_SIZE) {
+        for (position = 0; position < size && count < numSegments; position++) {
+            if (rand() % 8 == 0) {
+                continue;
+            }
+            // A vertical and a horizontal wall segment
+            guideAddBorder(guide, line, position, line, position + 1, RIGHT);
+            count++;
+            if (count < numSegments) {
+                guideAddBorder(guide, position, line, position + 1, line, RIGHT);
+                count++;
+            }
+        }
+    }
+}
+
+/*
+ * Returns the distance from p to the nearest border line of guide within radius meters (or radius when there is none).
+ */
+double nearestBorderDistance(BlindGuide * guide, Coordinate * p, double radius) {
+    BorderlineSoA * soa = &(guide->soa);
+    int found = collectBorderCandidates(&(guide->grid), &(guide->search), &(guide->borderlines), p, radius);
+    size_t numIndices = found ? guide->search.candidates.size : soa->size;
+    double nearest = radius;
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        size_t i = found ? guide->search.candidates.indices[k] : k;
+        double t = fmax(0.0, fmin(1.0, ((p->x - soa->bottomX[i]) * soa->dirX[i] + (p->y - soa->bottomY[i]) * soa->dirY[i]) * soa->invLength2[i]));
+        double dx = soa->bottomX[i] + t * soa->dirX[i] - p->x;
+        double dy = soa->bottomY[i] + t * soa->dirY[i] - p->y;
+        nearest = fmin(nearest, sqrt(dx * dx + dy * dy));
+    }
+    return nearest;
+}
+
+/*
+ * Generates NUM_QUERIES queries of the given distribution for the map of guide:
+ * open: at least a meter away from all border lines, pushed in a random direction
+ * near: up to half a meter from a border line on its good side, pushed towards it
+ * across: up to half a meter from a border line on its bad side, pushed in a random direction
+ */
+void createQueries(BlindGuide * guide, enum distribution distribution, QuerySet * queries) {
+    BorderlineSoA * soa = &(guide->soa);
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t i = 0;
+    for (i = 0; i < soa->size; i++) {
+        minX = fmin(minX, fmin(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        maxX = fmax(maxX, fmax(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        minY = fmin(minY, fmin(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+        maxY = fmax(maxY, fmax(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+    }
+    srand(2 + distribution);
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        unsigned int b = rand() % soa->size;
+        double force = randomBetween(1, 10);
+        double direction = randomBetween(-PI, PI);
+        queries->border[q] = getBorderline(&(guide->borderlines), b);
+        queries->phi[q] = 0;
+        queries->forceX[q] = force * cos(direction);
+        queries->forceY[q] = force * sin(direction);
+        if (distribution == OPEN) {
+            Coordinate p;
+            int attempt = 0;
+            do {
+                p = createCoordinate(randomBetween(minX, maxX), randomBetween(minY, maxY));
+            } while (nearestBorderDistance(guide, &p, 1.0) < 1.0 && ++attempt < 100);
+            queries->x[q] = p.x;
+            queries->y[q] = p.y;
+        } else {
+            // Offset a random point of the border line along its normal, which points to the good side
+            double t = randomBetween(0, 1);
+            double normalLength = sqrt(soa->normalX[b] * soa->normalX[b] + soa->normalY[b] * soa->normalY[b]);
+            double nx = soa->normalX[b] / normalLength;
+            double ny = soa->normalY[b] / normalLength;
+            double offset = randomBetween(0.05, 0.5) * (distribution == NEAR_WALLS ? 1 : -1);
+            queries->x[q] = soa->bottomX[b] + t * soa->dirX[b] + offset * nx;
+            queries->y[q] = soa->bottomY[b] + t * soa->dirY[b] + offset * ny;
+            if (distribution == NEAR_WALLS) {
+                queries->forceX[q] = -force * nx;
+                queries->forceY[q] = -force * ny;
+            }
+        }
+    }
+}
+
+/*
+ * Fills obstacles with numObstacles random obstacles within the area of the queries.
+ */
+void createObstacles(QuerySet * queries, unsigned int numObstacles, double * obstacles) {
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        minX = fmin(minX, queries->x[q]);
+        maxX = fmax(maxX, queries->x[q]);
+        minY = fmin(minY, queries->y[q]);
+        maxY = fmax(maxY, queries->y[q]);
+    }
+    srand(3);
+    unsigned int i = 0;
+    for (i = 0; i < numObstacles; i++) {
+        obstacles[2 * i] = randomBetween(minX, maxX);
+        obstacles[2 * i + 1] = randomBetween(minY, maxY);
+    }
+}
+
+/*
+ * Returns whether function is the benchmarked function name, possibly followed by a ":variant" suffix (see benchmarkParams()).
+ */
+int isFunction(const char * function, const char * name) {
+    size_t length = strcspn(function, ":");
+    return strlen(name) == length && strncmp(function, name, length) == 0;
+}
+
+/*
+ * Runs the given function for count queries starting at query first, and returns the sum of the results.
+ * The element functions use the parameters of guide.
+ */
+double runQueries(const char * function, BlindGuide * guide, QuerySet * queries, size_t first, size_t count, unsigned int numObstacles, double * obstacles) {
+    double sum = 0;
+    size_t k = 0;
+    if (isFunction(function, "getResistance")) {
+        for (k = 0; k < count; k++) {
+            size_t q = (first + k) % NUM_QUERIES;
+            sum += guideGetResistance(guide, queries->x[q], queries->y[q], queries->phi[q], queries->forceX[q], queries->forceY[q], numObstacles, obstacles);
+        }
+    } else if (isFunction(function, "getResistanceBatch")) {
+        static double poses[3 * BATCH_SIZE], forces[2 * BATCH_SIZE], resistances[BATCH_SIZE];
+        for (k = 0; k < count; k += BATCH_SIZE) {
+            size_t n = count - k < BATCH_SIZE ? count - k : BATCH_SIZE;
+            size_t j = 0;
+            for (j = 0; j < n; j++) {
+                size_t q = (first + k + j) % NUM_QUERIES;
+                poses[3 * j] = queries->x[q];
+                poses[3 * j + 1] = queries->y[q];
+                poses[3 * j + 2] = queries->phi[q];
+                forces[2 * j] = queries->forceX[q];
+                forces[2 * j + 1] = queries->forceY[q];
+            }
+            guideGetResistanceBatch(guide, n, poses, forces, numObstacles, obstacles, resistances);
+            for (j = 0; j < n; j++) {
+                sum += resistances[j];
+            }
+        }
+    } else if (isFunction(function, "approachingBorder")) {
+        for (k = 0; k < count; k++) {
+            size_t q = (first + k) % NUM_QUERIES;
+            Coordinate p = createCoordinate(queries->x[q], queries->y[q]);
+            Vector force = createVector(queries->forceX[q], queries->forceY[q]);
+            Vector toBorder;
+            sum += paramsApproachingBorder(&(guide->params), &p, &(queries->border[q]), &force, queries->phi[q], &toBorder) + toBorder.length;
+        }
+    } else if (isFunction(function, "approachingObstacle")) {
+        for (k = 0; k < count; k++) {
+            size_t q = (first + k) % NUM_QUERIES;
+            Coordinate p = createCoordinate(queries->x[q], queries->y[q]);
+            Vector force = createVector(queries->forceX[q], queries->forceY[q]);
+            Vector toBorder;
+            sum += paramsApproachingObstacle(&(guide->params), &p, queries->x[q] + 1, queries->y[q] + 1, &force, queries->phi[q], &toBorder) + toBorder.length;
+        }
+    } else if (isFunction(function, "getDistanceResistance")) {
+        for (k = 0; k < count; k++) {
+            size_t q = (first + k) % NUM_QUERIES;
+            Vector force = createVector(queries->forceX[q], queries->forceY[q]);
+            sum += paramsGetDistanceResistance(&(guide->params), &force, 0.1 + queries->x[q] - floor(queries->x[q]));
+        }
+    }
+    return sum;
+}
+
+/*
+ * Measures the given function for at least MIN_TIME seconds and prints a CSV row with the results.
+ */
+void measure(const char * function, const char * map, BlindGuide * guide, enum distribution distribution, QuerySet * queries, unsigned int numObstacles, double * obstacles) {
+    // Warm up the caches, and find a number of queries per round that takes about a tenth of MIN_TIME
+    size_t round = 16;
+    for (;;) {
+        double start = now();
+        sink = runQueries(function, guide, queries, 0, round, numObstacles, obstacles);
+        if (now() - start > MIN_TIME / 10 || round >= 1u << 24) {
+            break;
+        }
+        round *= 2;
+    }
+    size_t total = 0;
+    double start = now();
+    unsigned long long startCycles = cycles();
+    double elapsed = 0;
+    while (elapsed < MIN_TIME) {
+        sink = runQueries(function, guide, queries, total, round, numObstacles, obstacles);
+        total += round;
+        elapsed = now() - start;
+    }
+    unsigned long long totalCycles = cycles() - startCycles;
+    printf("%s,%s,%zu,%s,%u,%zu,%.1f,%.0f,%.0f\n", function, map, guide->borderlines.size, distributionNames[distribution], numObstacles, total,
+        elapsed / total * 1e9, total / elapsed, (double) totalCycles / total);
+    fflush(stdout);
+}
+
+/*
+ * Measures the functions that depend on the parameters for queries near the walls of the map of guide, with the compiled parameters (variant default),
+ * a LEFT handed user (variant left) and different radii and times (variant radius), to show that runtime parameters cost nothing.
+ * Restores the compiled parameters afterwards.
+ */
+void benchmarkParams(const char * map, BlindGuide * guide, QuerySet * queries) {
+    const char * functions[] = {"getResistance", "getResistanceBatch", "approachingBorder", "approachingObstacle"};
+    const char * variants[] = {"default", "left", "radius"};
+    size_t v = 0;
+    for (v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        GuideParams params;
+        getDefaultParams(&params);
+        if (strcmp(variants[v], "left") == 0) {
+            params.userHandedness = params.userHandedness == LEFT ? RIGHT : LEFT;
+        } else if (strcmp(variants[v], "radius") == 0) {
+            params.radius = 0.25;
+            params.userRadius = 0.6;
+            params.resistanceTime = 4.0;
+        }
+        guideSetParams(guide, &params);
+        size_t f = 0;
+        for (f = 0; f < sizeof(functions) / sizeof(functions[0]); f++) {
+            char function[64];
+            snprintf(function, sizeof(function), "%s:%s", functions[f], variants[v]);
+            measure(function, map, guide, NEAR_WALLS, queries, 0, NULL);
+        }
+    }
+    GuideParams params;
+    getDefaultParams(&params);
+    guideSetParams(guide, &params);
+}
+
+/*
+ * Runs all benchmarks for the map of guide.
+ */
+void benchmarkMap(const char * map, BlindGuide * guide) {
+    static QuerySet queries;
+    unsigned int obstacleCounts[] = {0, 16, 256};
+    double * obstacles = (double *) malloc(2 * 256 * sizeof(double));
+    int d = 0;
+    for (d = OPEN; d <= ACROSS_BORDERS; d++) {
+        createQueries(guide, (enum distribution) d, &queries);
+        size_t o = 0;
+        for (o = 0; o < sizeof(obstacleCounts) / sizeof(obstacleCounts[0]); o++) {
+            createObstacles(&queries, obstacleCounts[o], obstacles);
+            measure("getResistance", map, guide, (enum distribution) d, &queries, obstacleCounts[o], obstacles);
+        }
+        measure("getResistanceBatch", map, guide, (enum distribution) d, &queries, 0, obstacles);
+        measure("approachingBorder", map, guide, (enum distribution) d, &queries, 0, obstacles);
+        measure("approachingObstacle", map, guide, (enum distribution) d, &queries, 0, obstacles);
+        measure("getDistanceResistance", map, guide, (enum distribution) d, &queries, 0, obstacles);
+        if (d == NEAR_WALLS) {
+            benchmarkParams(map, guide, &queries);
+        }
+    }
+    free(obstacles);
+}
+
+/*
+ * Benchmarks the resistance pipeline on the bundled maps and synthetic maps of up to maxSegments border lines (first argument),
+ * and prints the results as CSV. Cycles are time stamp counter cycles (0 when not available).
+ */
+int main(int argc, char ** argv) {
+    size_t maxSegments = argc > 1 ? (size_t) atol(argv[1]) : MAX_SEGMENTS;
+    printf("function,map,segments,distribution,obstacles,queries,ns_per_query,queries_per_sec,cycles_per_query\n");
+
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    guideInitializeBorders(&guide);
+    benchmarkMap("zigzag", &guide);
+    freeBlindGuide(&guide);
+
+    const char * bundled[] = {"windy", "outer"};
+    size_t m = 0;
+    for (m = 0; m < sizeof(bundled) / sizeof(bundled[0]); m++) {
+        char path[64];
+        snprintf(path, sizeof(path), "maps/%s.txt", bundled[m]);
+        createBlindGuide(&guide);
+        if (guideImportTextMap(&guide, path, NULL) > 0) {
+            benchmarkMap(bundled[m], &guide);
+        } else {
+            fprintf(stderr, "Skipping %s, cannot read %s\n", bundled[m], path);
+        }
+        freeBlindGuide(&guide);
+    }
+
+    size_t numSegments = 0;
+    for (numSegments = 1000; numSegments <= maxSegments; numSegments *= 10) {
+        createBlindGuide(&guide);
+        createBuilding(&guide, numSegments);
+        benchmarkMap("building", &guide);
+        freeBlindGuide(&guide);
+    }
+    return 0;
+}
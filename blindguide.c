@@ -22,12 +22,21 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 /* include h-files */
 #include "Simulink/Bus/busses/bus.h"
 #include "Global_par/constants.h"
 #include "GeneralFunctions/generic_functions.h"
 #include "blindguide.h"
+#include "mapfile.h"
+#include "replay.h"
+#ifdef BAKED_MAP_HEADER
+#include BAKED_MAP_HEADER                /* baked map (see bakedmap.h) that replaces the compiled-in borderCoordinates */
+#endif
+#if TRACE
+#include "trace.h"
+#endif
 
 Coordinate createCoordinate(double x, double y) {
     Coordinate c;
@@ -60,12 +69,22 @@ Vector createVector(double x, double y) {
 #define NINPUTS2    48                   /* Ball xyzdxdydz */
 double NINPUTS_BGuide[NINPUTS] =  {NINPUTS0,NINPUTS1,NINPUTS2};
 
+/* The ball port carries one Ball bus (x y z dx dy dz), whose position is the only obstacle */
+#define NUM_OBSTACLES   1
+
 
 /****************************
  * Output Ports definitions *
  ****************************/
-#define NOUTPUTS    1
 #define NOUTPUTS0   1              /* Resistance */
+#if STATS
+/* Statistics of this tick: borders tested, obstacles tested, cache refreshed, full scan, action (0 NOTHING, 1 RESIST, 2 STOP), latency ns,
+ * followed by the p99 and maximum latency in ns since the start of the simulation */
+#define NOUTPUTS    2
+#define NOUTPUTS1   8
+#else
+#define NOUTPUTS    1
+#endif
 
 /*************************************************************************/
 static void mdlInitializeSizes(SimStruct *S)
@@ -104,6 +123,10 @@ static void mdlInitializeSizes(SimStruct *S)
     if (!ssSetNumOutputPorts(S, NOUTPUTS)) return;
     ssSetOutputPortWidth(S,0,NOUTPUTS0);
     ssSetOutputPortDataType(S,0,SS_DOUBLE);
+#if STATS
+    ssSetOutputPortWidth(S,1,NOUTPUTS1);
+    ssSetOutputPortDataType(S,1,SS_DOUBLE);
+#endif
     
 
     /***********************
@@ -119,7 +142,7 @@ static void mdlInitializeSizes(SimStruct *S)
 
     ssSetNumRWork(S, 0);
     ssSetNumIWork(S, 0);
-    ssSetNumPWork(S, 0);
+    ssSetNumPWork(S, 5);                /* Blind guide with the border map, obstacle buffer, border cache, trace and replay log, all built in mdlStart */
     ssSetNumModes(S, 0);
 }
     
@@ -152,6 +175,161 @@ static void mdlInitializeSampleTimes(SimStruct *S)
     ssSetOffsetTime(S, 0, FIXED_IN_MINOR_STEP_OFFSET);
 }
 
+/*************************************************************************/
+/* Environment variable with the path of a map file (see mapfile.h) that replaces the compiled-in map */
+#define MAP_FILE_VARIABLE "BLINDGUIDE_MAP"
+
+/* Loads the map file named by MAP_FILE_VARIABLE into guide, or the compiled-in map when the variable is not set:
+ * the map baked into BAKED_MAP_HEADER when that is defined (e.g. -DBAKED_MAP_HEADER='"venue.h"'), borderCoordinates otherwise */
+static void loadBorders(SimStruct *S, BlindGuide* guide)
+{
+    const char* path = getenv(MAP_FILE_VARIABLE);
+    if (path == NULL || path[0] == '\0') {
+#ifdef BAKED_MAP_HEADER
+        if (!guideLoadBakedMap(guide, &BAKED_MAP)) {
+#else
+        if (!guideInitializeBorders(guide)) {
+#endif
+            ssSetErrorStatus(S, "Not enough memory for the border map");
+        }
+    } else if (!guideLoadMap(guide, path)) {
+        ssSetErrorStatus(S, "Cannot load the map file named by " MAP_FILE_VARIABLE);
+    }
+}
+
+#if STATIC_CAPACITY
+/* Returns 1 when loadBorders() reuses the memory of the current map, which only holds for borderCoordinates:
+ * a map file or a baked map needs memory of its own, which cannot be allocated once mdlStart has frozen allocations */
+static int bordersReloadInPlace(void)
+{
+#ifdef BAKED_MAP_HEADER
+    return 0;
+#else
+    const char* path = getenv(MAP_FILE_VARIABLE);
+    return path == NULL || path[0] == '\0';
+#endif
+}
+#endif
+
+#if TRACE
+/* Environment variable with the path of a trace file (see trace.h) that receives the decision trace of every step */
+#define TRACE_FILE_VARIABLE "BLINDGUIDE_TRACE"
+
+/* Trace of the S-function: the ring written by mdlOutputs, and the writer that moves it to the trace file from another thread */
+typedef struct SFunctionTrace {
+    TraceRing ring;
+    TraceWriter writer;
+} SFunctionTrace;
+
+/* Starts tracing the queries through cache to the trace file named by TRACE_FILE_VARIABLE, returns NULL when the variable is not set or tracing failed */
+static SFunctionTrace* startTrace(SimStruct *S, BorderCache* cache)
+{
+    const char* path = getenv(TRACE_FILE_VARIABLE);
+    if (path == NULL || path[0] == '\0') {
+        return NULL;
+    }
+    /* Tracing is optional, so run without it instead of stopping the simulation when its memory is exhausted */
+    SFunctionTrace* trace = (SFunctionTrace*)malloc(sizeof(SFunctionTrace));
+    if (trace == NULL) {
+        ssWarning(S, "Not enough memory for the trace, tracing is disabled");
+        return NULL;
+    }
+    createTraceRing(&trace->ring, 0);
+    if (trace->ring.capacity == 0) {
+        ssWarning(S, "Not enough memory for the trace, tracing is disabled");
+        free(trace);
+        return NULL;
+    }
+    if (!startTraceWriter(&trace->writer, &trace->ring, path)) {
+        ssSetErrorStatus(S, "Cannot create the trace file named by " TRACE_FILE_VARIABLE);
+        freeTraceRing(&trace->ring);
+        free(trace);
+        return NULL;
+    }
+    cache->search.trace = &trace->ring;
+    setTraceEnabled(&trace->ring, 1);
+    return trace;
+}
+#endif
+
+/* Environment variable with the path of a replay log (see replay.h) that records the query of every step */
+#define LOG_FILE_VARIABLE "BLINDGUIDE_LOG"
+
+/* Creates the replay log named by LOG_FILE_VARIABLE, returns NULL when the variable is not set */
+static ReplayLogWriter* openRecorder(SimStruct *S)
+{
+    const char* path = getenv(LOG_FILE_VARIABLE);
+    if (path == NULL || path[0] == '\0') {
+        return NULL;
+    }
+    ReplayLogWriter* recorder = (ReplayLogWriter*)malloc(sizeof(ReplayLogWriter));
+    if (recorder == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the replay log");
+        return NULL;
+    }
+    if (!openReplayLog(recorder, path)) {
+        ssSetErrorStatus(S, "Cannot create the replay log named by " LOG_FILE_VARIABLE);
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+/*************************************************************************/
+#define MDL_START
+static void mdlStart(SimStruct *S)
+{
+#if STATIC_CAPACITY
+    /* Another block may have frozen allocations at the end of its mdlStart already */
+    freezeAllocations(0);
+#endif
+
+    /* Build the border map once, it is reused by every call to mdlOutputs */
+    BlindGuide* guide = (BlindGuide*)malloc(sizeof(BlindGuide));
+    if (guide == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the blind guide");
+        return;
+    }
+    createBlindGuide(guide);
+    loadBorders(S, guide);
+    ssSetPWorkValue(S, 0, guide);
+
+    /* Preallocate the buffer for the obstacles decoded from the ball port */
+    double* obstacles = (double*)malloc(2 * NUM_OBSTACLES * sizeof(double));
+    ssSetPWorkValue(S, 1, obstacles);
+    if (obstacles == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the obstacle buffer");
+        return;
+    }
+
+    /* The robot only moves a little between consecutive steps, so keep the border lines near it in cache */
+    BorderCache* cache = (BorderCache*)calloc(1, sizeof(BorderCache));
+    ssSetPWorkValue(S, 2, cache);
+    if (cache == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the border cache");
+        return;
+    }
+
+    /* Only trace when asked for, the trace is written to file from another thread so mdlOutputs never waits for it */
+#if TRACE
+    ssSetPWorkValue(S, 3, startTrace(S, cache));
+#else
+    ssSetPWorkValue(S, 3, NULL);
+#endif
+
+    /* Only record the queries when asked for, so that they can be replayed offline (see replay.h) */
+    ssSetPWorkValue(S, 4, openRecorder(S));
+
+#if STATIC_CAPACITY
+    /* Take all memory the queries need from the arena now, such that mdlOutputs never allocates (see guideReserve()) */
+    if (!guideReserve(guide, guide->borderlines.size, NUM_OBSTACLES) || !guideReserveSearch(guide, &cache->search, NUM_OBSTACLES)) {
+        ssSetErrorStatus(S, "Not enough memory in the static arena, increase STATIC_ARENA_SIZE");
+    }
+    /* All memory is reserved, so from now on allocating is an error */
+    freezeAllocations(1);
+#endif
+}
+
 /*************************************************************************/
 #define MDL_INITIALIZE_CONDITIONS
 static void mdlInitializeConditions(SimStruct *S)
@@ -164,22 +342,92 @@ static void mdlInitializeConditions(SimStruct *S)
 static void mdlOutputs(SimStruct *S, int_T tid)
 {
     /* Input Ports */
-    pPose_t cur_xyo = (pPose_t)ssGetInputPortRealSignalPtrs(S,0);             /* motionbus */
-    double* Fvec    = (double*)ssGetInputPortRealSignalPtrs(S,1);
-    pBall_t ball    = (pBall_t)ssGetInputPortRealSignalPtrs(S,2);
+    /* All ports are contiguous, so read the signals themselves instead of the pointers to their elements */
+    pPose_t cur_xyo = (pPose_t)ssGetInputPortSignal(S,0);             /* motionbus */
+    const double* Fvec = (const double*)ssGetInputPortSignal(S,1);
+    pBall_t ball    = (pBall_t)ssGetInputPortSignal(S,2);
 
     /* Output Ports */
     double* resistance      = (double*)ssGetOutputPortSignal(S,0);
-   
-    initializeBorders();
-    *resistance = getResistance(cur_xyo->x, cur_xyo->y, cur_xyo->o, Fvec[0], Fvec[1], 1, ball->pos.arr);
-    cleanup();
-    
+
+    /* Blind guide with the border map */
+    BlindGuide* guide       = (BlindGuide*)ssGetPWorkValue(S,0);
+    double* obstacles       = (double*)ssGetPWorkValue(S,1);
+    BorderCache* cache      = (BorderCache*)ssGetPWorkValue(S,2);
+    ReplayLogWriter* recorder = (ReplayLogWriter*)ssGetPWorkValue(S,4);
+    unsigned int numObstacles = NUM_OBSTACLES;
+
+    /* The obstacle is the position of the ball on the ball bus */
+    obstacles[0] = ball->pos.arr[0];
+    obstacles[1] = ball->pos.arr[1];
+
+    /* Only rebuild the border map when it has been invalidated */
+    if (bordersOutdated(&guide->borderlines)) {
+#if STATIC_CAPACITY
+        if (!bordersReloadInPlace()) {
+            ssSetErrorStatus(S, "Cannot reload a map file or baked map while allocations are frozen");
+            return;
+        }
+#endif
+        loadBorders(S, guide);
+    }
+#if STATS
+    GuideStats before = cache->search.stats;
+#endif
+    *resistance = guideGetResistanceCached(guide, cache, cur_xyo->x, cur_xyo->y, cur_xyo->o, Fvec[0], Fvec[1], numObstacles, obstacles);
+    if (recorder != NULL) {
+        appendReplayRecord(recorder, cur_xyo->x, cur_xyo->y, cur_xyo->o, Fvec[0], Fvec[1], numObstacles, obstacles);
+    }
+#if STATS
+    /* Publish the counters of this tick, which are the differences with the counters before the query */
+    GuideStats* after = &cache->search.stats;
+    double* stats = (double*)ssGetOutputPortSignal(S,1);
+    stats[0] = (double)(after->bordersTested - before.bordersTested);
+    stats[1] = (double)(after->obstaclesTested - before.obstaclesTested);
+    stats[2] = (double)(after->cacheRefreshes - before.cacheRefreshes);
+    stats[3] = (double)(after->fullScans - before.fullScans);
+    stats[4] = after->actions[STOP] != before.actions[STOP] ? STOP : (after->actions[RESIST] != before.actions[RESIST] ? RESIST : NOTHING);
+    stats[5] = (double)after->lastNanoseconds;
+    stats[6] = getStatsPercentile(after, 0.99);
+    stats[7] = (double)after->maxNanoseconds;
+#endif
 }
 /*************************************************************************/
 static void mdlTerminate(SimStruct *S)
 {
-
+    /* Release the blind guide, obstacle buffer, border cache, trace and replay log built in mdlStart */
+#if STATIC_CAPACITY
+    freezeAllocations(0);
+#endif
+    BlindGuide* guide = (BlindGuide*)ssGetPWorkValue(S,0);
+    if (guide != NULL) {
+        freeBlindGuide(guide);
+        free(guide);
+        ssSetPWorkValue(S, 0, NULL);
+    }
+    free(ssGetPWorkValue(S,1));
+    ssSetPWorkValue(S, 1, NULL);
+    BorderCache* cache = (BorderCache*)ssGetPWorkValue(S,2);
+    if (cache != NULL) {
+        freeBorderCache(cache);
+        free(cache);
+        ssSetPWorkValue(S, 2, NULL);
+    }
+#if TRACE
+    SFunctionTrace* trace = (SFunctionTrace*)ssGetPWorkValue(S,3);
+    if (trace != NULL) {
+        stopTraceWriter(&trace->writer);
+        freeTraceRing(&trace->ring);
+        free(trace);
+        ssSetPWorkValue(S, 3, NULL);
+    }
+#endif
+    ReplayLogWriter* recorder = (ReplayLogWriter*)ssGetPWorkValue(S,4);
+    if (recorder != NULL) {
+        closeReplayLog(recorder);
+        free(recorder);
+        ssSetPWorkValue(S, 4, NULL);
+    }
 }
 
 #ifdef  MATLAB_MEX_FILE    /* Is this file being compiled as a MEX-file? */
@@ -14,8 +14,26 @@
  * limitations under the License.
  */
 
-// Do we need debug output?
-#define DEBUG 0
+#ifndef BLINDGUIDE_H
+#define BLINDGUIDE_H
+
+// Do we need the trace points of the resistance computation (see TraceRing)? Tracing is switched on at runtime, but compiles to nothing when this is 0
+#ifndef TRACE
+    #define TRACE 1
+#endif
+// Do we need performance counters and latency histograms (see GuideStats)? Can also be enabled by compiling with -DSTATS=1
+#ifndef STATS
+    #define STATS 0
+#endif
+
+// Do we store the border lines for the border kernels, and evaluate them, in single precision (see BorderReal)? Can also be enabled by compiling with -DFLOAT32=1
+#ifndef FLOAT32
+    #define FLOAT32 0
+#endif
+// Do we take all memory from a static arena of STATIC_ARENA_SIZE bytes instead of the heap (see guideAllocate())? Can also be enabled by compiling with -DSTATIC_CAPACITY=1
+#ifndef STATIC_CAPACITY
+    #define STATIC_CAPACITY 0
+#endif
 
 // Mass of the robot in kg
 #define MASS 30
@@ -35,57 +53,160 @@
 // Whether the user is LEFT or RIGHT handed (a RIGHT handed user will walk on the RIGHT side of the robot)
 #define USER_HANDEDNESS RIGHT
 
+// Number of queries that getResistanceBatch() evaluates together (must be a multiple of 8)
+#define BATCH_BLOCK_SIZE 16
+// Largest ratio of the area around all queries of a block to the sum of their search areas, beyond which getResistanceBatch() searches them one by one
+#define BATCH_MAX_SPREAD 1.0
+// Number of border lines the block kernels evaluate for a query in the time it takes to search a cell of the grid for it
+#define BATCH_BORDERS_PER_CELL 32
+
+// Size of a (square) cell of the border grid in meter
+#define GRID_CELL_SIZE 1.0
+// Initial number of buckets of the border grid (must be a power of two)
+#define GRID_BUCKETS 64
+// Largest absolute x or y coordinate in meter of a border, such that its grid cells can always be computed (borders further out are rejected)
+#define MAX_COORDINATE 1e6
+
+// Maximum number of border lines of the chains that guideAddBorders() forms from connected border lines,
+// such that the bounding boxes of long walls stay small
+#define BORDER_CHAIN_LENGTH 64
+
+// Extra distance in meter around the search area of which a BorderCache keeps the border lines, so it only needs refreshing after moving this far
+#define BORDER_CACHE_MARGIN 1.0
+
+// Obstacle sets of at least this many obstacles are indexed in a grid before evaluating them
+#define OBSTACLE_INDEX_THRESHOLD 32
+// Minimum size of a (square) cell of the obstacle grid in meter
+#define OBSTACLE_CELL_SIZE 0.5
+
+// Number of buckets of the latency histogram of GuideStats
+#define STATS_BUCKETS 32
+
+// Default number of records of a TraceRing (must be a power of two)
+#define TRACE_CAPACITY 65536
+// Size in bytes of the static arena when STATIC_CAPACITY is 1 (can also be set when compiling, e.g. -DSTATIC_ARENA_SIZE=1048576)
+#ifndef STATIC_ARENA_SIZE
+    #define STATIC_ARENA_SIZE 8388608
+#endif
+
 // THESE DO NOT NEED TO BE CHANGED
 enum action {NOTHING, RESIST, STOP};
 enum side {LEFT, RIGHT};
+enum kernel {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+enum borderState {BORDER_ENABLED, BORDER_DISABLED, BORDER_REMOVED};
+enum traceType {TRACE_QUERY, TRACE_BORDER, TRACE_OBSTACLE, TRACE_RESISTANCE, TRACE_RESULT};
+
+// Alignment in bytes of the blocks of the static arena (the same as malloc)
+#define ARENA_ALIGNMENT 16
+// Number of size classes of the blocks of the static arena: 16, 32, 48, 64, 96, ... bytes, two per power of two
+#define ARENA_CLASSES 64
+// Index of a border line that does not exist, e.g. in the handle returned when a border cannot be added
+#define INVALID_BORDER_INDEX 0xFFFFFFFFu
+
+// The SSE2 and AVX2 border kernels are only available for x86 with GCC compatible compilers
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define BORDER_KERNEL_X86 1
+    #include <immintrin.h>
+#else
+    #define BORDER_KERNEL_X86 0
+#endif
+
+// Precision of the structure of arrays mirror of the border lines and of the border kernels (see FLOAT32)
+#if FLOAT32
+    typedef float BorderReal;
+    #define BORDER_SQRT sqrtf
+    #define BORDER_FMIN fminf
+    #define BORDER_FMAX fmaxf
+#else
+    typedef double BorderReal;
+    #define BORDER_SQRT sqrt
+    #define BORDER_FMIN fmin
+    #define BORDER_FMAX fmax
+#endif
+// Largest difference in resistance between FLOAT32 and double precision for forces of at least 1 Newton on maps of up to about 100 meter
+// (see measurePrecisionError()). Queries within about 1e-5 meter of a decision (touching a border, the side of a border, the edge of the user area,
+// or two borders that are equally far, like at the corner where they meet) may still take the other decision, and then differ by up to 1.
+// Where the resistance changes steeply (e.g. for a force almost along a border), the result is that of a point within about 1e-5 meter
+#define FLOAT32_MAX_DEVIATION 1e-4
+
+#if BORDER_KERNEL_X86
+    // Vector types of BorderReals used by the SSE2 and AVX2 kernels, their number of lanes,
+    // and the intrinsic for them (e.g. SSE2_OP(add) is _mm_add_pd, or _mm_add_ps in single precision)
+    #if FLOAT32
+        typedef __m128 SSE2Real;
+        typedef __m256 AVX2Real;
+        #define SSE2_LANES 4
+        #define AVX2_LANES 8
+        #define SSE2_OP(op) _mm_##op##_ps
+        #define AVX2_OP(op) _mm256_##op##_ps
+    #else
+        typedef __m128d SSE2Real;
+        typedef __m256d AVX2Real;
+        #define SSE2_LANES 2
+        #define AVX2_LANES 4
+        #define SSE2_OP(op) _mm_##op##_pd
+        #define AVX2_OP(op) _mm256_##op##_pd
+    #endif
+#endif
+
+// Functions that are compiled once for every handedness (see SPECIALIZE_HANDEDNESS), and inlined into the function that selects them
+#if defined(__GNUC__)
+    #define SPECIALIZED static inline __attribute__((always_inline))
+#else
+    #define SPECIALIZED static inline
+#endif
+// Calls body with the given arguments followed by the handedness of params as a constant, such that the compiler
+// specializes body for LEFT and RIGHT handed users, and the handedness is only tested once per call instead of once per border line
+#define SPECIALIZE_HANDEDNESS(params, body, ...) ((params)->userHandedness == LEFT ? body(__VA_ARGS__, LEFT) : body(__VA_ARGS__, RIGHT))
 
 #ifndef PI
     #define PI 3.14159265358979323846
 #endif
 
+#include <stdatomic.h>
+
+// Instrumentation of the resistance computation (see GuideStats), which compiles to nothing when STATS is 0
+#if STATS
+    #include <time.h>
+    // Adds n to the given counter of stats (which may be NULL)
+    #define STATS_ADD(stats, counter, n) do { if ((stats) != NULL) { (stats)->counter += (n); } } while (0)
+    // Declares start and sets it to the current time, when a query starts
+    #define STATS_START(start) unsigned long long start = getStatsTime()
+    // Counts a query that started at start in stats (which may be NULL), and adds its latency to the histogram
+    #define STATS_FINISH(stats, start) recordStatsLatency((stats), getStatsTime() - (start))
+#else
+    #define STATS_ADD(stats, counter, n) ((void) 0)
+    #define STATS_START(start)
+    #define STATS_FINISH(stats, start) ((void) 0)
+#endif
+
+#if TRACE
+    // Whether the queries that use the given BorderSearch (which may be NULL) are traced
+    #define TRACING(search) ((search) != NULL && (search)->trace != NULL && atomic_load_explicit(&((search)->trace->enabled), memory_order_relaxed))
+#else
+    #define TRACING(search) 0
+#endif
+
+// Flags of a TraceRecord
+// TRACE_BORDER: the robot is on the good side of the border line
+#define TRACE_GOOD_SIDE 1
+// TRACE_BORDER: the border line lies in the user area, so the user radius was subtracted from its distance
+#define TRACE_USER_AREA 2
+// TRACE_RESISTANCE: the resistance is caused by an obstacle instead of a border line
+#define TRACE_FROM_OBSTACLE 4
+
 /* 
  * The coordinates for the initial borders (bottom_x, bottom_y, top_x, top_y)
  * Note that the border is assumed to be safe to the right of this line
  * So define the top and bottom accordingly
  */
  
-// Only the outer borders:
-/*double borderCoordinates[16] = {
-    -4, -6, -4, 6, // l
-    -4, 6, 4, 6, // j
-    4, 6, 4, -6, // k
-    4, -6, -4, -6, // m
-};*/
-
-// Two lines; one right of the center, one left of the center:
-/*double borderCoordinates[8] = {
-    -1.5, -9.0,
-    -1.5, 9.0,
-    1.5, 9.0,
-    1.5, -9.0
-};*/
-
-// Windy path as specified in:
-// https://i.imgur.com/cc3qda1.png
-/*double borderCoordinates[56] = {
-    -4, -6, -4, 6, // l
-    -4, 6, 4, 6, // j
-    4, 6, 4, -6, // k
-    4, -6, -4, -6, // m
-    
-    1, -3, -1, -2, // r
-    -1, -2, 0, 4, // h
-    0, 4, -3, 4, // i
-    -3, 4, -2, -4, // f
-    -2, -4, 1, -3, // g
-    
-    3, 6, 2, 0, // s
-    2, 0, 3.5, 0, // b
-    3.5, 0, 3.5, -5, // q
-    3.5, -5, -3, -5, // n
-    -3, -5, -4, -6 // p
-};*/
+// Other maps (only the outer borders, two lines left and right of the center, and the windy path) are available as text maps in maps/,
+// which can be converted to map files using mapimport and loaded without recompiling using guideLoadMap() (see mapfile.h)
 
+// A program that bakes its map (see bakedmap.h) and names the header in BAKED_MAP_HEADER leaves these coordinates out,
+// together with guideInitializeBorders() and initializeBorders(), so its map is only stored once, in read-only memory
+#ifndef BAKED_MAP_HEADER
 // Zigzag path as specified in:
 // https://i.imgur.com/9O1BrWG.png
 double borderCoordinates[48] = {
@@ -104,6 +225,7 @@ double borderCoordinates[48] = {
     2, 0, 0, -3, // p
     0, -3, 3, -6, // r
 };
+#endif
 
 // A 2D coordinate structure
 typedef struct Coordinate {
@@ -137,29 +259,489 @@ typedef struct Vector {
 } Vector;
 
 /*
- * Dynamic array structure that holds Borderline structures in an array.
- * size indicates the number of elements that are currently present.
+ * A border line as stored in a BorderlineArray, where its coordinates are vertices of the array,
+ * such that the border lines of a chain share their vertices (see getBorderline()).
+ * bottom, top: indices of the bottom and top Coordinate in the vertices of the array
+ * goodSide: side which is considered 'safe' (LEFT or RIGHT)
+ */
+typedef struct BorderEnds {
+    unsigned int bottom;
+    unsigned int top;
+    enum side goodSide;
+} BorderEnds;
+
+/*
+ * Dynamic array structure that holds border lines as the BorderEnds of Borderline structures in an array.
+ * size indicates the number of elements that are currently present (including removed elements, whose slots are reused later).
  * capacity indicates the current maximum capacity of the dynamic array.
+ * version indicates the borderMapVersion the array was initialized from (0 if never initialized).
+ * states holds the borderState of every element.
+ * generations holds for every element how often it has been removed, such that old handles to a reused slot can be recognized.
+ * freeSlots holds the numFree indices of removed elements.
+ * vertices holds the numVertices coordinates of the elements, with room for verticesCapacity: two of its own for every element
+ * added by addToBorderlineArray(), and the vertices of a chain for all its border lines (see guideAddBorderChain()).
  */
 typedef struct BorderlineArray {
-    struct Borderline * borderlines;
+    struct BorderEnds * ends;
     size_t size;
     size_t capacity;
+    unsigned long version;
+    unsigned char * states;
+    unsigned int * generations;
+    unsigned int * freeSlots;
+    size_t numFree;
+    struct Coordinate * vertices;
+    size_t numVertices;
+    size_t verticesCapacity;
 } BorderlineArray;
 
-// Structure that holds all borderlines
-BorderlineArray borderlines;
+/*
+ * Handle to a border in the map of a guide, as returned by guideAddBorder().
+ * index: index of the border in the borderlines array of the guide
+ * generation: generation of that index when the border was added (the handle is invalid once the border has been removed)
+ */
+typedef struct BorderHandle {
+    unsigned int index;
+    unsigned int generation;
+} BorderHandle;
+
+/*
+ * A chain of connected border lines, as added by guideAddBorderChain(), where border line k of the chain runs from vertex k to vertex k + 1
+ * (and the last border line of a closed chain from the last vertex back to the first).
+ * firstVertex, numVertices: the vertices of the chain in the vertices of the BorderlineArray of its map, which are the coordinates of its border lines
+ * firstBorder, numBorders: the border lines of the chain are firstBorder up to (but excluding) firstBorder + numBorders,
+ *                          the chain is closed when numBorders equals numVertices
+ * goodSide: side of every border line of the chain which is considered 'safe' (LEFT or RIGHT)
+ * minX, minY, maxX, maxY: bounding box of the vertices, which contains every border line of the chain
+ */
+typedef struct BorderChain {
+    size_t firstVertex;
+    unsigned int numVertices;
+    unsigned int firstBorder;
+    unsigned int numBorders;
+    enum side goodSide;
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+} BorderChain;
+
+/*
+ * The chains of a map, in the order of their border lines. The border lines of a chain always have consecutive indices,
+ * and their slots are not reused by other borders when they are removed.
+ * chains: array of size chains, with room for capacity chains
+ */
+typedef struct BorderChainArray {
+    struct BorderChain * chains;
+    size_t size;
+    size_t capacity;
+} BorderChainArray;
+
+// Current version of the border map, increased by invalidateBorders()
+unsigned long borderMapVersion = 1;
+
+/*
+ * Dynamic array structure that holds indices into a BorderlineArray.
+ * size indicates the number of elements that are currently present.
+ * capacity indicates the current maximum capacity of the dynamic array.
+ */
+typedef struct IndexArray {
+    unsigned int * indices;
+    size_t size;
+    size_t capacity;
+} IndexArray;
+
+/*
+ * Spatial hash grid over the border lines, so that getResistance() only has to evaluate nearby border lines.
+ * The plane is divided in square cells of GRID_CELL_SIZE meters, and every border line is added to each cell it crosses.
+ * Cells are hashed into numBuckets buckets, so a bucket may hold border lines of several (far apart) cells.
+ * buckets: array of numBuckets IndexArrays
+ * numEntries: total number of indices stored in all buckets
+ */
+typedef struct BorderGrid {
+    struct IndexArray * buckets;
+    size_t numBuckets;
+    size_t numEntries;
+} BorderGrid;
+
+/*
+ * Uniform grid over a set of obstacles, rebuilt by indexObstacles() whenever the obstacles change (e.g. every tick).
+ * Node (i, j) covers the cell [minX + i * cellSize, minX + (i + 1) * cellSize) x [minY + j * cellSize, minY + (j + 1) * cellSize).
+ * The obstacles of cell c = j * width + i are order[cellStart[c]] up to (but excluding) order[cellStart[c + 1]].
+ * numObstacles, obstacles: the indexed obstacles (see getResistance())
+ * usable: 0 when the obstacles could not be indexed (e.g. because of non-finite coordinates)
+ * cells: for every obstacle, the cell that contains it
+ * cellsCapacity, capacity: allocated number of cells and obstacles, which only grow to avoid allocating every tick
+ * candidates: the obstacles found by the last call to collectObstacleCandidates()
+ */
+typedef struct ObstacleIndex {
+    double minX;
+    double minY;
+    double cellSize;
+    size_t width;
+    size_t height;
+    unsigned int * cellStart;
+    unsigned int * order;
+    unsigned int * cells;
+    size_t cellsCapacity;
+    size_t capacity;
+    unsigned int numObstacles;
+    double * obstacles;
+    int usable;
+    struct IndexArray candidates;
+} ObstacleIndex;
+
+/*
+ * Performance counters and latency histogram of the resistance computation, only updated when compiled with STATS enabled.
+ * Every BorderSearch has its own, so threads never share counters; use mergeStats() to combine them.
+ * queries: number of resistance computations
+ * bordersTested: number of border lines evaluated (including border lines evaluated again when all border lines had to be checked)
+ * obstaclesTested: number of obstacles evaluated
+ * fullScans: number of queries that evaluated all border lines, because neither the grid nor the chains could narrow down the search (also when checking whether a skipped border line might be closer)
+ * cacheRefreshes: number of times a BorderCache collected its border lines from the grid again
+ * actions: number of queries whose final action was NOTHING, RESIST or STOP (indexed by enum action)
+ * latency: latency[k] is the number of queries that took between 2^k and 2^(k+1) - 1 nanoseconds (latency[0] also counts queries of 0 nanoseconds)
+ * totalNanoseconds, maxNanoseconds, lastNanoseconds: sum, maximum and most recent latency of the queries
+ */
+typedef struct GuideStats {
+    unsigned long long queries;
+    unsigned long long bordersTested;
+    unsigned long long obstaclesTested;
+    unsigned long long fullScans;
+    unsigned long long cacheRefreshes;
+    unsigned long long actions[3];
+    unsigned long long latency[STATS_BUCKETS];
+    unsigned long long totalNanoseconds;
+    unsigned long long maxNanoseconds;
+    unsigned long long lastNanoseconds;
+} GuideStats;
+
+/*
+ * Fixed size binary record of the decision trace of the resistance computation, written to a TraceRing.
+ * type: the enum traceType of the record, which determines the meaning of the other fields:
+ *   TRACE_QUERY: start of a query, index is the number of obstacles,
+ *                values are x, y, phi, forceX and forceY of the query and the resistance for moving backwards (see prepareResistance())
+ *   TRACE_BORDER: an evaluated border line, index is the border line, action its action and flags TRACE_GOOD_SIDE and TRACE_USER_AREA,
+ *                 values are parameter t of the closest point along the border line, the distance to the border line (after subtracting the radius and possibly the user radius),
+ *                 the cosine of the angle between the force and the border line, the distance along the force vector, and the x and y of the closest point
+ *   TRACE_OBSTACLE: an evaluated obstacle, index is the obstacle and action its action, values are the x and y of the obstacle and the distance along the force vector
+ *   TRACE_RESISTANCE: resistance for the nearest border line (or obstacle when flags contains TRACE_FROM_OBSTACLE), values are the distance along the force vector,
+ *                     the resistance for that distance (see getDistanceResistance()) and the resistance so far
+ *   TRACE_RESULT: end of a query, action is the final action, values[0] is the resistance
+ * query: number of the query within the TraceRing, which is the same for all records of a query
+ */
+typedef struct TraceRecord {
+    unsigned char type;
+    unsigned char action;
+    unsigned char flags;
+    unsigned char reserved;
+    unsigned int index;
+    unsigned long long query;
+    double values[6];
+} TraceRecord;
+
+/*
+ * Lock-free single producer, single consumer ring buffer of TraceRecords.
+ * The producer is the thread computing resistances (see guideSetTrace()), which never waits: when the ring is full, records are dropped and counted.
+ * The consumer reads the records with readTrace(), e.g. from a separate thread that writes them to a file (see trace.h).
+ * records: capacity records, where capacity is a power of two
+ * head: number of records written by the producer
+ * tail: number of records read by the consumer (head and tail are on separate cache lines, so producer and consumer do not slow each other down)
+ * enabled: whether records are written, can be changed at any time and from any thread with setTraceEnabled()
+ * dropped: number of records that were dropped because the ring was full
+ * query: number of queries traced so far (only used by the producer)
+ */
+typedef struct TraceRing {
+    struct TraceRecord * records;
+    size_t capacity;
+    _Atomic int enabled;
+    _Atomic unsigned long long dropped;
+    unsigned long long query;
+    char padding1[64];
+    _Atomic size_t head;
+    char padding2[64];
+    _Atomic size_t tail;
+    char padding3[64];
+} TraceRing;
+
+/*
+ * Scratch space for searching a BorderGrid. The grid itself is only read while searching,
+ * so several threads can search the same grid at the same time when each uses its own BorderSearch.
+ * stamps: for every border line, the last query that visited it (prevents evaluating a border line twice)
+ * stampsCapacity: number of elements in stamps
+ * query: number of the current query
+ * candidates: the border lines found by the last call to collectBorderCandidates()
+ * obstacles: index over the obstacles of the current query, used for large obstacle sets
+ * stats: counters of the queries that used this BorderSearch (kept when the BorderSearch is freed)
+ * trace: ring that receives the decision trace of the queries that use this BorderSearch, NULL when they are not traced
+ * action: the final action of the last query that used this BorderSearch
+ */
+typedef struct BorderSearch {
+    unsigned int * stamps;
+    size_t stampsCapacity;
+    unsigned int query;
+    struct IndexArray candidates;
+    struct ObstacleIndex obstacles;
+    struct GuideStats stats;
+    struct TraceRing * trace;
+    enum action action;
+} BorderSearch;
+
+/*
+ * Border lines near the last position of a robot, reused by guideGetResistanceCached() while the robot stays close to that position.
+ * search: scratch space for searching the grid, where search.candidates holds the cached border lines
+ * center: position the cached border lines were collected around
+ * radius: every border line with a point within radius meters of center is cached
+ * narrowed: 0 when the grid could not narrow down the search, in which case all border lines are evaluated
+ * guide, revision: the guide and its revision the border lines were collected from (guide is NULL when the cache is empty)
+ */
+typedef struct BorderCache {
+    struct BorderSearch search;
+    struct Coordinate center;
+    double radius;
+    int narrowed;
+    struct BlindGuide * guide;
+    unsigned long revision;
+} BorderCache;
+
+/*
+ * Structure of arrays mirror of a BorderlineArray, used by the border kernels.
+ * For border line i:
+ * bottomX, bottomY: bottom coordinate
+ * dirX, dirY: direction from bottom to top (not normalized)
+ * invLength2: one over the squared length of the border line
+ * normalX, normalY: normal of the border line pointing towards its good side (not normalized)
+ * size and capacity are the same as for BorderlineArray.
+ * The arrays hold BorderReals, so they take half the memory when compiled with FLOAT32.
+ */
+typedef struct BorderlineSoA {
+    BorderReal * bottomX;
+    BorderReal * bottomY;
+    BorderReal * dirX;
+    BorderReal * dirY;
+    BorderReal * invLength2;
+    BorderReal * normalX;
+    BorderReal * normalY;
+    size_t size;
+    size_t capacity;
+} BorderlineSoA;
+
+/*
+ * A block of BATCH_BLOCK_SIZE queries, as evaluated by the border block kernels of getResistanceBatch().
+ * For query q:
+ * x, y: position of the robot
+ * forceX, forceY: rotated unit force vector (see prepareResistance())
+ * cosPhi, sinPhi: cosine and sine of the rotation of the robot
+ * nearestDistance, closestBorderAction: nearest distance along the force vector and the corresponding action (as a BorderReal)
+ */
+typedef struct BorderQueryBlock {
+    BorderReal x[BATCH_BLOCK_SIZE];
+    BorderReal y[BATCH_BLOCK_SIZE];
+    BorderReal forceX[BATCH_BLOCK_SIZE];
+    BorderReal forceY[BATCH_BLOCK_SIZE];
+    BorderReal cosPhi[BATCH_BLOCK_SIZE];
+    BorderReal sinPhi[BATCH_BLOCK_SIZE];
+    BorderReal nearestDistance[BATCH_BLOCK_SIZE];
+    BorderReal closestBorderAction[BATCH_BLOCK_SIZE];
+} BorderQueryBlock;
+
+/*
+ * Distance field over the border lines, used by getResistanceFromField().
+ * The field consists of width by height nodes, spaced resolution meters apart, where node (i, j) lies at (minX + i * resolution, minY + j * resolution).
+ * For node (i, j), stored at index j * width + i:
+ * distance: distance to the nearest border line
+ * nearest: index of the nearest border line
+ * goodSide: 1 if the node is on the good side of the nearest border line, 0 otherwise
+ * revision: revision of the guide when the field was built. Once the map or the parameters of the guide have changed, getResistanceFromField()
+ *           falls back to guideGetResistance() until the field is rebuilt (enabling and disabling borders keeps the revision;
+ *           queries whose nearest border line is no longer enabled fall back as well)
+ */
+typedef struct DistanceField {
+    double minX;
+    double minY;
+    double resolution;
+    size_t width;
+    size_t height;
+    double * distance;
+    unsigned int * nearest;
+    unsigned char * goodSide;
+    unsigned long revision;
+} DistanceField;
+
+/*
+ * Parameters of the robot and its user, which can be changed at runtime per guide (see guideSetParams()).
+ * The defaults are the defined MASS, RADIUS, USER_RADIUS, STOP_TIME, RESISTANCE_TIME, OBSTACLE_RADIUS, BACKWARDS_RESISTANCE and USER_HANDEDNESS.
+ * mass: mass of the robot in kg
+ * radius: radius around the center of the robot that must stay between the borders in meter
+ * userRadius: radius from the side of the robot that the user is expected to walk in
+ * stopTime: when the robot reaches the border within this many seconds, stop immediately
+ * resistanceTime: when the robot reaches the border within this many seconds, start resisting
+ * obstacleRadius: radius around obstacles in meter
+ * backwardsResistance: minimum resistance when moving backwards
+ * userHandedness: whether the user is LEFT or RIGHT handed
+ */
+typedef struct GuideParams {
+    double mass;
+    double radius;
+    double userRadius;
+    double stopTime;
+    double resistanceTime;
+    double obstacleRadius;
+    double backwardsResistance;
+    enum side userHandedness;
+} GuideParams;
+
+// The parameters as defined at compile time
+static const GuideParams compiledParams = {MASS, RADIUS, USER_RADIUS, STOP_TIME, RESISTANCE_TIME, OBSTACLE_RADIUS, BACKWARDS_RESISTANCE, USER_HANDEDNESS};
+
+// The fields of a GuideParams by number (see getParam() and setParam()), and their names
+enum param {PARAM_MASS, PARAM_RADIUS, PARAM_USER_RADIUS, PARAM_STOP_TIME, PARAM_RESISTANCE_TIME, PARAM_OBSTACLE_RADIUS, PARAM_BACKWARDS_RESISTANCE, PARAM_USER_HANDEDNESS, NUM_PARAMS};
+static const char * const paramNames[NUM_PARAMS] = {"mass", "radius", "userRadius", "stopTime", "resistanceTime", "obstacleRadius", "backwardsResistance", "userHandedness"};
+
+/*
+ * Function type of the border kernels.
+ * Determines the action for the border lines in indices (or the first numIndices border lines when indices is NULL) of soa.
+ * nearestDistance and closestBorderAction are updated with the border line that is closest along the force vector,
+ * exactly like evaluateBorders() does.
+ */
+typedef void (*BorderKernel)(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, struct GuideParams * params);
+
+/*
+ * Sections of a map that a guide can use in place, as stored in a map file (see mapfile.h) or a baked map (see bakedmap.h):
+ * ends, states: the BorderEnds of numBorderlines border lines and their borderStates
+ * soa: the seven arrays of their BorderlineSoA (bottomX, bottomY, dirX, dirY, invLength2, normalX, normalY) of numBorderlines BorderReals each
+ * bucketStart, entries: the BorderGrid (only when numBuckets is not 0), where bucket b holds entries[bucketStart[b]] up to (but excluding) entries[bucketStart[b + 1]]
+ * chains: numChains BorderChain structures
+ * vertices: the numVertices Coordinates of the border lines, shared by the border lines of a chain (see BorderlineArray)
+ */
+typedef struct MapSections {
+    size_t numBorderlines;
+    const struct BorderEnds * ends;
+    const unsigned char * states;
+    const BorderReal * soa;
+    size_t numBuckets;
+    size_t numEntries;
+    const unsigned int * bucketStart;
+    const unsigned int * entries;
+    size_t numChains;
+    const struct BorderChain * chains;
+    size_t numVertices;
+    const struct Coordinate * vertices;
+} MapSections;
+
+/*
+ * A blind guide context, which owns a border map together with its index and configuration.
+ * Contexts are independent of each other, so several robots or maps can be handled in one process.
+ * borderlines: the border lines of the map
+ * chains: the chains of connected border lines of the map (see guideAddBorderChain())
+ * grid: spatial index over the border lines
+ * soa: structure of arrays mirror of the border lines, used by the border kernels
+ * search: scratch space used by the guide for searching the grid
+ * kernel: the border kernel used by guideGetResistance() (see guideSelectBorderKernel())
+ * kernelType: the type of kernel
+ * revision: increased on every change of the map or the parameters, such that a BorderCache can tell that it is outdated
+ * params: parameters of the robot and its user (see guideSetParams())
+ * mapping: memory holding the map when it was loaded from a map file (see mapfile.h) or a baked map (see bakedmap.h), NULL otherwise.
+ *          The border lines, chains, structure of arrays mirror and (stored) grid buckets then point into this memory, until borders are added.
+ * mappingSize: size of mapping in bytes
+ * releaseMapping: function that releases mapping
+ * mappingReadOnly: 1 when mapping cannot be written (a baked map), such that removing, enabling or disabling borders copies the map first
+ */
+typedef struct BlindGuide {
+    struct BorderlineArray borderlines;
+    struct BorderChainArray chains;
+    struct BorderGrid grid;
+    struct BorderlineSoA soa;
+    struct BorderSearch search;
+    BorderKernel kernel;
+    enum kernel kernelType;
+    unsigned long revision;
+    struct GuideParams params;
+    void * mapping;
+    size_t mappingSize;
+    void (*releaseMapping)(void * mapping, size_t size);
+    int mappingReadOnly;
+} BlindGuide;
+
+// Guide used by the functions that do not take a guide (initializeBorders(), addBorder(), getResistance(), cleanup(), ...)
+BlindGuide defaultGuide = {.params = {MASS, RADIUS, USER_RADIUS, STOP_TIME, RESISTANCE_TIME, OBSTACLE_RADIUS, BACKWARDS_RESISTANCE, USER_HANDEDNESS}};
+
+/*
+ * Counters of the memory used by blindguide.h (see getAllocationInfo()).
+ * allocations: number of successful allocations and reallocations, which stays the same after initialization when the guide was reserved (see guideReserve())
+ * failures: number of allocations that failed, because the memory was exhausted or allocations were frozen (see freezeAllocations())
+ * arenaUsed: bytes of the static arena in blocks that are in use (0 when STATIC_CAPACITY is 0)
+ * arenaPeak: largest number of bytes of the static arena that were handed out at the same time, released blocks included (the size the arena needs)
+ * arenaSize: size of the static arena in bytes (STATIC_ARENA_SIZE, or 0 when STATIC_CAPACITY is 0)
+ */
+typedef struct AllocationInfo {
+    unsigned long long allocations;
+    unsigned long long failures;
+    size_t arenaUsed;
+    size_t arenaPeak;
+    size_t arenaSize;
+} AllocationInfo;
+
+/*
+ * Allocates size bytes for blindguide.h: from the heap, or from the static arena when STATIC_CAPACITY is 1, such that blindguide.h never calls malloc.
+ * Returns NULL (and counts a failure) when the memory is exhausted or allocations are frozen, so running out of memory is reported instead of crashing:
+ * adding borders then fails, and searches fall back to evaluating all border lines or obstacles, which gives the same results.
+ */
+void * guideAllocate(size_t size);
+
+/*
+ * Changes the size of array (allocated by guideAllocate(), or NULL) to size bytes like realloc().
+ * Returns NULL (and leaves array unchanged) when this fails (see guideAllocate()).
+ */
+void * guideReallocate(void * array, size_t size);
+
+/*
+ * Releases array, which was allocated by guideAllocate() or guideReallocate() (or is NULL). Never fails, also when allocations are frozen.
+ * The static arena reuses the memory of released blocks once every block has been released (or right away for the last block).
+ */
+void guideRelease(void * array);
+
+/*
+ * Freezes (frozen is 1) or unfreezes (frozen is 0) all allocations of blindguide.h: while frozen, every allocation fails.
+ * Freeze after initialization to guarantee that a real-time task never allocates, e.g. after guideReserve().
+ */
+void freezeAllocations(int frozen);
+
+/*
+ * Populates info with the memory counters of blindguide.h (see AllocationInfo).
+ */
+void getAllocationInfo(AllocationInfo * info);
 
 /*
  * Populates the given BorderlineArray structure, such that it is an empty array of capacity size.
+ * Returns 1 on success, or 0 when the memory is exhausted (the array then has capacity 0).
+ */
+int createBorderlineArray(BorderlineArray * ba, size_t size);
+
+/*
+ * Adds the given Borderline element to the specified BorderlineArray, with two new vertices for its bottom and top.
+ * If necessary, increases the capacity of the BorderlineArray array (or of its vertices), multiplying its current capacity by two.
+ * Returns 1 on success, or 0 when the memory is exhausted (the array is then unchanged).
  */
-void createBorderlineArray(BorderlineArray * ba, size_t size);
+int addToBorderlineArray(BorderlineArray * ba, Borderline element);
 
 /*
- * Adds the given Borderline element to the specified BorderlineArray.
- * If necessary, increases the capacity of the BorderlineArray array, multiplying its current capacity by two.
+ * Adds the given Borderline element to the specified BorderlineArray like addToBorderlineArray(), but reuses the slot of a removed element if there is one
+ * (together with its vertices, which are not shared as only the slots of border lines that do not belong to a chain are reused).
+ * Returns the index of the element, or INVALID_BORDER_INDEX when the memory is exhausted.
  */
-void addToBorderlineArray(BorderlineArray * ba, Borderline element);
+unsigned int insertIntoBorderlineArray(BorderlineArray * ba, Borderline element);
+
+/*
+ * Returns element index of the specified BorderlineArray as a Borderline structure, created from its vertices with createBorderline().
+ */
+Borderline getBorderline(BorderlineArray * ba, unsigned int index);
+
+/*
+ * Removes the element at index from the specified BorderlineArray, such that its slot can be reused by insertIntoBorderlineArray().
+ * The indices of the other elements do not change.
+ */
+void removeFromBorderlineArray(BorderlineArray * ba, unsigned int index);
 
 /*
  * Frees the memory allocated to the given BorderlineArray structure.
@@ -167,6 +749,176 @@ void addToBorderlineArray(BorderlineArray * ba, Borderline element);
  */
 void freeBorderlineArray(BorderlineArray * ba);
 
+/*
+ * Adds the given index to the specified IndexArray.
+ * If necessary, increases the capacity of the IndexArray array, multiplying its current capacity by two.
+ * Returns 1 on success, or 0 when the memory is exhausted (the array is then unchanged).
+ */
+int addToIndexArray(IndexArray * ia, unsigned int index);
+
+/*
+ * Frees the memory allocated to the given IndexArray structure.
+ * Also resets the size and capacity to zero.
+ */
+void freeIndexArray(IndexArray * ia);
+
+/*
+ * Adds border line index of ba to all cells of the BorderGrid grid that the border line crosses.
+ * Rehashes the whole grid (skipping removed border lines) when the buckets become too full.
+ * Returns 1 on success, or 0 when the memory is exhausted (the grid then does not contain the border line, but is otherwise unchanged).
+ */
+int addToBorderGrid(BorderGrid * grid, BorderlineArray * ba, unsigned int index);
+
+/*
+ * Removes border line index of ba from all cells of the BorderGrid grid that the border line crosses.
+ * Must be called before the border line is removed from ba.
+ */
+void removeFromBorderGrid(BorderGrid * grid, BorderlineArray * ba, unsigned int index);
+
+/*
+ * Frees the memory allocated to the given BorderGrid structure.
+ */
+void freeBorderGrid(BorderGrid * grid);
+
+/*
+ * Frees the memory allocated to the given BorderSearch structure.
+ */
+void freeBorderSearch(BorderSearch * search);
+
+/*
+ * Collects the indices of all border lines of ba in grid that have a point within radius meters of p into search->candidates.
+ * The result may contain some additional border lines further away, but never contains a border line twice.
+ * The indices are sorted in ascending order.
+ * Returns 0 when the grid cannot narrow down the search (search->candidates is then untouched) or the memory for the candidates is exhausted,
+ * in which case all border lines of ba need to be evaluated.
+ */
+int collectBorderCandidates(BorderGrid * grid, BorderSearch * search, BorderlineArray * ba, Coordinate * p, double radius);
+
+/*
+ * Indexes the given numObstacles obstacles (see getResistance()) in the given ObstacleIndex, replacing any previously indexed obstacles.
+ * The obstacles array is not copied, so it must stay unchanged while the index is used.
+ * Only allocates memory when more obstacles or cells are needed than ever before; when that fails, the index is not usable.
+ */
+void indexObstacles(ObstacleIndex * index, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Frees the memory allocated to the given ObstacleIndex structure.
+ */
+void freeObstacleIndex(ObstacleIndex * index);
+
+/*
+ * Collects the indices of all obstacles in index that are within radius meters of p into index->candidates, sorted in ascending order.
+ * The result may contain some additional obstacles further away.
+ * Returns 0 when the index cannot narrow down the search (index->candidates is then untouched) or the memory for the candidates is exhausted,
+ * in which case all obstacles need to be evaluated.
+ */
+int collectObstacleCandidates(ObstacleIndex * index, Coordinate * p, double radius);
+
+/*
+ * Adds the given Borderline element to the specified BorderlineSoA, precomputing its direction, inverse squared length and normal.
+ * If necessary, increases the capacity of the BorderlineSoA arrays, multiplying its current capacity by two.
+ * Returns 1 on success, or 0 when the memory is exhausted (the arrays are then unchanged).
+ */
+int addToBorderlineSoA(BorderlineSoA * soa, Borderline * element);
+
+/*
+ * Overwrites element i of the specified BorderlineSoA with the given Borderline element.
+ * When enabled is 0, the element is stored with a NaN coordinate instead, such that the border kernels never select it.
+ */
+void updateBorderlineSoA(BorderlineSoA * soa, size_t i, Borderline * element, int enabled);
+
+/*
+ * Frees the memory allocated to the given BorderlineSoA structure.
+ * Also resets the size and capacity to zero.
+ */
+void freeBorderlineSoA(BorderlineSoA * soa);
+
+/*
+ * Returns the border kernel of the given type.
+ * KERNEL_AUTO gives the fastest kernel supported by the CPU.
+ * When the requested kernel is not supported by the CPU, the fastest supported kernel is returned instead.
+ * type is updated with the type of the returned kernel.
+ * All kernels give exactly the same results.
+ */
+BorderKernel getBorderKernel(enum kernel * type);
+
+/*
+ * Selects the border kernel used by the given guide (see getBorderKernel()).
+ * Returns the type of the selected kernel.
+ */
+enum kernel guideSelectBorderKernel(BlindGuide * guide, enum kernel type);
+
+/*
+ * Selects the border kernel used by getResistance(), like guideSelectBorderKernel() for the default guide.
+ */
+enum kernel selectBorderKernel(enum kernel type);
+
+/*
+ * Populates the given BlindGuide structure, such that it has an empty map and uses the fastest border kernel.
+ */
+void createBlindGuide(BlindGuide * guide);
+
+/*
+ * Frees the memory allocated to the given BlindGuide structure, after which it has an empty map.
+ * The parameters of the guide are kept.
+ */
+void freeBlindGuide(BlindGuide * guide);
+
+/*
+ * Replaces the map, parameters and kernel of dest by a copy of those of src, in memory of its own (also when src points into a mapping).
+ * src is only read, so other threads may query it meanwhile. The revision of dest becomes one above the ones of src and dest,
+ * such that a BorderCache that was filled from src or from the old map of dest is refreshed for dest,
+ * even when dest takes the place of src in memory later on.
+ * Returns 1 on success, or 0 when the memory is exhausted (dest then has an empty map).
+ */
+int guideCopyMap(BlindGuide * dest, BlindGuide * src);
+
+/*
+ * Replaces the map of guide by the map in sections, which lie within mapping (of size bytes) and are used in place until release(mapping, size) is called.
+ * When readOnly is 1, the guide copies the map before it changes anything in it. The guide is responsible for mapping from now on, also when this fails.
+ * Marks the borderlines array of the guide with the current borderMapVersion.
+ * Returns 1 on success, or 0 when the memory is exhausted (the guide is then unchanged, or without a map when there is no index and the grid did not fit).
+ */
+int guideUseMapSections(BlindGuide * guide, const MapSections * sections, void * mapping, size_t size, void (*release)(void * mapping, size_t size), int readOnly);
+
+/*
+ * Stores the parameters defined at compile time (MASS, RADIUS, ...) in params.
+ */
+void getDefaultParams(GuideParams * params);
+
+/*
+ * Sets the parameters of the robot and its user that guide uses from the next query on.
+ * The mass and resistanceTime must be positive, the radii, stopTime and backwardsResistance must not be negative,
+ * stopTime must be smaller than resistanceTime and userHandedness must be LEFT or RIGHT.
+ * Returns 1 on success, or 0 when params are invalid (the parameters of guide are then unchanged).
+ */
+int guideSetParams(BlindGuide * guide, GuideParams * params);
+
+/*
+ * Sets the parameters of the default guide, like guideSetParams().
+ */
+int setParams(GuideParams * params);
+
+/*
+ * Returns 1 when params are valid (see guideSetParams()), 0 otherwise.
+ */
+int validParams(GuideParams * params);
+
+/*
+ * Returns the given field of params, where userHandedness is LEFT (0) or RIGHT (1).
+ */
+double getParam(GuideParams * params, enum param param);
+
+/*
+ * Sets the given field of params to value, where userHandedness is LEFT for values below 0.5 and RIGHT otherwise.
+ */
+void setParam(GuideParams * params, enum param param, double value);
+
+/*
+ * Returns the number of the field of a GuideParams with the given name (see paramNames), or -1 when there is none.
+ */
+int findParam(const char * name);
+
 /*
  * Creates and returns a Coordinate structure with the given x and y coordinates.
  */
@@ -192,72 +944,561 @@ Vector createVector(double x, double y);
  */
 void populateVector(double x, double y, Vector * v);
 
+#ifndef BAKED_MAP_HEADER
 /*
- * Creates and fills the borderlines array based on the values in borderCoordinates.
+ * Fills the map of the given guide based on the values in borderCoordinates.
+ * Any previously loaded borders are removed first, so this can also be used to reload the map.
+ * The memory of the previous map is reused, so reloading the same map does not allocate memory.
+ * Marks the borderlines array of the guide with the current borderMapVersion.
+ * Returns 1 on success, or 0 when the memory is exhausted (the map then holds the borders that fit).
  */
-void initializeBorders();
+int guideInitializeBorders(BlindGuide * guide);
 
 /*
- * Adds a border to the border lines array, where the border is specified by the bottom and top x and y coordinates.
- * goodSide indicates which side of the border, given the bottom and top coordinates, the robot should stay on.
+ * Creates and fills the borderlines array of the default guide based on the values in borderCoordinates (see guideInitializeBorders()).
  */
-void addBorder(double bottomX, double bottomY, double topX, double topY, enum side goodSide);
+int initializeBorders();
+#endif
 
 /*
- * Compute the necessary resistance when the robot is at the position defined by x, y and phi
- * and the robot is pushed according to forceX and forceY, where forceX and forceY constitute the
- * force vector.
- * Note that the units of x and y are assumed to be meters, phi in radians, and forceX and forceY Newtons.
- * phi = 0 means that the robot is facing towards the positive y axis
- * obstacles contains an array of 2 * numObstacles elements, where the coordinates for obstacle 0 <= i < numObstacles are specified
- * in obstacles[2 * i] (x) and obstacles[2 * i + 1] (y)
+ * Marks the currently loaded border maps as outdated, e.g. after borderCoordinates has been changed.
+ * Users that keep a map alive between calls should reload it using guideInitializeBorders()
+ * when its version differs from borderMapVersion (see bordersOutdated()).
  */
-double getResistance(double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+void invalidateBorders();
 
 /*
- * Calculate the acceleration along the given force vector.
- * Uses the defined MASS of the robot.
- * Formula: a = F / m.
+ * Returns 1 when the given BorderlineArray was not initialized from the current borderMapVersion, 0 otherwise.
  */
-double getAcceleration(Vector * force);
+int bordersOutdated(BorderlineArray * ba);
 
 /*
- * Calculates and returns the dot product of the two given vectors.
+ * Adds a border to the map of the given guide, where the border is specified by the bottom and top x and y coordinates.
+ * goodSide indicates which side of the border, given the bottom and top coordinates, the robot should stay on.
+ * Also adds the border to the index and structure of arrays mirror of the guide.
+ * Returns a handle that can be used to remove, disable or enable the border later on,
+ * or a handle with index INVALID_BORDER_INDEX when the memory is exhausted or a coordinate is not finite or beyond MAX_COORDINATE (the map is then unchanged).
  */
-double dotProduct(Vector * v1, Vector * v2);
+BorderHandle guideAddBorder(BlindGuide * guide, double bottomX, double bottomY, double topX, double topY, enum side goodSide);
 
 /*
- * Determines whether the robot at position p with the predefined RADIUS is approaching border line b
- * when it is pushed along force vector force, with rotation phi.
- * toBorder will be populated by the vector from p to the closest point along the border line.
- * If the robot is on the 'good' side of the border, and the robot is pushed towards the border, returns RESIST.
- * If the robot is on the 'bad' side of the border, and the robot is pushed away from the border, returns STOP.
- * Else, returns NOTHING.
+ * Adds a border to the border lines array of the default guide (see guideAddBorder()).
  */
-enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder);
+BorderHandle addBorder(double bottomX, double bottomY, double topX, double topY, enum side goodSide);
 
 /*
- * Determines whether the robot at position p with the predefined RADIUS is approaching the obstacle at coordinate (x, y)
- * when it is pushed along force vector force, with rotation phi.
- * toBorder will be populated by the vector from p to the obstacle center
- * If the robot is pushed towards the obstacle, returns RESIST.
- * Else, returns NOTHING.
+ * Removes the border with the given handle from the map of the given guide, and from its index and structure of arrays mirror.
+ * Only the grid cells of the border are updated, so this does not depend on the size of the map.
+ * Returns 1 on success, or 0 when the handle is invalid (e.g. because the border was removed before),
+ * or when the map is baked (see bakedmap.h) and there is not enough memory to copy it.
  */
-enum action approachingObstacle(Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder);
+int guideRemoveBorder(BlindGuide * guide, BorderHandle handle);
 
 /*
- * Determines the resistance needed when the robot is pushed with the given force for dist meters.
- * Uses RESISTANCE_TIME and STOP_TIME to create a linearly increasing resistance when the time to traverse
- * the toBorder vector decreases.
- * Return value is clamped between 0 and 1.
+ * Removes a border from the map of the default guide (see guideRemoveBorder()).
  */
-double getDistanceResistance(Vector * force, double dist);
+int removeBorder(BorderHandle handle);
 
 /*
- * Frees the memory allocated for the borderlines array.
+ * Enables (enabled is 1) or disables (enabled is 0) the border with the given handle in the map of the given guide.
+ * A disabled border is ignored by the resistance computation, but keeps its place in the index, so it can be enabled again in constant time
+ * (e.g. for a door that is closed and opened again).
+ * Returns 1 on success, or 0 when the handle is invalid, or when the map is baked (see bakedmap.h) and there is not enough memory to copy it.
  */
-void cleanup();
-
+int guideEnableBorder(BlindGuide * guide, BorderHandle handle, int enabled);
+
+/*
+ * Enables or disables a border in the map of the default guide (see guideEnableBorder()).
+ */
+int enableBorder(BorderHandle handle, int enabled);
+
+/*
+ * Adds a chain of connected borders to the map of the given guide, where vertices holds 2 * numVertices elements
+ * (vertex k at vertices[2 * k] (x) and vertices[2 * k + 1] (y)) and border k runs from vertex k to vertex k + 1.
+ * When closed is 1, a last border runs from the last vertex back to the first, such that the chain is a polygon.
+ * goodSide indicates which side of every border the robot should stay on (see guideAddBorder()).
+ * The vertices are stored once for the whole chain, and the chain keeps their bounding box, such that queries that cannot narrow down
+ * their search with the grid (see collectBorderCandidates()) skip every chain that is out of reach at once.
+ * The borders of the chain can be removed, disabled and enabled separately with the handles returned by guideGetChainBorder().
+ * Returns the number of the chain, or -1 when the chain has no borders (fewer than two vertices), the memory is exhausted
+ * or a vertex is not finite or beyond MAX_COORDINATE (the map is then unchanged).
+ */
+long guideAddBorderChain(BlindGuide * guide, size_t numVertices, double * vertices, int closed, enum side goodSide);
+
+/*
+ * Adds a chain of connected borders to the map of the default guide (see guideAddBorderChain()).
+ */
+long addBorderChain(size_t numVertices, double * vertices, int closed, enum side goodSide);
+
+/*
+ * Returns the handle of border k of the given chain in the map of the given guide,
+ * or a handle that is invalid for every guide when there is no such chain or border.
+ */
+BorderHandle guideGetChainBorder(BlindGuide * guide, size_t chain, size_t k);
+
+/*
+ * Adds numBorders borders to the map of the given guide, where border i runs from (coordinates[4 * i], coordinates[4 * i + 1]) to
+ * (coordinates[4 * i + 2], coordinates[4 * i + 3]) with good side goodSides[i] (RIGHT for every border when goodSides is NULL).
+ * Runs of consecutive borders where each one starts at the end of the previous one (and has the same good side) are added as chains
+ * of up to BORDER_CHAIN_LENGTH borders (see guideAddBorderChain()), the other borders as separate borders, keeping their order.
+ * Returns 1 on success, or 0 when the memory is exhausted or a coordinate is not finite or beyond MAX_COORDINATE
+ * (the borders before the one that could not be added have been added).
+ */
+int guideAddBorders(BlindGuide * guide, size_t numBorders, double * coordinates, enum side * goodSides);
+
+/*
+ * Allocates the memory for a map of numBorders border lines in the given guide, and the scratch space of its search for that map and numObstacles obstacles
+ * (see guideReserveSearch()), such that adding up to numBorders borders and the queries on that map do not allocate memory.
+ * The grid gets the number of buckets of numBorders borders, and every bucket room for its share of the borders still to come,
+ * taken from where the borders in the map are (so reserve once the map is loaded): only a bucket that gets far more borders
+ * than that still grows. Rebuilding the same map with guideInitializeBorders() reuses the buckets.
+ * A map that is used in place (see guideLoadMap() and guideLoadBakedMap()) is only copied when numBorders does not fit in it, and its first change copies it.
+ * Returns 1 on success, or 0 when the memory is exhausted.
+ */
+int guideReserve(BlindGuide * guide, size_t numBorders, unsigned int numObstacles);
+
+/*
+ * Allocates the scratch space of search for the current capacity of the map of the given guide and numObstacles obstacles,
+ * such that queries with that search (or a BorderCache holding it) do not allocate memory. Returns 1 on success, or 0 when the memory is exhausted.
+ */
+int guideReserveSearch(BlindGuide * guide, BorderSearch * search, unsigned int numObstacles);
+
+/*
+ * Compute the necessary resistance when the robot is at the position defined by x, y and phi
+ * and the robot is pushed according to forceX and forceY, where forceX and forceY constitute the
+ * force vector.
+ * Note that the units of x and y are assumed to be meters, phi in radians, and forceX and forceY Newtons.
+ * phi = 0 means that the robot is facing towards the positive y axis
+ * obstacles contains an array of 2 * numObstacles elements, where the coordinates for obstacle 0 <= i < numObstacles are specified
+ * in obstacles[2 * i] (x) and obstacles[2 * i + 1] (y)
+ */
+double getResistance(double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Compute the necessary resistance like getResistance(), using the map of the given guide.
+ */
+double guideGetResistance(BlindGuide * guide, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Compute the necessary resistance like guideGetResistance(), but use search as scratch space instead of the one of the guide.
+ * The guide is not modified, so several threads can use the same guide at the same time when each uses its own BorderSearch
+ * (the border kernel of the guide must have been selected before, which createBlindGuide() does).
+ */
+double guideGetResistanceWith(BlindGuide * guide, BorderSearch * search, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Compute the necessary resistance like guideGetResistanceWith(), but with params instead of the parameters of the guide,
+ * such that several threads can evaluate different parameters on the same map at the same time. params must be valid (see validParams()).
+ */
+double guideGetResistanceWithParams(BlindGuide * guide, BorderSearch * search, GuideParams * params, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Compute the necessary resistance like guideGetResistance(), for a robot that is queried again and again (e.g. every control tick).
+ * The border lines near the robot are kept in cache, and are only collected from the grid again when the robot has moved
+ * so far (or the force has grown so much) that its search area is no longer covered by the cached area, or when the map has changed.
+ * Gives exactly the same results as guideGetResistance(). Use a separate BorderCache for every robot.
+ */
+double guideGetResistanceCached(BlindGuide * guide, BorderCache * cache, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Frees the memory allocated to the given BorderCache structure, after which it is empty.
+ * A BorderCache should be zero initialized before its first use.
+ */
+void freeBorderCache(BorderCache * cache);
+
+/*
+ * Compute the resistance for numQueries robot poses and force vectors at once, giving the same results as calling getResistance() for every query.
+ * poses contains 3 * numQueries elements, where query i is at poses[3 * i] (x) and poses[3 * i + 1] (y) with rotation poses[3 * i + 2] (phi)
+ * forces contains 2 * numQueries elements, where query i is pushed with forces[2 * i] (forceX) and forces[2 * i + 1] (forceY)
+ * All queries share the same obstacles (see getResistance()).
+ * The resistance for query i is stored in resistances[i].
+ * Queries are evaluated in blocks of BATCH_BLOCK_SIZE, such that every border line near a block is only loaded once for the whole block.
+ * The queries of a block that are spread over a map too large to evaluate all of it for each of them (see BATCH_MAX_SPREAD and BATCH_BORDERS_PER_CELL)
+ * are searched one by one like guideGetResistance() instead.
+ */
+void getResistanceBatch(size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances);
+
+/*
+ * Compute the resistance for numQueries robot poses and force vectors at once like getResistanceBatch(), using the map of the given guide.
+ */
+void guideGetResistanceBatch(BlindGuide * guide, size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances);
+
+/*
+ * Compute the resistance for numQueries queries at once like guideGetResistanceBatch(), but use search as scratch space instead of the one of the guide,
+ * such that several threads can evaluate batches on the same guide at the same time (see guideGetResistanceWith()).
+ */
+void guideGetResistanceBatchWith(BlindGuide * guide, BorderSearch * search, size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances);
+
+/*
+ * Populates the given TraceRing structure, such that it is an empty and disabled ring of at least capacity records (0 for TRACE_CAPACITY).
+ * When the memory is exhausted, the ring has capacity 0 and drops every record.
+ */
+void createTraceRing(TraceRing * ring, size_t capacity);
+
+/*
+ * Frees the memory allocated to the given TraceRing structure. The ring must no longer be used by any guide.
+ */
+void freeTraceRing(TraceRing * ring);
+
+/*
+ * Enables (enabled is 1) or disables (enabled is 0) writing records to the given TraceRing. Can be called from any thread.
+ */
+void setTraceEnabled(TraceRing * ring, int enabled);
+
+/*
+ * Consumer side of the given TraceRing: moves up to maxRecords of the oldest records into records, and returns the number of records moved.
+ * Must only be called from one thread at a time.
+ */
+size_t readTrace(TraceRing * ring, TraceRecord * records, size_t maxRecords);
+
+/*
+ * Returns the number of records that were dropped because the given TraceRing was full.
+ */
+unsigned long long getTraceDropped(TraceRing * ring);
+
+/*
+ * Sends the decision trace of the queries of the given guide (guideGetResistance(), guideGetResistanceBatch() and getResistanceFromField()) to ring,
+ * or stops tracing them when ring is NULL. Tracing only has an effect when compiled with TRACE enabled (the default), and while the ring is enabled.
+ * The guide becomes the producer of the ring, so no other guide, BorderSearch or BorderCache may use the same ring.
+ * To trace queries through guideGetResistanceWith() or guideGetResistanceCached(), set the trace member of their BorderSearch (or search.trace of the BorderCache).
+ * Batches are evaluated one query at a time while they are traced.
+ */
+void guideSetTrace(BlindGuide * guide, TraceRing * ring);
+
+/*
+ * Sends the decision trace of the queries of the default guide to ring (see guideSetTrace()).
+ */
+void setTrace(TraceRing * ring);
+
+/*
+ * Stores a snapshot of the counters of the given guide (of guideGetResistance() and guideGetResistanceBatch()) in snapshot.
+ * Queries through guideGetResistanceWith() and guideGetResistanceCached() are counted in the stats of their BorderSearch or BorderCache instead.
+ * The counters are only updated when compiled with STATS enabled, otherwise the snapshot is all zeros.
+ */
+void guideGetStats(BlindGuide * guide, GuideStats * snapshot);
+
+/*
+ * Stores a snapshot of the counters of the default guide in snapshot (see guideGetStats()).
+ */
+void getStats(GuideStats * snapshot);
+
+/*
+ * Resets all counters of the given guide to zero.
+ */
+void guideResetStats(BlindGuide * guide);
+
+/*
+ * Resets all counters of the default guide to zero.
+ */
+void resetStats();
+
+/*
+ * Adds the counters of stats to total, e.g. to combine the counters of several threads or robots.
+ */
+void mergeStats(GuideStats * total, GuideStats * stats);
+
+/*
+ * Returns the latency in nanoseconds below which the given fraction (between 0 and 1) of the queries of stats completed.
+ * As the histogram only has a bucket per power of two, this is the upper bound of the bucket that contains the requested fraction.
+ * Returns 0 when no queries were counted.
+ */
+double getStatsPercentile(GuideStats * stats, double fraction);
+
+/*
+ * Rasterizes the border lines of the given guide into the given DistanceField, with nodes spaced resolution meters apart.
+ * The field covers all border lines plus a margin of the radius and user radius of guide plus resolution meters.
+ * Any previous content of the field is freed first.
+ * When the memory is exhausted, the field stays empty, and getResistanceFromField() falls back to guideGetResistance().
+ */
+void createDistanceField(BlindGuide * guide, DistanceField * field, double resolution);
+
+/*
+ * Frees the memory allocated to the given DistanceField structure.
+ */
+void freeDistanceField(DistanceField * field);
+
+/*
+ * Compute the resistance like guideGetResistance(), but look up the nearest border line in the given DistanceField
+ * instead of evaluating the border lines, such that the cost does not depend on the size of the map.
+ * The distance to the border is bilinearly interpolated; the side and nearest border line are taken from the nearest node.
+ * Note that guideGetResistance() uses the nearest border line along the force vector, while the distance field uses the nearest border line
+ * around the robot, so the results differ near corners (see measureDistanceFieldError()).
+ * The field must have been created from the map of the guide. Queries outside the field, and all queries once the map or the parameters
+ * of the guide have changed since the field was created (see DistanceField), are evaluated with guideGetResistance().
+ */
+double getResistanceFromField(BlindGuide * guide, DistanceField * field, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Returns the maximum error in meters of the interpolated distance to the nearest border line in the given DistanceField.
+ * As the distance changes by at most one meter per meter, the error is at most half the diagonal of a cell: resolution / sqrt(2).
+ * This bounds the distance only, not the resistance: near corners the nearest border line of a node can differ from the one
+ * along the force, and its side can differ from that of the robot. Use measureDistanceFieldError() to pick a resolution for a map.
+ */
+double getDistanceFieldDistanceBound(DistanceField * field);
+
+/*
+ * Compares getResistanceFromField() with guideGetResistance() for numSamples pseudo random queries inside the given DistanceField,
+ * pushed with forces of forceMagnitude Newton in random directions. This is the way to pick the resolution of a field:
+ * create fields of decreasing resolution until the returned difference is acceptable for the map.
+ * Returns the largest absolute difference in resistance, and stores the mean absolute difference in meanError (if not NULL).
+ */
+double measureDistanceFieldError(BlindGuide * guide, DistanceField * field, size_t numSamples, double forceMagnitude, double * meanError);
+
+/*
+ * Compares guideGetResistance(), whose border kernels compute in BorderReals, with a reference that evaluates all border lines of guide
+ * in double precision with evaluateBorders(), for numSamples pseudo random queries around the border lines pushed with forces of forceMagnitude Newton.
+ * Returns the largest absolute difference in resistance, and stores the mean absolute difference in meanError (if not NULL).
+ * With FLOAT32 this measures the deviation of single precision (see FLOAT32_MAX_DEVIATION), otherwise the differences are rounding errors.
+ */
+double measurePrecisionError(BlindGuide * guide, size_t numSamples, double forceMagnitude, double * meanError);
+
+/*
+ * First part of getResistance(): fills point and the rotated force vector force for the given query,
+ * and returns the resistance for moving backwards.
+ */
+double prepareResistance(double x, double y, double phi, double forceX, double forceY, Coordinate * point, Vector * force, GuideParams * params);
+
+/*
+ * Last part of getResistance(): applies the action of the nearest border line to the given resistance (from prepareResistance())
+ * and evaluates the obstacles (see getResistance()).
+ * When obstacleIndex is not NULL, it must index the given obstacles, and only the obstacles that can be reached within the resistance time are evaluated.
+ * The evaluated obstacles and the final action are counted in the stats of search, and traced to its trace ring (search may be NULL).
+ * The final action is also stored in the action of search.
+ * Returns the final resistance.
+ */
+double finishResistance(Coordinate * point, Vector * force, double phi, double resistance, double nearestDistance, enum action closestBorderAction, unsigned int numObstacles, double * obstacles, ObstacleIndex * obstacleIndex, BorderSearch * search, GuideParams * params);
+
+/*
+ * Calculate the acceleration along the given force vector.
+ * Uses the mass of the robot of the default guide (see setParams()).
+ * Formula: a = F / m.
+ */
+double getAcceleration(Vector * force);
+
+/*
+ * Calculate the acceleration along the given force vector, like getAcceleration() for the given parameters.
+ */
+double paramsGetAcceleration(GuideParams * params, Vector * force);
+
+/*
+ * Calculate the distance that the robot travels along the given force vector within the resistance time of the default guide.
+ * Borders and obstacles further away than this distance never cause any resistance.
+ */
+double getReach(Vector * force);
+
+/*
+ * Calculate the distance that the robot travels along the given force vector, like getReach() for the given parameters.
+ */
+double paramsGetReach(GuideParams * params, Vector * force);
+
+/*
+ * Calculates and returns the dot product of the two given vectors.
+ */
+double dotProduct(Vector * v1, Vector * v2);
+
+/*
+ * Determines whether the robot at position p is approaching border line b
+ * when it is pushed along force vector force, with rotation phi (using the parameters of the default guide).
+ * toBorder will be populated by the vector from p to the closest point along the border line.
+ * If the robot is on the 'good' side of the border, and the robot is pushed towards the border, returns RESIST.
+ * If the robot is on the 'bad' side of the border, and the robot is pushed away from the border, returns STOP.
+ * Else, returns NOTHING.
+ */
+enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder);
+
+/*
+ * Determines whether the robot is approaching border line b, like approachingBorder() for the given parameters.
+ */
+enum action paramsApproachingBorder(GuideParams * params, Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder);
+
+/*
+ * Determines whether the robot at position p is approaching the obstacle at coordinate (x, y)
+ * when it is pushed along force vector force, with rotation phi (using the parameters of the default guide).
+ * toBorder will be populated by the vector from p to the obstacle center
+ * If the robot is pushed towards the obstacle, returns RESIST.
+ * Else, returns NOTHING.
+ */
+enum action approachingObstacle(Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder);
+
+/*
+ * Determines whether the robot is approaching the obstacle at coordinate (x, y), like approachingObstacle() for the given parameters.
+ */
+enum action paramsApproachingObstacle(GuideParams * params, Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder);
+
+/*
+ * Determines the resistance needed when the robot is pushed with the given force for dist meters.
+ * Uses the resistance time and stop time of the default guide to create a linearly increasing resistance when the time to traverse
+ * the toBorder vector decreases.
+ * Return value is clamped between 0 and 1.
+ */
+double getDistanceResistance(Vector * force, double dist);
+
+/*
+ * Determines the resistance needed when the robot is pushed with the given force for dist meters, like getDistanceResistance() for the given parameters.
+ */
+double paramsGetDistanceResistance(GuideParams * params, Vector * force, double dist);
+
+/*
+ * Determines the action for the border lines in indices (or the first numIndices border lines when indices is NULL) of ba, like getResistance().
+ * nearestDistance and closestBorderAction are updated with the border line that is closest along the force vector.
+ */
+void evaluateBorders(Coordinate * p, BorderlineArray * ba, unsigned int * indices, size_t numIndices, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params);
+
+/*
+ * Border kernel that evaluates one border line at a time.
+ * Unlike approachingBorder(), the user area is determined without atan2 (by rotating the toBorder vector by -phi),
+ * so the result may only differ from evaluateBorders() for border lines right at the edge of the user area.
+ */
+void borderKernelScalar(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params);
+
+/*
+ * Evaluates border line i of soa for the robot at p like borderKernelScalar(), where (c, s) is (cos(phi), sin(phi)).
+ * Returns the distance to the border line along the force vector and stores the action in a.
+ */
+double borderKernelSingle(BorderlineSoA * soa, size_t i, Coordinate * p, Vector * force, double c, double s, enum action * a, GuideParams * params);
+
+#if BORDER_KERNEL_X86
+/*
+ * Border kernel that evaluates SSE2_LANES (two, or four with FLOAT32) border lines at a time using SSE2, giving the same results as borderKernelScalar().
+ */
+void borderKernelSSE2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params);
+
+/*
+ * Border kernel that evaluates AVX2_LANES (four, or eight with FLOAT32) border lines at a time using AVX2, giving the same results as borderKernelScalar().
+ */
+void borderKernelAVX2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params);
+#endif
+
+/*
+ * Border block kernel that evaluates the border lines in indices (or the first numIndices border lines when indices is NULL) of soa
+ * for all queries of block, one query at a time.
+ * Updates the nearest distance and action of every query of the block, giving the same results as borderKernelScalar().
+ */
+void borderBlockKernelScalar(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, GuideParams * params);
+
+#if BORDER_KERNEL_X86
+/*
+ * Border block kernel that evaluates AVX2_LANES queries of the block at a time using AVX2, giving the same results as borderBlockKernelScalar().
+ */
+void borderBlockKernelAVX2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, GuideParams * params);
+#endif
+
+/*
+ * Frees the memory allocated for the map of the default guide.
+ */
+void cleanup();
+
+
+#if STATS
+/*
+ * Returns the current time in nanoseconds, for measuring the latency of queries.
+ */
+static unsigned long long getStatsTime() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long) t.tv_sec * 1000000000ULL + (unsigned long long) t.tv_nsec;
+}
+
+/*
+ * Counts a query that took the given number of nanoseconds in stats (which may be NULL).
+ */
+static void recordStatsLatency(GuideStats * stats, unsigned long long nanoseconds) {
+    if (stats == NULL) {
+        return;
+    }
+    int bucket = 0;
+    while (bucket < STATS_BUCKETS - 1 && (nanoseconds >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    stats->queries++;
+    stats->latency[bucket]++;
+    stats->totalNanoseconds += nanoseconds;
+    stats->lastNanoseconds = nanoseconds;
+    if (nanoseconds > stats->maxNanoseconds) {
+        stats->maxNanoseconds = nanoseconds;
+    }
+}
+#endif
+
+/*
+ * Producer side of ring: appends the given record, or drops it when the ring is full (the producer never waits for the consumer).
+ */
+static void writeTrace(TraceRing * ring, TraceRecord * record) {
+    size_t head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&(ring->tail), memory_order_acquire);
+    if (head - tail >= ring->capacity) {
+        atomic_fetch_add_explicit(&(ring->dropped), 1, memory_order_relaxed);
+        return;
+    }
+    ring->records[head & (ring->capacity - 1)] = *record;
+    // Only publish the record after it has been written completely
+    atomic_store_explicit(&(ring->head), head + 1, memory_order_release);
+}
+
+/*
+ * Writes a record of the given type for the current query to the trace ring of search (see TraceRecord for the meaning of the fields).
+ */
+static void traceEvent(BorderSearch * search, enum traceType type, unsigned int index, enum action a, int flags, double v0, double v1, double v2, double v3, double v4, double v5) {
+    TraceRecord record;
+    record.type = (unsigned char) type;
+    record.action = (unsigned char) a;
+    record.flags = (unsigned char) flags;
+    record.reserved = 0;
+    record.index = index;
+    record.query = search->trace->query;
+    record.values[0] = v0;
+    record.values[1] = v1;
+    record.values[2] = v2;
+    record.values[3] = v3;
+    record.values[4] = v4;
+    record.values[5] = v5;
+    writeTrace(search->trace, &record);
+}
+
+/*
+ * Starts a new query in the trace ring of search, and writes its TRACE_QUERY record.
+ */
+static void traceQuery(BorderSearch * search, double x, double y, double phi, double forceX, double forceY, double resistance, unsigned int numObstacles) {
+    search->trace->query++;
+    traceEvent(search, TRACE_QUERY, numObstacles, NOTHING, 0, x, y, phi, forceX, forceY, resistance);
+}
+
+/*
+ * Writes a TRACE_BORDER record to the trace ring of search for the enabled border lines in indices (or the first numIndices border lines when indices is NULL) of guide.
+ * The action and distance along the force vector are those of the border kernels (see borderKernelSingle()) for params.
+ */
+static void traceBorders(BlindGuide * guide, BorderSearch * search, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, GuideParams * params) {
+    BorderlineSoA * soa = &(guide->soa);
+    double c = cos(phi);
+    double s = sin(phi);
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        unsigned int i = indices != NULL ? indices[k] : k;
+        if (guide->borderlines.states[i] != BORDER_ENABLED) {
+            continue;
+        }
+        enum action a;
+        double dist = borderKernelSingle(soa, i, p, force, c, s, &a, params);
+        // Repeat the steps of borderKernelSingle() that it does not return
+        double qx = p->x - soa->bottomX[i];
+        double qy = p->y - soa->bottomY[i];
+        double t = fmax(0.0, fmin(1.0, (qx * soa->dirX[i] + qy * soa->dirY[i]) * soa->invLength2[i]));
+        double x = soa->bottomX[i] + t * soa->dirX[i];
+        double y = soa->bottomY[i] + t * soa->dirY[i];
+        double length = sqrt((x - p->x) * (x - p->x) + (y - p->y) * (y - p->y));
+        double ux = (x - p->x) / length;
+        double uy = (y - p->y) / length;
+        length -= params->radius;
+        int flags = qx * soa->normalX[i] + qy * soa->normalY[i] > 0 ? TRACE_GOOD_SIDE : 0;
+        double rx = c * ux + s * uy;
+        double ry = c * uy - s * ux;
+        if (ry <= 0 && ((params->userHandedness == RIGHT && rx >= 0) || (params->userHandedness == LEFT && rx <= 0))) {
+            length -= params->userRadius;
+            flags |= TRACE_USER_AREA;
+        }
+        traceEvent(search, TRACE_BORDER, i, a, flags, t, length, force->x * ux + force->y * uy, dist, x, y);
+    }
+}
 
 void populateVector(double x, double y, Vector * v) {
     v->length = sqrt(x * x + y * y);
@@ -265,112 +1506,1952 @@ void populateVector(double x, double y, Vector * v) {
     v->y = y / v->length;
 }
 
-void createBorderlineArray(BorderlineArray * ba, size_t size) {
-    ba->borderlines = (struct Borderline *) malloc(size * sizeof(struct Borderline));
-    ba->size = 0;
-    ba->capacity = size;
+// Number of successful and failed allocations, and whether allocations are frozen (see freezeAllocations())
+static atomic_ullong numAllocations;
+static atomic_ullong numAllocationFailures;
+static atomic_int allocationsFrozen;
+
+#if STATIC_CAPACITY
+/*
+ * Static arena that holds all memory when STATIC_CAPACITY is 1.
+ * Every block has one of ARENA_CLASSES sizes (see arenaClassSize()) and is preceded by a header of ARENA_ALIGNMENT bytes that holds its class.
+ * Released blocks are kept in a free list per class and handed out again by the next allocation of that class,
+ * so memory that is released and allocated again (e.g. by copies of the map and by arrays that grow) is reused instead of used up.
+ * New blocks are taken from top on; the last of them (at offset last) can grow in place.
+ * used: bytes in blocks that are in use, peak: the highest top so far (the size the arena needs)
+ * freeBlocks: the first released block (its header) of every class, whose first bytes point to the next one
+ * lock makes the arena safe to use from several threads (e.g. threads that create their own BorderSearch).
+ */
+typedef struct GuideArena {
+    _Alignas(ARENA_ALIGNMENT) unsigned char memory[STATIC_ARENA_SIZE];
+    size_t top;
+    size_t used;
+    size_t peak;
+    size_t last;
+    size_t numBlocks;
+    unsigned char * freeBlocks[ARENA_CLASSES];
+    atomic_flag lock;
+} GuideArena;
+
+static GuideArena guideArena = {.last = STATIC_ARENA_SIZE, .lock = ATOMIC_FLAG_INIT};
+
+/*
+ * Returns the size in bytes of the blocks of class c: 16, 32, 48, 64, 96, 128, ... (all multiples of ARENA_ALIGNMENT).
+ */
+static size_t arenaClassSize(size_t c) {
+    return c == 0 ? 16 : (size_t) (c % 2 == 1 ? 16 : 24) << ((c + 1) / 2);
 }
 
-void addToBorderlineArray(BorderlineArray * ba, Borderline element) {
-    if (ba->size >= ba->capacity) {
-        ba->capacity *= 2;
-        ba->borderlines = (struct Borderline *) realloc(ba->borderlines, ba->capacity * sizeof(struct Borderline));
+/*
+ * Returns the smallest class of guideArena whose blocks hold size bytes (which must be at most STATIC_ARENA_SIZE).
+ */
+static size_t arenaClass(size_t size) {
+    size_t c = 0;
+    while (arenaClassSize(c) < size) {
+        c++;
     }
-    ba->borderlines[ba->size++] = element;
+    return c;
 }
 
-void freeBorderlineArray(BorderlineArray * ba) {
-    free(ba->borderlines);
-    ba->borderlines = NULL;
-    ba->size = ba->capacity = 0;
+/*
+ * Allocates a block of size bytes from guideArena: a released block of its class, a new block, or when the arena is full
+ * a released block of a larger class. Returns NULL when none fits. Must hold the lock of the arena.
+ */
+static void * arenaAllocate(size_t size) {
+    if (size > STATIC_ARENA_SIZE) {
+        return NULL;
+    }
+    size_t c = arenaClass(size);
+    size_t reused = c;
+    if (guideArena.freeBlocks[c] == NULL && ARENA_ALIGNMENT + arenaClassSize(c) > STATIC_ARENA_SIZE - guideArena.top) {
+        while (reused < ARENA_CLASSES && guideArena.freeBlocks[reused] == NULL) {
+            reused++;
+        }
+        if (reused == ARENA_CLASSES) {
+            return NULL;
+        }
+    }
+    unsigned char * header = guideArena.freeBlocks[reused];
+    if (header != NULL) {
+        guideArena.freeBlocks[reused] = *(unsigned char **) (header + ARENA_ALIGNMENT);
+    } else {
+        header = guideArena.memory + guideArena.top;
+        *(size_t *) header = c;
+        guideArena.last = guideArena.top;
+        guideArena.top += ARENA_ALIGNMENT + arenaClassSize(c);
+        guideArena.peak = guideArena.top > guideArena.peak ? guideArena.top : guideArena.peak;
+    }
+    guideArena.used += ARENA_ALIGNMENT + arenaClassSize(*(size_t *) header);
+    guideArena.numBlocks++;
+    return header + ARENA_ALIGNMENT;
 }
 
-void initializeBorders() {
-    size_t numCoords = sizeof(borderCoordinates) / sizeof(borderCoordinates[0]);
-    size_t numBorderlines = numCoords / 4;
-    createBorderlineArray(&borderlines, numBorderlines);
-    unsigned int i = 0;
-    for (i = 0; i < numBorderlines; i++) {
-        int index = i * 4;
-        addBorder(borderCoordinates[index], borderCoordinates[index + 1], borderCoordinates[index + 2], borderCoordinates[index + 3], RIGHT);
+/*
+ * Releases a block of guideArena. Must hold the lock of the arena.
+ */
+static void arenaRelease(void * array) {
+    unsigned char * header = (unsigned char *) array - ARENA_ALIGNMENT;
+    size_t c = *(size_t *) header;
+    size_t offset = (size_t) (header - guideArena.memory);
+    guideArena.used -= ARENA_ALIGNMENT + arenaClassSize(c);
+    guideArena.numBlocks--;
+    if (guideArena.numBlocks == 0) {
+        guideArena.top = 0;
+        guideArena.last = STATIC_ARENA_SIZE;
+        memset(guideArena.freeBlocks, 0, sizeof(guideArena.freeBlocks));
+    } else if (offset == guideArena.last) {
+        // The block before it is unknown, so no block can grow in place until the next new block
+        guideArena.top = offset;
+        guideArena.last = STATIC_ARENA_SIZE;
+    } else {
+        *(unsigned char **) array = guideArena.freeBlocks[c];
+        guideArena.freeBlocks[c] = header;
     }
 }
 
-void addBorder(double bottomX, double bottomY, double topX, double topY, enum side goodSide) {
-    if (borderlines.borderlines == NULL || borderlines.capacity <= 0) {
-        createBorderlineArray(&borderlines, 1);
-    }
-    struct Coordinate bottom = createCoordinate(bottomX, bottomY);
-    struct Coordinate top = createCoordinate(topX, topY);
-    struct Borderline bl = createBorderline(bottom, top, goodSide);
-    addToBorderlineArray(&borderlines, bl);
+/*
+ * Changes the size of a block of guideArena (or allocates one when array is NULL) like realloc(). Must hold the lock of the arena.
+ */
+static void * arenaReallocate(void * array, size_t size) {
+    if (array == NULL) {
+        return arenaAllocate(size);
+    }
+    unsigned char * header = (unsigned char *) array - ARENA_ALIGNMENT;
+    size_t c = *(size_t *) header;
+    if (size <= arenaClassSize(c)) {
+        return array;
+    }
+    size_t offset = (size_t) (header - guideArena.memory);
+    if (offset == guideArena.last && size <= STATIC_ARENA_SIZE - offset - ARENA_ALIGNMENT) {
+        // The last block can simply grow into a larger class
+        size_t grown = arenaClass(size);
+        if (arenaClassSize(grown) <= STATIC_ARENA_SIZE - offset - ARENA_ALIGNMENT) {
+            *(size_t *) header = grown;
+            guideArena.used += arenaClassSize(grown) - arenaClassSize(c);
+            guideArena.top = offset + ARENA_ALIGNMENT + arenaClassSize(grown);
+            guideArena.peak = guideArena.top > guideArena.peak ? guideArena.top : guideArena.peak;
+            return array;
+        }
+    }
+    void * grown = arenaAllocate(size);
+    if (grown != NULL) {
+        memcpy(grown, array, arenaClassSize(c));
+        arenaRelease(array);
+    }
+    return grown;
+}
+#endif
+
+void * guideAllocate(size_t size) {
+    return guideReallocate(NULL, size);
+}
+
+void * guideReallocate(void * array, size_t size) {
+    void * result = NULL;
+    if (!atomic_load_explicit(&allocationsFrozen, memory_order_relaxed)) {
+        #if STATIC_CAPACITY
+            while (atomic_flag_test_and_set_explicit(&(guideArena.lock), memory_order_acquire));
+            result = arenaReallocate(array, size > 0 ? size : 1);
+            atomic_flag_clear_explicit(&(guideArena.lock), memory_order_release);
+        #else
+            result = realloc(array, size > 0 ? size : 1);
+        #endif
+    }
+    atomic_fetch_add_explicit(result != NULL ? &numAllocations : &numAllocationFailures, 1, memory_order_relaxed);
+    return result;
+}
+
+void guideRelease(void * array) {
+    if (array == NULL) {
+        return;
+    }
+    #if STATIC_CAPACITY
+        while (atomic_flag_test_and_set_explicit(&(guideArena.lock), memory_order_acquire));
+        arenaRelease(array);
+        atomic_flag_clear_explicit(&(guideArena.lock), memory_order_release);
+    #else
+        free(array);
+    #endif
+}
+
+void freezeAllocations(int frozen) {
+    atomic_store_explicit(&allocationsFrozen, frozen, memory_order_relaxed);
+}
+
+void getAllocationInfo(AllocationInfo * info) {
+    memset(info, 0, sizeof(AllocationInfo));
+    info->allocations = atomic_load_explicit(&numAllocations, memory_order_relaxed);
+    info->failures = atomic_load_explicit(&numAllocationFailures, memory_order_relaxed);
+    #if STATIC_CAPACITY
+        while (atomic_flag_test_and_set_explicit(&(guideArena.lock), memory_order_acquire));
+        info->arenaUsed = guideArena.used;
+        info->arenaPeak = guideArena.peak;
+        atomic_flag_clear_explicit(&(guideArena.lock), memory_order_release);
+        info->arenaSize = STATIC_ARENA_SIZE;
+    #endif
+}
+
+/*
+ * Changes the capacity of ba to capacity elements (which must not be below its size). Returns 1 on success, or 0 when the memory is exhausted.
+ * The arrays that did grow keep their new size, which is harmless as the capacity only changes when all of them did.
+ */
+static int reserveBorderlineArray(BorderlineArray * ba, size_t capacity) {
+    void * ends = guideReallocate(ba->ends, capacity * sizeof(struct BorderEnds));
+    ba->ends = ends != NULL ? (struct BorderEnds *) ends : ba->ends;
+    void * states = ends != NULL ? guideReallocate(ba->states, capacity * sizeof(unsigned char)) : NULL;
+    ba->states = states != NULL ? (unsigned char *) states : ba->states;
+    void * generations = states != NULL ? guideReallocate(ba->generations, capacity * sizeof(unsigned int)) : NULL;
+    ba->generations = generations != NULL ? (unsigned int *) generations : ba->generations;
+    void * freeSlots = generations != NULL ? guideReallocate(ba->freeSlots, capacity * sizeof(unsigned int)) : NULL;
+    ba->freeSlots = freeSlots != NULL ? (unsigned int *) freeSlots : ba->freeSlots;
+    if (freeSlots == NULL) {
+        return 0;
+    }
+    ba->capacity = capacity;
+    return 1;
+}
+
+/*
+ * Makes room for numVertices more vertices in ba (doubling their capacity when they grow). Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveBorderVertices(BorderlineArray * ba, size_t numVertices) {
+    if (ba->numVertices + numVertices <= ba->verticesCapacity) {
+        return 1;
+    }
+    size_t capacity = ba->verticesCapacity > 0 ? ba->verticesCapacity : 64;
+    while (ba->numVertices + numVertices > capacity) {
+        capacity *= 2;
+    }
+    Coordinate * grown = (Coordinate *) guideReallocate(ba->vertices, capacity * sizeof(struct Coordinate));
+    if (grown == NULL) {
+        return 0;
+    }
+    ba->vertices = grown;
+    ba->verticesCapacity = capacity;
+    return 1;
+}
+
+/*
+ * Stores the coordinates of element in vertices bottom and top of ba, and makes element index refer to them.
+ */
+static void setBorderlineArrayElement(BorderlineArray * ba, unsigned int index, unsigned int bottom, unsigned int top, Borderline * element) {
+    ba->vertices[bottom] = element->bottom;
+    ba->vertices[top] = element->top;
+    ba->ends[index].bottom = bottom;
+    ba->ends[index].top = top;
+    ba->ends[index].goodSide = element->goodSide;
+}
+
+int createBorderlineArray(BorderlineArray * ba, size_t size) {
+    memset(ba, 0, sizeof(BorderlineArray));
+    if (!reserveBorderlineArray(ba, size)) {
+        freeBorderlineArray(ba);
+        return 0;
+    }
+    return 1;
+}
+
+int addToBorderlineArray(BorderlineArray * ba, Borderline element) {
+    if ((ba->size >= ba->capacity && !reserveBorderlineArray(ba, ba->capacity > 0 ? ba->capacity * 2 : 1)) || !reserveBorderVertices(ba, 2)) {
+        return 0;
+    }
+    ba->states[ba->size] = BORDER_ENABLED;
+    ba->generations[ba->size] = 0;
+    setBorderlineArrayElement(ba, (unsigned int) ba->size++, (unsigned int) ba->numVertices, (unsigned int) ba->numVertices + 1, &element);
+    ba->numVertices += 2;
+    return 1;
+}
+
+unsigned int insertIntoBorderlineArray(BorderlineArray * ba, Borderline element) {
+    if (ba->numFree == 0) {
+        return addToBorderlineArray(ba, element) ? ba->size - 1 : INVALID_BORDER_INDEX;
+    }
+    unsigned int index = ba->freeSlots[--ba->numFree];
+    setBorderlineArrayElement(ba, index, ba->ends[index].bottom, ba->ends[index].top, &element);
+    ba->states[index] = BORDER_ENABLED;
+    return index;
+}
+
+Borderline getBorderline(BorderlineArray * ba, unsigned int index) {
+    BorderEnds * ends = &(ba->ends[index]);
+    return createBorderline(ba->vertices[ends->bottom], ba->vertices[ends->top], ends->goodSide);
+}
+
+void removeFromBorderlineArray(BorderlineArray * ba, unsigned int index) {
+    ba->states[index] = BORDER_REMOVED;
+    ba->generations[index]++;
+    ba->freeSlots[ba->numFree++] = index;
+}
+
+void freeBorderlineArray(BorderlineArray * ba) {
+    guideRelease(ba->ends);
+    guideRelease(ba->states);
+    guideRelease(ba->generations);
+    guideRelease(ba->freeSlots);
+    guideRelease(ba->vertices);
+    ba->ends = NULL;
+    ba->states = NULL;
+    ba->generations = ba->freeSlots = NULL;
+    ba->vertices = NULL;
+    ba->size = ba->capacity = ba->numFree = 0;
+    ba->numVertices = ba->verticesCapacity = 0;
+    ba->version = 0;
+}
+
+/*
+ * Changes the capacity of ia to at least capacity indices. Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveIndexArray(IndexArray * ia, size_t capacity) {
+    if (capacity <= ia->capacity) {
+        return 1;
+    }
+    unsigned int * indices = (unsigned int *) guideReallocate(ia->indices, capacity * sizeof(unsigned int));
+    if (indices == NULL) {
+        return 0;
+    }
+    ia->indices = indices;
+    ia->capacity = capacity;
+    return 1;
+}
+
+int addToIndexArray(IndexArray * ia, unsigned int index) {
+    if (ia->size >= ia->capacity && !reserveIndexArray(ia, ia->capacity > 0 ? ia->capacity * 2 : 4)) {
+        return 0;
+    }
+    ia->indices[ia->size++] = index;
+    return 1;
+}
+
+void freeIndexArray(IndexArray * ia) {
+    guideRelease(ia->indices);
+    ia->indices = NULL;
+    ia->size = ia->capacity = 0;
+}
+
+/*
+ * Returns the bucket of grid for the cell (cx, cy).
+ */
+static size_t gridBucket(BorderGrid * grid, long cx, long cy) {
+    unsigned long h = ((unsigned long) cx * 73856093UL) ^ ((unsigned long) cy * 19349663UL);
+    return (size_t) (h & (grid->numBuckets - 1));
+}
+
+/*
+ * Returns 1 when the given coordinates of a border are finite and at most MAX_COORDINATE meters from the axes, 0 otherwise.
+ */
+static int validBorderCoordinates(double bottomX, double bottomY, double topX, double topY) {
+    // Every comparison with NaN is false, so NaN is rejected as well
+    return fabs(bottomX) <= MAX_COORDINATE && fabs(bottomY) <= MAX_COORDINATE && fabs(topX) <= MAX_COORDINATE && fabs(topY) <= MAX_COORDINATE;
+}
+
+/*
+ * Adds border line index to (add is 1) or removes it from (add is 0) the buckets of grid, without rehashing.
+ * Only the cells along the border line are visited, so this takes time proportional to its length rather than to its bounding box.
+ * Returns 1 on success, or 0 when a bucket cannot grow or the coordinates of the border line are invalid (see validBorderCoordinates()),
+ * in which case the border line is not in the buckets.
+ */
+static int updateBorderGridCells(BorderGrid * grid, Borderline * b, unsigned int index, int add) {
+    if (!validBorderCoordinates(b->bottom.x, b->bottom.y, b->top.x, b->top.y)) {
+        // Such border lines are never added, so there is nothing to remove either
+        return !add;
+    }
+    long minX = (long) floor(fmin(b->bottom.x, b->top.x) / GRID_CELL_SIZE);
+    long maxX = (long) floor(fmax(b->bottom.x, b->top.x) / GRID_CELL_SIZE);
+    long minY = (long) floor(fmin(b->bottom.y, b->top.y) / GRID_CELL_SIZE);
+    long maxY = (long) floor(fmax(b->bottom.y, b->top.y) / GRID_CELL_SIZE);
+    double dx = b->top.x - b->bottom.x;
+    double dy = b->top.y - b->bottom.y;
+    // A cell is crossed by the border line if the distance from the cell center to the line is at most half the cell diagonal
+    double halfDiagonal = GRID_CELL_SIZE * 0.5 * sqrt(2.0) + 1e-9;
+    // In a column, those cell centers lie within reach of the height of the line at the center of the column
+    double reach = b->length > 0 && dx != 0 ? halfDiagonal * b->length / fabs(dx) : INFINITY;
+    long cx, cy;
+    for (cx = minX; cx <= maxX; cx++) {
+        long fromY = minY;
+        long toY = maxY;
+        double y = b->bottom.y + ((cx + 0.5) * GRID_CELL_SIZE - b->bottom.x) * dy / dx;
+        if (reach < INFINITY && isfinite(y)) {
+            // One cell extra on both sides, so that rounding never skips a cell (the exact test below decides)
+            double low = floor((y - reach) / GRID_CELL_SIZE - 0.5) - 1;
+            double high = ceil((y + reach) / GRID_CELL_SIZE - 0.5) + 1;
+            if (low > maxY || high < minY) {
+                continue;
+            }
+            if (low > minY) {
+                fromY = (long) low;
+            }
+            if (high < maxY) {
+                toY = (long) high;
+            }
+        }
+        for (cy = fromY; cy <= toY; cy++) {
+            if (b->length > 0) {
+                double mx = (cx + 0.5) * GRID_CELL_SIZE;
+                double my = (cy + 0.5) * GRID_CELL_SIZE;
+                double cross = (mx - b->bottom.x) * dy - (my - b->bottom.y) * dx;
+                if (fabs(cross) / b->length > halfDiagonal) {
+                    continue;
+                }
+            }
+            IndexArray * bucket = &(grid->buckets[gridBucket(grid, cx, cy)]);
+            if (add) {
+                if (!addToIndexArray(bucket, index)) {
+                    updateBorderGridCells(grid, b, index, 0);
+                    return 0;
+                }
+                grid->numEntries++;
+            } else {
+                // The order within a bucket does not matter, so replace the entry by the last one
+                size_t i = 0;
+                for (i = 0; i < bucket->size; i++) {
+                    if (bucket->indices[i] == index) {
+                        bucket->indices[i] = bucket->indices[--bucket->size];
+                        grid->numEntries--;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Replaces the buckets of grid by numBuckets new ones, holding all border lines of ba that are not removed except for border line skip.
+ * Returns 1 on success, or 0 when the memory is exhausted (grid is then unchanged).
+ */
+static int rehashBorderGrid(BorderGrid * grid, BorderlineArray * ba, size_t numBuckets, unsigned int skip) {
+    BorderGrid rehashed;
+    rehashed.numBuckets = numBuckets;
+    rehashed.numEntries = 0;
+    rehashed.buckets = (struct IndexArray *) guideAllocate(numBuckets * sizeof(struct IndexArray));
+    if (rehashed.buckets == NULL) {
+        return 0;
+    }
+    memset(rehashed.buckets, 0, numBuckets * sizeof(struct IndexArray));
+    size_t i = 0;
+    for (i = 0; i < ba->size; i++) {
+        if (i == skip || ba->states[i] == BORDER_REMOVED) {
+            continue;
+        }
+        Borderline b = getBorderline(ba, (unsigned int) i);
+        if (!updateBorderGridCells(&rehashed, &b, i, 1)) {
+            freeBorderGrid(&rehashed);
+            return 0;
+        }
+    }
+    freeBorderGrid(grid);
+    *grid = rehashed;
+    return 1;
+}
+
+/*
+ * Prepares grid for numBorders border lines of ba: rehashes it into the number of buckets that adding them would lead to,
+ * and gives every bucket room for the entries of the border lines still to come, assuming that they are spread like those in the grid.
+ * Every bucket gets a share of these entries in proportion to the entries it holds, and an equal share on top for border lines
+ * in new places, plus three times the square root of the sum and four more, for border lines that do not follow the spread exactly.
+ * The number of entries per border line is taken from the border lines in the grid (four for an empty grid).
+ * Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveBorderGrid(BorderGrid * grid, BorderlineArray * ba, size_t numBorders) {
+    size_t numLive = ba->size - ba->numFree;
+    double entriesPerBorder = numLive > 0 && grid->numEntries > 0 ? (double) grid->numEntries / numLive : 4;
+    size_t numEntries = (size_t) ceil(entriesPerBorder * (double) numBorders);
+    size_t numBuckets = grid->numBuckets > 0 ? grid->numBuckets : GRID_BUCKETS;
+    // Like addToBorderGrid(), which rehashes once there are 2 entries per bucket
+    while (numEntries >= 2 * numBuckets) {
+        numBuckets *= 4;
+    }
+    if (grid->buckets == NULL) {
+        grid->buckets = (struct IndexArray *) guideAllocate(numBuckets * sizeof(struct IndexArray));
+        if (grid->buckets == NULL) {
+            return 0;
+        }
+        memset(grid->buckets, 0, numBuckets * sizeof(struct IndexArray));
+        grid->numBuckets = numBuckets;
+        grid->numEntries = 0;
+    } else if (numBuckets > grid->numBuckets && !rehashBorderGrid(grid, ba, numBuckets, INVALID_BORDER_INDEX)) {
+        return 0;
+    }
+    double numNew = numEntries > grid->numEntries ? (double) (numEntries - grid->numEntries) : 0;
+    size_t i = 0;
+    for (i = 0; i < grid->numBuckets; i++) {
+        IndexArray * bucket = &(grid->buckets[i]);
+        double share = numNew / grid->numBuckets + (grid->numEntries > 0 ? numNew * bucket->size / grid->numEntries : 0);
+        if (!reserveIndexArray(bucket, bucket->size + (size_t) ceil(share + 3 * sqrt(share)) + 4)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int addToBorderGrid(BorderGrid * grid, BorderlineArray * ba, unsigned int index) {
+    if (grid->buckets == NULL) {
+        grid->buckets = (struct IndexArray *) guideAllocate(GRID_BUCKETS * sizeof(struct IndexArray));
+        if (grid->buckets == NULL) {
+            return 0;
+        }
+        memset(grid->buckets, 0, GRID_BUCKETS * sizeof(struct IndexArray));
+        grid->numBuckets = GRID_BUCKETS;
+        grid->numEntries = 0;
+    } else if (grid->numEntries >= 2 * grid->numBuckets) {
+        // Too many entries per bucket, so rehash all border lines into four times as many buckets (or keep the full buckets when that does not fit)
+        rehashBorderGrid(grid, ba, 4 * grid->numBuckets, index);
+    }
+    Borderline b = getBorderline(ba, index);
+    return updateBorderGridCells(grid, &b, index, 1);
+}
+
+void removeFromBorderGrid(BorderGrid * grid, BorderlineArray * ba, unsigned int index) {
+    if (grid->buckets != NULL) {
+        Borderline b = getBorderline(ba, index);
+        updateBorderGridCells(grid, &b, index, 0);
+    }
+}
+
+void freeBorderGrid(BorderGrid * grid) {
+    size_t i = 0;
+    for (i = 0; grid->buckets != NULL && i < grid->numBuckets; i++) {
+        freeIndexArray(&(grid->buckets[i]));
+    }
+    guideRelease(grid->buckets);
+    grid->buckets = NULL;
+    grid->numBuckets = grid->numEntries = 0;
+}
+
+void freeBorderSearch(BorderSearch * search) {
+    guideRelease(search->stamps);
+    freeIndexArray(&(search->candidates));
+    freeObstacleIndex(&(search->obstacles));
+    search->stamps = NULL;
+    search->stampsCapacity = 0;
+    search->query = 0;
+}
+
+/*
+ * Changes the capacity of the stamps of search to at least capacity border lines. Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveSearchStamps(BorderSearch * search, size_t capacity) {
+    if (capacity <= search->stampsCapacity) {
+        return 1;
+    }
+    unsigned int * stamps = (unsigned int *) guideReallocate(search->stamps, capacity * sizeof(unsigned int));
+    if (stamps == NULL) {
+        return 0;
+    }
+    memset(stamps + search->stampsCapacity, 0, (capacity - search->stampsCapacity) * sizeof(unsigned int));
+    search->stamps = stamps;
+    search->stampsCapacity = capacity;
+    return 1;
+}
+
+/*
+ * Sorts the given numIndices indices in ascending order with heapsort, which needs no memory and takes O(n log n) time also in the worst case.
+ */
+static void sortIndices(unsigned int * indices, size_t numIndices) {
+    size_t n = numIndices;
+    size_t start = n / 2;
+    while (n > 1) {
+        unsigned int value;
+        size_t parent;
+        if (start > 0) {
+            // Build the heap
+            parent = --start;
+            value = indices[parent];
+        } else {
+            // Move the largest index to the end
+            value = indices[--n];
+            indices[n] = indices[0];
+            parent = 0;
+        }
+        size_t child;
+        while ((child = 2 * parent + 1) < n) {
+            if (child + 1 < n && indices[child + 1] > indices[child]) {
+                child++;
+            }
+            if (indices[child] <= value) {
+                break;
+            }
+            indices[parent] = indices[child];
+            parent = child;
+        }
+        indices[parent] = value;
+    }
+}
+
+int collectBorderCandidates(BorderGrid * grid, BorderSearch * search, BorderlineArray * ba, Coordinate * p, double radius) {
+    // The border lines lie within MAX_COORDINATE, so a search area beyond it (or a non-finite one) is left to a full scan
+    if (grid->buckets == NULL || !(fabs(p->x) + radius <= 2 * MAX_COORDINATE && fabs(p->y) + radius <= 2 * MAX_COORDINATE)) {
+        return 0;
+    }
+    long minX = (long) floor((p->x - radius) / GRID_CELL_SIZE);
+    long maxX = (long) floor((p->x + radius) / GRID_CELL_SIZE);
+    long minY = (long) floor((p->y - radius) / GRID_CELL_SIZE);
+    long maxY = (long) floor((p->y + radius) / GRID_CELL_SIZE);
+    // Visiting more cells than there are border lines is slower than simply evaluating all border lines
+    if ((double) (maxX - minX + 1) * (double) (maxY - minY + 1) > (double) ba->size) {
+        return 0;
+    }
+    if (search->stampsCapacity < ba->capacity && !reserveSearchStamps(search, ba->capacity)) {
+        return 0;
+    }
+    if (++search->query == 0) {
+        // The query counter wrapped around, so old stamps could be mistaken for the current query
+        memset(search->stamps, 0, search->stampsCapacity * sizeof(unsigned int));
+        search->query = 1;
+    }
+    search->candidates.size = 0;
+    long cx, cy;
+    for (cx = minX; cx <= maxX; cx++) {
+        for (cy = minY; cy <= maxY; cy++) {
+            IndexArray * bucket = &(grid->buckets[gridBucket(grid, cx, cy)]);
+            size_t i = 0;
+            for (i = 0; i < bucket->size; i++) {
+                unsigned int index = bucket->indices[i];
+                if (search->stamps[index] != search->query) {
+                    search->stamps[index] = search->query;
+                    if (!addToIndexArray(&(search->candidates), index)) {
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    // Keep the order of the border lines, such that ties are resolved exactly like when evaluating all border lines
+    sortIndices(search->candidates.indices, search->candidates.size);
+    return 1;
+}
+
+/*
+ * Changes the capacity of index to at least numObstacles obstacles and numCells cells. Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveObstacleIndex(ObstacleIndex * index, size_t numObstacles, size_t numCells) {
+    if (index->cellsCapacity < numCells + 1) {
+        unsigned int * cellStart = (unsigned int *) guideReallocate(index->cellStart, (numCells + 1) * sizeof(unsigned int));
+        if (cellStart == NULL) {
+            return 0;
+        }
+        index->cellStart = cellStart;
+        index->cellsCapacity = numCells + 1;
+    }
+    if (index->capacity < numObstacles) {
+        unsigned int * order = (unsigned int *) guideReallocate(index->order, numObstacles * sizeof(unsigned int));
+        index->order = order != NULL ? order : index->order;
+        unsigned int * cells = order != NULL ? (unsigned int *) guideReallocate(index->cells, numObstacles * sizeof(unsigned int)) : NULL;
+        index->cells = cells != NULL ? cells : index->cells;
+        if (cells == NULL) {
+            return 0;
+        }
+        index->capacity = numObstacles;
+    }
+    return 1;
+}
+
+void indexObstacles(ObstacleIndex * index, unsigned int numObstacles, double * obstacles) {
+    index->numObstacles = numObstacles;
+    index->obstacles = obstacles;
+    index->usable = 0;
+    if (numObstacles == 0) {
+        return;
+    }
+    
+    double minX = obstacles[0], maxX = obstacles[0], minY = obstacles[1], maxY = obstacles[1];
+    unsigned int i = 0;
+    for (i = 0; i < numObstacles; i++) {
+        double x = obstacles[2 * i];
+        double y = obstacles[2 * i + 1];
+        if (!isfinite(x) || !isfinite(y)) {
+            return;
+        }
+        minX = fmin(minX, x);
+        maxX = fmax(maxX, x);
+        minY = fmin(minY, y);
+        maxY = fmax(maxY, y);
+    }
+    // Use larger cells when the obstacles are spread out, such that there are at most a few cells per obstacle
+    index->cellSize = OBSTACLE_CELL_SIZE;
+    for (;;) {
+        index->width = (size_t) ((maxX - minX) / index->cellSize) + 1;
+        index->height = (size_t) ((maxY - minY) / index->cellSize) + 1;
+        if ((double) index->width * (double) index->height <= 4.0 * numObstacles + 64) {
+            break;
+        }
+        index->cellSize *= 2;
+    }
+    index->minX = minX;
+    index->minY = minY;
+    
+    size_t numCells = index->width * index->height;
+    if (!reserveObstacleIndex(index, numObstacles, numCells)) {
+        return;
+    }
+    
+    // Counting sort of the obstacles by cell, keeping the obstacles of a cell in their original order
+    memset(index->cellStart, 0, (numCells + 1) * sizeof(unsigned int));
+    for (i = 0; i < numObstacles; i++) {
+        size_t cx = (size_t) ((obstacles[2 * i] - minX) / index->cellSize);
+        size_t cy = (size_t) ((obstacles[2 * i + 1] - minY) / index->cellSize);
+        if (cx >= index->width) cx = index->width - 1;
+        if (cy >= index->height) cy = index->height - 1;
+        index->cells[i] = cy * index->width + cx;
+        index->cellStart[index->cells[i] + 1]++;
+    }
+    size_t c = 0;
+    for (c = 0; c < numCells; c++) {
+        index->cellStart[c + 1] += index->cellStart[c];
+    }
+    for (i = 0; i < numObstacles; i++) {
+        index->order[index->cellStart[index->cells[i]]++] = i;
+    }
+    // Placing the obstacles moved every cell start to the start of the next cell, so shift them back
+    for (c = numCells; c > 0; c--) {
+        index->cellStart[c] = index->cellStart[c - 1];
+    }
+    index->cellStart[0] = 0;
+    index->usable = 1;
+}
+
+void freeObstacleIndex(ObstacleIndex * index) {
+    guideRelease(index->cellStart);
+    guideRelease(index->order);
+    guideRelease(index->cells);
+    freeIndexArray(&(index->candidates));
+    memset(index, 0, sizeof(ObstacleIndex));
+}
+
+int collectObstacleCandidates(ObstacleIndex * index, Coordinate * p, double radius) {
+    if (!index->usable || !(radius < 1e9)) {
+        return 0;
+    }
+    double fromX = (p->x - radius - index->minX) / index->cellSize;
+    double toX = (p->x + radius - index->minX) / index->cellSize;
+    double fromY = (p->y - radius - index->minY) / index->cellSize;
+    double toY = (p->y + radius - index->minY) / index->cellSize;
+    if (fromX <= 0 && fromY <= 0 && toX >= index->width - 1 && toY >= index->height - 1) {
+        // The search area covers all cells
+        return 0;
+    }
+    index->candidates.size = 0;
+    if (toX < 0 || toY < 0 || fromX >= index->width || fromY >= index->height) {
+        return 1;
+    }
+    size_t minCX = fromX > 0 ? (size_t) fromX : 0;
+    size_t minCY = fromY > 0 ? (size_t) fromY : 0;
+    size_t maxCX = toX < index->width - 1 ? (size_t) toX : index->width - 1;
+    size_t maxCY = toY < index->height - 1 ? (size_t) toY : index->height - 1;
+    size_t cx, cy;
+    for (cy = minCY; cy <= maxCY; cy++) {
+        for (cx = minCX; cx <= maxCX; cx++) {
+            size_t c = cy * index->width + cx;
+            unsigned int k = 0;
+            for (k = index->cellStart[c]; k < index->cellStart[c + 1]; k++) {
+                if (!addToIndexArray(&(index->candidates), index->order[k])) {
+                    return 0;
+                }
+            }
+        }
+    }
+    // Keep the order of the obstacles, such that ties are resolved exactly like when evaluating all obstacles
+    sortIndices(index->candidates.indices, index->candidates.size);
+    return 1;
+}
+
+/*
+ * Changes the capacity of soa to at least capacity border lines. Returns 1 on success, or 0 when the memory is exhausted.
+ * The arrays that did grow keep their new size, which is harmless as the capacity only changes when all of them did.
+ */
+static int reserveBorderlineSoA(BorderlineSoA * soa, size_t capacity) {
+    if (capacity <= soa->capacity) {
+        return 1;
+    }
+    BorderReal ** arrays[7] = {&(soa->bottomX), &(soa->bottomY), &(soa->dirX), &(soa->dirY), &(soa->invLength2), &(soa->normalX), &(soa->normalY)};
+    int a = 0;
+    for (a = 0; a < 7; a++) {
+        BorderReal * grown = (BorderReal *) guideReallocate(*arrays[a], capacity * sizeof(BorderReal));
+        if (grown == NULL) {
+            return 0;
+        }
+        *arrays[a] = grown;
+    }
+    soa->capacity = capacity;
+    return 1;
+}
+
+int addToBorderlineSoA(BorderlineSoA * soa, Borderline * element) {
+    if (soa->size >= soa->capacity && !reserveBorderlineSoA(soa, soa->capacity > 0 ? soa->capacity * 2 : 4)) {
+        return 0;
+    }
+    updateBorderlineSoA(soa, soa->size++, element, 1);
+    return 1;
+}
+
+/*
+ * Computes the values of element in the seven arrays of a BorderlineSoA (bottomX, bottomY, dirX, dirY, invLength2, normalX, normalY) in double precision.
+ */
+static void getBorderlineSoAValues(const Borderline * element, int enabled, double values[7]) {
+    double dx = element->top.x - element->bottom.x;
+    double dy = element->top.y - element->bottom.y;
+    // A NaN coordinate makes the distance to the border line NaN, which the border kernels never consider closer
+    values[0] = enabled ? element->bottom.x : NAN;
+    values[1] = element->bottom.y;
+    values[2] = dx;
+    values[3] = dy;
+    values[4] = 1.0 / (element->length * element->length);
+    // (dy, -dx) points to the RIGHT of the border line
+    values[5] = element->goodSide == RIGHT ? dy : -dy;
+    values[6] = element->goodSide == RIGHT ? -dx : dx;
+}
+
+void updateBorderlineSoA(BorderlineSoA * soa, size_t i, Borderline * element, int enabled) {
+    double values[7];
+    getBorderlineSoAValues(element, enabled, values);
+    soa->bottomX[i] = values[0];
+    soa->bottomY[i] = values[1];
+    soa->dirX[i] = values[2];
+    soa->dirY[i] = values[3];
+    soa->invLength2[i] = values[4];
+    soa->normalX[i] = values[5];
+    soa->normalY[i] = values[6];
+}
+
+void freeBorderlineSoA(BorderlineSoA * soa) {
+    guideRelease(soa->bottomX);
+    guideRelease(soa->bottomY);
+    guideRelease(soa->dirX);
+    guideRelease(soa->dirY);
+    guideRelease(soa->invLength2);
+    guideRelease(soa->normalX);
+    guideRelease(soa->normalY);
+    memset(soa, 0, sizeof(BorderlineSoA));
+}
+
+BorderKernel getBorderKernel(enum kernel * type) {
+    #if BORDER_KERNEL_X86
+        __builtin_cpu_init();
+        int hasAVX2 = __builtin_cpu_supports("avx2");
+        int hasSSE2 = __builtin_cpu_supports("sse2");
+        if (*type == KERNEL_AUTO || (*type == KERNEL_AVX2 && !hasAVX2) || (*type == KERNEL_SSE2 && !hasSSE2)) {
+            *type = hasAVX2 ? KERNEL_AVX2 : (hasSSE2 ? KERNEL_SSE2 : KERNEL_SCALAR);
+        }
+        if (*type == KERNEL_AVX2) {
+            return borderKernelAVX2;
+        } else if (*type == KERNEL_SSE2) {
+            return borderKernelSSE2;
+        }
+    #endif
+    *type = KERNEL_SCALAR;
+    return borderKernelScalar;
+}
+
+enum kernel guideSelectBorderKernel(BlindGuide * guide, enum kernel type) {
+    guide->kernel = getBorderKernel(&type);
+    guide->kernelType = type;
+    return type;
+}
+
+enum kernel selectBorderKernel(enum kernel type) {
+    return guideSelectBorderKernel(&defaultGuide, type);
+}
+
+/*
+ * Returns a newly allocated copy of the size bytes of array, or NULL when array is NULL or the memory is exhausted.
+ */
+static void * copyOfArray(const void * array, size_t size) {
+    if (array == NULL) {
+        return NULL;
+    }
+    void * copy = guideAllocate(size);
+    if (copy != NULL) {
+        memcpy(copy, array, size);
+    }
+    return copy;
+}
+
+/*
+ * Returns 1 when array points into the mapping of guide, 0 otherwise.
+ */
+static int pointsIntoMapping(BlindGuide * guide, const void * array) {
+    const char * start = (const char *) guide->mapping;
+    return guide->mapping != NULL && array != NULL && (const char *) array >= start && (const char *) array < start + guide->mappingSize;
+}
+
+/*
+ * Returns array, or NULL when it points into the mapping of guide.
+ */
+static void * outsideMapping(BlindGuide * guide, void * array) {
+    return pointsIntoMapping(guide, array) ? NULL : array;
+}
+
+/*
+ * Returns a copy of array (of size bytes) in memory of its own when it points into the mapping of guide, and array itself otherwise.
+ * When the memory is exhausted, sets owned to 0 and returns array itself.
+ */
+static void * ownArray(BlindGuide * guide, void * array, size_t size, int * owned) {
+    if (!pointsIntoMapping(guide, array)) {
+        return array;
+    }
+    void * copy = copyOfArray(array, size);
+    if (copy == NULL) {
+        *owned = 0;
+        return array;
+    }
+    return copy;
+}
+
+/*
+ * Copies the parts of the map of guide that point into its mapping into memory of its own, and releases the mapping.
+ * Needed before the map can grow, as memory in the mapping cannot be reallocated.
+ * Returns 1 on success, or 0 when the memory is exhausted (the parts that were not copied then still point into the mapping, which is kept).
+ */
+static int guideOwnMap(BlindGuide * guide) {
+    if (guide->mapping == NULL) {
+        return 1;
+    }
+    int owned = 1;
+    BorderlineArray * ba = &(guide->borderlines);
+    BorderlineSoA * soa = &(guide->soa);
+    BorderChainArray * chains = &(guide->chains);
+    ba->ends = (struct BorderEnds *) ownArray(guide, ba->ends, ba->capacity * sizeof(struct BorderEnds), &owned);
+    ba->vertices = (struct Coordinate *) ownArray(guide, ba->vertices, ba->verticesCapacity * sizeof(struct Coordinate), &owned);
+    chains->chains = (struct BorderChain *) ownArray(guide, chains->chains, chains->capacity * sizeof(struct BorderChain), &owned);
+    BorderReal ** arrays[7] = {&(soa->bottomX), &(soa->bottomY), &(soa->dirX), &(soa->dirY), &(soa->invLength2), &(soa->normalX), &(soa->normalY)};
+    int a = 0;
+    for (a = 0; a < 7; a++) {
+        *arrays[a] = (BorderReal *) ownArray(guide, *arrays[a], soa->capacity * sizeof(BorderReal), &owned);
+    }
+    size_t i = 0;
+    for (i = 0; i < guide->grid.numBuckets; i++) {
+        IndexArray * bucket = &(guide->grid.buckets[i]);
+        bucket->indices = (unsigned int *) ownArray(guide, bucket->indices, bucket->capacity * sizeof(unsigned int), &owned);
+    }
+    if (!owned) {
+        return 0;
+    }
+    guide->releaseMapping(guide->mapping, guide->mappingSize);
+    guide->mapping = NULL;
+    guide->mappingReadOnly = 0;
+    return 1;
+}
+
+/*
+ * Frees the map of guide (but not its scratch space), also when it points into a mapping.
+ */
+static void guideFreeMap(BlindGuide * guide) {
+    if (guide->mapping != NULL) {
+        // These arrays point into the mapping, which is released as a whole
+        // (parts that were copied by guideOwnMap() are freed like any other array)
+        BorderlineSoA * soa = &(guide->soa);
+        guide->borderlines.ends = (struct BorderEnds *) outsideMapping(guide, guide->borderlines.ends);
+        guide->borderlines.vertices = (struct Coordinate *) outsideMapping(guide, guide->borderlines.vertices);
+        guide->chains.chains = (struct BorderChain *) outsideMapping(guide, guide->chains.chains);
+        BorderReal ** arrays[7] = {&(soa->bottomX), &(soa->bottomY), &(soa->dirX), &(soa->dirY), &(soa->invLength2), &(soa->normalX), &(soa->normalY)};
+        int a = 0;
+        for (a = 0; a < 7; a++) {
+            *arrays[a] = (BorderReal *) outsideMapping(guide, *arrays[a]);
+        }
+        size_t i = 0;
+        for (i = 0; i < guide->grid.numBuckets; i++) {
+            guide->grid.buckets[i].indices = (unsigned int *) outsideMapping(guide, guide->grid.buckets[i].indices);
+        }
+        guide->releaseMapping(guide->mapping, guide->mappingSize);
+        guide->mapping = NULL;
+        guide->mappingReadOnly = 0;
+    }
+    freeBorderlineArray(&(guide->borderlines));
+    guideRelease(guide->chains.chains);
+    memset(&(guide->chains), 0, sizeof(BorderChainArray));
+    freeBorderGrid(&(guide->grid));
+    freeBorderlineSoA(&(guide->soa));
+}
+
+/*
+ * Removes all borders of guide, but keeps the memory of its map (unless the map points into a mapping, which is released),
+ * such that adding the same borders again does not allocate memory.
+ */
+static void guideClearMap(BlindGuide * guide) {
+    if (guide->mapping != NULL) {
+        guideFreeMap(guide);
+    }
+    guide->borderlines.size = guide->borderlines.numFree = guide->borderlines.numVertices = 0;
+    guide->soa.size = 0;
+    guide->chains.size = 0;
+    size_t i = 0;
+    for (i = 0; guide->grid.buckets != NULL && i < guide->grid.numBuckets; i++) {
+        guide->grid.buckets[i].size = 0;
+    }
+    guide->grid.numEntries = 0;
+    guide->revision++;
+}
+
+void createBlindGuide(BlindGuide * guide) {
+    memset(guide, 0, sizeof(BlindGuide));
+    guide->params = compiledParams;
+    guideSelectBorderKernel(guide, KERNEL_AUTO);
+}
+
+void freeBlindGuide(BlindGuide * guide) {
+    guideFreeMap(guide);
+    freeBorderSearch(&(guide->search));
+    guide->revision++;
+}
+
+/*
+ * Returns a copy of the size bytes of array like copyOfArray(), where an empty array is copied as NULL.
+ * Sets copied to 0 when the memory is exhausted.
+ */
+static void * copyOfMapArray(const void * array, size_t size, int * copied) {
+    if (size == 0) {
+        return NULL;
+    }
+    void * copy = copyOfArray(array, size);
+    *copied = *copied && copy != NULL;
+    return copy;
+}
+
+int guideCopyMap(BlindGuide * dest, BlindGuide * src) {
+    guideFreeMap(dest);
+    dest->params = src->params;
+    dest->kernel = src->kernel;
+    dest->kernelType = src->kernelType;
+    // Stay above the revisions dest had before, such that a BorderCache filled from its old map is refreshed as well
+    dest->revision = (dest->revision > src->revision ? dest->revision : src->revision) + 1;
+    
+    // The copies only get the capacity they need, every array that fills up grows like any other
+    int copied = 1;
+    BorderlineArray * ba = &(dest->borderlines);
+    size_t n = src->borderlines.size;
+    ba->ends = (struct BorderEnds *) copyOfMapArray(src->borderlines.ends, n * sizeof(struct BorderEnds), &copied);
+    ba->states = (unsigned char *) copyOfMapArray(src->borderlines.states, n * sizeof(unsigned char), &copied);
+    ba->generations = (unsigned int *) copyOfMapArray(src->borderlines.generations, n * sizeof(unsigned int), &copied);
+    ba->freeSlots = (unsigned int *) copyOfMapArray(src->borderlines.freeSlots, n * sizeof(unsigned int), &copied);
+    ba->size = ba->capacity = n;
+    ba->numFree = src->borderlines.numFree;
+    ba->version = src->borderlines.version;
+    ba->vertices = (struct Coordinate *) copyOfMapArray(src->borderlines.vertices, src->borderlines.numVertices * sizeof(struct Coordinate), &copied);
+    ba->numVertices = ba->verticesCapacity = src->borderlines.numVertices;
+    
+    BorderChainArray * chains = &(dest->chains);
+    chains->chains = (struct BorderChain *) copyOfMapArray(src->chains.chains, src->chains.size * sizeof(struct BorderChain), &copied);
+    chains->size = chains->capacity = src->chains.size;
+    
+    BorderlineSoA * soa = &(dest->soa);
+    BorderlineSoA * from = &(src->soa);
+    BorderReal ** arrays[7] = {&(soa->bottomX), &(soa->bottomY), &(soa->dirX), &(soa->dirY), &(soa->invLength2), &(soa->normalX), &(soa->normalY)};
+    BorderReal * fromArrays[7] = {from->bottomX, from->bottomY, from->dirX, from->dirY, from->invLength2, from->normalX, from->normalY};
+    int a = 0;
+    for (a = 0; a < 7; a++) {
+        *arrays[a] = (BorderReal *) copyOfMapArray(fromArrays[a], from->size * sizeof(BorderReal), &copied);
+    }
+    soa->size = soa->capacity = from->size;
+    
+    BorderGrid * grid = &(dest->grid);
+    if (src->grid.buckets != NULL) {
+        grid->buckets = (struct IndexArray *) guideAllocate(src->grid.numBuckets * sizeof(struct IndexArray));
+        copied = copied && grid->buckets != NULL;
+    }
+    if (grid->buckets != NULL) {
+        memset(grid->buckets, 0, src->grid.numBuckets * sizeof(struct IndexArray));
+        grid->numBuckets = src->grid.numBuckets;
+        grid->numEntries = src->grid.numEntries;
+        size_t i = 0;
+        for (i = 0; i < grid->numBuckets; i++) {
+            IndexArray * bucket = &(src->grid.buckets[i]);
+            grid->buckets[i].indices = (unsigned int *) copyOfMapArray(bucket->indices, bucket->size * sizeof(unsigned int), &copied);
+            grid->buckets[i].size = grid->buckets[i].capacity = grid->buckets[i].indices != NULL ? bucket->size : 0;
+        }
+    }
+    if (!copied) {
+        guideFreeMap(dest);
+        return 0;
+    }
+    return 1;
+}
+
+void getDefaultParams(GuideParams * params) {
+    *params = compiledParams;
+}
+
+int validParams(GuideParams * params) {
+    return params->mass > 0 && params->resistanceTime > 0 && params->stopTime >= 0 && params->stopTime < params->resistanceTime
+        && params->radius >= 0 && params->userRadius >= 0 && params->obstacleRadius >= 0 && params->backwardsResistance >= 0
+        && (params->userHandedness == LEFT || params->userHandedness == RIGHT);
+}
+
+int guideSetParams(BlindGuide * guide, GuideParams * params) {
+    if (!validParams(params)) {
+        return 0;
+    }
+    guide->params = *params;
+    // The radii determine which border lines can be reached, so cached border lines are outdated
+    guide->revision++;
+    return 1;
+}
+
+int setParams(GuideParams * params) {
+    return guideSetParams(&defaultGuide, params);
+}
+
+double getParam(GuideParams * params, enum param param) {
+    switch (param) {
+        case PARAM_MASS: return params->mass;
+        case PARAM_RADIUS: return params->radius;
+        case PARAM_USER_RADIUS: return params->userRadius;
+        case PARAM_STOP_TIME: return params->stopTime;
+        case PARAM_RESISTANCE_TIME: return params->resistanceTime;
+        case PARAM_OBSTACLE_RADIUS: return params->obstacleRadius;
+        case PARAM_BACKWARDS_RESISTANCE: return params->backwardsResistance;
+        case PARAM_USER_HANDEDNESS: return params->userHandedness;
+        default: return 0;
+    }
+}
+
+void setParam(GuideParams * params, enum param param, double value) {
+    switch (param) {
+        case PARAM_MASS: params->mass = value; break;
+        case PARAM_RADIUS: params->radius = value; break;
+        case PARAM_USER_RADIUS: params->userRadius = value; break;
+        case PARAM_STOP_TIME: params->stopTime = value; break;
+        case PARAM_RESISTANCE_TIME: params->resistanceTime = value; break;
+        case PARAM_OBSTACLE_RADIUS: params->obstacleRadius = value; break;
+        case PARAM_BACKWARDS_RESISTANCE: params->backwardsResistance = value; break;
+        case PARAM_USER_HANDEDNESS: params->userHandedness = value < 0.5 ? LEFT : RIGHT; break;
+        default: break;
+    }
+}
+
+int findParam(const char * name) {
+    int i = 0;
+    for (i = 0; i < NUM_PARAMS; i++) {
+        if (strcmp(name, paramNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifndef BAKED_MAP_HEADER
+int guideInitializeBorders(BlindGuide * guide) {
+    size_t numCoords = sizeof(borderCoordinates) / sizeof(borderCoordinates[0]);
+    size_t numBorderlines = numCoords / 4;
+    guideClearMap(guide);
+    int ok = numBorderlines <= guide->borderlines.capacity || reserveBorderlineArray(&(guide->borderlines), numBorderlines);
+    ok = ok && guideAddBorders(guide, numBorderlines, borderCoordinates, NULL);
+    guide->borderlines.version = borderMapVersion;
+    return ok;
+}
+
+int initializeBorders() {
+    return guideInitializeBorders(&defaultGuide);
+}
+#endif
+
+void invalidateBorders() {
+    borderMapVersion++;
+}
+
+int bordersOutdated(BorderlineArray * ba) {
+    return ba->version != borderMapVersion;
+}
+
+/*
+ * Makes room for numBorders border lines with numVertices more vertices in the border lines array of guide and its mirror
+ * (doubling their capacity when they grow). Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveGuideBorders(BlindGuide * guide, size_t numBorders, size_t numVertices) {
+    BorderlineArray * ba = &(guide->borderlines);
+    if (numBorders > ba->capacity) {
+        size_t capacity = ba->capacity > 0 ? 2 * ba->capacity : 1;
+        if (!reserveBorderlineArray(ba, capacity > numBorders ? capacity : numBorders)) {
+            return 0;
+        }
+    }
+    return reserveBorderVertices(ba, numVertices) && reserveBorderlineSoA(&(guide->soa), ba->capacity);
+}
+
+/*
+ * Adds border line index of the map of guide, whose slot has just been filled, to the grid and the structure of arrays mirror.
+ * Returns 1 on success, or 0 when the grid runs out of memory (the border line is then in neither of them).
+ */
+static int indexGuideBorder(BlindGuide * guide, unsigned int index) {
+    if (!addToBorderGrid(&(guide->grid), &(guide->borderlines), index)) {
+        return 0;
+    }
+    Borderline bl = getBorderline(&(guide->borderlines), index);
+    if (index < guide->soa.size) {
+        updateBorderlineSoA(&(guide->soa), index, &bl, 1);
+    } else {
+        addToBorderlineSoA(&(guide->soa), &bl);
+    }
+    guide->revision++;
+    return 1;
+}
+
+BorderHandle guideAddBorder(BlindGuide * guide, double bottomX, double bottomY, double topX, double topY, enum side goodSide) {
+    BorderlineArray * ba = &(guide->borderlines);
+    BorderHandle handle;
+    handle.index = INVALID_BORDER_INDEX;
+    handle.generation = 0;
+    // Make room for the border line and its vertices in the array and its mirror first, such that only the grid can still run out of memory
+    int appended = ba->numFree == 0;
+    if (!validBorderCoordinates(bottomX, bottomY, topX, topY) || !guideOwnMap(guide) || (appended && !reserveGuideBorders(guide, ba->size + 1, 2))) {
+        return handle;
+    }
+    struct Coordinate bottom = createCoordinate(bottomX, bottomY);
+    struct Coordinate top = createCoordinate(topX, topY);
+    handle.index = insertIntoBorderlineArray(ba, createBorderline(bottom, top, goodSide));
+    if (!indexGuideBorder(guide, handle.index)) {
+        // Give the slot back (the vertices of a reused slot belong to it alone, so they need not be restored)
+        if (appended) {
+            ba->size--;
+            ba->numVertices -= 2;
+        } else {
+            ba->states[handle.index] = BORDER_REMOVED;
+            ba->freeSlots[ba->numFree++] = handle.index;
+        }
+        handle.index = INVALID_BORDER_INDEX;
+        return handle;
+    }
+    handle.generation = ba->generations[handle.index];
+    return handle;
+}
+
+BorderHandle addBorder(double bottomX, double bottomY, double topX, double topY, enum side goodSide) {
+    return guideAddBorder(&defaultGuide, bottomX, bottomY, topX, topY, goodSide);
+}
+
+/*
+ * Returns 1 when handle refers to a border that is present in ba, 0 otherwise.
+ */
+static int validBorderHandle(BorderlineArray * ba, BorderHandle handle) {
+    return handle.index < ba->size && ba->generations[handle.index] == handle.generation && ba->states[handle.index] != BORDER_REMOVED;
+}
+
+/*
+ * Returns the number of the chain of chains that border line index belongs to, or -1 when it does not belong to a chain.
+ */
+static long findBorderChain(BorderChainArray * chains, unsigned int index) {
+    // The chains are sorted by their border lines
+    size_t low = 0;
+    size_t high = chains->size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (chains->chains[middle].firstBorder + chains->chains[middle].numBorders <= index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < chains->size && chains->chains[low].firstBorder <= index ? (long) low : -1;
+}
+
+int guideRemoveBorder(BlindGuide * guide, BorderHandle handle) {
+    BorderlineArray * ba = &(guide->borderlines);
+    if (!validBorderHandle(ba, handle) || (guide->mappingReadOnly && !guideOwnMap(guide))) {
+        return 0;
+    }
+    removeFromBorderGrid(&(guide->grid), ba, handle.index);
+    Borderline bl = getBorderline(ba, handle.index);
+    updateBorderlineSoA(&(guide->soa), handle.index, &bl, 0);
+    removeFromBorderlineArray(ba, handle.index);
+    if (findBorderChain(&(guide->chains), handle.index) >= 0) {
+        // Keep the border lines of the chain consecutive, so do not let other borders reuse the slot
+        ba->numFree--;
+    }
+    guide->revision++;
+    return 1;
+}
+
+int removeBorder(BorderHandle handle) {
+    return guideRemoveBorder(&defaultGuide, handle);
+}
+
+int guideEnableBorder(BlindGuide * guide, BorderHandle handle, int enabled) {
+    BorderlineArray * ba = &(guide->borderlines);
+    if (!validBorderHandle(ba, handle) || (guide->mappingReadOnly && !guideOwnMap(guide))) {
+        return 0;
+    }
+    // A disabled border line stays in the grid, so border caches remain valid and the revision does not change
+    ba->states[handle.index] = enabled ? BORDER_ENABLED : BORDER_DISABLED;
+    Borderline bl = getBorderline(ba, handle.index);
+    updateBorderlineSoA(&(guide->soa), handle.index, &bl, enabled);
+    return 1;
+}
+
+int enableBorder(BorderHandle handle, int enabled) {
+    return guideEnableBorder(&defaultGuide, handle, enabled);
+}
+
+/*
+ * Makes room for one more chain in chains (doubling their capacity when they grow).
+ * Returns 1 on success, or 0 when the memory is exhausted.
+ */
+static int reserveBorderChain(BorderChainArray * chains) {
+    if (chains->size >= chains->capacity) {
+        size_t capacity = chains->capacity > 0 ? chains->capacity * 2 : 4;
+        BorderChain * grown = (BorderChain *) guideReallocate(chains->chains, capacity * sizeof(struct BorderChain));
+        if (grown == NULL) {
+            return 0;
+        }
+        chains->chains = grown;
+        chains->capacity = capacity;
+    }
+    return 1;
+}
+
+long guideAddBorderChain(BlindGuide * guide, size_t numVertices, double * vertices, int closed, enum side goodSide) {
+    BorderChainArray * chains = &(guide->chains);
+    BorderlineArray * ba = &(guide->borderlines);
+    size_t numBorders = closed ? numVertices : numVertices - 1;
+    size_t k = 0;
+    for (k = 0; k < numVertices; k++) {
+        if (!validBorderCoordinates(vertices[2 * k], vertices[2 * k + 1], vertices[2 * k], vertices[2 * k + 1])) {
+            return -1;
+        }
+    }
+    if (numVertices < 2 || !guideOwnMap(guide) || !reserveBorderChain(chains) || !reserveGuideBorders(guide, ba->size + numBorders, numVertices)) {
+        return -1;
+    }
+    BorderChain * chain = &(chains->chains[chains->size]);
+    chain->firstVertex = ba->numVertices;
+    chain->numVertices = (unsigned int) numVertices;
+    chain->numBorders = (unsigned int) numBorders;
+    chain->goodSide = goodSide;
+    chain->minX = chain->minY = 1e300;
+    chain->maxX = chain->maxY = -1e300;
+    Coordinate * v = ba->vertices + chain->firstVertex;
+    for (k = 0; k < numVertices; k++) {
+        v[k] = createCoordinate(vertices[2 * k], vertices[2 * k + 1]);
+        chain->minX = fmin(chain->minX, v[k].x);
+        chain->maxX = fmax(chain->maxX, v[k].x);
+        chain->minY = fmin(chain->minY, v[k].y);
+        chain->maxY = fmax(chain->maxY, v[k].y);
+    }
+    ba->numVertices += numVertices;
+    // The border lines of the chain are added after all others, such that they get consecutive indices, and refer to the vertices of the chain
+    chain->firstBorder = (unsigned int) ba->size;
+    for (k = 0; k < numBorders; k++) {
+        BorderEnds * ends = &(ba->ends[ba->size]);
+        ends->bottom = (unsigned int) (chain->firstVertex + k);
+        ends->top = (unsigned int) (chain->firstVertex + (k + 1) % numVertices);
+        ends->goodSide = goodSide;
+        ba->states[ba->size] = BORDER_ENABLED;
+        ba->generations[ba->size] = 0;
+        ba->size++;
+        if (!indexGuideBorder(guide, (unsigned int) ba->size - 1)) {
+            // The grid ran out of memory, so take the border lines that were added out again, with the vertices
+            ba->size--;
+            while (k-- > 0) {
+                removeFromBorderGrid(&(guide->grid), ba, (unsigned int) ba->size - 1);
+                ba->size--;
+                guide->soa.size--;
+            }
+            ba->numVertices -= numVertices;
+            return -1;
+        }
+    }
+    return (long) chains->size++;
+}
+
+long addBorderChain(size_t numVertices, double * vertices, int closed, enum side goodSide) {
+    return guideAddBorderChain(&defaultGuide, numVertices, vertices, closed, goodSide);
+}
+
+BorderHandle guideGetChainBorder(BlindGuide * guide, size_t chain, size_t k) {
+    BorderHandle handle;
+    handle.index = INVALID_BORDER_INDEX;
+    handle.generation = 0;
+    if (chain < guide->chains.size && k < guide->chains.chains[chain].numBorders) {
+        handle.index = guide->chains.chains[chain].firstBorder + (unsigned int) k;
+        handle.generation = guide->borderlines.generations[handle.index];
+    }
+    return handle;
+}
+
+int guideAddBorders(BlindGuide * guide, size_t numBorders, double * coordinates, enum side * goodSides) {
+    double vertices[2 * (BORDER_CHAIN_LENGTH + 1)];
+    size_t i = 0;
+    while (i < numBorders) {
+        // Find the run of connected borders starting at border i
+        enum side goodSide = goodSides != NULL ? goodSides[i] : RIGHT;
+        size_t end = i + 1;
+        while (end < numBorders && end - i < BORDER_CHAIN_LENGTH && (goodSides != NULL ? goodSides[end] : RIGHT) == goodSide
+                && coordinates[4 * end] == coordinates[4 * end - 2] && coordinates[4 * end + 1] == coordinates[4 * end - 1]) {
+            end++;
+        }
+        if (end - i == 1) {
+            if (guideAddBorder(guide, coordinates[4 * i], coordinates[4 * i + 1], coordinates[4 * i + 2], coordinates[4 * i + 3], goodSide).index == INVALID_BORDER_INDEX) {
+                return 0;
+            }
+            i = end;
+            continue;
+        }
+        size_t numVertices = 0;
+        size_t k = 0;
+        for (k = i; k < end; k++) {
+            vertices[2 * numVertices] = coordinates[4 * k];
+            vertices[2 * numVertices + 1] = coordinates[4 * k + 1];
+            numVertices++;
+        }
+        // A run that ends where it started is a polygon, whose last border closes the chain
+        double * last = &(coordinates[4 * (end - 1) + 2]);
+        int closed = last[0] == coordinates[4 * i] && last[1] == coordinates[4 * i + 1];
+        if (!closed) {
+            vertices[2 * numVertices] = last[0];
+            vertices[2 * numVertices + 1] = last[1];
+            numVertices++;
+        }
+        if (guideAddBorderChain(guide, numVertices, vertices, closed, goodSide) < 0) {
+            return 0;
+        }
+        i = end;
+    }
+    return 1;
+}
+
+int guideUseMapSections(BlindGuide * guide, const MapSections * sections, void * mapping, size_t size, void (*release)(void * mapping, size_t size), int readOnly) {
+    size_t n = sections->numBorderlines;
+    // Only the bookkeeping of removed borders and the buckets of the grid need memory of their own, allocated before the current map is freed
+    unsigned char * states = NULL;
+    unsigned int * generations = NULL;
+    unsigned int * freeSlots = NULL;
+    struct IndexArray * buckets = NULL;
+    if (n > 0) {
+        states = (unsigned char *) copyOfArray(sections->states, n);
+        generations = (unsigned int *) guideAllocate(n * sizeof(unsigned int));
+        freeSlots = (unsigned int *) guideAllocate(n * sizeof(unsigned int));
+        buckets = sections->numBuckets > 0 ? (struct IndexArray *) guideAllocate(sections->numBuckets * sizeof(struct IndexArray)) : NULL;
+        if (states == NULL || generations == NULL || freeSlots == NULL || (buckets == NULL && sections->numBuckets > 0)) {
+            guideRelease(buckets);
+            guideRelease(freeSlots);
+            guideRelease(generations);
+            guideRelease(states);
+            release(mapping, size);
+            return 0;
+        }
+    }
+
+    guideFreeMap(guide);
+    guide->revision++;
+    if (n == 0) {
+        release(mapping, size);
+        guide->borderlines.version = borderMapVersion;
+        return 1;
+    }
+
+    // The border lines, their vertices and their mirror are used in place
+    BorderlineArray * ba = &(guide->borderlines);
+    ba->ends = (struct BorderEnds *) sections->ends;
+    ba->states = states;
+    ba->generations = generations;
+    memset(ba->generations, 0, n * sizeof(unsigned int));
+    ba->freeSlots = freeSlots;
+    ba->size = ba->capacity = n;
+    ba->numFree = 0;
+    ba->version = borderMapVersion;
+    ba->vertices = (struct Coordinate *) sections->vertices;
+    ba->numVertices = ba->verticesCapacity = sections->numVertices;
+
+    BorderlineSoA * soa = &(guide->soa);
+    BorderReal * arrays = (BorderReal *) sections->soa;
+    soa->bottomX = arrays;
+    soa->bottomY = arrays + n;
+    soa->dirX = arrays + 2 * n;
+    soa->dirY = arrays + 3 * n;
+    soa->invLength2 = arrays + 4 * n;
+    soa->normalX = arrays + 5 * n;
+    soa->normalY = arrays + 6 * n;
+    soa->size = soa->capacity = n;
+
+    if (sections->numChains > 0) {
+        BorderChainArray * chains = &(guide->chains);
+        chains->chains = (struct BorderChain *) sections->chains;
+        chains->size = chains->capacity = sections->numChains;
+    }
+
+    BorderGrid * grid = &(guide->grid);
+    unsigned int i = 0;
+    int complete = 1;
+    if (buckets != NULL) {
+        grid->numBuckets = sections->numBuckets;
+        grid->numEntries = sections->numEntries;
+        grid->buckets = buckets;
+        memset(grid->buckets, 0, grid->numBuckets * sizeof(struct IndexArray));
+        size_t b = 0;
+        for (b = 0; b < grid->numBuckets; b++) {
+            if (sections->bucketStart[b + 1] > sections->bucketStart[b]) {
+                grid->buckets[b].indices = (unsigned int *) sections->entries + sections->bucketStart[b];
+                grid->buckets[b].size = grid->buckets[b].capacity = sections->bucketStart[b + 1] - sections->bucketStart[b];
+            }
+        }
+    } else {
+        for (i = 0; i < n && complete; i++) {
+            if (ba->states[i] != BORDER_REMOVED) {
+                complete = addToBorderGrid(grid, ba, i);
+            }
+        }
+    }
+    // Removed borders should not be stored, but reuse their slots when they are (unless they belong to a chain)
+    for (i = 0; i < n; i++) {
+        if (ba->states[i] == BORDER_REMOVED && findBorderChain(&(guide->chains), i) < 0) {
+            ba->freeSlots[ba->numFree++] = i;
+        }
+    }
+
+    guide->mapping = mapping;
+    guide->mappingSize = size;
+    guide->releaseMapping = release;
+    guide->mappingReadOnly = readOnly;
+    if (!complete) {
+        // The grid ran out of memory, which leaves the guide without a map
+        guideFreeMap(guide);
+        guide->revision++;
+        return 0;
+    }
+    return 1;
+}
+
+int guideReserve(BlindGuide * guide, size_t numBorders, unsigned int numObstacles) {
+    BorderlineArray * ba = &(guide->borderlines);
+    // Every border line takes at most two vertices of its own
+    size_t numVertices = 2 * numBorders > ba->numVertices ? 2 * numBorders - ba->numVertices : 0;
+    if ((numBorders > ba->capacity || ba->numVertices + numVertices > ba->verticesCapacity) && (!guideOwnMap(guide)
+            || (numBorders > ba->capacity && !reserveBorderlineArray(ba, numBorders)) || !reserveBorderVertices(ba, numVertices))) {
+        return 0;
+    }
+    if (!reserveBorderlineSoA(&(guide->soa), guide->borderlines.capacity)) {
+        return 0;
+    }
+    // A map that is used in place is copied by its first change anyway
+    if (guide->mapping == NULL && !reserveBorderGrid(&(guide->grid), ba, numBorders)) {
+        return 0;
+    }
+    return guideReserveSearch(guide, &(guide->search), numObstacles);
+}
+
+int guideReserveSearch(BlindGuide * guide, BorderSearch * search, unsigned int numObstacles) {
+    size_t capacity = guide->borderlines.capacity;
+    // The obstacle index never uses more than 4 * numObstacles + 64 cells (see indexObstacles())
+    return reserveSearchStamps(search, capacity) && reserveIndexArray(&(search->candidates), capacity)
+        && reserveObstacleIndex(&(search->obstacles), numObstacles, 4 * (size_t) numObstacles + 64)
+        && reserveIndexArray(&(search->obstacles.candidates), numObstacles);
+}
+
+/*
+ * Returns the distance from p to border line i of soa, and stores the closest point of the border line in closest.
+ */
+static double distanceToBorderline(BorderlineSoA * soa, size_t i, Coordinate * p, Coordinate * closest) {
+    double t = fmax(0.0, fmin(1.0, ((p->x - soa->bottomX[i]) * soa->dirX[i] + (p->y - soa->bottomY[i]) * soa->dirY[i]) * soa->invLength2[i]));
+    closest->x = soa->bottomX[i] + t * soa->dirX[i];
+    closest->y = soa->bottomY[i] + t * soa->dirY[i];
+    return sqrt((closest->x - p->x) * (closest->x - p->x) + (closest->y - p->y) * (closest->y - p->y));
+}
+
+void createDistanceField(BlindGuide * guide, DistanceField * field, double resolution) {
+    BorderlineSoA * soa = &(guide->soa);
+    freeDistanceField(field);
+    field->resolution = resolution;
+    field->revision = guide->revision;
+    if (soa->size == 0) {
+        return;
+    }
+    
+    // Determine the area covered by the border lines
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t i = 0;
+    for (i = 0; i < soa->size; i++) {
+        minX = fmin(minX, fmin(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        maxX = fmax(maxX, fmax(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        minY = fmin(minY, fmin(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+        maxY = fmax(maxY, fmax(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+    }
+    if (minX > maxX) {
+        // All border lines are disabled or removed
+        return;
+    }
+    double margin = guide->params.radius + guide->params.userRadius + resolution;
+    field->minX = minX - margin;
+    field->minY = minY - margin;
+    field->width = (size_t) ceil((maxX - minX + 2 * margin) / resolution) + 1;
+    field->height = (size_t) ceil((maxY - minY + 2 * margin) / resolution) + 1;
+    size_t numNodes = field->width * field->height;
+    field->distance = (double *) guideAllocate(numNodes * sizeof(double));
+    field->nearest = (unsigned int *) guideAllocate(numNodes * sizeof(unsigned int));
+    field->goodSide = (unsigned char *) guideAllocate(numNodes * sizeof(unsigned char));
+    if (field->distance == NULL || field->nearest == NULL || field->goodSide == NULL) {
+        // Leave the field empty, such that getResistanceFromField() falls back to the exact computation
+        freeDistanceField(field);
+        field->resolution = resolution;
+        field->revision = guide->revision;
+        return;
+    }
+    
+    size_t n = 0;
+    for (n = 0; n < numNodes; n++) {
+        Coordinate node = createCoordinate(field->minX + (n % field->width) * resolution, field->minY + (n / field->width) * resolution);
+        Coordinate closest;
+        double nearestDistance = 1e300;
+        unsigned int nearest = 0;
+        // Search the grid in growing circles, every border line within the radius is guaranteed to be found
+        double radius = GRID_CELL_SIZE;
+        for (;;) {
+            int found = collectBorderCandidates(&(guide->grid), &(guide->search), &(guide->borderlines), &node, radius);
+            size_t numIndices = found ? guide->search.candidates.size : soa->size;
+            size_t k = 0;
+            for (k = 0; k < numIndices; k++) {
+                unsigned int index = found ? guide->search.candidates.indices[k] : k;
+                double d = distanceToBorderline(soa, index, &node, &closest);
+                if (d < nearestDistance) {
+                    nearestDistance = d;
+                    nearest = index;
+                }
+            }
+            if (!found || nearestDistance <= radius) {
+                break;
+            }
+            radius *= 2;
+        }
+        field->distance[n] = nearestDistance;
+        field->nearest[n] = nearest;
+        field->goodSide[n] = (node.x - soa->bottomX[nearest]) * soa->normalX[nearest] + (node.y - soa->bottomY[nearest]) * soa->normalY[nearest] > 0;
+    }
+}
+
+void freeDistanceField(DistanceField * field) {
+    guideRelease(field->goodSide);
+    guideRelease(field->nearest);
+    guideRelease(field->distance);
+    memset(field, 0, sizeof(DistanceField));
+}
+
+double getResistanceFromField(BlindGuide * guide, DistanceField * field, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    double gx = (x - field->minX) / field->resolution;
+    double gy = (y - field->minY) / field->resolution;
+    if (field->distance == NULL || field->revision != guide->revision || !(gx >= 0 && gy >= 0 && gx < field->width - 1 && gy < field->height - 1)) {
+        return guideGetResistance(guide, x, y, phi, forceX, forceY, numObstacles, obstacles);
+    }
+    size_t i = (size_t) gx;
+    size_t j = (size_t) gy;
+    double fx = gx - i;
+    double fy = gy - j;
+    size_t n = j * field->width + i;
+    size_t nearestNode = n + (fx >= 0.5 ? 1 : 0) + (fy >= 0.5 ? field->width : 0);
+    unsigned int index = field->nearest[nearestNode];
+    if (index >= guide->borderlines.size || guide->borderlines.states[index] != BORDER_ENABLED) {
+        // The field was not built from this map, or its nearest border line has been disabled since
+        return guideGetResistance(guide, x, y, phi, forceX, forceY, numObstacles, obstacles);
+    }
+    
+    STATS_START(start);
+    Coordinate point;
+    Vector force;
+    double resistance = prepareResistance(x, y, phi, forceX, forceY, &point, &force, &(guide->params));
+    if (TRACING(&(guide->search))) {
+        traceQuery(&(guide->search), x, y, phi, forceX, forceY, resistance, numObstacles);
+    }
+    
+    // Bilinearly interpolate the distance to the nearest border line
+    double length = (1 - fy) * ((1 - fx) * field->distance[n] + fx * field->distance[n + 1])
+        + fy * ((1 - fx) * field->distance[n + field->width] + fx * field->distance[n + field->width + 1]);
+    
+    // The direction to the nearest border line only requires a single border line
+    Coordinate closest;
+    double d = distanceToBorderline(&(guide->soa), index, &point, &closest);
+    double ux = (closest.x - point.x) / d;
+    double uy = (closest.y - point.y) / d;
+    GuideParams * params = &(guide->params);
+    length -= params->radius;
+    double rx = cos(phi) * ux + sin(phi) * uy;
+    double ry = cos(phi) * uy - sin(phi) * ux;
+    if (ry <= 0 && ((params->userHandedness == RIGHT && rx >= 0) || (params->userHandedness == LEFT && rx <= 0))) {
+        length -= params->userRadius;
+    }
+    double angle = force.x * ux + force.y * uy;
+    double dist = length / angle;
+    
+    enum action closestBorderAction = NOTHING;
+    double nearestDistance = 1000000000;
+    if (dist >= 0 && dist < nearestDistance) {
+        nearestDistance = dist;
+        if (field->goodSide[nearestNode]) {
+            closestBorderAction = angle > 0 ? RESIST : NOTHING;
+        } else {
+            closestBorderAction = angle > 0 ? NOTHING : STOP;
+        }
+    }
+    
+    ObstacleIndex * obstacleIndex = NULL;
+    if (numObstacles >= OBSTACLE_INDEX_THRESHOLD) {
+        indexObstacles(&(guide->search.obstacles), numObstacles, obstacles);
+        obstacleIndex = &(guide->search.obstacles);
+    }
+    // Only the nearest border line of the field is evaluated
+    STATS_ADD(&(guide->search.stats), bordersTested, 1);
+    resistance = finishResistance(&point, &force, phi, resistance, nearestDistance, closestBorderAction, numObstacles, obstacles, obstacleIndex, &(guide->search), &(guide->params));
+    STATS_FINISH(&(guide->search.stats), start);
+    return resistance;
+}
+
+double getDistanceFieldDistanceBound(DistanceField * field) {
+    return field->resolution / sqrt(2.0);
+}
+
+double measureDistanceFieldError(BlindGuide * guide, DistanceField * field, size_t numSamples, double forceMagnitude, double * meanError) {
+    // Simple linear congruential generator, such that the samples do not depend on (or disturb) rand()
+    unsigned long long state = 12345;
+    double maxError = 0;
+    double totalError = 0;
+    size_t k = 0;
+    for (k = 0; k < numSamples; k++) {
+        double r[4];
+        int m = 0;
+        for (m = 0; m < 4; m++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            r[m] = (state >> 11) * (1.0 / 9007199254740992.0);
+        }
+        double x = field->minX + r[0] * (field->width - 1) * field->resolution;
+        double y = field->minY + r[1] * (field->height - 1) * field->resolution;
+        double phi = (r[2] * 2 - 1) * PI;
+        double forceAngle = (r[3] * 2 - 1) * PI;
+        double forceX = forceMagnitude * cos(forceAngle);
+        double forceY = forceMagnitude * sin(forceAngle);
+        double error = fabs(getResistanceFromField(guide, field, x, y, phi, forceX, forceY, 0, NULL) - guideGetResistance(guide, x, y, phi, forceX, forceY, 0, NULL));
+        maxError = fmax(maxError, error);
+        totalError += error;
+    }
+    if (meanError != NULL) {
+        *meanError = numSamples > 0 ? totalError / numSamples : 0;
+    }
+    return maxError;
+}
+
+double measurePrecisionError(BlindGuide * guide, size_t numSamples, double forceMagnitude, double * meanError) {
+    BorderlineArray * ba = &(guide->borderlines);
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t i = 0;
+    for (i = 0; i < ba->size; i++) {
+        if (ba->states[i] == BORDER_ENABLED) {
+            Borderline b = getBorderline(ba, (unsigned int) i);
+            minX = fmin(minX, fmin(b.bottom.x, b.top.x));
+            maxX = fmax(maxX, fmax(b.bottom.x, b.top.x));
+            minY = fmin(minY, fmin(b.bottom.y, b.top.y));
+            maxY = fmax(maxY, fmax(b.bottom.y, b.top.y));
+        }
+    }
+    if (minX > maxX) {
+        minX = minY = maxX = maxY = 0;
+    }
+    // Also sample the area just outside the border lines that the robot and user can reach
+    double margin = guide->params.radius + guide->params.userRadius + 1;
+    // Simple linear congruential generator, such that the samples do not depend on (or disturb) rand()
+    unsigned long long state = 12345;
+    double maxError = 0;
+    double totalError = 0;
+    size_t k = 0;
+    for (k = 0; k < numSamples; k++) {
+        double r[4];
+        int m = 0;
+        for (m = 0; m < 4; m++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            r[m] = (state >> 11) * (1.0 / 9007199254740992.0);
+        }
+        double x = minX - margin + r[0] * (maxX - minX + 2 * margin);
+        double y = minY - margin + r[1] * (maxY - minY + 2 * margin);
+        double phi = (r[2] * 2 - 1) * PI;
+        double forceAngle = (r[3] * 2 - 1) * PI;
+        double forceX = forceMagnitude * cos(forceAngle);
+        double forceY = forceMagnitude * sin(forceAngle);
+        
+        Coordinate point;
+        Vector force;
+        double reference = prepareResistance(x, y, phi, forceX, forceY, &point, &force, &(guide->params));
+        double nearestDistance = 1000000000;
+        enum action closestBorderAction = NOTHING;
+        evaluateBorders(&point, ba, NULL, ba->size, &force, phi, &nearestDistance, &closestBorderAction, &(guide->params));
+        reference = finishResistance(&point, &force, phi, reference, nearestDistance, closestBorderAction, 0, NULL, NULL, NULL, &(guide->params));
+        
+        double error = fabs(guideGetResistance(guide, x, y, phi, forceX, forceY, 0, NULL) - reference);
+        maxError = fmax(maxError, error);
+        totalError += error;
+    }
+    if (meanError != NULL) {
+        *meanError = numSamples > 0 ? totalError / numSamples : 0;
+    }
+    return maxError;
+}
+
+void guideGetStats(BlindGuide * guide, GuideStats * snapshot) {
+    *snapshot = guide->search.stats;
+}
+
+void getStats(GuideStats * snapshot) {
+    guideGetStats(&defaultGuide, snapshot);
+}
+
+void guideResetStats(BlindGuide * guide) {
+    memset(&(guide->search.stats), 0, sizeof(GuideStats));
+}
+
+void resetStats() {
+    guideResetStats(&defaultGuide);
+}
+
+void mergeStats(GuideStats * total, GuideStats * stats) {
+    total->queries += stats->queries;
+    total->bordersTested += stats->bordersTested;
+    total->obstaclesTested += stats->obstaclesTested;
+    total->fullScans += stats->fullScans;
+    total->cacheRefreshes += stats->cacheRefreshes;
+    int i = 0;
+    for (i = 0; i < 3; i++) {
+        total->actions[i] += stats->actions[i];
+    }
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        total->latency[i] += stats->latency[i];
+    }
+    total->totalNanoseconds += stats->totalNanoseconds;
+    total->maxNanoseconds = total->maxNanoseconds > stats->maxNanoseconds ? total->maxNanoseconds : stats->maxNanoseconds;
+    total->lastNanoseconds = stats->lastNanoseconds;
+}
+
+double getStatsPercentile(GuideStats * stats, double fraction) {
+    if (stats->queries == 0) {
+        return 0;
+    }
+    // The number of queries that must have completed within the returned latency
+    double needed = fmin(fmax(fraction, 0.0), 1.0) * stats->queries;
+    unsigned long long seen = 0;
+    int i = 0;
+    for (i = 0; i < STATS_BUCKETS - 1; i++) {
+        seen += stats->latency[i];
+        if (seen > 0 && seen >= needed) {
+            break;
+        }
+    }
+    return ldexp(1.0, i + 1) - 1;
+}
+
+void createTraceRing(TraceRing * ring, size_t capacity) {
+    memset(ring, 0, sizeof(TraceRing));
+    if (capacity == 0) {
+        capacity = TRACE_CAPACITY;
+    }
+    ring->capacity = 1;
+    while (ring->capacity < capacity) {
+        ring->capacity *= 2;
+    }
+    ring->records = (struct TraceRecord *) guideAllocate(ring->capacity * sizeof(struct TraceRecord));
+    if (ring->records == NULL) {
+        ring->capacity = 0;
+    }
+    atomic_init(&(ring->enabled), 0);
+    atomic_init(&(ring->dropped), 0);
+    atomic_init(&(ring->head), 0);
+    atomic_init(&(ring->tail), 0);
+}
+
+void freeTraceRing(TraceRing * ring) {
+    guideRelease(ring->records);
+    memset(ring, 0, sizeof(TraceRing));
+}
+
+void setTraceEnabled(TraceRing * ring, int enabled) {
+    atomic_store_explicit(&(ring->enabled), enabled, memory_order_relaxed);
+}
+
+size_t readTrace(TraceRing * ring, TraceRecord * records, size_t maxRecords) {
+    size_t tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+    size_t head = atomic_load_explicit(&(ring->head), memory_order_acquire);
+    size_t n = head - tail < maxRecords ? head - tail : maxRecords;
+    size_t i = 0;
+    for (i = 0; i < n; i++) {
+        records[i] = ring->records[(tail + i) & (ring->capacity - 1)];
+    }
+    // Only hand the slots back to the producer after they have been copied
+    atomic_store_explicit(&(ring->tail), tail + n, memory_order_release);
+    return n;
+}
+
+unsigned long long getTraceDropped(TraceRing * ring) {
+    return atomic_load_explicit(&(ring->dropped), memory_order_relaxed);
+}
+
+void guideSetTrace(BlindGuide * guide, TraceRing * ring) {
+    guide->search.trace = ring;
+}
+
+void setTrace(TraceRing * ring) {
+    guideSetTrace(&defaultGuide, ring);
 }
 
-double getResistance(double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
-    #if DEBUG
-        printf("\nGetting resistance for point (%lf,%lf) against direction (%lf, %lf)\n", x, y, forceX, forceY);
-    #endif
+double prepareResistance(double x, double y, double phi, double forceX, double forceY, Coordinate * point, Vector * force, GuideParams * params) {
     
     double resistance = 0;
-    Coordinate point = createCoordinate(x, y);
+    *point = createCoordinate(x, y);
     
     double forceAngle = atan2(forceY, forceX);
     
-    // Moving backwards always gives a minimum of BACKWARDS_RESISTANCE resistance
+    // Moving backwards always gives a minimum of backwardsResistance resistance
     if (forceAngle < 0) {
-        resistance = BACKWARDS_RESISTANCE * (1 - 2 * abs(forceAngle / PI + 0.5));
+        resistance = params->backwardsResistance * (1 - 2 * abs(forceAngle / PI + 0.5));
     }
     
     double forceXRot = cos(phi) * forceX - sin(phi) * forceY;
     double forceYRot = sin(phi) * forceX + cos(phi) * forceY;
     
-    Vector force = createVector(forceXRot, forceYRot);
+    *force = createVector(forceXRot, forceYRot);
     
-    #if DEBUG
-        Vector f = createVector(forceX, forceY);
-        printf("Original force: distance: %lf, x: %lf, y: %lf\n", f.length, f.x, f.y);
-        printf("Force: distance: %lf, x: %lf, y: %lf\n", force.length, force.x, force.y);
-    #endif
     
+    return resistance;
+}
+
+double finishResistance(Coordinate * point, Vector * force, double phi, double resistance, double nearestDistance, enum action closestBorderAction, unsigned int numObstacles, double * obstacles, ObstacleIndex * obstacleIndex, BorderSearch * search, GuideParams * params) {
     Vector toBorder;
-    double nearestDistance = 1000000000;
-    enum action closestBorderAction = NOTHING;
-    
-    unsigned int i = 0;
-    for (i = 0; i < borderlines.size; i++) {
-        #if DEBUG
-            printf("\nBorder %d of %d:\n", i+1, borderlines.size);
-        #endif
-        // Determine the necessary action for the current border line
-        // The toBorder vector will also be populated accordingly
-        enum action a = approachingBorder(&point, &(borderlines.borderlines[i]), &force, phi, &toBorder);
-        if (toBorder.length >= 0 && toBorder.length < nearestDistance) {
-            nearestDistance = toBorder.length;
-            closestBorderAction = a;
-        }
-    }
+    #if STATS
+        GuideStats * stats = search != NULL ? &(search->stats) : NULL;
+    #endif
+    int tracing = TRACING(search);
     
     if (closestBorderAction == RESIST) {
         // Determine the calculated resistance that is necessary for the given force and distance to the nearest border line
-        resistance = fmax(resistance, getDistanceResistance(&force, nearestDistance));
+        double borderResistance = paramsGetDistanceResistance(params, force, nearestDistance);
+        resistance = fmax(resistance, borderResistance);
+        if (tracing) {
+            traceEvent(search, TRACE_RESISTANCE, 0, RESIST, 0, nearestDistance, borderResistance, resistance, 0, 0, 0);
+        }
     } else if (closestBorderAction == STOP) {
         // If STOP is required, resist fully
+        STATS_ADD(stats, actions[STOP], 1);
+        if (search != NULL) {
+            search->action = STOP;
+        }
+        if (tracing) {
+            traceEvent(search, TRACE_RESULT, 0, STOP, 0, 1.0, 0, 0, 0, 0, 0);
+        }
         return 1.0;
     }
     
-    if (numObstacles == 1 && obstacles[0] == x && obstacles[1] == y) {
+    if (numObstacles == 1 && obstacles[0] == point->x && obstacles[1] == point->y) {
         numObstacles = 0;
     }
     
+    // Obstacles that cannot be reached within the resistance time never cause resistance, so only evaluate nearby obstacles
+    unsigned int * indices = NULL;
+    if (obstacleIndex != NULL && collectObstacleCandidates(obstacleIndex, point, paramsGetReach(params, force) * 1.0001 + params->radius + params->obstacleRadius + params->userRadius)) {
+        indices = obstacleIndex->candidates.indices;
+        numObstacles = obstacleIndex->candidates.size;
+    }
+    STATS_ADD(stats, obstaclesTested, numObstacles);
+    
     nearestDistance = 1000000000;
-    i = 0;
-    for (i = 0; i < numObstacles; i++) {
-        #if DEBUG
-            printf("\nObstacle %d of %d at (%lf, %lf):\n", i+1, numObstacles, obstacles[2 * i], obstacles[2 * i + 1]);
-        #endif
+    unsigned int k = 0;
+    for (k = 0; k < numObstacles; k++) {
+        unsigned int i = indices != NULL ? indices[k] : k;
         // Determine the necessary action for the current obstacle
         // The toBorder vector will also be populated accordingly
-        enum action a = approachingObstacle(&point, obstacles[2 * i], obstacles[2 * i + 1], &force, phi, &toBorder);
+        enum action a = paramsApproachingObstacle(params, point, obstacles[2 * i], obstacles[2 * i + 1], force, phi, &toBorder);
+        if (tracing) {
+            traceEvent(search, TRACE_OBSTACLE, i, a, 0, obstacles[2 * i], obstacles[2 * i + 1], toBorder.length, 0, 0, 0);
+        }
         if (toBorder.length >= 0 && toBorder.length < nearestDistance && a != NOTHING) {
             nearestDistance = toBorder.length;
             closestBorderAction = a;
@@ -379,24 +3460,447 @@ double getResistance(double x, double y, double phi, double forceX, double force
     
     if (closestBorderAction == RESIST) {
         // Determine the calculated resistance that is necessary for the given force and distance to the nearest obstacle
-        resistance = fmax(resistance, getDistanceResistance(&force, nearestDistance));
+        double obstacleResistance = paramsGetDistanceResistance(params, force, nearestDistance);
+        resistance = fmax(resistance, obstacleResistance);
+        if (tracing) {
+            traceEvent(search, TRACE_RESISTANCE, 0, RESIST, TRACE_FROM_OBSTACLE, nearestDistance, obstacleResistance, resistance, 0, 0, 0);
+        }
     } else if (closestBorderAction == STOP) {
         // If STOP is required, resist fully
+        STATS_ADD(stats, actions[STOP], 1);
+        if (search != NULL) {
+            search->action = STOP;
+        }
+        if (tracing) {
+            traceEvent(search, TRACE_RESULT, 0, STOP, 0, 1.0, 0, 0, 0, 0, 0);
+        }
         return 1.0;
     }
     
+    STATS_ADD(stats, actions[closestBorderAction], 1);
+    if (search != NULL) {
+        search->action = closestBorderAction;
+    }
+    if (tracing) {
+        traceEvent(search, TRACE_RESULT, 0, closestBorderAction, 0, resistance, 0, 0, 0, 0, 0);
+    }
+    return resistance;
+}
+
+double getResistance(double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    return guideGetResistance(&defaultGuide, x, y, phi, forceX, forceY, numObstacles, obstacles);
+}
+
+double guideGetResistance(BlindGuide * guide, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    return guideGetResistanceWith(guide, &(guide->search), x, y, phi, forceX, forceY, numObstacles, obstacles);
+}
+
+/*
+ * Returns the radius around the robot that contains every border line that can be reached along the force vector within the resistance time of params.
+ * Also covers the radius of the robot and the user (and a small margin for rounding errors).
+ */
+static double getSearchRadius(GuideParams * params, Vector * force) {
+    return paramsGetReach(params, force) * 1.0001 + params->radius + params->userRadius;
+}
+
+/*
+ * Returns 1 when the bounding box of chain overlaps the square of radius meters around p, 0 otherwise.
+ * Like the cells of the grid, the square also covers the corners that lie more than radius meters away from p.
+ */
+static int chainWithinSquare(BorderChain * chain, Coordinate * p, double radius) {
+    return chain->minX - p->x <= radius && p->x - chain->maxX <= radius && chain->minY - p->y <= radius && p->y - chain->maxY <= radius;
+}
+
+/*
+ * Collects the indices of all border lines of guide into search->candidates, except for the border lines of the chains whose bounding box
+ * lies outside the square of radius meters around p (see chainWithinSquare()), in ascending order.
+ * Returns 0 (and leaves search->candidates untouched) when no chain can be skipped or the memory is exhausted, 1 otherwise.
+ */
+static int collectChainCandidates(BlindGuide * guide, BorderSearch * search, Coordinate * p, double radius) {
+    BorderChainArray * chains = &(guide->chains);
+    if (chains->size == 0 || !(radius < 1e9) || !isfinite(p->x) || !isfinite(p->y)) {
+        return 0;
+    }
+    size_t numSkipped = 0;
+    size_t i = 0;
+    for (i = 0; i < chains->size; i++) {
+        BorderChain * chain = &(chains->chains[i]);
+        numSkipped += !chainWithinSquare(chain, p, radius);
+    }
+    BorderlineArray * ba = &(guide->borderlines);
+    if (numSkipped == 0 || !reserveIndexArray(&(search->candidates), ba->size)) {
+        return 0;
+    }
+    search->candidates.size = 0;
+    unsigned int index = 0;
+    for (i = 0; i <= chains->size; i++) {
+        // Add the loose border lines before chain i (or after the last chain)
+        unsigned int end = i < chains->size ? chains->chains[i].firstBorder : (unsigned int) ba->size;
+        for (; index < end; index++) {
+            if (ba->states[index] != BORDER_REMOVED) {
+                addToIndexArray(&(search->candidates), index);
+            }
+        }
+        if (i == chains->size) {
+            break;
+        }
+        BorderChain * chain = &(chains->chains[i]);
+        if (chainWithinSquare(chain, p, radius)) {
+            for (; index < chain->firstBorder + chain->numBorders; index++) {
+                addToIndexArray(&(search->candidates), index);
+            }
+        }
+        index = chain->firstBorder + chain->numBorders;
+    }
+    return 1;
+}
+
+/*
+ * Collects the border lines of guide that have a point within radius meters of p into search->candidates, sorted in ascending order,
+ * using the grid (see collectBorderCandidates()) or else the bounding boxes of the chains, which may add border lines that are further away.
+ * Returns 0 (and leaves search->candidates untouched) when neither can narrow down the search, 1 otherwise.
+ */
+static int collectGuideCandidates(BlindGuide * guide, BorderSearch * search, Coordinate * p, double radius) {
+    return collectBorderCandidates(&(guide->grid), search, &(guide->borderlines), p, radius) || collectChainCandidates(guide, search, p, radius);
+}
+
+/*
+ * Re-evaluates the border lines of guide for the robot at point after a narrowed search found a STOP border line beyond the reach,
+ * since a skipped border line might be closer along the force vector.
+ * Along the (unit) force vector, a border line is never closer than its distance minus the radius of the robot and the user,
+ * so only the border lines within nearestDistance plus these radii of point can replace the one found.
+ * Replaces search->candidates, and counts a full scan in the stats of search when no border line can be skipped.
+ */
+static void recheckGuideBorders(BlindGuide * guide, BorderSearch * search, Coordinate * point, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    BorderlineSoA * soa = &(guide->soa);
+    double radius = *nearestDistance * 1.0001 + params->radius + params->userRadius;
+    *nearestDistance = 1000000000;
+    *closestBorderAction = NOTHING;
+    if (collectGuideCandidates(guide, search, point, radius)) {
+        guide->kernel(soa, search->candidates.indices, search->candidates.size, point, force, phi, nearestDistance, closestBorderAction, params);
+        STATS_ADD(&(search->stats), bordersTested, search->candidates.size);
+        if (TRACING(search)) {
+            traceBorders(guide, search, search->candidates.indices, search->candidates.size, point, force, phi, params);
+        }
+    } else {
+        guide->kernel(soa, NULL, soa->size, point, force, phi, nearestDistance, closestBorderAction, params);
+        STATS_ADD(&(search->stats), bordersTested, soa->size);
+        STATS_ADD(&(search->stats), fullScans, 1);
+        if (TRACING(search)) {
+            traceBorders(guide, search, NULL, soa->size, point, force, phi, params);
+        }
+    }
+}
+
+/*
+ * Determines the border line of guide that is nearest to point along the force vector for params, like evaluateBorders().
+ * candidates are the border lines to evaluate (NULL to evaluate all of them), which must include every border line within the search radius of point.
+ * The evaluated border lines are counted in the stats of search, and traced to its trace ring.
+ * Returns 1 when search->candidates was replaced by the border lines of a second search, 0 otherwise.
+ */
+static int evaluateGuideBorders(BlindGuide * guide, BorderSearch * search, IndexArray * candidates, Coordinate * point, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    BorderlineSoA * soa = &(guide->soa);
+    if (candidates != NULL) {
+        guide->kernel(soa, candidates->indices, candidates->size, point, force, phi, nearestDistance, closestBorderAction, params);
+        STATS_ADD(&(search->stats), bordersTested, candidates->size);
+        if (TRACING(search)) {
+            traceBorders(guide, search, candidates->indices, candidates->size, point, force, phi, params);
+        }
+        if (*closestBorderAction == STOP && *nearestDistance > paramsGetReach(params, force)) {
+            // A skipped border line might be closer along the force vector than this one
+            recheckGuideBorders(guide, search, point, force, phi, nearestDistance, closestBorderAction, params);
+            return 1;
+        }
+    } else {
+        guide->kernel(soa, NULL, soa->size, point, force, phi, nearestDistance, closestBorderAction, params);
+        STATS_ADD(&(search->stats), bordersTested, soa->size);
+        STATS_ADD(&(search->stats), fullScans, 1);
+        if (TRACING(search)) {
+            traceBorders(guide, search, NULL, soa->size, point, force, phi, params);
+        }
+    }
+    return 0;
+}
+
+double guideGetResistanceWith(BlindGuide * guide, BorderSearch * search, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    return guideGetResistanceWithParams(guide, search, &(guide->params), x, y, phi, forceX, forceY, numObstacles, obstacles);
+}
+
+double guideGetResistanceWithParams(BlindGuide * guide, BorderSearch * search, GuideParams * params, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    STATS_START(start);
+    Coordinate point;
+    Vector force;
+    double resistance = prepareResistance(x, y, phi, forceX, forceY, &point, &force, params);
+    if (TRACING(search)) {
+        traceQuery(search, x, y, phi, forceX, forceY, resistance, numObstacles);
+    }
+    
+    double nearestDistance = 1000000000;
+    enum action closestBorderAction = NOTHING;
+    
+    // Border lines that cannot be reached within the resistance time never cause resistance, so only evaluate nearby border lines
+    IndexArray * candidates = NULL;
+    if (collectGuideCandidates(guide, search, &point, getSearchRadius(params, &force))) {
+        candidates = &(search->candidates);
+    }
+    evaluateGuideBorders(guide, search, candidates, &point, &force, phi, &nearestDistance, &closestBorderAction, params);
+    
+    ObstacleIndex * obstacleIndex = NULL;
+    if (numObstacles >= OBSTACLE_INDEX_THRESHOLD) {
+        indexObstacles(&(search->obstacles), numObstacles, obstacles);
+        obstacleIndex = &(search->obstacles);
+    }
+    resistance = finishResistance(&point, &force, phi, resistance, nearestDistance, closestBorderAction, numObstacles, obstacles, obstacleIndex, search, params);
+    STATS_FINISH(&(search->stats), start);
+    return resistance;
+}
+
+double guideGetResistanceCached(BlindGuide * guide, BorderCache * cache, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    STATS_START(start);
+    Coordinate point;
+    Vector force;
+    double resistance = prepareResistance(x, y, phi, forceX, forceY, &point, &force, &(guide->params));
+    if (TRACING(&(cache->search))) {
+        traceQuery(&(cache->search), x, y, phi, forceX, forceY, resistance, numObstacles);
+    }
+    
+    double nearestDistance = 1000000000;
+    enum action closestBorderAction = NOTHING;
+    
+    // The cached border lines can be reused as long as the search area lies within the cached area
+    // (this test also fails for non-finite positions and forces)
+    double searchRadius = getSearchRadius(&(guide->params), &force);
+    double dx = point.x - cache->center.x;
+    double dy = point.y - cache->center.y;
+    if (cache->guide != guide || cache->revision != guide->revision || !(sqrt(dx * dx + dy * dy) + searchRadius <= cache->radius)) {
+        cache->guide = guide;
+        cache->revision = guide->revision;
+        cache->center = point;
+        cache->radius = searchRadius + BORDER_CACHE_MARGIN;
+        STATS_ADD(&(cache->search.stats), cacheRefreshes, 1);
+        cache->narrowed = collectGuideCandidates(guide, &(cache->search), &point, cache->radius);
+        if (!cache->narrowed && collectGuideCandidates(guide, &(cache->search), &point, searchRadius)) {
+            // The search area can be narrowed down but the larger cached area cannot, so do not keep these border lines
+            cache->guide = NULL;
+            cache->narrowed = 1;
+        }
+    }
+    if (evaluateGuideBorders(guide, &(cache->search), cache->narrowed ? &(cache->search.candidates) : NULL, &point, &force, phi, &nearestDistance, &closestBorderAction, &(guide->params))) {
+        // The cached border lines were replaced, so collect them again for the next query
+        cache->guide = NULL;
+    }
+    
+    ObstacleIndex * obstacleIndex = NULL;
+    if (numObstacles >= OBSTACLE_INDEX_THRESHOLD) {
+        indexObstacles(&(cache->search.obstacles), numObstacles, obstacles);
+        obstacleIndex = &(cache->search.obstacles);
+    }
+    resistance = finishResistance(&point, &force, phi, resistance, nearestDistance, closestBorderAction, numObstacles, obstacles, obstacleIndex, &(cache->search), &(guide->params));
+    STATS_FINISH(&(cache->search.stats), start);
     return resistance;
 }
 
+void freeBorderCache(BorderCache * cache) {
+    freeBorderSearch(&(cache->search));
+    memset(cache, 0, sizeof(BorderCache));
+}
+
+void getResistanceBatch(size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances) {
+    guideGetResistanceBatch(&defaultGuide, numQueries, poses, forces, numObstacles, obstacles, resistances);
+}
+
+void guideGetResistanceBatch(BlindGuide * guide, size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances) {
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    guideGetResistanceBatchWith(guide, &(guide->search), numQueries, poses, forces, numObstacles, obstacles, resistances);
+}
+
+void guideGetResistanceBatchWith(BlindGuide * guide, BorderSearch * search, size_t numQueries, double * poses, double * forces, unsigned int numObstacles, double * obstacles, double * resistances) {
+    if (TRACING(search)) {
+        // Trace every query separately
+        size_t q = 0;
+        for (q = 0; q < numQueries; q++) {
+            resistances[q] = guideGetResistanceWith(guide, search, poses[3 * q], poses[3 * q + 1], poses[3 * q + 2], forces[2 * q], forces[2 * q + 1], numObstacles, obstacles);
+        }
+        return;
+    }
+    Coordinate points[BATCH_BLOCK_SIZE];
+    Vector blockForces[BATCH_BLOCK_SIZE];
+    double baseResistance[BATCH_BLOCK_SIZE], reach[BATCH_BLOCK_SIZE];
+    BorderQueryBlock block;
+    BorderlineSoA * soa = &(guide->soa);
+    
+    // All queries share the same obstacles, so index them only once
+    ObstacleIndex * obstacleIndex = NULL;
+    if (numObstacles >= OBSTACLE_INDEX_THRESHOLD) {
+        indexObstacles(&(search->obstacles), numObstacles, obstacles);
+        obstacleIndex = &(search->obstacles);
+    }
+    
+    size_t start = 0;
+    for (start = 0; start < numQueries; start += BATCH_BLOCK_SIZE) {
+        STATS_START(blockStart);
+        size_t count = numQueries - start < BATCH_BLOCK_SIZE ? numQueries - start : BATCH_BLOCK_SIZE;
+        double * pose = poses + 3 * start;
+        double * force = forces + 2 * start;
+        
+        // Prepare all queries of this block, and determine the area that contains the search areas of all of them
+        double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+        double searchArea = 0;
+        int bounded = 1;
+        size_t q = 0;
+        for (q = 0; q < BATCH_BLOCK_SIZE; q++) {
+            if (q < count) {
+                baseResistance[q] = prepareResistance(pose[3 * q], pose[3 * q + 1], pose[3 * q + 2], force[2 * q], force[2 * q + 1], &points[q], &blockForces[q], &(guide->params));
+                reach[q] = paramsGetReach(&(guide->params), &blockForces[q]);
+                double searchRadius = reach[q] * 1.0001 + guide->params.radius + guide->params.userRadius;
+                if (!(searchRadius < 1e9)) {
+                    bounded = 0;
+                }
+                searchArea += 4 * searchRadius * searchRadius;
+                minX = fmin(minX, points[q].x - searchRadius);
+                maxX = fmax(maxX, points[q].x + searchRadius);
+                minY = fmin(minY, points[q].y - searchRadius);
+                maxY = fmax(maxY, points[q].y + searchRadius);
+                block.x[q] = points[q].x;
+                block.y[q] = points[q].y;
+                block.forceX[q] = blockForces[q].x;
+                block.forceY[q] = blockForces[q].y;
+                block.cosPhi[q] = cos(pose[3 * q + 2]);
+                block.sinPhi[q] = sin(pose[3 * q + 2]);
+            } else {
+                // Pad the block with copies of the first query, so that the block kernels can always evaluate whole blocks
+                block.x[q] = block.x[0];
+                block.y[q] = block.y[0];
+                block.forceX[q] = block.forceX[0];
+                block.forceY[q] = block.forceY[0];
+                block.cosPhi[q] = block.cosPhi[0];
+                block.sinPhi[q] = block.sinPhi[0];
+            }
+            block.nearestDistance[q] = 1000000000;
+            block.closestBorderAction[q] = NOTHING;
+        }
+        
+        #if STATS
+            GuideStats * stats = &(search->stats);
+        #endif
+        double side = fmax(maxX - minX, maxY - minY);
+        double numCells = searchArea / (GRID_CELL_SIZE * GRID_CELL_SIZE);
+        if (bounded && side * side > BATCH_MAX_SPREAD * searchArea && (double) count * soa->size > BATCH_BORDERS_PER_CELL * numCells) {
+            // The queries are spread out, such that the area around all of them holds far more border lines than each of them needs,
+            // and the map is too large to simply evaluate all of it for every query, so search the border lines of every query on its own like guideGetResistance()
+            for (q = 0; q < count; q++) {
+                double nearestDistance = 1000000000;
+                enum action closestBorderAction = NOTHING;
+                IndexArray * candidates = NULL;
+                if (collectGuideCandidates(guide, search, &points[q], getSearchRadius(&(guide->params), &blockForces[q]))) {
+                    candidates = &(search->candidates);
+                }
+                evaluateGuideBorders(guide, search, candidates, &points[q], &blockForces[q], pose[3 * q + 2], &nearestDistance, &closestBorderAction, &(guide->params));
+                resistances[start + q] = finishResistance(&points[q], &blockForces[q], pose[3 * q + 2], baseResistance[q], nearestDistance, closestBorderAction, numObstacles, obstacles, obstacleIndex, search, &(guide->params));
+            }
+        } else {
+            Coordinate center = createCoordinate(0.5 * (minX + maxX), 0.5 * (minY + maxY));
+            unsigned int * indices = NULL;
+            size_t numIndices = soa->size;
+            if (bounded && collectGuideCandidates(guide, search, &center, 0.5 * side)) {
+                indices = search->candidates.indices;
+                numIndices = search->candidates.size;
+            }
+            
+            // Stream every border line once for all queries of the block
+            #if BORDER_KERNEL_X86
+            if (guide->kernelType == KERNEL_AVX2) {
+                borderBlockKernelAVX2(soa, indices, numIndices, &block, &(guide->params));
+            } else
+            #endif
+            {
+                borderBlockKernelScalar(soa, indices, numIndices, &block, &(guide->params));
+            }
+            
+            STATS_ADD(stats, bordersTested, count * numIndices);
+            STATS_ADD(stats, fullScans, indices == NULL ? count : 0);
+            int narrowed = indices != NULL;
+            for (q = 0; q < count; q++) {
+                double nearestDistance = block.nearestDistance[q];
+                enum action closestBorderAction = (enum action) (int) block.closestBorderAction[q];
+                if (narrowed && closestBorderAction == STOP && nearestDistance > reach[q]) {
+                    // A skipped border line might be closer along the force vector than this one
+                    // (this replaces the candidates of the block, which are no longer needed)
+                    recheckGuideBorders(guide, search, &points[q], &blockForces[q], pose[3 * q + 2], &nearestDistance, &closestBorderAction, &(guide->params));
+                }
+                resistances[start + q] = finishResistance(&points[q], &blockForces[q], pose[3 * q + 2], baseResistance[q], nearestDistance, closestBorderAction, numObstacles, obstacles, obstacleIndex, search, &(guide->params));
+            }
+        }
+        #if STATS
+            // The queries of a block are evaluated together, so every query gets an equal share of the time of the block
+            unsigned long long blockTime = getStatsTime() - blockStart;
+            for (q = 0; q < count; q++) {
+                recordStatsLatency(stats, blockTime / count);
+            }
+        #endif
+    }
+}
+
 double getAcceleration(Vector * force) {
-    return force->length / MASS;
+    return paramsGetAcceleration(&(defaultGuide.params), force);
+}
+
+double paramsGetAcceleration(GuideParams * params, Vector * force) {
+    return force->length / params->mass;
+}
+
+double getReach(Vector * force) {
+    return paramsGetReach(&(defaultGuide.params), force);
+}
+
+double paramsGetReach(GuideParams * params, Vector * force) {
+    return 0.5 * paramsGetAcceleration(params, force) * params->resistanceTime * params->resistanceTime;
+}
+
+/*
+ * Body of approachingBorder() for the given radius, user radius and handedness.
+ */
+SPECIALIZED enum action approachingBorderBody(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder, double radius, double userRadius, enum side handedness);
+
+/*
+ * Body of evaluateBorders() for the given radius, user radius and handedness.
+ */
+SPECIALIZED void evaluateBordersBody(Coordinate * p, BorderlineArray * ba, unsigned int * indices, size_t numIndices, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, double radius, double userRadius, enum side handedness) {
+    Vector toBorder;
+    size_t i = 0;
+    for (i = 0; i < numIndices; i++) {
+        unsigned int index = indices != NULL ? indices[i] : i;
+        if (ba->states[index] != BORDER_ENABLED) {
+            continue;
+        }
+        // Determine the necessary action for the current border line
+        // The toBorder vector will also be populated accordingly
+        Borderline b = getBorderline(ba, index);
+        enum action a = approachingBorderBody(p, &b, force, phi, &toBorder, radius, userRadius, handedness);
+        if (toBorder.length >= 0 && toBorder.length < *nearestDistance) {
+            *nearestDistance = toBorder.length;
+            *closestBorderAction = a;
+        }
+    }
+}
+
+void evaluateBorders(Coordinate * p, BorderlineArray * ba, unsigned int * indices, size_t numIndices, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, evaluateBordersBody, p, ba, indices, numIndices, force, phi, nearestDistance, closestBorderAction, params->radius, params->userRadius);
 }
 
 double dotProduct(Vector * v1, Vector * v2) {
     return (v1->x * v2->x) + (v1->y * v2->y);
 }
 
-enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder) {
+SPECIALIZED enum action approachingBorderBody(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder, double radius, double userRadius, enum side handedness) {
     Coordinate * v = &(b->bottom);
     Coordinate * w = &(b->top);
     
@@ -411,23 +3915,17 @@ enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, do
     // Fill the toBorder vector using the given point and the determined border line point
     populateVector(x - p->x, y - p->y, toBorder);
     // Account for the radius of the robot (by reducing the length of the toBorder vector)
-    toBorder->length -= RADIUS;
+    toBorder->length -= radius;
     
     double toBorderAngle = atan2(toBorder->y, toBorder->x);
     double correctedToBorderAngle = toBorderAngle - phi;
     while (correctedToBorderAngle > PI) correctedToBorderAngle -= 2*PI;
     while (correctedToBorderAngle < -PI) correctedToBorderAngle += 2*PI;
     
-    if (USER_HANDEDNESS == RIGHT && correctedToBorderAngle >= -PI * 0.5 && correctedToBorderAngle <= 0) {
-        toBorder->length -= USER_RADIUS;
-        #if DEBUG
-            printf("In right user area.\n");
-        #endif
-    } else if (USER_HANDEDNESS == LEFT && correctedToBorderAngle <= -PI * 0.5 && correctedToBorderAngle >= -PI) {
-        toBorder->length -= USER_RADIUS;
-        #if DEBUG
-            printf("In left user area.\n");
-        #endif
+    if (handedness == RIGHT && correctedToBorderAngle >= -PI * 0.5 && correctedToBorderAngle <= 0) {
+        toBorder->length -= userRadius;
+    } else if (handedness == LEFT && correctedToBorderAngle <= -PI * 0.5 && correctedToBorderAngle >= -PI) {
+        toBorder->length -= userRadius;
     }
     
     // Calculate on what side of the border line p is. d < 0 means LEFT, d > means right
@@ -445,15 +3943,6 @@ enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, do
     toBorder->y = force->y;
     toBorder->length = dist;
     
-    #if DEBUG
-        printf("vx: %lf, vy: %lf, wx: %lf, wy: %lf\n", v->x, v->y, w->x, w->y);
-        printf("l2: %lf, t: %lf, x: %lf, y: %lf\n", l2, t, x, y);
-        printf("To border: distance: %lf, x: %lf, y: %lf\n", toBorder->length, toBorder->x, toBorder->y);
-        printf("Force: distance: %lf, x: %lf, y: %lf\n", force->length, force->x, force->y);
-        printf("Good side: %s, Side: %s\n", b->goodSide == LEFT ? "left" : "right", d < 0 ? "left" : "right");
-        printf("To border angle: %lf\n", correctedToBorderAngle);
-        printf("Angle: %lf, Going to border: %d\n", angle, goingToBorder);
-    #endif
     
     if ((b->goodSide == LEFT && d < 0) || (b->goodSide == RIGHT && d > 0)) {
         // p is on the good side of the border
@@ -474,29 +3963,440 @@ enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, do
     return NOTHING;
 }
 
-enum action approachingObstacle(Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder) {
+enum action approachingBorder(Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder) {
+    return paramsApproachingBorder(&(defaultGuide.params), p, b, force, phi, toBorder);
+}
+
+enum action paramsApproachingBorder(GuideParams * params, Coordinate * p, Borderline * b, Vector * force, double phi, Vector * toBorder) {
+    return SPECIALIZE_HANDEDNESS(params, approachingBorderBody, p, b, force, phi, toBorder, params->radius, params->userRadius);
+}
+
+/*
+ * Body of borderKernelSingle() for the given radius, user radius and handedness.
+ */
+SPECIALIZED double borderKernelSingleBody(BorderlineSoA * soa, size_t i, Coordinate * p, Vector * force, BorderReal c, BorderReal s, enum action * a, double radius, double userRadius, enum side handedness) {
+    // Everything is computed in BorderReals, exactly like the lanes of the SSE2 and AVX2 kernels
+    BorderReal px = (BorderReal) p->x;
+    BorderReal py = (BorderReal) p->y;
+    BorderReal qx = px - soa->bottomX[i];
+    BorderReal qy = py - soa->bottomY[i];
+    // Fraction of the border line that point p is closest to
+    BorderReal t = BORDER_FMAX(0, BORDER_FMIN(1, (qx * soa->dirX[i] + qy * soa->dirY[i]) * soa->invLength2[i]));
+    BorderReal ux = soa->bottomX[i] + t * soa->dirX[i] - px;
+    BorderReal uy = soa->bottomY[i] + t * soa->dirY[i] - py;
+    BorderReal length = BORDER_SQRT(ux * ux + uy * uy);
+    ux = ux / length;
+    uy = uy / length;
+    length -= (BorderReal) radius;
+    // The toBorder vector rotated by -phi lies in the user area when its angle is between -PI/2 and 0 (RIGHT) or -PI and -PI/2 (LEFT)
+    BorderReal rx = c * ux + s * uy;
+    BorderReal ry = c * uy - s * ux;
+    if (ry <= 0 && ((handedness == RIGHT && rx >= 0) || (handedness == LEFT && rx <= 0))) {
+        length -= (BorderReal) userRadius;
+    }
+    BorderReal side = qx * soa->normalX[i] + qy * soa->normalY[i];
+    BorderReal angle = (BorderReal) force->x * ux + (BorderReal) force->y * uy;
+    if (side > 0) {
+        *a = angle > 0 ? RESIST : NOTHING;
+    } else {
+        *a = angle > 0 ? NOTHING : STOP;
+    }
+    return length / angle;
+}
+
+double borderKernelSingle(BorderlineSoA * soa, size_t i, Coordinate * p, Vector * force, double c, double s, enum action * a, GuideParams * params) {
+    return SPECIALIZE_HANDEDNESS(params, borderKernelSingleBody, soa, i, p, force, c, s, a, params->radius, params->userRadius);
+}
+
+/*
+ * Body of borderKernelScalar() for the given radius, user radius and handedness.
+ */
+SPECIALIZED void borderKernelScalarBody(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, double radius, double userRadius, enum side handedness) {
+    BorderReal c = cos(phi);
+    BorderReal s = sin(phi);
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        enum action a;
+        double dist = borderKernelSingleBody(soa, indices != NULL ? indices[k] : k, p, force, c, s, &a, radius, userRadius, handedness);
+        if (dist >= 0 && dist < *nearestDistance) {
+            *nearestDistance = dist;
+            *closestBorderAction = a;
+        }
+    }
+}
+
+void borderKernelScalar(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, borderKernelScalarBody, soa, indices, numIndices, p, force, phi, nearestDistance, closestBorderAction, params->radius, params->userRadius);
+}
+
+/*
+ * Body of borderBlockKernelScalar() for the given radius, user radius and handedness.
+ */
+SPECIALIZED void borderBlockKernelScalarBody(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, double radius, double userRadius, enum side handedness) {
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        size_t index = indices != NULL ? indices[k] : k;
+        size_t q = 0;
+        for (q = 0; q < BATCH_BLOCK_SIZE; q++) {
+            Coordinate p = createCoordinate(block->x[q], block->y[q]);
+            Vector force;
+            force.x = block->forceX[q];
+            force.y = block->forceY[q];
+            enum action a;
+            double dist = borderKernelSingleBody(soa, index, &p, &force, block->cosPhi[q], block->sinPhi[q], &a, radius, userRadius, handedness);
+            if (dist >= 0 && dist < block->nearestDistance[q]) {
+                block->nearestDistance[q] = dist;
+                block->closestBorderAction[q] = a;
+            }
+        }
+    }
+}
+
+void borderBlockKernelScalar(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, borderBlockKernelScalarBody, soa, indices, numIndices, block, params->radius, params->userRadius);
+}
+
+#if BORDER_KERNEL_X86
+/*
+ * Returns a vector with the elements of array at the SSE2_LANES indices starting at indices.
+ */
+__attribute__((target("sse2"))) static inline SSE2Real sse2Gather(BorderReal * array, unsigned int * indices) {
+    #if FLOAT32
+        return _mm_set_ps(array[indices[3]], array[indices[2]], array[indices[1]], array[indices[0]]);
+    #else
+        return _mm_set_pd(array[indices[1]], array[indices[0]]);
+    #endif
+}
+
+/*
+ * Returns a vector with the lane numbers 0, 1, ... up to SSE2_LANES - 1.
+ */
+__attribute__((target("sse2"))) static inline SSE2Real sse2Lanes() {
+    #if FLOAT32
+        return _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    #else
+        return _mm_set_pd(1.0, 0.0);
+    #endif
+}
+
+/*
+ * Returns a vector with the elements of array at the AVX2_LANES indices starting at indices.
+ */
+__attribute__((target("avx2"))) static inline AVX2Real avx2Gather(BorderReal * array, unsigned int * indices) {
+    #if FLOAT32
+        return _mm256_i32gather_ps(array, _mm256_loadu_si256((const __m256i *) indices), 4);
+    #else
+        return _mm256_i32gather_pd(array, _mm_loadu_si128((const __m128i *) indices), 8);
+    #endif
+}
+
+/*
+ * Returns a vector with the AVX2_LANES elements of array starting at array, where the lanes that are not set in mask are 0 and not read.
+ */
+__attribute__((target("avx2"))) static inline AVX2Real avx2MaskLoad(BorderReal * array, AVX2Real mask) {
+    #if FLOAT32
+        return _mm256_maskload_ps(array, _mm256_castps_si256(mask));
+    #else
+        return _mm256_maskload_pd(array, _mm256_castpd_si256(mask));
+    #endif
+}
+
+/*
+ * Returns a vector with the lane numbers 0, 1, ... up to AVX2_LANES - 1.
+ */
+__attribute__((target("avx2"))) static inline AVX2Real avx2Lanes() {
+    #if FLOAT32
+        return _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+    #else
+        return _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    #endif
+}
+
+/*
+ * Body of borderKernelSSE2() for the given radius, user radius and handedness.
+ */
+__attribute__((target("sse2"))) SPECIALIZED void borderKernelSSE2Body(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, double radius, double userRadius, enum side handedness) {
+    BorderReal c = cos(phi);
+    BorderReal s = sin(phi);
+    const SSE2Real zero = SSE2_OP(setzero)();
+    const SSE2Real one = SSE2_OP(set1)(1.0);
+    const SSE2Real two = SSE2_OP(set1)(2.0);
+    const SSE2Real px = SSE2_OP(set1)(p->x), py = SSE2_OP(set1)(p->y);
+    const SSE2Real fx = SSE2_OP(set1)(force->x), fy = SSE2_OP(set1)(force->y);
+    const SSE2Real vc = SSE2_OP(set1)(c), vs = SSE2_OP(set1)(s);
+    const SSE2Real vRadius = SSE2_OP(set1)(radius), vUserRadius = SSE2_OP(set1)(userRadius);
+    // Per lane: nearest distance, its position k and its action
+    SSE2Real bestDist = SSE2_OP(set1)(*nearestDistance);
+    SSE2Real bestK = SSE2_OP(set1)(-1.0);
+    SSE2Real bestAction = zero;
+    // Positions k are exact in the lanes up to 2^24 border lines in single precision (ties between further border lines may pick either)
+    SSE2Real vk = sse2Lanes();
+    const SSE2Real lanes = SSE2_OP(set1)(SSE2_LANES);
+    size_t k = 0;
+    for (k = 0; k < numIndices; k += SSE2_LANES) {
+        SSE2Real bx, by, dx, dy, il2, nx, ny;
+        unsigned int * lineIndices = indices != NULL ? indices + k : NULL;
+        unsigned int tail[SSE2_LANES];
+        if (k + SSE2_LANES > numIndices) {
+            // Fill the lanes past the last border line with the last border line again, which has the same distance but a later position k
+            size_t lane = 0;
+            for (lane = 0; lane < SSE2_LANES; lane++) {
+                size_t position = k + (k + lane < numIndices ? lane : numIndices - k - 1);
+                tail[lane] = indices != NULL ? indices[position] : (unsigned int) position;
+            }
+            lineIndices = tail;
+        }
+        if (lineIndices != NULL) {
+            bx = sse2Gather(soa->bottomX, lineIndices);
+            by = sse2Gather(soa->bottomY, lineIndices);
+            dx = sse2Gather(soa->dirX, lineIndices);
+            dy = sse2Gather(soa->dirY, lineIndices);
+            il2 = sse2Gather(soa->invLength2, lineIndices);
+            nx = sse2Gather(soa->normalX, lineIndices);
+            ny = sse2Gather(soa->normalY, lineIndices);
+        } else {
+            bx = SSE2_OP(loadu)(soa->bottomX + k);
+            by = SSE2_OP(loadu)(soa->bottomY + k);
+            dx = SSE2_OP(loadu)(soa->dirX + k);
+            dy = SSE2_OP(loadu)(soa->dirY + k);
+            il2 = SSE2_OP(loadu)(soa->invLength2 + k);
+            nx = SSE2_OP(loadu)(soa->normalX + k);
+            ny = SSE2_OP(loadu)(soa->normalY + k);
+        }
+        SSE2Real qx = SSE2_OP(sub)(px, bx);
+        SSE2Real qy = SSE2_OP(sub)(py, by);
+        // SSE2_OP(min) returns its second operand for NaN, just like fmin()
+        SSE2Real t = SSE2_OP(mul)(SSE2_OP(add)(SSE2_OP(mul)(qx, dx), SSE2_OP(mul)(qy, dy)), il2);
+        t = SSE2_OP(max)(SSE2_OP(min)(t, one), zero);
+        SSE2Real ux = SSE2_OP(sub)(SSE2_OP(add)(bx, SSE2_OP(mul)(t, dx)), px);
+        SSE2Real uy = SSE2_OP(sub)(SSE2_OP(add)(by, SSE2_OP(mul)(t, dy)), py);
+        SSE2Real length = SSE2_OP(sqrt)(SSE2_OP(add)(SSE2_OP(mul)(ux, ux), SSE2_OP(mul)(uy, uy)));
+        ux = SSE2_OP(div)(ux, length);
+        uy = SSE2_OP(div)(uy, length);
+        length = SSE2_OP(sub)(length, vRadius);
+        SSE2Real rx = SSE2_OP(add)(SSE2_OP(mul)(vc, ux), SSE2_OP(mul)(vs, uy));
+        SSE2Real ry = SSE2_OP(sub)(SSE2_OP(mul)(vc, uy), SSE2_OP(mul)(vs, ux));
+        SSE2Real inUserArea = SSE2_OP(and)(SSE2_OP(cmple)(ry, zero), (handedness == RIGHT ? SSE2_OP(cmpge)(rx, zero) : SSE2_OP(cmple)(rx, zero)));
+        length = SSE2_OP(sub)(length, SSE2_OP(and)(inUserArea, vUserRadius));
+        SSE2Real good = SSE2_OP(cmpgt)(SSE2_OP(add)(SSE2_OP(mul)(qx, nx), SSE2_OP(mul)(qy, ny)), zero);
+        SSE2Real angle = SSE2_OP(add)(SSE2_OP(mul)(fx, ux), SSE2_OP(mul)(fy, uy));
+        SSE2Real going = SSE2_OP(cmpgt)(angle, zero);
+        SSE2Real dist = SSE2_OP(div)(length, angle);
+        // RESIST (1) on the good side when going to the border, STOP (2) on the bad side when not going to the border
+        SSE2Real action = SSE2_OP(or)(SSE2_OP(and)(SSE2_OP(and)(good, going), one), SSE2_OP(andnot)(SSE2_OP(or)(good, going), two));
+        SSE2Real closer = SSE2_OP(and)(SSE2_OP(cmpge)(dist, zero), SSE2_OP(cmplt)(dist, bestDist));
+        bestDist = SSE2_OP(or)(SSE2_OP(and)(closer, dist), SSE2_OP(andnot)(closer, bestDist));
+        bestK = SSE2_OP(or)(SSE2_OP(and)(closer, vk), SSE2_OP(andnot)(closer, bestK));
+        bestAction = SSE2_OP(or)(SSE2_OP(and)(closer, action), SSE2_OP(andnot)(closer, bestAction));
+        vk = SSE2_OP(add)(vk, lanes);
+    }
+    // Reduce the lanes, preferring the first border line on equal distance
+    BorderReal dists[SSE2_LANES], ks[SSE2_LANES], actions[SSE2_LANES];
+    SSE2_OP(storeu)(dists, bestDist);
+    SSE2_OP(storeu)(ks, bestK);
+    SSE2_OP(storeu)(actions, bestAction);
+    int bestLane = -1;
+    int lane = 0;
+    for (lane = 0; lane < SSE2_LANES; lane++) {
+        if (ks[lane] >= 0 && (bestLane < 0 || dists[lane] < dists[bestLane] || (dists[lane] == dists[bestLane] && ks[lane] < ks[bestLane]))) {
+            bestLane = lane;
+        }
+    }
+    if (bestLane >= 0) {
+        *nearestDistance = dists[bestLane];
+        *closestBorderAction = (enum action) (int) actions[bestLane];
+    }
+}
+
+__attribute__((target("sse2")))
+void borderKernelSSE2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, borderKernelSSE2Body, soa, indices, numIndices, p, force, phi, nearestDistance, closestBorderAction, params->radius, params->userRadius);
+}
+
+/*
+ * Body of borderKernelAVX2() for the given radius, user radius and handedness.
+ */
+__attribute__((target("avx2"))) SPECIALIZED void borderKernelAVX2Body(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, double radius, double userRadius, enum side handedness) {
+    BorderReal c = cos(phi);
+    BorderReal s = sin(phi);
+    const AVX2Real zero = AVX2_OP(setzero)();
+    const AVX2Real one = AVX2_OP(set1)(1.0);
+    const AVX2Real two = AVX2_OP(set1)(2.0);
+    const AVX2Real px = AVX2_OP(set1)(p->x), py = AVX2_OP(set1)(p->y);
+    const AVX2Real fx = AVX2_OP(set1)(force->x), fy = AVX2_OP(set1)(force->y);
+    const AVX2Real vc = AVX2_OP(set1)(c), vs = AVX2_OP(set1)(s);
+    const AVX2Real vRadius = AVX2_OP(set1)(radius), vUserRadius = AVX2_OP(set1)(userRadius);
+    // Per lane: nearest distance, its position k and its action
+    AVX2Real bestDist = AVX2_OP(set1)(*nearestDistance);
+    AVX2Real bestK = AVX2_OP(set1)(-1.0);
+    AVX2Real bestAction = zero;
+    // Positions k are exact in the lanes up to 2^24 border lines in single precision (ties between further border lines may pick either)
+    AVX2Real vk = avx2Lanes();
+    const AVX2Real lanes = AVX2_OP(set1)(AVX2_LANES);
+    size_t k = 0;
+    for (k = 0; k < numIndices; k += AVX2_LANES) {
+        AVX2Real bx, by, dx, dy, il2, nx, ny;
+        if (indices != NULL) {
+            unsigned int * lineIndices = indices + k;
+            unsigned int tail[AVX2_LANES];
+            if (k + AVX2_LANES > numIndices) {
+                // Fill the lanes past the last border line with the last border line again, which has the same distance but a later position k
+                size_t lane = 0;
+                for (lane = 0; lane < AVX2_LANES; lane++) {
+                    tail[lane] = indices[k + lane < numIndices ? k + lane : numIndices - 1];
+                }
+                lineIndices = tail;
+            }
+            bx = avx2Gather(soa->bottomX, lineIndices);
+            by = avx2Gather(soa->bottomY, lineIndices);
+            dx = avx2Gather(soa->dirX, lineIndices);
+            dy = avx2Gather(soa->dirY, lineIndices);
+            il2 = avx2Gather(soa->invLength2, lineIndices);
+            nx = avx2Gather(soa->normalX, lineIndices);
+            ny = avx2Gather(soa->normalY, lineIndices);
+        } else if (k + AVX2_LANES > numIndices) {
+            // Only load the lanes up to the last border line, and give the other lanes a NaN bottomX so that they are ignored like disabled border lines
+            AVX2Real valid = AVX2_OP(cmp)(avx2Lanes(), AVX2_OP(set1)(numIndices - k), _CMP_LT_OQ);
+            bx = AVX2_OP(blendv)(AVX2_OP(set1)(NAN), avx2MaskLoad(soa->bottomX + k, valid), valid);
+            by = avx2MaskLoad(soa->bottomY + k, valid);
+            dx = avx2MaskLoad(soa->dirX + k, valid);
+            dy = avx2MaskLoad(soa->dirY + k, valid);
+            il2 = avx2MaskLoad(soa->invLength2 + k, valid);
+            nx = avx2MaskLoad(soa->normalX + k, valid);
+            ny = avx2MaskLoad(soa->normalY + k, valid);
+        } else {
+            bx = AVX2_OP(loadu)(soa->bottomX + k);
+            by = AVX2_OP(loadu)(soa->bottomY + k);
+            dx = AVX2_OP(loadu)(soa->dirX + k);
+            dy = AVX2_OP(loadu)(soa->dirY + k);
+            il2 = AVX2_OP(loadu)(soa->invLength2 + k);
+            nx = AVX2_OP(loadu)(soa->normalX + k);
+            ny = AVX2_OP(loadu)(soa->normalY + k);
+        }
+        AVX2Real qx = AVX2_OP(sub)(px, bx);
+        AVX2Real qy = AVX2_OP(sub)(py, by);
+        // AVX2_OP(min) returns its second operand for NaN, just like fmin()
+        AVX2Real t = AVX2_OP(mul)(AVX2_OP(add)(AVX2_OP(mul)(qx, dx), AVX2_OP(mul)(qy, dy)), il2);
+        t = AVX2_OP(max)(AVX2_OP(min)(t, one), zero);
+        AVX2Real ux = AVX2_OP(sub)(AVX2_OP(add)(bx, AVX2_OP(mul)(t, dx)), px);
+        AVX2Real uy = AVX2_OP(sub)(AVX2_OP(add)(by, AVX2_OP(mul)(t, dy)), py);
+        AVX2Real length = AVX2_OP(sqrt)(AVX2_OP(add)(AVX2_OP(mul)(ux, ux), AVX2_OP(mul)(uy, uy)));
+        ux = AVX2_OP(div)(ux, length);
+        uy = AVX2_OP(div)(uy, length);
+        length = AVX2_OP(sub)(length, vRadius);
+        AVX2Real rx = AVX2_OP(add)(AVX2_OP(mul)(vc, ux), AVX2_OP(mul)(vs, uy));
+        AVX2Real ry = AVX2_OP(sub)(AVX2_OP(mul)(vc, uy), AVX2_OP(mul)(vs, ux));
+        AVX2Real inUserArea = AVX2_OP(and)(AVX2_OP(cmp)(ry, zero, _CMP_LE_OQ), (handedness == RIGHT ? AVX2_OP(cmp)(rx, zero, _CMP_GE_OQ) : AVX2_OP(cmp)(rx, zero, _CMP_LE_OQ)));
+        length = AVX2_OP(sub)(length, AVX2_OP(and)(inUserArea, vUserRadius));
+        AVX2Real good = AVX2_OP(cmp)(AVX2_OP(add)(AVX2_OP(mul)(qx, nx), AVX2_OP(mul)(qy, ny)), zero, _CMP_GT_OQ);
+        AVX2Real angle = AVX2_OP(add)(AVX2_OP(mul)(fx, ux), AVX2_OP(mul)(fy, uy));
+        AVX2Real going = AVX2_OP(cmp)(angle, zero, _CMP_GT_OQ);
+        AVX2Real dist = AVX2_OP(div)(length, angle);
+        // RESIST (1) on the good side when going to the border, STOP (2) on the bad side when not going to the border
+        AVX2Real action = AVX2_OP(or)(AVX2_OP(and)(AVX2_OP(and)(good, going), one), AVX2_OP(andnot)(AVX2_OP(or)(good, going), two));
+        AVX2Real closer = AVX2_OP(and)(AVX2_OP(cmp)(dist, zero, _CMP_GE_OQ), AVX2_OP(cmp)(dist, bestDist, _CMP_LT_OQ));
+        bestDist = AVX2_OP(blendv)(bestDist, dist, closer);
+        bestK = AVX2_OP(blendv)(bestK, vk, closer);
+        bestAction = AVX2_OP(blendv)(bestAction, action, closer);
+        vk = AVX2_OP(add)(vk, lanes);
+    }
+    // Reduce the lanes, preferring the first border line on equal distance
+    BorderReal dists[AVX2_LANES], ks[AVX2_LANES], actions[AVX2_LANES];
+    AVX2_OP(storeu)(dists, bestDist);
+    AVX2_OP(storeu)(ks, bestK);
+    AVX2_OP(storeu)(actions, bestAction);
+    int bestLane = -1;
+    int lane = 0;
+    for (lane = 0; lane < AVX2_LANES; lane++) {
+        if (ks[lane] >= 0 && (bestLane < 0 || dists[lane] < dists[bestLane] || (dists[lane] == dists[bestLane] && ks[lane] < ks[bestLane]))) {
+            bestLane = lane;
+        }
+    }
+    if (bestLane >= 0) {
+        *nearestDistance = dists[bestLane];
+        *closestBorderAction = (enum action) (int) actions[bestLane];
+    }
+}
+
+__attribute__((target("avx2")))
+void borderKernelAVX2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, Coordinate * p, Vector * force, double phi, double * nearestDistance, enum action * closestBorderAction, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, borderKernelAVX2Body, soa, indices, numIndices, p, force, phi, nearestDistance, closestBorderAction, params->radius, params->userRadius);
+}
+
+/*
+ * Body of borderBlockKernelAVX2() for the given radius, user radius and handedness.
+ */
+__attribute__((target("avx2"))) SPECIALIZED void borderBlockKernelAVX2Body(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, double radius, double userRadius, enum side handedness) {
+    const AVX2Real zero = AVX2_OP(setzero)();
+    const AVX2Real one = AVX2_OP(set1)(1.0);
+    const AVX2Real two = AVX2_OP(set1)(2.0);
+    const AVX2Real vRadius = AVX2_OP(set1)(radius), vUserRadius = AVX2_OP(set1)(userRadius);
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        size_t index = indices != NULL ? indices[k] : k;
+        const AVX2Real bx = AVX2_OP(set1)(soa->bottomX[index]), by = AVX2_OP(set1)(soa->bottomY[index]);
+        const AVX2Real dx = AVX2_OP(set1)(soa->dirX[index]), dy = AVX2_OP(set1)(soa->dirY[index]);
+        const AVX2Real il2 = AVX2_OP(set1)(soa->invLength2[index]);
+        const AVX2Real nx = AVX2_OP(set1)(soa->normalX[index]), ny = AVX2_OP(set1)(soa->normalY[index]);
+        size_t q = 0;
+        for (q = 0; q < BATCH_BLOCK_SIZE; q += AVX2_LANES) {
+            AVX2Real px = AVX2_OP(loadu)(block->x + q), py = AVX2_OP(loadu)(block->y + q);
+            AVX2Real qx = AVX2_OP(sub)(px, bx);
+            AVX2Real qy = AVX2_OP(sub)(py, by);
+            // AVX2_OP(min) returns its second operand for NaN, just like fmin()
+            AVX2Real t = AVX2_OP(mul)(AVX2_OP(add)(AVX2_OP(mul)(qx, dx), AVX2_OP(mul)(qy, dy)), il2);
+            t = AVX2_OP(max)(AVX2_OP(min)(t, one), zero);
+            AVX2Real ux = AVX2_OP(sub)(AVX2_OP(add)(bx, AVX2_OP(mul)(t, dx)), px);
+            AVX2Real uy = AVX2_OP(sub)(AVX2_OP(add)(by, AVX2_OP(mul)(t, dy)), py);
+            AVX2Real length = AVX2_OP(sqrt)(AVX2_OP(add)(AVX2_OP(mul)(ux, ux), AVX2_OP(mul)(uy, uy)));
+            ux = AVX2_OP(div)(ux, length);
+            uy = AVX2_OP(div)(uy, length);
+            length = AVX2_OP(sub)(length, vRadius);
+            AVX2Real vc = AVX2_OP(loadu)(block->cosPhi + q), vs = AVX2_OP(loadu)(block->sinPhi + q);
+            AVX2Real rx = AVX2_OP(add)(AVX2_OP(mul)(vc, ux), AVX2_OP(mul)(vs, uy));
+            AVX2Real ry = AVX2_OP(sub)(AVX2_OP(mul)(vc, uy), AVX2_OP(mul)(vs, ux));
+            AVX2Real inUserArea = AVX2_OP(and)(AVX2_OP(cmp)(ry, zero, _CMP_LE_OQ), (handedness == RIGHT ? AVX2_OP(cmp)(rx, zero, _CMP_GE_OQ) : AVX2_OP(cmp)(rx, zero, _CMP_LE_OQ)));
+            length = AVX2_OP(sub)(length, AVX2_OP(and)(inUserArea, vUserRadius));
+            AVX2Real good = AVX2_OP(cmp)(AVX2_OP(add)(AVX2_OP(mul)(qx, nx), AVX2_OP(mul)(qy, ny)), zero, _CMP_GT_OQ);
+            AVX2Real angle = AVX2_OP(add)(AVX2_OP(mul)(AVX2_OP(loadu)(block->forceX + q), ux), AVX2_OP(mul)(AVX2_OP(loadu)(block->forceY + q), uy));
+            AVX2Real going = AVX2_OP(cmp)(angle, zero, _CMP_GT_OQ);
+            AVX2Real dist = AVX2_OP(div)(length, angle);
+            // RESIST (1) on the good side when going to the border, STOP (2) on the bad side when not going to the border
+            AVX2Real action = AVX2_OP(or)(AVX2_OP(and)(AVX2_OP(and)(good, going), one), AVX2_OP(andnot)(AVX2_OP(or)(good, going), two));
+            AVX2Real bestDist = AVX2_OP(loadu)(block->nearestDistance + q);
+            AVX2Real closer = AVX2_OP(and)(AVX2_OP(cmp)(dist, zero, _CMP_GE_OQ), AVX2_OP(cmp)(dist, bestDist, _CMP_LT_OQ));
+            AVX2_OP(storeu)(block->nearestDistance + q, AVX2_OP(blendv)(bestDist, dist, closer));
+            AVX2_OP(storeu)(block->closestBorderAction + q, AVX2_OP(blendv)(AVX2_OP(loadu)(block->closestBorderAction + q), action, closer));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void borderBlockKernelAVX2(BorderlineSoA * soa, unsigned int * indices, size_t numIndices, BorderQueryBlock * block, GuideParams * params) {
+    SPECIALIZE_HANDEDNESS(params, borderBlockKernelAVX2Body, soa, indices, numIndices, block, params->radius, params->userRadius);
+}
+#endif
+
+/*
+ * Body of approachingObstacle() for the given radius, user radius, obstacle radius and handedness.
+ */
+SPECIALIZED enum action approachingObstacleBody(Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder, double radius, double userRadius, double obstacleRadius, enum side handedness) {
     // Fill the toBorder vector using the given point and the given obstacle coordinates
     populateVector(x - p->x, y - p->y, toBorder);
     // Account for the radius of the robot (by reducing the length of the toBorder vector)
-    toBorder->length -= RADIUS;
+    toBorder->length -= radius;
     // Account for the radius of the obstacle
-    toBorder->length -= OBSTACLE_RADIUS;
+    toBorder->length -= obstacleRadius;
     
     double toBorderAngle = atan2(toBorder->y, toBorder->x);
     double correctedToBorderAngle = toBorderAngle - phi;
     while (correctedToBorderAngle > PI) correctedToBorderAngle -= 2*PI;
     while (correctedToBorderAngle < -PI) correctedToBorderAngle += 2*PI;
     
-    if (USER_HANDEDNESS == RIGHT && correctedToBorderAngle >= -PI * 0.5 && correctedToBorderAngle <= 0) {
-        toBorder->length -= USER_RADIUS;
-        #if DEBUG
-            printf("In right user area.\n");
-        #endif
-    } else if (USER_HANDEDNESS == LEFT && correctedToBorderAngle <= -PI * 0.5 && correctedToBorderAngle >= -PI) {
-        toBorder->length -= USER_RADIUS;
-        #if DEBUG
-            printf("In left user area.\n");
-        #endif
+    if (handedness == RIGHT && correctedToBorderAngle >= -PI * 0.5 && correctedToBorderAngle <= 0) {
+        toBorder->length -= userRadius;
+    } else if (handedness == LEFT && correctedToBorderAngle <= -PI * 0.5 && correctedToBorderAngle >= -PI) {
+        toBorder->length -= userRadius;
     }
     
     // Get the cosine of the angle between the force and toBorder vectors
@@ -511,12 +4411,6 @@ enum action approachingObstacle(Coordinate * p, double x, double y, Vector * for
     toBorder->y = force->y;
     toBorder->length = dist;
     
-    #if DEBUG
-        printf("To obstacle: distance: %lf, x: %lf, y: %lf\n", toBorder->length, toBorder->x, toBorder->y);
-        printf("Force: distance: %lf, x: %lf, y: %lf\n", force->length, force->x, force->y);
-        printf("To obstacle angle: %lf\n", correctedToBorderAngle);
-        printf("Angle: %lf, Going to obstacle: %d\n", angle, goingToObstacle);
-    #endif
     
     if (goingToObstacle) {
         // The robot is moving towards the obstacle, so RESIST
@@ -528,24 +4422,35 @@ enum action approachingObstacle(Coordinate * p, double x, double y, Vector * for
     return NOTHING;
 }
 
+enum action approachingObstacle(Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder) {
+    return paramsApproachingObstacle(&(defaultGuide.params), p, x, y, force, phi, toBorder);
+}
+
+enum action paramsApproachingObstacle(GuideParams * params, Coordinate * p, double x, double y, Vector * force, double phi, Vector * toBorder) {
+    return SPECIALIZE_HANDEDNESS(params, approachingObstacleBody, p, x, y, force, phi, toBorder, params->radius, params->userRadius, params->obstacleRadius);
+}
+
 double getDistanceResistance(Vector * force, double dist) {
+    return paramsGetDistanceResistance(&(defaultGuide.params), force, dist);
+}
+
+double paramsGetDistanceResistance(GuideParams * params, Vector * force, double dist) {
     if (dist <= 0) {
         return 1.0;
     }
     
     // Then determine the acceleration and with that the time to traverse this scaled distance
     // Now linearly interpolate the resistance based on the parameters
-    double a = getAcceleration(force);
+    double a = paramsGetAcceleration(params, force);
     double t = sqrt((2 * dist) / a);
-    double resistance = (RESISTANCE_TIME - t) / (RESISTANCE_TIME - STOP_TIME);
-    #if DEBUG
-        printf("distance: %lf, a: %lf, t: %lf, res: %lf\n", dist, a, t, resistance);
-    #endif
+    double resistance = (params->resistanceTime - t) / (params->resistanceTime - params->stopTime);
     
     // Remove 0.5 from the resistance, to account for static resistance of the robot, then multiply the resistance by two, and finally clamp it between 0 and 1
     return fmin(fmax(0.0, (resistance - 0.5) * 2.0), 1.0);
 }
 
 void cleanup() {
-    freeBorderlineArray(&borderlines);
-}
\ No newline at end of file
+    freeBlindGuide(&defaultGuide);
+}
+
+#endif
@@ -0,0 +1,360 @@
+
+#define S_FUNCTION_NAME blindguidefleet
+#define S_FUNCTION_LEVEL 2
+
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Multi-robot variant of the blindguide S-function: one block evaluates NUM_ROBOTS robots per step against one shared map,
+ * with a single batched query (see guideGetResistanceBatch()) instead of one block, map and query per robot.
+ */
+
+#include "simstruc.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* include h-files */
+#include "Simulink/Bus/busses/bus.h"
+#include "Global_par/constants.h"
+#include "GeneralFunctions/generic_functions.h"
+#include "blindguide.h"
+#include "mapfile.h"
+#include "replay.h"
+#ifdef BAKED_MAP_HEADER
+#include BAKED_MAP_HEADER                /* baked map (see bakedmap.h) that replaces the compiled-in borderCoordinates */
+#endif
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+/* Number of robots evaluated by one block, override with -DNUM_ROBOTS=n */
+#ifndef NUM_ROBOTS
+#define NUM_ROBOTS  16
+#endif
+
+/***************************
+ * Input Ports definitions *
+ ***************************/
+#define NINPUTS     3                   /* Number of input ports (0...)*/
+#define NINPUTS0    POSETYPESIZE        /* cur x y o, stacked for all robots */
+#define NINPUTS1    3                   /* Jerrel's Forces, one frame row per robot */
+#define NINPUTS2    48                  /* Ball xyzdxdydz, shared by all robots */
+double NINPUTS_BGuideFleet[NINPUTS] =  {NINPUTS0,NINPUTS1,NINPUTS2};
+
+/* The ball port carries one Ball bus (x y z dx dy dz), whose position is the only obstacle */
+#define NUM_OBSTACLES   1
+
+
+/****************************
+ * Output Ports definitions *
+ ****************************/
+#define NOUTPUTS0   1              /* Resistance, one frame row per robot */
+#if STATS
+/* Statistics of this step over all robots: borders tested, obstacles tested, full scans,
+ * followed by the p99 and maximum latency per robot in ns since the start of the simulation */
+#define NOUTPUTS    2
+#define NOUTPUTS1   5
+#else
+#define NOUTPUTS    1
+#endif
+
+/*************************************************************************/
+static void mdlInitializeSizes(SimStruct *S)
+{
+    ssSetNumSFcnParams(S, 0);
+    if (ssGetNumSFcnParams(S) != ssGetSFcnParamsCount(S)) {
+        return;
+    }
+
+    /***************************
+     * Input Ports definitions *
+     ***************************/
+    if (!ssSetNumInputPorts(S,NINPUTS)) return;
+    /* input port 0: the pose buses of all robots one after the other */
+    ssSetInputPortWidth(S,0,NUM_ROBOTS * NINPUTS_BGuideFleet[0]);
+    ssSetInputPortDirectFeedThrough(S,0,1);
+    ssSetInputPortRequiredContiguous(S,0,1);
+    ssSetInputPortDataType(S,0,SS_INT8);
+    /* input port 1: a frame with a row of forces per robot */
+    ssSetInputPortMatrixDimensions(S,1,NUM_ROBOTS,NINPUTS_BGuideFleet[1]);
+    ssSetInputPortFrameData(S,1,FRAME_INHERITED);
+    ssSetInputPortDirectFeedThrough(S,1,1);
+    ssSetInputPortRequiredContiguous(S,1,1);
+    ssSetInputPortDataType(S,1,SS_DOUBLE);
+    /* input port 2: the ball bus, which every robot has to avoid */
+    ssSetInputPortWidth(S,2,NINPUTS_BGuideFleet[2]);
+    ssSetInputPortDirectFeedThrough(S,2,1);
+    ssSetInputPortRequiredContiguous(S,2,1);
+    ssSetInputPortDataType(S,2,SS_INT8);
+
+
+    /****************************
+     * Output Ports definitions *
+     ****************************/
+    if (!ssSetNumOutputPorts(S, NOUTPUTS)) return;
+    ssSetOutputPortMatrixDimensions(S,0,NUM_ROBOTS,NOUTPUTS0);
+    ssSetOutputPortFrameData(S,0,FRAME_INHERITED);
+    ssSetOutputPortDataType(S,0,SS_DOUBLE);
+#if STATS
+    ssSetOutputPortWidth(S,1,NOUTPUTS1);
+    ssSetOutputPortDataType(S,1,SS_DOUBLE);
+#endif
+
+
+    /***********************
+     * Definition of States *
+     ************************/
+    ssSetNumContStates(S, 0);
+    ssSetNumDiscStates(S, 0);
+
+    /**********************
+     * Default Definitions *
+     **********************/
+    ssSetNumSampleTimes(S, 1);
+
+    ssSetNumRWork(S, 0);
+    ssSetNumIWork(S, 0);
+    ssSetNumPWork(S, 3);                /* Blind guide with the border map, query buffers and replay log, all built in mdlStart */
+    ssSetNumModes(S, 0);
+}
+
+/*************************************************************************/
+static void mdlInitializeSampleTimes(SimStruct *S)
+{
+    ssSetSampleTime(S, 0, INHERITED_SAMPLE_TIME);
+    ssSetOffsetTime(S, 0, FIXED_IN_MINOR_STEP_OFFSET);
+}
+
+/*************************************************************************/
+/* Environment variable with the path of a map file (see mapfile.h) that replaces the compiled-in map */
+#define MAP_FILE_VARIABLE "BLINDGUIDE_MAP"
+
+/* Loads the map file named by MAP_FILE_VARIABLE into guide, or the compiled-in map when the variable is not set:
+ * the map baked into BAKED_MAP_HEADER when that is defined (e.g. -DBAKED_MAP_HEADER='"venue.h"'), borderCoordinates otherwise */
+static void loadBorders(SimStruct *S, BlindGuide* guide)
+{
+    const char* path = getenv(MAP_FILE_VARIABLE);
+    if (path == NULL || path[0] == '\0') {
+#ifdef BAKED_MAP_HEADER
+        if (!guideLoadBakedMap(guide, &BAKED_MAP)) {
+#else
+        if (!guideInitializeBorders(guide)) {
+#endif
+            ssSetErrorStatus(S, "Not enough memory for the border map");
+        }
+    } else if (!guideLoadMap(guide, path)) {
+        ssSetErrorStatus(S, "Cannot load the map file named by " MAP_FILE_VARIABLE);
+    }
+}
+
+#if STATIC_CAPACITY
+/* Returns 1 when loadBorders() reuses the memory of the current map, which only holds for borderCoordinates:
+ * a map file or a baked map needs memory of its own, which cannot be allocated once mdlStart has frozen allocations */
+static int bordersReloadInPlace(void)
+{
+#ifdef BAKED_MAP_HEADER
+    return 0;
+#else
+    const char* path = getenv(MAP_FILE_VARIABLE);
+    return path == NULL || path[0] == '\0';
+#endif
+}
+#endif
+
+/* Environment variable with the path of a replay log (see replay.h) that records the queries of every step */
+#define LOG_FILE_VARIABLE "BLINDGUIDE_LOG"
+
+/* Creates the replay log named by LOG_FILE_VARIABLE, returns NULL when the variable is not set */
+static ReplayLogWriter* openRecorder(SimStruct *S)
+{
+    const char* path = getenv(LOG_FILE_VARIABLE);
+    if (path == NULL || path[0] == '\0') {
+        return NULL;
+    }
+    ReplayLogWriter* recorder = (ReplayLogWriter*)malloc(sizeof(ReplayLogWriter));
+    if (recorder == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the replay log");
+        return NULL;
+    }
+    if (!openReplayLog(recorder, path)) {
+        ssSetErrorStatus(S, "Cannot create the replay log named by " LOG_FILE_VARIABLE);
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+/* Buffers of the batched query, laid out as guideGetResistanceBatch() expects them */
+typedef struct FleetBuffers {
+    double poses[3 * NUM_ROBOTS];       /* x y phi of every robot */
+    double forces[2 * NUM_ROBOTS];      /* forceX forceY of every robot */
+    double obstacles[2 * NUM_OBSTACLES];
+} FleetBuffers;
+
+/*************************************************************************/
+#define MDL_START
+static void mdlStart(SimStruct *S)
+{
+#if STATIC_CAPACITY
+    /* Another block may have frozen allocations at the end of its mdlStart already */
+    freezeAllocations(0);
+#endif
+
+    /* Build the border map once, it is shared by all robots and reused by every call to mdlOutputs */
+    BlindGuide* guide = (BlindGuide*)malloc(sizeof(BlindGuide));
+    if (guide == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the blind guide");
+        return;
+    }
+    createBlindGuide(guide);
+    loadBorders(S, guide);
+    ssSetPWorkValue(S, 0, guide);
+
+    /* Preallocate the buffers the inputs are gathered in */
+    FleetBuffers* buffers = (FleetBuffers*)malloc(sizeof(FleetBuffers));
+    ssSetPWorkValue(S, 1, buffers);
+    if (buffers == NULL) {
+        ssSetErrorStatus(S, "Not enough memory for the query buffers");
+        return;
+    }
+
+    /* Only record the queries when asked for, so that they can be replayed offline (see replay.h) */
+    ssSetPWorkValue(S, 2, openRecorder(S));
+
+#if STATIC_CAPACITY
+    /* Take all memory the queries need from the arena now, such that mdlOutputs never allocates (see guideReserve()) */
+    if (!guideReserve(guide, guide->borderlines.size, NUM_OBSTACLES)) {
+        ssSetErrorStatus(S, "Not enough memory in the static arena, increase STATIC_ARENA_SIZE");
+    }
+    /* All memory is reserved, so from now on allocating is an error */
+    freezeAllocations(1);
+#endif
+}
+
+/*************************************************************************/
+static void mdlOutputs(SimStruct *S, int_T tid)
+{
+    /* Input Ports */
+    pPose_t cur_xyo = (pPose_t)ssGetInputPortSignal(S,0);             /* motionbus of every robot */
+    const double* Fvec = (const double*)ssGetInputPortSignal(S,1);
+    pBall_t ball    = (pBall_t)ssGetInputPortSignal(S,2);
+
+    /* Output Ports */
+    double* resistance      = (double*)ssGetOutputPortSignal(S,0);
+
+    /* Blind guide with the border map */
+    BlindGuide* guide       = (BlindGuide*)ssGetPWorkValue(S,0);
+    FleetBuffers* buffers   = (FleetBuffers*)ssGetPWorkValue(S,1);
+    ReplayLogWriter* recorder = (ReplayLogWriter*)ssGetPWorkValue(S,2);
+    unsigned int numObstacles = NUM_OBSTACLES;
+    int i;
+
+    /* The obstacle of all robots is the position of the ball on the ball bus */
+    buffers->obstacles[0] = ball->pos.arr[0];
+    buffers->obstacles[1] = ball->pos.arr[1];
+
+    /* Gather the robots, the force frame is stored column by column (all forceX first, then all forceY) */
+    for (i = 0; i < NUM_ROBOTS; i++) {
+        buffers->poses[3 * i] = cur_xyo[i].x;
+        buffers->poses[3 * i + 1] = cur_xyo[i].y;
+        buffers->poses[3 * i + 2] = cur_xyo[i].o;
+        buffers->forces[2 * i] = Fvec[i];
+        buffers->forces[2 * i + 1] = Fvec[NUM_ROBOTS + i];
+    }
+
+    /* Only rebuild the border map when it has been invalidated */
+    if (bordersOutdated(&guide->borderlines)) {
+#if STATIC_CAPACITY
+        if (!bordersReloadInPlace()) {
+            ssSetErrorStatus(S, "Cannot reload a map file or baked map while allocations are frozen");
+            return;
+        }
+#endif
+        loadBorders(S, guide);
+    }
+#if STATS
+    GuideStats before = guide->search.stats;
+#endif
+    /* Robots close together share the border lines they load, and robots spread over a large venue are searched one by one (see BATCH_MAX_SPREAD),
+       so the batch is never slower than calling guideGetResistance() for every robot */
+    guideGetResistanceBatch(guide, NUM_ROBOTS, buffers->poses, buffers->forces, numObstacles, buffers->obstacles, resistance);
+    if (recorder != NULL) {
+        for (i = 0; i < NUM_ROBOTS; i++) {
+            appendReplayRecord(recorder, buffers->poses[3 * i], buffers->poses[3 * i + 1], buffers->poses[3 * i + 2],
+                buffers->forces[2 * i], buffers->forces[2 * i + 1], numObstacles, buffers->obstacles);
+        }
+    }
+#if STATS
+    /* Publish the counters of this step, which are the differences with the counters before the query */
+    GuideStats* after = &guide->search.stats;
+    double* stats = (double*)ssGetOutputPortSignal(S,1);
+    stats[0] = (double)(after->bordersTested - before.bordersTested);
+    stats[1] = (double)(after->obstaclesTested - before.obstaclesTested);
+    stats[2] = (double)(after->fullScans - before.fullScans);
+    stats[3] = getStatsPercentile(after, 0.99);
+    stats[4] = (double)after->maxNanoseconds;
+#endif
+}
+/*************************************************************************/
+static void mdlTerminate(SimStruct *S)
+{
+    /* Release the blind guide, query buffers and replay log built in mdlStart */
+#if STATIC_CAPACITY
+    freezeAllocations(0);
+#endif
+    BlindGuide* guide = (BlindGuide*)ssGetPWorkValue(S,0);
+    if (guide != NULL) {
+        freeBlindGuide(guide);
+        free(guide);
+        ssSetPWorkValue(S, 0, NULL);
+    }
+    free(ssGetPWorkValue(S,1));
+    ssSetPWorkValue(S, 1, NULL);
+    ReplayLogWriter* recorder = (ReplayLogWriter*)ssGetPWorkValue(S,2);
+    if (recorder != NULL) {
+        closeReplayLog(recorder);
+        free(recorder);
+        ssSetPWorkValue(S, 2, NULL);
+    }
+}
+
+#ifdef  MATLAB_MEX_FILE    /* Is this file being compiled as a MEX-file? */
+#include "simulink.c"      /* MEX-file interface mechanism */
+#else
+#include "cg_sfun.h"       /* Code generation registration function */
+#endif
@@ -0,0 +1,587 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "mapfile.h"
+#include "snapshot.h"
+// The bundled maps, baked by mapbake (see the Makefile)
+#include "maps/lines.h"
+#include "maps/outer.h"
+#include "maps/windy.h"
+#include "maps/zigzag.h"
+
+// Number of queries per map
+#define NUM_QUERIES 10000
+// Number of queries of one walk, like a robot queried every control tick
+#define WALK_LENGTH 50
+// Number of obstacles passed to the queries with obstacles (enough to index them, see OBSTACLE_INDEX_THRESHOLD)
+#define NUM_OBSTACLES 40
+// Distance in meter that a query is moved to find the other side of a decision (see checkPrecision())
+#define DECISION_DISTANCE 1e-5
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+/*
+ * A set of queries on one map, in the layout of getResistanceBatch(), and the obstacles that all of them share.
+ */
+typedef struct QuerySet {
+    double poses[3 * NUM_QUERIES];
+    double forces[2 * NUM_QUERIES];
+    unsigned int numObstacles;
+    double obstacles[2 * NUM_OBSTACLES];
+} QuerySet;
+
+// Number of failed checks
+int numFailures = 0;
+
+/*
+ * A random map: numBorders borders in coordinates and goodSides (see guideAddBorders()), where the polylines of more than one border
+ * form chains (chain i holds the chainLength[i] borders from chainStart[i] on),
+ * followed by changes: the borders in removed are removed, those in disabled are disabled, and then numExtra further borders are added.
+ */
+typedef struct RandomMap {
+    size_t numBorders;
+    double * coordinates;
+    enum side * goodSides;
+    size_t numChains;
+    size_t * chainStart;
+    size_t * chainLength;
+    size_t numRemoved;
+    size_t * removed;
+    size_t numDisabled;
+    size_t * disabled;
+    size_t numExtra;
+    double * extra;
+} RandomMap;
+
+/*
+ * Fills map with about numBorders borders within size meters around the origin, with polylines and polygons of up to 12 borders.
+ */
+void createRandomMap(RandomMap * map, size_t numBorders, double size) {
+    map->coordinates = (double *) malloc(4 * (numBorders + 12) * sizeof(double));
+    map->goodSides = (enum side *) malloc((numBorders + 12) * sizeof(enum side));
+    map->chainStart = (size_t *) malloc(numBorders * sizeof(size_t));
+    map->chainLength = (size_t *) malloc(numBorders * sizeof(size_t));
+    map->numBorders = 0;
+    map->numChains = 0;
+    while (map->numBorders < numBorders) {
+        size_t length = 1 + rand() % 12;
+        int closed = length >= 3 && rand() % 4 == 0;
+        enum side goodSide = rand() % 2 ? LEFT : RIGHT;
+        double x = randomBetween(-size / 2, size / 2);
+        double y = randomBetween(-size / 2, size / 2);
+        double firstX = x, firstY = y;
+        if (length > 1) {
+            map->chainStart[map->numChains] = map->numBorders;
+            map->chainLength[map->numChains++] = length;
+        }
+        size_t k = 0;
+        for (k = 0; k < length; k++) {
+            double * c = &(map->coordinates[4 * map->numBorders]);
+            c[0] = x;
+            c[1] = y;
+            if (closed && k == length - 1) {
+                x = firstX;
+                y = firstY;
+            } else {
+                // Turn back at the edge of the map rather than following it, as overlapping borders tie for every query along them
+                double dx = randomBetween(-3, 3);
+                double dy = randomBetween(-3, 3);
+                x += fabs(x + dx) > size / 2 ? -dx : dx;
+                y += fabs(y + dy) > size / 2 ? -dy : dy;
+            }
+            c[2] = x;
+            c[3] = y;
+            map->goodSides[map->numBorders++] = goodSide;
+        }
+    }
+    map->numRemoved = map->numBorders / 20;
+    map->removed = (size_t *) malloc(map->numRemoved * sizeof(size_t));
+    map->numDisabled = map->numBorders / 20;
+    map->disabled = (size_t *) malloc(map->numDisabled * sizeof(size_t));
+    size_t i = 0;
+    for (i = 0; i < map->numRemoved; i++) {
+        map->removed[i] = rand() % map->numBorders;
+    }
+    for (i = 0; i < map->numDisabled; i++) {
+        map->disabled[i] = rand() % map->numBorders;
+    }
+    // The extra borders take the slots of the removed ones
+    map->numExtra = map->numRemoved + 10;
+    map->extra = (double *) malloc(4 * map->numExtra * sizeof(double));
+    for (i = 0; i < map->numExtra; i++) {
+        double x = randomBetween(-size / 2, size / 2);
+        double y = randomBetween(-size / 2, size / 2);
+        map->extra[4 * i] = x;
+        map->extra[4 * i + 1] = y;
+        map->extra[4 * i + 2] = x + randomBetween(-2, 2);
+        map->extra[4 * i + 3] = y + randomBetween(-2, 2);
+    }
+}
+
+void freeRandomMap(RandomMap * map) {
+    free(map->coordinates);
+    free(map->goodSides);
+    free(map->chainStart);
+    free(map->chainLength);
+    free(map->removed);
+    free(map->disabled);
+    free(map->extra);
+}
+
+/*
+ * Builds map in the new guide, with its polylines as chains (chained is 1) or with every border added on its own (chained is 0).
+ * Returns 1 on success, 0 otherwise.
+ */
+int buildRandomMap(BlindGuide * guide, RandomMap * map, int chained) {
+    BorderHandle * handles = (BorderHandle *) malloc(map->numBorders * sizeof(BorderHandle));
+    int ok = handles != NULL;
+    size_t i = 0;
+    if (ok && chained) {
+        // The borders of a new guide take the slots in order, and the members of a chain are found through the chain
+        ok = guideAddBorders(guide, map->numBorders, map->coordinates, map->goodSides) && guide->chains.size == map->numChains;
+        for (i = 0; ok && i < map->numBorders; i++) {
+            handles[i].index = (unsigned int) i;
+            handles[i].generation = guide->borderlines.generations[i];
+        }
+        size_t chain = 0;
+        for (chain = 0; ok && chain < map->numChains; chain++) {
+            size_t k = 0;
+            for (k = 0; k < map->chainLength[chain]; k++) {
+                handles[map->chainStart[chain] + k] = guideGetChainBorder(guide, chain, k);
+            }
+        }
+    }
+    for (i = 0; ok && !chained && i < map->numBorders; i++) {
+        double * c = &(map->coordinates[4 * i]);
+        handles[i] = guideAddBorder(guide, c[0], c[1], c[2], c[3], map->goodSides[i]);
+        ok = handles[i].index != INVALID_BORDER_INDEX;
+    }
+    for (i = 0; ok && i < map->numRemoved; i++) {
+        guideRemoveBorder(guide, handles[map->removed[i]]);
+    }
+    for (i = 0; ok && i < map->numDisabled; i++) {
+        guideEnableBorder(guide, handles[map->disabled[i]], 0);
+    }
+    for (i = 0; ok && i < map->numExtra; i++) {
+        double * c = &(map->extra[4 * i]);
+        ok = guideAddBorder(guide, c[0], c[1], c[2], c[3], i % 2 ? LEFT : RIGHT).index != INVALID_BORDER_INDEX;
+    }
+    free(handles);
+    return ok;
+}
+
+/*
+ * Fills queries with walks of WALK_LENGTH queries over the map of guide: half of the walks start near a border line, the others anywhere
+ * within a meter of the map. The forces are between 1 and 20 N. With obstacles, NUM_OBSTACLES obstacles are spread over the map.
+ */
+void createQueries(BlindGuide * guide, QuerySet * queries, int withObstacles) {
+    BorderlineArray * ba = &(guide->borderlines);
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t i = 0;
+    for (i = 0; i < ba->size; i++) {
+        Borderline b = getBorderline(ba, (unsigned int) i);
+        minX = fmin(minX, fmin(b.bottom.x, b.top.x));
+        maxX = fmax(maxX, fmax(b.bottom.x, b.top.x));
+        minY = fmin(minY, fmin(b.bottom.y, b.top.y));
+        maxY = fmax(maxY, fmax(b.bottom.y, b.top.y));
+    }
+    minX -= 1;
+    maxX += 1;
+    minY -= 1;
+    maxY += 1;
+    double x = 0, y = 0, phi = 0;
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        if (q % WALK_LENGTH == 0) {
+            if (rand() % 2 == 0) {
+                Borderline b = getBorderline(ba, rand() % ba->size);
+                double t = randomBetween(0, 1);
+                x = b.bottom.x + t * (b.top.x - b.bottom.x) + randomBetween(-0.5, 0.5);
+                y = b.bottom.y + t * (b.top.y - b.bottom.y) + randomBetween(-0.5, 0.5);
+            } else {
+                x = randomBetween(minX, maxX);
+                y = randomBetween(minY, maxY);
+            }
+            phi = randomBetween(-PI, PI);
+        }
+        x += randomBetween(-0.05, 0.05);
+        y += randomBetween(-0.05, 0.05);
+        phi += randomBetween(-0.05, 0.05);
+        double force = randomBetween(1, 20);
+        double direction = randomBetween(-PI, PI);
+        queries->poses[3 * q] = x;
+        queries->poses[3 * q + 1] = y;
+        queries->poses[3 * q + 2] = phi;
+        queries->forces[2 * q] = force * cos(direction);
+        queries->forces[2 * q + 1] = force * sin(direction);
+    }
+    queries->numObstacles = withObstacles ? NUM_OBSTACLES : 0;
+    unsigned int o = 0;
+    for (o = 0; o < queries->numObstacles; o++) {
+        queries->obstacles[2 * o] = randomBetween(minX, maxX);
+        queries->obstacles[2 * o + 1] = randomBetween(minY, maxY);
+    }
+}
+
+/*
+ * Stores the result of guideGetResistance() for every query in resistances.
+ */
+void runQueries(BlindGuide * guide, QuerySet * queries, double * resistances) {
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        double * pose = &(queries->poses[3 * q]);
+        resistances[q] = guideGetResistance(guide, pose[0], pose[1], pose[2], queries->forces[2 * q], queries->forces[2 * q + 1],
+            queries->numObstacles, queries->obstacles);
+    }
+}
+
+/*
+ * Stores the result of guideGetResistanceCached() for every query in resistances, with one cache for all queries.
+ */
+void runCachedQueries(BlindGuide * guide, QuerySet * queries, double * resistances) {
+    BorderCache cache;
+    memset(&cache, 0, sizeof(BorderCache));
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        double * pose = &(queries->poses[3 * q]);
+        resistances[q] = guideGetResistanceCached(guide, &cache, pose[0], pose[1], pose[2], queries->forces[2 * q], queries->forces[2 * q + 1],
+            queries->numObstacles, queries->obstacles);
+    }
+    freeBorderCache(&cache);
+}
+
+/*
+ * Stores the result of evaluating every border line of guide with its kernel for every query in resistances, without the grid and the chains.
+ */
+void runFullScans(BlindGuide * guide, QuerySet * queries, double * resistances) {
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        double * pose = &(queries->poses[3 * q]);
+        Coordinate point;
+        Vector force;
+        double resistance = prepareResistance(pose[0], pose[1], pose[2], queries->forces[2 * q], queries->forces[2 * q + 1], &point, &force, &(guide->params));
+        double nearestDistance = 1000000000;
+        enum action closestBorderAction = NOTHING;
+        guide->kernel(&(guide->soa), NULL, guide->soa.size, &point, &force, pose[2], &nearestDistance, &closestBorderAction, &(guide->params));
+        resistances[q] = finishResistance(&point, &force, pose[2], resistance, nearestDistance, closestBorderAction,
+            queries->numObstacles, queries->obstacles, NULL, NULL, &(guide->params));
+    }
+}
+
+/*
+ * Returns the resistance for the given query, with every border line of guide evaluated in double precision by evaluateBorders(),
+ * in the order of the map (reversed is 0) or the other way around (reversed is 1), which decides ties the other way.
+ */
+double getReferenceResistance(BlindGuide * guide, int reversed, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    BorderlineArray * ba = &(guide->borderlines);
+    Coordinate point;
+    Vector force;
+    double resistance = prepareResistance(x, y, phi, forceX, forceY, &point, &force, &(guide->params));
+    double nearestDistance = 1000000000;
+    enum action closestBorderAction = NOTHING;
+    unsigned int i = 0;
+    for (i = 0; i < ba->size; i++) {
+        unsigned int index = reversed ? (unsigned int) ba->size - 1 - i : i;
+        evaluateBorders(&point, ba, &index, 1, &force, phi, &nearestDistance, &closestBorderAction, &(guide->params));
+    }
+    return finishResistance(&point, &force, phi, resistance, nearestDistance, closestBorderAction, numObstacles, obstacles, NULL, NULL, &(guide->params));
+}
+
+/*
+ * Compares results with expected, and prints a line for the check with the number of mismatches. Returns the number of mismatches.
+ */
+size_t compareResults(const char * map, const char * check, double * expected, double * results) {
+    size_t mismatches = 0;
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        mismatches += results[q] != expected[q];
+    }
+    printf("%s\t%s\t%d\t%zu\n", map, check, NUM_QUERIES, mismatches);
+    numFailures += mismatches > 0;
+    return mismatches;
+}
+
+/*
+ * Checks that results (of the kernels of guide) are within FLOAT32_MAX_DEVIATION of the double precision reference
+ * (or within 1e-9 without FLOAT32). Where the resistance changes steeply (see FLOAT32_MAX_DEVIATION), a result between the references
+ * for points within DECISION_DISTANCE (in eight directions) is also right, and so is either decision of a tie between two border lines
+ * that are equally far (e.g. at the corner where they meet), which the reference decides by their order.
+ */
+void checkPrecision(const char * map, BlindGuide * guide, QuerySet * queries, double * results) {
+    double tolerance = FLOAT32 ? FLOAT32_MAX_DEVIATION : 1e-9;
+    double maxDeviation = 0;
+    size_t mismatches = 0;
+    size_t q = 0;
+    for (q = 0; q < NUM_QUERIES; q++) {
+        double * pose = &(queries->poses[3 * q]);
+        double * force = &(queries->forces[2 * q]);
+        double deviation = fmin(fabs(results[q] - getReferenceResistance(guide, 0, pose[0], pose[1], pose[2], force[0], force[1], queries->numObstacles, queries->obstacles)),
+            fabs(results[q] - getReferenceResistance(guide, 1, pose[0], pose[1], pose[2], force[0], force[1], queries->numObstacles, queries->obstacles)));
+        maxDeviation = fmax(maxDeviation, deviation);
+        if (deviation <= tolerance) {
+            continue;
+        }
+        double low = INFINITY, high = -INFINITY;
+        int d = 0;
+        for (d = 0; d < 8; d++) {
+            double x = pose[0] + DECISION_DISTANCE * cos(d * PI / 4);
+            double y = pose[1] + DECISION_DISTANCE * sin(d * PI / 4);
+            int reversed = 0;
+            for (reversed = 0; reversed <= 1; reversed++) {
+                double reference = getReferenceResistance(guide, reversed, x, y, pose[2], force[0], force[1], queries->numObstacles, queries->obstacles);
+                low = fmin(low, reference);
+                high = fmax(high, reference);
+            }
+        }
+        mismatches += results[q] < low - tolerance || results[q] > high + tolerance;
+    }
+    printf("%s\tprecision (max %.1e)\t%d\t%zu\n", map, maxDeviation, NUM_QUERIES, mismatches);
+    numFailures += mismatches > 0;
+}
+
+/*
+ * Checks every evaluation path on the map of guide against guideGetResistance() with the scalar kernel, for queries without and with obstacles,
+ * and the results on the maps of others (e.g. the same map loaded in another way) against those on guide.
+ */
+void checkMap(const char * map, BlindGuide * guide, size_t numOthers, const char ** otherNames, BlindGuide ** others) {
+    static QuerySet queries;
+    static double expected[NUM_QUERIES], results[NUM_QUERIES];
+    const char * kernelNames[] = {"scalar", "sse2", "avx2"};
+    enum kernel kernels[] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+    int withObstacles = 0;
+    for (withObstacles = 0; withObstacles <= 1; withObstacles++) {
+        char name[128];
+        snprintf(name, sizeof(name), "%s%s", map, withObstacles ? "+obstacles" : "");
+        createQueries(guide, &queries, withObstacles);
+        guideSelectBorderKernel(guide, KERNEL_SCALAR);
+        runQueries(guide, &queries, expected);
+        checkPrecision(name, guide, &queries, expected);
+
+        size_t k = 0;
+        for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            char check[64];
+            if (guideSelectBorderKernel(guide, kernels[k]) != kernels[k]) {
+                printf("%s\t%s skipped, not supported by the CPU\t0\t0\n", name, kernelNames[k]);
+                continue;
+            }
+            if (kernels[k] != KERNEL_SCALAR) {
+                runQueries(guide, &queries, results);
+                snprintf(check, sizeof(check), "getResistance:%s", kernelNames[k]);
+                compareResults(name, check, expected, results);
+            }
+            guideGetResistanceBatch(guide, NUM_QUERIES, queries.poses, queries.forces, queries.numObstacles, queries.obstacles, results);
+            snprintf(check, sizeof(check), "batch:%s", kernelNames[k]);
+            compareResults(name, check, expected, results);
+            runCachedQueries(guide, &queries, results);
+            snprintf(check, sizeof(check), "cached:%s", kernelNames[k]);
+            compareResults(name, check, expected, results);
+            runFullScans(guide, &queries, results);
+            snprintf(check, sizeof(check), "fullscan:%s", kernelNames[k]);
+            compareResults(name, check, expected, results);
+        }
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+
+        size_t o = 0;
+        for (o = 0; o < numOthers; o++) {
+            runQueries(others[o], &queries, results);
+            compareResults(name, otherNames[o], expected, results);
+        }
+    }
+}
+
+/*
+ * Checks a random map of numBorders borders within size meters: the evaluation paths (see checkMap()), the same map with every border
+ * added on its own, a copy, and the map saved to a map file with and without its grid and loaded again.
+ */
+void checkRandomMap(size_t numBorders, double size) {
+    char map[64];
+    snprintf(map, sizeof(map), "random-%zu", numBorders);
+    RandomMap randomMap;
+    createRandomMap(&randomMap, numBorders, size);
+    BlindGuide guide, loose, copy, loaded, unindexed;
+    createBlindGuide(&guide);
+    createBlindGuide(&loose);
+    createBlindGuide(&copy);
+    createBlindGuide(&loaded);
+    createBlindGuide(&unindexed);
+    // Loaded map files are used in place, so the map file without grid needs a file of its own
+    char path[] = "/tmp/crosscheck-XXXXXX";
+    char unindexedPath[] = "/tmp/crosscheck-XXXXXX";
+    int fd = mkstemp(path);
+    int unindexedFd = mkstemp(unindexedPath);
+    if (fd < 0 || unindexedFd < 0 || !buildRandomMap(&guide, &randomMap, 1) || !buildRandomMap(&loose, &randomMap, 0) || !guideCopyMap(&copy, &guide)
+            || !guideSaveMap(&guide, path, 1) || !guideLoadMap(&loaded, path) || !guideSaveMap(&guide, unindexedPath, 0) || !guideLoadMap(&unindexed, unindexedPath)) {
+        printf("%s\tbuild\t0\t1\n", map);
+        numFailures++;
+    } else {
+        const char * names[] = {"loose", "copy", "mapfile", "mapfile:noindex"};
+        BlindGuide * others[] = {&loose, &copy, &loaded, &unindexed};
+        checkMap(map, &guide, 4, names, others);
+    }
+    if (fd >= 0) {
+        close(fd);
+        unlink(path);
+    }
+    if (unindexedFd >= 0) {
+        close(unindexedFd);
+        unlink(unindexedPath);
+    }
+    freeBlindGuide(&unindexed);
+    freeBlindGuide(&loaded);
+    freeBlindGuide(&copy);
+    freeBlindGuide(&loose);
+    freeBlindGuide(&guide);
+    freeRandomMap(&randomMap);
+}
+
+/*
+ * Checks the bundled map with the given name: the evaluation paths on the text map (see checkMap()), and its baked map.
+ */
+void checkBakedMap(const char * name, const BakedMap * bakedMap) {
+    char path[64];
+    snprintf(path, sizeof(path), "maps/%s.txt", name);
+    BlindGuide guide, baked;
+    createBlindGuide(&guide);
+    createBlindGuide(&baked);
+    if (guideImportTextMap(&guide, path, NULL) <= 0 || !guideLoadBakedMap(&baked, bakedMap)) {
+        printf("%s\tbuild\t0\t1\n", name);
+        numFailures++;
+    } else {
+        const char * names[] = {"baked"};
+        BlindGuide * others[] = {&baked};
+        checkMap(name, &guide, 1, names, others);
+    }
+    freeBlindGuide(&baked);
+    freeBlindGuide(&guide);
+}
+
+/*
+ * Checks cached queries through snapshots of a random map of numBorders borders within size meters against uncached queries on the same map,
+ * while the map is reloaded (built again, like guideserver does on SIGHUP) and then updated with a few borders, for a number of rounds.
+ * Every reload and update replaces a snapshot, so later snapshots take the place of freed ones in memory,
+ * and a cache filled from a replaced snapshot must not be taken for one of the current snapshot.
+ * The queries are walked forth and back in turn, such that every round starts where the cache of the previous round is.
+ */
+void checkSnapshotReload(size_t numBorders, double size) {
+    static QuerySet queries;
+    static double expected[NUM_QUERIES], results[NUM_QUERIES];
+    char map[64];
+    snprintf(map, sizeof(map), "random-%zu", numBorders);
+    RandomMap randomMap;
+    createRandomMap(&randomMap, numBorders, size);
+    BlindGuide venue;
+    createBlindGuide(&venue);
+    MapSnapshots snapshots;
+    if (!buildRandomMap(&venue, &randomMap, 1) || !createMapSnapshots(&snapshots, &venue)) {
+        printf("%s\tsnapshot reload\t0\t1\n", map);
+        numFailures++;
+        freeBlindGuide(&venue);
+        freeRandomMap(&randomMap);
+        return;
+    }
+    createQueries(&venue, &queries, 0);
+    int reader = registerSnapshotReader(&snapshots);
+    BorderCache cache;
+    memset(&cache, 0, sizeof(BorderCache));
+    int round = 0;
+    for (round = 0; round < 8; round++) {
+        // Reload the venue, and mirror the snapshot in venue itself
+        freeBlindGuide(&venue);
+        createBlindGuide(&venue);
+        BlindGuide * next = NULL;
+        int reloaded = buildRandomMap(&venue, &randomMap, 1) && (next = beginMapUpdate(&snapshots)) != NULL;
+        if (reloaded && !guideCopyMap(next, &venue)) {
+            cancelMapUpdate(&snapshots);
+            reloaded = 0;
+        } else if (reloaded) {
+            publishMapUpdate(&snapshots);
+        }
+        // Then add a few short borders along the walk where the previous round ended, and so the cache is, which the next reload takes away again.
+        // Start with a varying number of them elsewhere, so that the borders along the walk take other slots every round
+        next = reloaded ? beginMapUpdate(&snapshots) : NULL;
+        if (next == NULL) {
+            printf("%s\tsnapshot reload\t0\t1\n", map);
+            numFailures++;
+            break;
+        }
+        int backward = round % 2;
+        int numElsewhere = rand() % 20;
+        int b = 0;
+        for (b = 0; b < 20; b++) {
+            size_t q = b < numElsewhere ? WALK_LENGTH + rand() % (NUM_QUERIES - 2 * WALK_LENGTH) : rand() % WALK_LENGTH;
+            double * pose = &(queries.poses[3 * (backward ? NUM_QUERIES - 1 - q : q)]);
+            double x = pose[0] + randomBetween(-0.5, 0.5);
+            double y = pose[1] + randomBetween(-0.5, 0.5);
+            double dx = randomBetween(-1, 1), dy = randomBetween(-1, 1);
+            guideAddBorder(next, x, y, x + dx, y + dy, RIGHT);
+            guideAddBorder(&venue, x, y, x + dx, y + dy, RIGHT);
+        }
+        publishMapUpdate(&snapshots);
+
+        runQueries(&venue, &queries, expected);
+        size_t k = 0;
+        for (k = 0; k < NUM_QUERIES; k++) {
+            size_t q = backward ? NUM_QUERIES - 1 - k : k;
+            double * pose = &(queries.poses[3 * q]);
+            results[q] = snapshotGetResistance(&snapshots, reader, &cache, pose[0], pose[1], pose[2], queries.forces[2 * q], queries.forces[2 * q + 1], 0, NULL);
+        }
+        char check[64];
+        snprintf(check, sizeof(check), "snapshot reload %d", round);
+        compareResults(map, check, expected, results);
+    }
+    freeBorderCache(&cache);
+    unregisterSnapshotReader(&snapshots, reader);
+    freeMapSnapshots(&snapshots);
+    freeBlindGuide(&venue);
+    freeRandomMap(&randomMap);
+}
+
+/*
+ * Checks that the ways to evaluate a query and to load a map give the same results on random maps and the bundled maps,
+ * and prints a line per check with the number of queries whose result differs. Run from the directory with maps/.
+ * Returns 1 when any result differs.
+ */
+int main() {
+    srand(1);
+    printf("map\tcheck\tqueries\tmismatches\n");
+    checkRandomMap(100, 20);
+    checkRandomMap(1000, 50);
+    checkRandomMap(4000, 80);
+    checkBakedMap("lines", &linesMap);
+    checkBakedMap("outer", &outerMap);
+    checkBakedMap("windy", &windyMap);
+    checkBakedMap("zigzag", &zigzagMap);
+    checkSnapshotReload(1000, 50);
+    if (numFailures > 0) {
+        printf("%d checks failed\n", numFailures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
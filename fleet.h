@@ -0,0 +1,298 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "blindguide.h"
+
+// Number of robots that a worker evaluates before looking for more work
+#define FLEET_CHUNK_SIZE 8
+
+/*
+ * State of a single robot of the fleet, see getResistance() for the meaning of the fields.
+ * obstacles contains 2 * numObstacles elements and belongs to this robot only.
+ */
+typedef struct RobotState {
+    double x;
+    double y;
+    double phi;
+    double forceX;
+    double forceY;
+    unsigned int numObstacles;
+    double * obstacles;
+} RobotState;
+
+/*
+ * A worker of the fleet evaluator.
+ * range: the chunks that are still queued for this worker, packed as (begin << 32) | end.
+ *        The worker itself takes chunks from the begin, other workers steal chunks from the end.
+ * search: scratch space for searching the border grid of the shared guide
+ * thread: the thread running this worker (unused for worker 0, which is the calling thread)
+ * fleet: the fleet this worker belongs to
+ */
+typedef struct FleetWorker {
+    _Atomic uint64_t range;
+    struct BorderSearch search;
+    pthread_t thread;
+    struct Fleet * fleet;
+} FleetWorker;
+
+/*
+ * Evaluator that computes the resistance for many robots at once on a pool of threads, sharing a single read-only guide.
+ * guide: the guide with the shared map (it is not modified while evaluating)
+ * numWorkers: number of workers, including the calling thread
+ * workers: array of numWorkers workers
+ * lock, start, done: used to hand out jobs to the worker threads and to wait for them
+ * generation: number of the current job
+ * numBusy: number of worker threads still working on the current job
+ * stop: set when the worker threads should terminate
+ * robots, resistances, numRobots: the current job
+ */
+typedef struct Fleet {
+    BlindGuide * guide;
+    size_t numWorkers;
+    struct FleetWorker * workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    size_t numBusy;
+    int stop;
+    RobotState * robots;
+    double * resistances;
+    size_t numRobots;
+} Fleet;
+
+/*
+ * Populates the given Fleet structure and starts its worker threads.
+ * All robots are evaluated against the map of the given guide, which must not be changed while the fleet exists.
+ * numWorkers is the total number of threads used (including the thread calling evaluateFleet()), or 0 to use all cores.
+ */
+void createFleet(Fleet * fleet, BlindGuide * guide, size_t numWorkers);
+
+/*
+ * Computes the resistance for each of the numRobots robots, and stores the resistance of robot i in resistances[i].
+ * Gives the same results as calling guideGetResistance() for every robot.
+ * The robots are divided in chunks of FLEET_CHUNK_SIZE robots which are distributed evenly over the workers;
+ * workers that run out of chunks steal chunks from the others, so robots in dense areas of the map do not delay the whole fleet.
+ */
+void evaluateFleet(Fleet * fleet, size_t numRobots, RobotState * robots, double * resistances);
+
+/*
+ * Stops the worker threads and frees the memory allocated to the given Fleet structure.
+ */
+void freeFleet(Fleet * fleet);
+
+/*
+ * Stores the counters of all workers of the fleet, merged with mergeStats(), in snapshot (see GuideStats).
+ * Must not be called while evaluateFleet() is running.
+ */
+void fleetGetStats(Fleet * fleet, GuideStats * snapshot);
+
+/*
+ * Resets the counters of all workers of the fleet to zero.
+ * Must not be called while evaluateFleet() is running.
+ */
+void fleetResetStats(Fleet * fleet);
+
+/*
+ * Returns the number of cores that are available.
+ */
+size_t getNumCores();
+
+
+/*
+ * Takes the first chunk queued for worker, returns 0 if there is none.
+ */
+static int popFleetChunk(FleetWorker * worker, size_t * chunk) {
+    uint64_t range = atomic_load(&(worker->range));
+    for (;;) {
+        uint32_t begin = (uint32_t) (range >> 32);
+        uint32_t end = (uint32_t) range;
+        if (begin >= end) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak(&(worker->range), &range, ((uint64_t) (begin + 1) << 32) | end)) {
+            *chunk = begin;
+            return 1;
+        }
+    }
+}
+
+/*
+ * Steals the last chunk queued for worker, returns 0 if there is none.
+ */
+static int stealFleetChunk(FleetWorker * worker, size_t * chunk) {
+    uint64_t range = atomic_load(&(worker->range));
+    for (;;) {
+        uint32_t begin = (uint32_t) (range >> 32);
+        uint32_t end = (uint32_t) range;
+        if (begin >= end) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak(&(worker->range), &range, ((uint64_t) begin << 32) | (end - 1))) {
+            *chunk = end - 1;
+            return 1;
+        }
+    }
+}
+
+/*
+ * Evaluates chunks of the current job of fleet as worker w, until no chunks are left for any worker.
+ */
+static void runFleetWorker(Fleet * fleet, size_t w) {
+    FleetWorker * self = &(fleet->workers[w]);
+    size_t chunk;
+    for (;;) {
+        int found = popFleetChunk(self, &chunk);
+        size_t v = 1;
+        for (v = 1; !found && v < fleet->numWorkers; v++) {
+            found = stealFleetChunk(&(fleet->workers[(w + v) % fleet->numWorkers]), &chunk);
+        }
+        if (!found) {
+            return;
+        }
+        size_t i = chunk * FLEET_CHUNK_SIZE;
+        size_t end = i + FLEET_CHUNK_SIZE < fleet->numRobots ? i + FLEET_CHUNK_SIZE : fleet->numRobots;
+        for (; i < end; i++) {
+            RobotState * r = &(fleet->robots[i]);
+            fleet->resistances[i] = guideGetResistanceWith(fleet->guide, &(self->search), r->x, r->y, r->phi, r->forceX, r->forceY, r->numObstacles, r->obstacles);
+        }
+    }
+}
+
+/*
+ * Main function of the worker threads: waits for a new job, evaluates it and reports back.
+ */
+static void * fleetThread(void * arg) {
+    FleetWorker * self = (FleetWorker *) arg;
+    Fleet * fleet = self->fleet;
+    size_t w = self - fleet->workers;
+    unsigned long generation = 0;
+    pthread_mutex_lock(&(fleet->lock));
+    for (;;) {
+        while (!fleet->stop && fleet->generation == generation) {
+            pthread_cond_wait(&(fleet->start), &(fleet->lock));
+        }
+        if (fleet->stop) {
+            break;
+        }
+        generation = fleet->generation;
+        pthread_mutex_unlock(&(fleet->lock));
+        runFleetWorker(fleet, w);
+        pthread_mutex_lock(&(fleet->lock));
+        if (--fleet->numBusy == 0) {
+            pthread_cond_signal(&(fleet->done));
+        }
+    }
+    pthread_mutex_unlock(&(fleet->lock));
+    return NULL;
+}
+
+size_t getNumCores() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t) n : 1;
+}
+
+void createFleet(Fleet * fleet, BlindGuide * guide, size_t numWorkers) {
+    memset(fleet, 0, sizeof(Fleet));
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    fleet->guide = guide;
+    fleet->numWorkers = numWorkers > 0 ? numWorkers : getNumCores();
+    fleet->workers = (struct FleetWorker *) calloc(fleet->numWorkers, sizeof(struct FleetWorker));
+    pthread_mutex_init(&(fleet->lock), NULL);
+    pthread_cond_init(&(fleet->start), NULL);
+    pthread_cond_init(&(fleet->done), NULL);
+    size_t w = 0;
+    for (w = 0; w < fleet->numWorkers; w++) {
+        fleet->workers[w].fleet = fleet;
+        atomic_init(&(fleet->workers[w].range), 0);
+    }
+    for (w = 1; w < fleet->numWorkers; w++) {
+        pthread_create(&(fleet->workers[w].thread), NULL, fleetThread, &(fleet->workers[w]));
+    }
+}
+
+void evaluateFleet(Fleet * fleet, size_t numRobots, RobotState * robots, double * resistances) {
+    size_t numChunks = (numRobots + FLEET_CHUNK_SIZE - 1) / FLEET_CHUNK_SIZE;
+    fleet->robots = robots;
+    fleet->resistances = resistances;
+    fleet->numRobots = numRobots;
+    // Give every worker an equal share of consecutive chunks
+    size_t w = 0;
+    for (w = 0; w < fleet->numWorkers; w++) {
+        uint64_t begin = numChunks * w / fleet->numWorkers;
+        uint64_t end = numChunks * (w + 1) / fleet->numWorkers;
+        atomic_store(&(fleet->workers[w].range), (begin << 32) | end);
+    }
+
+    pthread_mutex_lock(&(fleet->lock));
+    fleet->numBusy = fleet->numWorkers - 1;
+    fleet->generation++;
+    pthread_cond_broadcast(&(fleet->start));
+    pthread_mutex_unlock(&(fleet->lock));
+
+    runFleetWorker(fleet, 0);
+
+    pthread_mutex_lock(&(fleet->lock));
+    while (fleet->numBusy > 0) {
+        pthread_cond_wait(&(fleet->done), &(fleet->lock));
+    }
+    pthread_mutex_unlock(&(fleet->lock));
+}
+
+void fleetGetStats(Fleet * fleet, GuideStats * snapshot) {
+    memset(snapshot, 0, sizeof(GuideStats));
+    size_t w = 0;
+    for (w = 0; w < fleet->numWorkers; w++) {
+        mergeStats(snapshot, &(fleet->workers[w].search.stats));
+    }
+}
+
+void fleetResetStats(Fleet * fleet) {
+    size_t w = 0;
+    for (w = 0; w < fleet->numWorkers; w++) {
+        memset(&(fleet->workers[w].search.stats), 0, sizeof(GuideStats));
+    }
+}
+
+void freeFleet(Fleet * fleet) {
+    pthread_mutex_lock(&(fleet->lock));
+    fleet->stop = 1;
+    pthread_cond_broadcast(&(fleet->start));
+    pthread_mutex_unlock(&(fleet->lock));
+    size_t w = 0;
+    for (w = 0; w < fleet->numWorkers; w++) {
+        if (w > 0) {
+            pthread_join(fleet->workers[w].thread, NULL);
+        }
+        freeBorderSearch(&(fleet->workers[w].search));
+    }
+    free(fleet->workers);
+    pthread_mutex_destroy(&(fleet->lock));
+    pthread_cond_destroy(&(fleet->start));
+    pthread_cond_destroy(&(fleet->done));
+    memset(fleet, 0, sizeof(Fleet));
+}
+
+#endif
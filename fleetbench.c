@@ -0,0 +1,120 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fleet.h"
+
+// Number of robots in the simulated fleet
+#define NUM_ROBOTS 4000
+// Number of short border lines in the dense area of the map
+#define NUM_DENSE_BORDERS 2000
+// Number of fleet evaluations measured per number of threads
+#define NUM_ROUNDS 20
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int compareDoubles(const void * a, const void * b) {
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+int main() {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    guideInitializeBorders(&guide);
+    srand(1);
+    // Clutter the left part of the map, so that robots there are more expensive than robots in open space
+    int i = 0;
+    for (i = 0; i < NUM_DENSE_BORDERS; i++) {
+        double x = randomBetween(-4, -2);
+        double y = randomBetween(-6, 6);
+        guideAddBorder(&guide, x, y, x + randomBetween(-0.05, 0.05), y + randomBetween(-0.05, 0.05), RIGHT);
+    }
+
+    RobotState * robots = (RobotState *) malloc(NUM_ROBOTS * sizeof(RobotState));
+    double * obstacles = (double *) malloc(2 * NUM_ROBOTS * sizeof(double));
+    double * expected = (double *) malloc(NUM_ROBOTS * sizeof(double));
+    double * resistances = (double *) malloc(NUM_ROBOTS * sizeof(double));
+    for (i = 0; i < NUM_ROBOTS; i++) {
+        robots[i].x = randomBetween(-4, 4);
+        robots[i].y = randomBetween(-6, 6);
+        robots[i].phi = randomBetween(-PI, PI);
+        robots[i].forceX = randomBetween(-10, 10);
+        robots[i].forceY = randomBetween(-10, 10);
+        obstacles[2 * i] = randomBetween(-4, 4);
+        obstacles[2 * i + 1] = randomBetween(-6, 6);
+        robots[i].numObstacles = 1;
+        robots[i].obstacles = &obstacles[2 * i];
+        expected[i] = guideGetResistance(&guide, robots[i].x, robots[i].y, robots[i].phi, robots[i].forceX, robots[i].forceY, 1, robots[i].obstacles);
+    }
+
+    printf("%zu border lines, %d robots, %zu cores\n", guide.borderlines.size, NUM_ROBOTS, getNumCores());
+    printf("threads\trobots/s\tspeedup\tp50 ms\tp99 ms\tmax ms\n");
+    double baseline = 0;
+    size_t numThreads = 1;
+    for (numThreads = 1; numThreads <= getNumCores(); numThreads++) {
+        Fleet fleet;
+        createFleet(&fleet, &guide, numThreads);
+        evaluateFleet(&fleet, NUM_ROBOTS, robots, resistances);
+        if (memcmp(expected, resistances, NUM_ROBOTS * sizeof(double)) != 0) {
+            printf("Fleet results differ from guideGetResistance()\n");
+            return 1;
+        }
+        double latencies[NUM_ROUNDS];
+        double total = 0;
+        int round = 0;
+        for (round = 0; round < NUM_ROUNDS; round++) {
+            double start = now();
+            evaluateFleet(&fleet, NUM_ROBOTS, robots, resistances);
+            latencies[round] = now() - start;
+            total += latencies[round];
+        }
+        freeFleet(&fleet);
+        qsort(latencies, NUM_ROUNDS, sizeof(double), compareDoubles);
+        double throughput = NUM_ROUNDS * NUM_ROBOTS / total;
+        if (numThreads == 1) {
+            baseline = throughput;
+        }
+        printf("%zu\t%.0f\t%.2f\t%.3f\t%.3f\t%.3f\n", numThreads, throughput, throughput / baseline,
+            latencies[NUM_ROUNDS / 2] * 1e3, latencies[(NUM_ROUNDS * 99) / 100] * 1e3, latencies[NUM_ROUNDS - 1] * 1e3);
+    }
+
+    free(robots);
+    free(obstacles);
+    free(expected);
+    free(resistances);
+    freeBlindGuide(&guide);
+    return 0;
+}
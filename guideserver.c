@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "mapfile.h"
+#include "service.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+/*
+ * Fills the map of the given new guide from the map file or text map at path, or from borderCoordinates when path is NULL.
+ * Returns 1 on success, 0 otherwise.
+ */
+int loadVenue(BlindGuide * guide, const char * path) {
+    if (path == NULL) {
+        return guideInitializeBorders(guide);
+    }
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(path + length - 4, ".map") == 0) {
+        if (!guideLoadMap(guide, path)) {
+            printf("Cannot load the map file %s\n", path);
+            return 0;
+        }
+        return 1;
+    }
+    unsigned long errorLine = 0;
+    if (guideImportTextMap(guide, path, &errorLine) < 0) {
+        if (errorLine == 0) {
+            printf("Cannot open %s, or not enough memory\n", path);
+        } else {
+            printf("%s:%lu: expected \"bottomX bottomY topX topY [LEFT|RIGHT]\" with coordinates within %g\n", path, errorLine, MAX_COORDINATE);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Loads the map at path again, and publishes it to the clients of the service as one update.
+ */
+void reloadVenue(MapSnapshots * snapshots, const char * path) {
+    BlindGuide venue;
+    createBlindGuide(&venue);
+    if (loadVenue(&venue, path)) {
+        BlindGuide * next = beginMapUpdate(snapshots);
+        if (next == NULL) {
+            printf("Not enough memory to reload the map\n");
+        } else if (!guideCopyMap(next, &venue)) {
+            printf("Not enough memory to reload the map\n");
+            cancelMapUpdate(snapshots);
+        } else {
+            publishMapUpdate(snapshots);
+            printf("Reloaded %zu borders\n", venue.borderlines.size);
+        }
+    }
+    freeBlindGuide(&venue);
+}
+
+int main(int argc, char ** argv) {
+    const char * name = SERVICE_DEFAULT_NAME;
+    unsigned int numThreads = 1;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--name") == 0 && arg + 1 < argc) {
+            name = argv[++arg];
+        } else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+            numThreads = (unsigned int) atoi(argv[++arg]);
+        } else {
+            arg = argc + 1;
+        }
+    }
+    if (arg > argc || argc - arg > 1 || numThreads == 0 || numThreads > SERVICE_MAX_THREADS) {
+        printf("Usage: %s [--name name] [--threads 1-%d] [venue.txt | venue.map]\n", argv[0], SERVICE_MAX_THREADS);
+        printf("Serves the map (borderCoordinates by default) to the clients of %s until interrupted, SIGHUP reloads the map\n", SERVICE_DEFAULT_NAME);
+        return 1;
+    }
+    const char * path = arg < argc ? argv[arg] : NULL;
+
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    if (!loadVenue(&guide, path)) {
+        return 1;
+    }
+    MapSnapshots snapshots;
+    if (!createMapSnapshots(&snapshots, &guide)) {
+        printf("Not enough memory for the snapshots\n");
+        return 1;
+    }
+    size_t numBorders = guide.borderlines.size;
+    freeBlindGuide(&guide);
+
+    // Block the signals before the threads start, so that they are only received by sigwait() below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    static ResistanceService service;
+    if (!startResistanceService(&service, &snapshots, name, numThreads)) {
+        printf("Cannot create the shared memory %s\n", name);
+        freeMapSnapshots(&snapshots);
+        return 1;
+    }
+    printf("Serving %zu borders as %s with %u threads\n", numBorders, name, numThreads);
+    fflush(stdout);
+
+    int received = 0;
+    while (sigwait(&signals, &received) == 0 && received == SIGHUP) {
+        reloadVenue(&snapshots, path);
+        fflush(stdout);
+    }
+    unsigned long numServed = atomic_load(&(service.region->numServed));
+    stopResistanceService(&service);
+    printf("Served %lu requests\n", numServed);
+    freeMapSnapshots(&snapshots);
+    return 0;
+}
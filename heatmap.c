@@ -0,0 +1,144 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mapfile.h"
+#include "heatmap.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Renders the resistance over the whole map for one or more headings and forces (see heatmap.h),
+ * and writes an 8-bit raw image (and optionally a CSV file) per frame.
+ */
+int main(int argc, char ** argv) {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    size_t numThreads = 0;
+    size_t width = 1024;
+    size_t height = 1024;
+    size_t csvStep = 0;
+    double margin = 1;
+    int hasMap = 0;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (arg + 1 >= argc) {
+            arg = argc;
+            break;
+        }
+        if (strcmp(argv[arg], "--threads") == 0) {
+            numThreads = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--size") == 0) {
+            if (sscanf(argv[arg + 1], "%zux%zu", &width, &height) != 2) {
+                width = 0;
+            }
+        } else if (strcmp(argv[arg], "--margin") == 0) {
+            margin = atof(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--csv") == 0) {
+            csvStep = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--map") == 0) {
+            if (!guideLoadMap(&guide, argv[arg + 1])) {
+                printf("Cannot load the map file %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else if (strcmp(argv[arg], "--text") == 0) {
+            if (guideImportTextMap(&guide, argv[arg + 1], NULL) < 0) {
+                printf("Cannot import the text map %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else {
+            arg = argc;
+        }
+    }
+    size_t numFrames = argc - arg > 1 ? argc - arg - 1 : 0;
+    HeatmapFrame * frames = (HeatmapFrame *) malloc((numFrames > 0 ? numFrames : 1) * sizeof(HeatmapFrame));
+    size_t f = 0;
+    for (f = 0; f < numFrames; f++) {
+        HeatmapFrame * frame = &frames[f];
+        if (sscanf(argv[arg + 1 + f], "%lf,%lf,%lf", &(frame->phi), &(frame->forceX), &(frame->forceY)) != 3) {
+            numFrames = 0;
+        }
+    }
+    if (numFrames == 0 || width == 0 || height == 0) {
+        printf("Usage: %s [--threads n] [--map venue.map | --text venue.txt] [--size WIDTHxHEIGHT] [--margin m] [--csv step] prefix phi,forceX,forceY ...\n", argv[0]);
+        printf("Writes prefix_N.raw (8-bit grayscale, resistance 0 is black and 1 is white) for frame N, and prefix_N.csv with every step-th pixel when --csv is given.\n");
+        printf("The map defaults to borderCoordinates, the size to 1024x1024 pixels and the margin around the map to 1 meter\n");
+        return 1;
+    }
+    if (!hasMap) {
+        guideInitializeBorders(&guide);
+    }
+    HeatmapView view;
+    if (!fitHeatmapView(&guide, margin, width, height, &view)) {
+        printf("The map has no border lines\n");
+        return 1;
+    }
+    float * images = (float *) malloc(numFrames * width * height * sizeof(float));
+    if (images == NULL) {
+        printf("Cannot allocate %zu images of %zux%zu pixels\n", numFrames, width, height);
+        return 1;
+    }
+
+    double start = now();
+    renderHeatmap(&guide, &view, numFrames, frames, numThreads, images);
+    double seconds = now() - start;
+    fprintf(stderr, "Rendered %zu frames of %zux%zu pixels in %.3f s: %.0f pixels/s\n", numFrames, width, height, seconds, numFrames * (double) width * height / seconds);
+
+    printf("frame,phi,forceX,forceY,width,height,minX,minY,maxX,maxY,meanResistance,file\n");
+    char path[4096];
+    for (f = 0; f < numFrames; f++) {
+        float * image = images + f * width * height;
+        snprintf(path, sizeof(path), "%s_%zu.raw", argv[arg], f);
+        if (!writeHeatmapRaw(path, &view, image)) {
+            printf("Cannot write %s\n", path);
+            return 1;
+        }
+        double sum = 0;
+        size_t i = 0;
+        for (i = 0; i < width * height; i++) {
+            sum += image[i];
+        }
+        printf("%zu,%.17g,%.17g,%.17g,%zu,%zu,%.17g,%.17g,%.17g,%.17g,%.17g,%s\n", f, frames[f].phi, frames[f].forceX, frames[f].forceY,
+            width, height, view.minX, view.minY, view.maxX, view.maxY, sum / (width * height), path);
+        if (csvStep > 0) {
+            snprintf(path, sizeof(path), "%s_%zu.csv", argv[arg], f);
+            if (!writeHeatmapCSV(path, &view, image, csvStep)) {
+                printf("Cannot write %s\n", path);
+                return 1;
+            }
+        }
+    }
+    free(images);
+    free(frames);
+    freeBlindGuide(&guide);
+    return 0;
+}
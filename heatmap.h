@@ -0,0 +1,273 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "fleet.h"
+
+// Width and height in pixels of the square tiles that the workers of renderHeatmap() render at a time
+#define HEATMAP_TILE_SIZE 64
+
+/*
+ * The area of the field covered by a heatmap, and its size in pixels.
+ * Pixel (i, j) is the query at x = minX + (i + 0.5) * (maxX - minX) / width, y = maxY - (j + 0.5) * (maxY - minY) / height,
+ * so row 0 is the top (largest y) of the area, as in an image.
+ */
+typedef struct HeatmapView {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    size_t width;
+    size_t height;
+} HeatmapView;
+
+/*
+ * The heading and force of the robot at every pixel of a heatmap, see getResistance() for the meaning of the fields.
+ */
+typedef struct HeatmapFrame {
+    double phi;
+    double forceX;
+    double forceY;
+} HeatmapFrame;
+
+/*
+ * A worker of renderHeatmap().
+ * search: scratch space for searching the border grid of the guide
+ * poses, forces, resistances: the queries of a row of a tile (see guideGetResistanceBatch())
+ * thread: the thread running this worker (unused for worker 0, which is the calling thread)
+ * heatmap: the heatmap this worker belongs to
+ */
+typedef struct HeatmapWorker {
+    struct BorderSearch search;
+    double poses[3 * HEATMAP_TILE_SIZE];
+    double forces[2 * HEATMAP_TILE_SIZE];
+    double resistances[HEATMAP_TILE_SIZE];
+    pthread_t thread;
+    struct Heatmap * heatmap;
+} HeatmapWorker;
+
+/*
+ * State of renderHeatmap(), shared by its workers.
+ * guide: the guide with the map (it is not modified while rendering)
+ * view, frames, numFrames: what to render
+ * tilesX, tilesY: number of tiles per row and per column of an image
+ * numItems: number of tiles of all frames
+ * nextItem: the next tile to render, tile t is tile t % (tilesX * tilesY) of frame t / (tilesX * tilesY)
+ * images: the images of all frames
+ */
+typedef struct Heatmap {
+    BlindGuide * guide;
+    HeatmapView * view;
+    HeatmapFrame * frames;
+    size_t numFrames;
+    size_t tilesX;
+    size_t tilesY;
+    size_t numItems;
+    _Atomic size_t nextItem;
+    float * images;
+} Heatmap;
+
+/*
+ * Sets view to the area covered by the border lines of guide plus margin meters on every side, rendered at width by height pixels.
+ * The area is widened in one direction such that pixels are square. Returns 0 when the guide has no (enabled) border lines.
+ */
+int fitHeatmapView(BlindGuide * guide, double margin, size_t width, size_t height, HeatmapView * view);
+
+/*
+ * Computes the resistance at every pixel of view for each of the numFrames frames, on numWorkers threads (including the calling thread, 0 to use all cores).
+ * The resistance of pixel (i, j) of frame f is stored in images[(f * view->height + j) * view->width + i], without obstacles.
+ * The images are divided in tiles of HEATMAP_TILE_SIZE pixels square that the workers take in turn, and every row of a tile is evaluated
+ * as a single batch (see guideGetResistanceBatch()), so neighbouring pixels share the border lines they load.
+ * Gives the same results as calling guideGetResistance() for every pixel.
+ */
+void renderHeatmap(BlindGuide * guide, HeatmapView * view, size_t numFrames, HeatmapFrame * frames, size_t numWorkers, float * images);
+
+/*
+ * Writes image as a raw 8-bit grayscale image (view->width by view->height bytes, row by row from the top, without header),
+ * where a resistance of 0 becomes 0 (black) and a resistance of 1 or more becomes 255 (white).
+ * Returns 1 on success, or 0 when the file cannot be written.
+ */
+int writeHeatmapRaw(const char * path, HeatmapView * view, float * image);
+
+/*
+ * Writes every step-th pixel of every step-th row of image as CSV, with a line "x,y,resistance" per pixel.
+ * Returns 1 on success, or 0 when the file cannot be written.
+ */
+int writeHeatmapCSV(const char * path, HeatmapView * view, float * image, size_t step);
+
+
+int fitHeatmapView(BlindGuide * guide, double margin, size_t width, size_t height, HeatmapView * view) {
+    BorderlineSoA * soa = &(guide->soa);
+    double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+    size_t i = 0;
+    for (i = 0; i < soa->size; i++) {
+        minX = fmin(minX, fmin(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        maxX = fmax(maxX, fmax(soa->bottomX[i], soa->bottomX[i] + soa->dirX[i]));
+        minY = fmin(minY, fmin(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+        maxY = fmax(maxY, fmax(soa->bottomY[i], soa->bottomY[i] + soa->dirY[i]));
+    }
+    if (minX > maxX || width == 0 || height == 0) {
+        return 0;
+    }
+    minX -= margin;
+    maxX += margin;
+    minY -= margin;
+    maxY += margin;
+    // Widen the area around its center until a pixel is as wide as it is high
+    double pixel = fmax((maxX - minX) / width, (maxY - minY) / height);
+    double centerX = 0.5 * (minX + maxX);
+    double centerY = 0.5 * (minY + maxY);
+    view->minX = centerX - 0.5 * pixel * width;
+    view->maxX = centerX + 0.5 * pixel * width;
+    view->minY = centerY - 0.5 * pixel * height;
+    view->maxY = centerY + 0.5 * pixel * height;
+    view->width = width;
+    view->height = height;
+    return 1;
+}
+
+/*
+ * Renders tiles of the heatmap as worker, until all tiles have been handed out.
+ */
+static void runHeatmapWorker(Heatmap * heatmap, HeatmapWorker * worker) {
+    HeatmapView * view = heatmap->view;
+    double pixelWidth = (view->maxX - view->minX) / view->width;
+    double pixelHeight = (view->maxY - view->minY) / view->height;
+    size_t tilesPerFrame = heatmap->tilesX * heatmap->tilesY;
+    for (;;) {
+        size_t item = atomic_fetch_add(&(heatmap->nextItem), 1);
+        if (item >= heatmap->numItems) {
+            return;
+        }
+        HeatmapFrame * frame = &(heatmap->frames[item / tilesPerFrame]);
+        size_t tile = item % tilesPerFrame;
+        size_t left = tile % heatmap->tilesX * HEATMAP_TILE_SIZE;
+        size_t top = tile / heatmap->tilesX * HEATMAP_TILE_SIZE;
+        size_t tileWidth = view->width - left < HEATMAP_TILE_SIZE ? view->width - left : HEATMAP_TILE_SIZE;
+        size_t tileHeight = view->height - top < HEATMAP_TILE_SIZE ? view->height - top : HEATMAP_TILE_SIZE;
+        // The heading and force are the same for every pixel
+        size_t i = 0;
+        for (i = 0; i < tileWidth; i++) {
+            worker->poses[3 * i] = view->minX + (left + i + 0.5) * pixelWidth;
+            worker->poses[3 * i + 2] = frame->phi;
+            worker->forces[2 * i] = frame->forceX;
+            worker->forces[2 * i + 1] = frame->forceY;
+        }
+        size_t j = 0;
+        for (j = top; j < top + tileHeight; j++) {
+            double y = view->maxY - (j + 0.5) * pixelHeight;
+            for (i = 0; i < tileWidth; i++) {
+                worker->poses[3 * i + 1] = y;
+            }
+            guideGetResistanceBatchWith(heatmap->guide, &(worker->search), tileWidth, worker->poses, worker->forces, 0, NULL, worker->resistances);
+            float * row = heatmap->images + ((item / tilesPerFrame) * view->height + j) * view->width + left;
+            for (i = 0; i < tileWidth; i++) {
+                row[i] = (float) worker->resistances[i];
+            }
+        }
+    }
+}
+
+/*
+ * Main function of the worker threads of renderHeatmap().
+ */
+static void * heatmapThread(void * arg) {
+    HeatmapWorker * worker = (HeatmapWorker *) arg;
+    runHeatmapWorker(worker->heatmap, worker);
+    return NULL;
+}
+
+void renderHeatmap(BlindGuide * guide, HeatmapView * view, size_t numFrames, HeatmapFrame * frames, size_t numWorkers, float * images) {
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    Heatmap heatmap;
+    memset(&heatmap, 0, sizeof(Heatmap));
+    heatmap.guide = guide;
+    heatmap.view = view;
+    heatmap.frames = frames;
+    heatmap.numFrames = numFrames;
+    heatmap.tilesX = (view->width + HEATMAP_TILE_SIZE - 1) / HEATMAP_TILE_SIZE;
+    heatmap.tilesY = (view->height + HEATMAP_TILE_SIZE - 1) / HEATMAP_TILE_SIZE;
+    heatmap.numItems = numFrames * heatmap.tilesX * heatmap.tilesY;
+    heatmap.images = images;
+    atomic_init(&(heatmap.nextItem), 0);
+
+    numWorkers = numWorkers > 0 ? numWorkers : getNumCores();
+    HeatmapWorker * workers = (HeatmapWorker *) calloc(numWorkers, sizeof(HeatmapWorker));
+    size_t w = 0;
+    for (w = 0; w < numWorkers; w++) {
+        workers[w].heatmap = &heatmap;
+    }
+    for (w = 1; w < numWorkers; w++) {
+        pthread_create(&(workers[w].thread), NULL, heatmapThread, &(workers[w]));
+    }
+    runHeatmapWorker(&heatmap, &(workers[0]));
+    for (w = 0; w < numWorkers; w++) {
+        if (w > 0) {
+            pthread_join(workers[w].thread, NULL);
+        }
+        freeBorderSearch(&(workers[w].search));
+    }
+    free(workers);
+}
+
+int writeHeatmapRaw(const char * path, HeatmapView * view, float * image) {
+    FILE * file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    unsigned char * row = (unsigned char *) malloc(view->width > 0 ? view->width : 1);
+    int written = 1;
+    size_t j = 0;
+    for (j = 0; j < view->height && written; j++) {
+        size_t i = 0;
+        for (i = 0; i < view->width; i++) {
+            float r = image[j * view->width + i];
+            row[i] = (unsigned char) (r >= 1 ? 255 : (r > 0 ? r * 255 + 0.5f : 0));
+        }
+        written = fwrite(row, 1, view->width, file) == view->width;
+    }
+    free(row);
+    return fclose(file) == 0 && written;
+}
+
+int writeHeatmapCSV(const char * path, HeatmapView * view, float * image, size_t step) {
+    FILE * file = fopen(path, "w");
+    if (file == NULL) {
+        return 0;
+    }
+    step = step > 0 ? step : 1;
+    double pixelWidth = (view->maxX - view->minX) / view->width;
+    double pixelHeight = (view->maxY - view->minY) / view->height;
+    int written = fprintf(file, "x,y,resistance\n") > 0;
+    size_t j = 0;
+    for (j = 0; j < view->height && written; j += step) {
+        size_t i = 0;
+        for (i = 0; i < view->width && written; i += step) {
+            written = fprintf(file, "%.9g,%.9g,%.9g\n", view->minX + (i + 0.5) * pixelWidth, view->maxY - (j + 0.5) * pixelHeight, image[j * view->width + i]) > 0;
+        }
+    }
+    return fclose(file) == 0 && written;
+}
+
+#endif
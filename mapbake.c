@@ -0,0 +1,84 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "mapfile.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+/*
+ * Bakes a text map (see guideImportTextMap()), a map file (see guideLoadMap()) or the compiled-in borderCoordinates
+ * into a C header that defines it as static const tables (see bakedmap.h).
+ */
+int main(int argc, char ** argv) {
+    int withIndex = 1;
+    const char * name = "bakedMap";
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--no-index") == 0) {
+            withIndex = 0;
+        } else if (strcmp(argv[arg], "--name") == 0 && arg + 1 < argc) {
+            name = argv[++arg];
+        } else {
+            arg = argc;
+        }
+    }
+    if (argc - arg != 1 && argc - arg != 2) {
+        printf("Usage: %s [--no-index] [--name name] [venue.txt | venue.map] venue.h\n", argv[0]);
+        printf("The map defaults to borderCoordinates, the name of the baked map to bakedMap\n");
+        return 1;
+    }
+    const char * output = argv[argc - 1];
+
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    if (argc - arg == 1) {
+        guideInitializeBorders(&guide);
+    } else {
+        const char * input = argv[arg];
+        size_t length = strlen(input);
+        if (length > 4 && strcmp(input + length - 4, ".map") == 0) {
+            if (!guideLoadMap(&guide, input)) {
+                printf("Cannot load the map file %s\n", input);
+                return 1;
+            }
+        } else {
+            unsigned long errorLine = 0;
+            if (guideImportTextMap(&guide, input, &errorLine) < 0) {
+                if (errorLine == 0) {
+                    printf("Cannot open %s, or not enough memory\n", input);
+                } else {
+                    printf("%s:%lu: expected \"bottomX bottomY topX topY [LEFT|RIGHT]\" with coordinates within %g\n", input, errorLine, MAX_COORDINATE);
+                }
+                return 1;
+            }
+        }
+    }
+    if (!guideBakeMap(&guide, output, name, withIndex)) {
+        printf("Cannot write %s (the name must be a C identifier)\n", output);
+        return 1;
+    }
+    printf("Baked %zu borders (%zu chains) into %s as %s (%s grid)\n", guide.borderlines.size, guide.chains.size, output, name, withIndex ? "with" : "without");
+    freeBlindGuide(&guide);
+    return 0;
+}
@@ -0,0 +1,689 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include "blindguide.h"
+#include "bakedmap.h"
+
+// Map files are memory-mapped where possible, and read into memory otherwise
+#if defined(__unix__) || defined(__APPLE__)
+    #define MAP_FILE_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #define MAP_FILE_MMAP 0
+#endif
+
+// First bytes of every map file
+#define MAP_FILE_MAGIC "BGMAP\r\n"
+// Version of the map file format
+#define MAP_FILE_VERSION 4
+// Alignment of the sections of a map file in bytes
+#define MAP_FILE_ALIGNMENT 64
+
+/*
+ * Header at the start of a map file.
+ * The sections of the file are stored at the given offsets (in bytes from the start of the file), in the native layout of the platform that wrote it,
+ * such that they can be used in place:
+ * ends: the BorderEnds of numBorderlines border lines
+ * states: numBorderlines borderStates (one byte each)
+ * soa: the seven arrays of a BorderlineSoA (bottomX, bottomY, dirX, dirY, invLength2, normalX, normalY) of numBorderlines BorderReals each
+ * bucketStart, entries: the BorderGrid (only when numBuckets is not 0), where bucket b holds entries[bucketStart[b]] up to (but excluding) entries[bucketStart[b + 1]]
+ * chains: numChains BorderChain structures
+ * vertices: the numVertices Coordinates of the border lines, shared by the border lines of a chain (see BorderlineArray)
+ * endsSize, chainSize, realSize and gridCellSize are used to check that the file matches the platform, the precision (see FLOAT32) and the GRID_CELL_SIZE of the reader.
+ */
+typedef struct MapFileHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int endsSize;
+    unsigned int realSize;
+    unsigned int chainSize;
+    unsigned long long numBorderlines;
+    unsigned long long numBuckets;
+    unsigned long long numEntries;
+    double gridCellSize;
+    unsigned long long endsOffset;
+    unsigned long long statesOffset;
+    unsigned long long soaOffset;
+    unsigned long long bucketStartOffset;
+    unsigned long long entriesOffset;
+    unsigned long long numChains;
+    unsigned long long numVertices;
+    unsigned long long chainsOffset;
+    unsigned long long verticesOffset;
+    unsigned long long fileSize;
+} MapFileHeader;
+
+/*
+ * Replaces the map of the given guide by the map in the map file at path.
+ * The file is memory-mapped and used in place, so loading does not depend on the number of border lines
+ * (when the file contains an index; otherwise the grid is built while loading).
+ * The map is copied into memory of the guide only when borders are added later on.
+ * Marks the borderlines array of the guide with the current borderMapVersion.
+ * Returns 1 on success, or 0 when the file cannot be read or is not a valid map file for this platform (the guide is then unchanged)
+ * or when the memory is exhausted (the guide is then unchanged, or without a map when the file has no index and the grid did not fit).
+ */
+int guideLoadMap(BlindGuide * guide, const char * path);
+
+/*
+ * Loads the map file at path into the default guide (see guideLoadMap()).
+ */
+int loadMap(const char * path);
+
+/*
+ * Writes the map of the given guide to a map file at path. Removed borders are left out, disabled borders stay disabled.
+ * Chains that lost a border are stored as loose borders.
+ * When withIndex is 1, the grid is stored as well, such that guideLoadMap() does not need to build it.
+ * Returns 1 on success, 0 when the file cannot be written or the memory is exhausted.
+ */
+int guideSaveMap(BlindGuide * guide, const char * path, int withIndex);
+
+/*
+ * Writes the map of the given guide to a C header at path, which defines it as the baked map name (see bakedmap.h):
+ * static const tables of the border lines, their structure of arrays mirror, the chains with their bounding boxes,
+ * and when withIndex is 1 the grid, all computed now, such that including the header and calling guideLoadBakedMap() builds nothing.
+ * All numbers are written exactly, so the baked map gives the same results as the map of the guide (also with FLOAT32).
+ * Removed borders are left out, disabled borders stay disabled, chains that lost a border are stored as loose borders.
+ * The header also defines BAKED_MAP as name, unless BAKED_MAP is defined already.
+ * Returns 1 on success, 0 when name is not a C identifier or the file cannot be written.
+ */
+int guideBakeMap(BlindGuide * guide, const char * path, const char * name, int withIndex);
+
+/*
+ * Adds the borders in the text map at path to the map of the given guide.
+ * Every line holds a border as "bottomX bottomY topX topY goodSide", where goodSide is LEFT or RIGHT (RIGHT when omitted).
+ * Numbers may be separated by spaces or commas, and everything after # or // is ignored.
+ * Consecutive lines that connect are added as chains (see guideAddBorders()).
+ * Lines with a coordinate that is not finite or beyond MAX_COORDINATE are errors.
+ * Returns the number of borders added, or -1 on error, in which case errorLine (if not NULL) is set to the line with the error
+ * (0 when the file cannot be opened or the memory is exhausted, in which case no or only some borders have been added).
+ */
+long guideImportTextMap(BlindGuide * guide, const char * path, unsigned long * errorLine);
+
+
+/*
+ * Returns 1 when the chains of a map file with the given ends of n border lines and numVertices vertices are valid, 0 otherwise:
+ * sorted by their border lines, without overlapping, with their vertices within the vertices of the file,
+ * and with border lines that run along their vertices.
+ */
+static int validMapFileChains(BorderChain * chains, unsigned long long numChains, BorderEnds * ends, unsigned long long numVertices, unsigned long long n) {
+    unsigned long long end = 0;
+    unsigned long long i = 0;
+    for (i = 0; i < numChains; i++) {
+        BorderChain * chain = &(chains[i]);
+        if (chain->numVertices < 2 || (chain->numBorders != chain->numVertices && chain->numBorders != chain->numVertices - 1)
+                || chain->firstBorder < end || (unsigned long long) chain->firstBorder + chain->numBorders > n
+                || chain->firstVertex > numVertices || chain->numVertices > numVertices - chain->firstVertex) {
+            return 0;
+        }
+        unsigned int k = 0;
+        for (k = 0; k < chain->numBorders; k++) {
+            BorderEnds * e = &(ends[chain->firstBorder + k]);
+            if (e->bottom != chain->firstVertex + k || e->top != chain->firstVertex + (k + 1) % chain->numVertices || e->goodSide != chain->goodSide) {
+                return 0;
+            }
+        }
+        end = (unsigned long long) chain->firstBorder + chain->numBorders;
+    }
+    return 1;
+}
+
+/*
+ * Returns 1 when the given ends of the n border lines of a map file refer to its numVertices vertices, their states are borderStates,
+ * and every vertex has valid coordinates (see validBorderCoordinates()), 0 otherwise.
+ */
+static int validMapFileBorderlines(BorderEnds * ends, unsigned char * states, unsigned long long n, Coordinate * vertices, unsigned long long numVertices) {
+    unsigned long long i = 0;
+    for (i = 0; i < n; i++) {
+        if (ends[i].bottom >= numVertices || ends[i].top >= numVertices || (ends[i].goodSide != LEFT && ends[i].goodSide != RIGHT)
+            || (states[i] != BORDER_ENABLED && states[i] != BORDER_DISABLED && states[i] != BORDER_REMOVED)) {
+            return 0;
+        }
+    }
+    for (i = 0; i < numVertices; i++) {
+        if (!validBorderCoordinates(vertices[i].x, vertices[i].y, vertices[i].x, vertices[i].y)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Releases a memory-mapped map file.
+ */
+static void releaseMapFile(void * mapping, size_t size) {
+    #if MAP_FILE_MMAP
+        munmap(mapping, size);
+    #else
+        (void) size;
+        free(mapping);
+    #endif
+}
+
+/*
+ * Rounds offset up to a multiple of MAP_FILE_ALIGNMENT.
+ */
+static unsigned long long alignMapFileOffset(unsigned long long offset) {
+    return (offset + MAP_FILE_ALIGNMENT - 1) / MAP_FILE_ALIGNMENT * MAP_FILE_ALIGNMENT;
+}
+
+/*
+ * Returns 1 when the section of size bytes at offset lies within a file of fileSize bytes and is aligned, 0 otherwise.
+ */
+static int validMapFileSection(unsigned long long offset, unsigned long long size, unsigned long long fileSize) {
+    return offset % MAP_FILE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+int guideLoadMap(BlindGuide * guide, const char * path) {
+    void * mapping = NULL;
+    size_t size = 0;
+    #if MAP_FILE_MMAP
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return 0;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(MapFileHeader)) {
+            close(fd);
+            return 0;
+        }
+        size = (size_t) st.st_size;
+        // A private writable mapping, such that borders can be removed, enabled and disabled in place without changing the file
+        mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return 0;
+        }
+    #else
+        FILE * file = fopen(path, "rb");
+        if (file == NULL) {
+            return 0;
+        }
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length < (long) sizeof(MapFileHeader)) {
+            fclose(file);
+            return 0;
+        }
+        size = (size_t) length;
+        mapping = malloc(size);
+        if (mapping == NULL || fread(mapping, 1, size, file) != size) {
+            free(mapping);
+            fclose(file);
+            return 0;
+        }
+        fclose(file);
+    #endif
+
+    // Check that the file is a complete map file for this platform
+    MapFileHeader * header = (MapFileHeader *) mapping;
+    unsigned long long n = header->numBorderlines;
+    int valid = memcmp(header->magic, MAP_FILE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == MAP_FILE_VERSION
+        && header->endsSize == sizeof(struct BorderEnds)
+        && header->realSize == sizeof(BorderReal)
+        && header->chainSize == sizeof(struct BorderChain)
+        && header->fileSize == size
+        && n < 0xFFFFFFFFULL
+        && validMapFileSection(header->endsOffset, n * sizeof(struct BorderEnds), size)
+        && validMapFileSection(header->statesOffset, n, size)
+        && validMapFileSection(header->soaOffset, 7 * n * sizeof(BorderReal), size)
+        && header->numChains <= n && header->numVertices <= 2 * n
+        && validMapFileSection(header->chainsOffset, header->numChains * sizeof(struct BorderChain), size)
+        && validMapFileSection(header->verticesOffset, header->numVertices * sizeof(struct Coordinate), size);
+    BorderEnds * ends = (BorderEnds *) ((char *) mapping + header->endsOffset);
+    unsigned char * states = (unsigned char *) mapping + header->statesOffset;
+    valid = valid && validMapFileBorderlines(ends, states, n, (Coordinate *) ((char *) mapping + header->verticesOffset), header->numVertices);
+    valid = valid && validMapFileChains((BorderChain *) ((char *) mapping + header->chainsOffset), header->numChains, ends, header->numVertices, n);
+    int hasIndex = valid && header->numBuckets > 0 && header->gridCellSize == GRID_CELL_SIZE;
+    if (hasIndex) {
+        // The index must be a valid power of two number of buckets holding valid border lines, or it is ignored
+        hasIndex = (header->numBuckets & (header->numBuckets - 1)) == 0
+            && header->numBuckets < 0xFFFFFFFFULL && header->numEntries < 0xFFFFFFFFULL
+            && validMapFileSection(header->bucketStartOffset, (header->numBuckets + 1) * sizeof(unsigned int), size)
+            && validMapFileSection(header->entriesOffset, header->numEntries * sizeof(unsigned int), size);
+        unsigned int * bucketStart = (unsigned int *) ((char *) mapping + header->bucketStartOffset);
+        unsigned int * entries = (unsigned int *) ((char *) mapping + header->entriesOffset);
+        unsigned long long i = 0;
+        for (i = 0; hasIndex && i < header->numBuckets; i++) {
+            hasIndex = bucketStart[i] <= bucketStart[i + 1];
+        }
+        hasIndex = hasIndex && bucketStart[0] == 0 && bucketStart[header->numBuckets] == header->numEntries;
+        for (i = 0; hasIndex && i < header->numEntries; i++) {
+            hasIndex = entries[i] < n;
+        }
+    }
+    if (!valid) {
+        releaseMapFile(mapping, size);
+        return 0;
+    }
+
+    MapSections sections;
+    sections.numBorderlines = n;
+    sections.ends = ends;
+    sections.states = states;
+    sections.soa = (BorderReal *) ((char *) mapping + header->soaOffset);
+    sections.numBuckets = hasIndex ? header->numBuckets : 0;
+    sections.numEntries = hasIndex ? header->numEntries : 0;
+    sections.bucketStart = (unsigned int *) ((char *) mapping + header->bucketStartOffset);
+    sections.entries = (unsigned int *) ((char *) mapping + header->entriesOffset);
+    sections.numChains = header->numChains;
+    sections.chains = (struct BorderChain *) ((char *) mapping + header->chainsOffset);
+    sections.numVertices = header->numVertices;
+    sections.vertices = (struct Coordinate *) ((char *) mapping + header->verticesOffset);
+    return guideUseMapSections(guide, &sections, mapping, size, releaseMapFile, 0);
+}
+
+int loadMap(const char * path) {
+    return guideLoadMap(&defaultGuide, path);
+}
+
+/*
+ * Writes size bytes of data to file at offset, padding the file with zeros up to offset. Returns 1 on success.
+ */
+static int writeMapFileSection(FILE * file, unsigned long long offset, const void * data, size_t size) {
+    static const char zeros[MAP_FILE_ALIGNMENT] = {0};
+    long position = ftell(file);
+    if (position < 0 || (unsigned long long) position > offset || offset - position > MAP_FILE_ALIGNMENT) {
+        return 0;
+    }
+    return fwrite(zeros, 1, offset - position, file) == offset - position && (size == 0 || fwrite(data, 1, size, file) == size);
+}
+
+/*
+ * Returns the number of removed borders of ba, including those whose slots are not reused because they belong to a chain.
+ */
+static size_t countRemovedBorders(BorderlineArray * ba) {
+    size_t numRemoved = 0;
+    size_t i = 0;
+    for (i = 0; i < ba->size; i++) {
+        numRemoved += ba->states[i] == BORDER_REMOVED;
+    }
+    return numRemoved;
+}
+
+/*
+ * Returns the map of guide without its removed borders: guide itself when it has none,
+ * and otherwise compact, which is then created with a copy of the other borders in the same order (free it with freeBlindGuide()).
+ * Chains that lost a border are copied as loose borders.
+ */
+static BlindGuide * compactGuideMap(BlindGuide * guide, BlindGuide * compact) {
+    if (guide->borderlines.numFree > 0 || countRemovedBorders(&(guide->borderlines)) > 0) {
+        // Leave out removed borders by copying the others into a new guide, keeping their order
+        createBlindGuide(compact);
+        BorderlineArray * from = &(guide->borderlines);
+        BorderChainArray * chains = &(guide->chains);
+        size_t chain = 0;
+        size_t i = 0;
+        while (i < from->size) {
+            if (chain < chains->size && chains->chains[chain].firstBorder == i) {
+                BorderChain * c = &(chains->chains[chain++]);
+                size_t k = 0;
+                int intact = 1;
+                for (k = 0; k < c->numBorders; k++) {
+                    intact = intact && from->states[i + k] != BORDER_REMOVED;
+                }
+                if (intact) {
+                    // Keep the chain, which gets the same border lines in the new guide
+                    long copy = guideAddBorderChain(compact, c->numVertices, (double *) (from->vertices + c->firstVertex), c->numBorders == c->numVertices, c->goodSide);
+                    for (k = 0; k < c->numBorders; k++) {
+                        if (from->states[i + k] == BORDER_DISABLED) {
+                            guideEnableBorder(compact, guideGetChainBorder(compact, (size_t) copy, k), 0);
+                        }
+                    }
+                    i += c->numBorders;
+                    continue;
+                }
+            }
+            if (from->states[i] != BORDER_REMOVED) {
+                Borderline b = getBorderline(from, (unsigned int) i);
+                BorderHandle handle = guideAddBorder(compact, b.bottom.x, b.bottom.y, b.top.x, b.top.y, b.goodSide);
+                if (from->states[i] == BORDER_DISABLED) {
+                    guideEnableBorder(compact, handle, 0);
+                }
+            }
+            i++;
+        }
+        return compact;
+    }
+    return guide;
+}
+
+int guideSaveMap(BlindGuide * guide, const char * path, int withIndex) {
+    BlindGuide compact;
+    BlindGuide * source = compactGuideMap(guide, &compact);
+    BorderlineArray * ba = &(source->borderlines);
+    BorderChainArray * chains = &(source->chains);
+    BorderlineSoA * soa = &(source->soa);
+    BorderGrid * grid = &(source->grid);
+    unsigned long long n = ba->size;
+
+    MapFileHeader header;
+    memset(&header, 0, sizeof(MapFileHeader));
+    memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = MAP_FILE_VERSION;
+    header.endsSize = sizeof(struct BorderEnds);
+    header.realSize = sizeof(BorderReal);
+    header.chainSize = sizeof(struct BorderChain);
+    header.numBorderlines = n;
+    header.numChains = chains->size;
+    header.numVertices = ba->numVertices;
+    header.gridCellSize = GRID_CELL_SIZE;
+    header.numBuckets = withIndex && n > 0 ? grid->numBuckets : 0;
+    header.numEntries = header.numBuckets > 0 ? grid->numEntries : 0;
+    header.endsOffset = alignMapFileOffset(sizeof(MapFileHeader));
+    header.statesOffset = alignMapFileOffset(header.endsOffset + n * sizeof(struct BorderEnds));
+    header.soaOffset = alignMapFileOffset(header.statesOffset + n);
+    header.bucketStartOffset = alignMapFileOffset(header.soaOffset + 7 * n * sizeof(BorderReal));
+    header.entriesOffset = alignMapFileOffset(header.bucketStartOffset + (header.numBuckets > 0 ? (header.numBuckets + 1) * sizeof(unsigned int) : 0));
+    header.chainsOffset = alignMapFileOffset(header.entriesOffset + header.numEntries * sizeof(unsigned int));
+    header.verticesOffset = alignMapFileOffset(header.chainsOffset + header.numChains * sizeof(struct BorderChain));
+    header.fileSize = header.verticesOffset + header.numVertices * sizeof(struct Coordinate);
+
+    FILE * file = fopen(path, "wb");
+    int ok = file != NULL;
+    ok = ok && writeMapFileSection(file, 0, &header, sizeof(MapFileHeader));
+    ok = ok && writeMapFileSection(file, header.endsOffset, ba->ends, n * sizeof(struct BorderEnds));
+    ok = ok && writeMapFileSection(file, header.statesOffset, ba->states, n);
+    BorderReal * arrays[7] = {soa->bottomX, soa->bottomY, soa->dirX, soa->dirY, soa->invLength2, soa->normalX, soa->normalY};
+    int a = 0;
+    for (a = 0; a < 7; a++) {
+        ok = ok && writeMapFileSection(file, header.soaOffset + a * n * sizeof(BorderReal), arrays[a], n * sizeof(BorderReal));
+    }
+    if (header.numBuckets > 0) {
+        // Store the buckets one after another, such that they can be used in place
+        unsigned int * bucketStart = (unsigned int *) malloc((header.numBuckets + 1) * sizeof(unsigned int));
+        ok = ok && bucketStart != NULL;
+        size_t b = 0;
+        if (ok) {
+            bucketStart[0] = 0;
+            for (b = 0; b < grid->numBuckets; b++) {
+                bucketStart[b + 1] = bucketStart[b] + grid->buckets[b].size;
+            }
+        }
+        ok = ok && writeMapFileSection(file, header.bucketStartOffset, bucketStart, (header.numBuckets + 1) * sizeof(unsigned int));
+        free(bucketStart);
+        ok = ok && writeMapFileSection(file, header.entriesOffset, NULL, 0);
+        for (b = 0; ok && b < grid->numBuckets; b++) {
+            size_t count = grid->buckets[b].size;
+            ok = count == 0 || fwrite(grid->buckets[b].indices, sizeof(unsigned int), count, file) == count;
+        }
+    } else {
+        ok = ok && writeMapFileSection(file, header.entriesOffset, NULL, 0);
+    }
+    ok = ok && writeMapFileSection(file, header.chainsOffset, chains->chains, header.numChains * sizeof(struct BorderChain));
+    ok = ok && writeMapFileSection(file, header.verticesOffset, ba->vertices, header.numVertices * sizeof(struct Coordinate));
+    if (file != NULL && fclose(file) != 0) {
+        ok = 0;
+    }
+    if (source == &compact) {
+        freeBlindGuide(&compact);
+    }
+    return ok;
+}
+
+/*
+ * Writes value to file as a C constant that has exactly this value (a hexadecimal floating point constant, NAN or INFINITY).
+ */
+static void writeBakedReal(FILE * file, double value) {
+    if (isnan(value)) {
+        fputs("NAN", file);
+    } else if (isinf(value)) {
+        fputs(value > 0 ? "INFINITY" : "-INFINITY", file);
+    } else {
+        fprintf(file, "%a", value);
+    }
+}
+
+/*
+ * Returns 1 when name is a C identifier, 0 otherwise.
+ */
+static int validBakedMapName(const char * name) {
+    if (name == NULL || !(isalpha((unsigned char) name[0]) || name[0] == '_')) {
+        return 0;
+    }
+    const char * c = name;
+    for (c = name; *c != '\0'; c++) {
+        if (!isalnum((unsigned char) *c) && *c != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int guideBakeMap(BlindGuide * guide, const char * path, const char * name, int withIndex) {
+    if (!validBakedMapName(name)) {
+        return 0;
+    }
+    FILE * file = fopen(path, "w");
+    if (file == NULL) {
+        return 0;
+    }
+    BlindGuide compact;
+    BlindGuide * source = compactGuideMap(guide, &compact);
+    BorderlineArray * ba = &(source->borderlines);
+    BorderChainArray * chains = &(source->chains);
+    BorderGrid * grid = &(source->grid);
+    size_t n = ba->size;
+    size_t numBuckets = withIndex && n > 0 ? grid->numBuckets : 0;
+    size_t numEntries = numBuckets > 0 ? grid->numEntries : 0;
+    double minX = 0, minY = 0, maxX = 0, maxY = 0;
+    size_t i = 0;
+    for (i = 0; i < n; i++) {
+        Borderline b = getBorderline(ba, (unsigned int) i);
+        minX = i == 0 ? fmin(b.bottom.x, b.top.x) : fmin(minX, fmin(b.bottom.x, b.top.x));
+        minY = i == 0 ? fmin(b.bottom.y, b.top.y) : fmin(minY, fmin(b.bottom.y, b.top.y));
+        maxX = i == 0 ? fmax(b.bottom.x, b.top.x) : fmax(maxX, fmax(b.bottom.x, b.top.x));
+        maxY = i == 0 ? fmax(b.bottom.y, b.top.y) : fmax(maxY, fmax(b.bottom.y, b.top.y));
+    }
+
+    fprintf(file, "/*\n * Baked map %s: %zu border lines, %zu chains, ", name, n, chains->size);
+    if (numBuckets > 0) {
+        fprintf(file, "grid of %zu buckets.\n", numBuckets);
+    } else {
+        fprintf(file, "without grid.\n");
+    }
+    fprintf(file, " * Written by guideBakeMap() (see mapfile.h and bakedmap.h), do not edit: bake the map again instead.\n */\n\n");
+    fprintf(file, "#ifndef BAKED_MAP_%s_H\n#define BAKED_MAP_%s_H\n\n#include \"bakedmap.h\"\n\n", name, name);
+    fprintf(file, "#if BAKED_MAP_FORMAT != %d\n#error \"%s was baked for another version of bakedmap.h, bake it again\"\n#endif\n\n", BAKED_MAP_FORMAT, name);
+
+    // All tables in one read-only object, which guides use in place (C has no empty arrays, so empty tables get one unused element)
+    fprintf(file, "static const struct {\n");
+    fprintf(file, "    BorderEnds ends[%zu];\n", n > 0 ? n : 1);
+    fprintf(file, "    unsigned char states[%zu];\n", n > 0 ? n : 1);
+    fprintf(file, "    BorderReal soa[%zu];\n", n > 0 ? 7 * n : 1);
+    fprintf(file, "    unsigned int bucketStart[%zu];\n", numBuckets + 1);
+    fprintf(file, "    unsigned int entries[%zu];\n", numEntries > 0 ? numEntries : 1);
+    fprintf(file, "    BorderChain chains[%zu];\n", chains->size > 0 ? chains->size : 1);
+    fprintf(file, "    Coordinate vertices[%zu];\n", ba->numVertices > 0 ? ba->numVertices : 1);
+    fprintf(file, "} %sTables = {\n    {\n", name);
+    for (i = 0; i < n; i++) {
+        fprintf(file, "        {%u, %u, %s},\n", ba->ends[i].bottom, ba->ends[i].top, ba->ends[i].goodSide == LEFT ? "LEFT" : "RIGHT");
+    }
+    if (n == 0) {
+        fputs("        {0, 0, RIGHT},\n", file);
+    }
+    fputs("    },\n    {", file);
+    for (i = 0; i < n; i++) {
+        fprintf(file, "%s%d,", i % 32 == 0 ? "\n        " : " ", ba->states[i]);
+    }
+    fputs(n == 0 ? "0},\n    {" : "\n    },\n    {", file);
+    // The mirror is computed in double precision like updateBorderlineSoA() does, and rounded to BorderReal by the compiler
+    int a = 0;
+    for (a = 0; a < 7; a++) {
+        for (i = 0; i < n; i++) {
+            double values[7];
+            Borderline b = getBorderline(ba, (unsigned int) i);
+            getBorderlineSoAValues(&b, ba->states[i] == BORDER_ENABLED, values);
+            fputs(i % 4 == 0 ? "\n        " : " ", file);
+            writeBakedReal(file, values[a]);
+            fputs(",", file);
+        }
+    }
+    fputs(n == 0 ? "0},\n    {0," : "\n    },\n    {\n        0,", file);
+    size_t b = 0;
+    unsigned int start = 0;
+    for (b = 0; b < numBuckets; b++) {
+        start += grid->buckets[b].size;
+        fprintf(file, "%s%u,", (b + 1) % 16 == 0 ? "\n        " : " ", start);
+    }
+    fputs(numBuckets == 0 ? "},\n    {" : "\n    },\n    {", file);
+    size_t count = 0;
+    for (b = 0; b < numBuckets; b++) {
+        size_t k = 0;
+        for (k = 0; k < grid->buckets[b].size; k++) {
+            fprintf(file, "%s%u,", count++ % 16 == 0 ? "\n        " : " ", grid->buckets[b].indices[k]);
+        }
+    }
+    fputs(numEntries == 0 ? "0},\n    {\n" : "\n    },\n    {\n", file);
+    for (i = 0; i < chains->size; i++) {
+        BorderChain * c = &(chains->chains[i]);
+        fprintf(file, "        {%zu, %u, %u, %u, %s, ", c->firstVertex, c->numVertices, c->firstBorder, c->numBorders, c->goodSide == LEFT ? "LEFT" : "RIGHT");
+        writeBakedReal(file, c->minX);
+        fputs(", ", file);
+        writeBakedReal(file, c->minY);
+        fputs(", ", file);
+        writeBakedReal(file, c->maxX);
+        fputs(", ", file);
+        writeBakedReal(file, c->maxY);
+        fputs("},\n", file);
+    }
+    if (chains->size == 0) {
+        fputs("        {0, 0, 0, 0, RIGHT, 0, 0, 0, 0},\n", file);
+    }
+    fputs("    },\n    {\n", file);
+    for (i = 0; i < ba->numVertices; i++) {
+        fputs("        {", file);
+        writeBakedReal(file, ba->vertices[i].x);
+        fputs(", ", file);
+        writeBakedReal(file, ba->vertices[i].y);
+        fputs("},\n", file);
+    }
+    if (ba->numVertices == 0) {
+        fputs("        {0, 0},\n", file);
+    }
+    fputs("    }\n};\n\n", file);
+
+    fprintf(file, "const BakedMap %s = {\n", name);
+    fprintf(file, "    {%zu, %sTables.ends, %sTables.states, %sTables.soa,\n", n, name, name, name);
+    fprintf(file, "     %zu, %zu, %sTables.bucketStart, %sTables.entries,\n", numBuckets, numEntries, name, name);
+    fprintf(file, "     %zu, %sTables.chains, %zu, %sTables.vertices},\n    ", chains->size, name, ba->numVertices, name);
+    double numbers[5] = {GRID_CELL_SIZE, minX, minY, maxX, maxY};
+    for (i = 0; i < 5; i++) {
+        writeBakedReal(file, numbers[i]);
+        fputs(i < 4 ? ", " : ",\n", file);
+    }
+    fprintf(file, "    &%sTables, sizeof(%sTables)\n};\n\n", name, name);
+    fprintf(file, "#ifndef BAKED_MAP\n#define BAKED_MAP %s\n#endif\n\n#endif\n", name);
+
+    int ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (source == &compact) {
+        freeBlindGuide(&compact);
+    }
+    return ok;
+}
+
+long guideImportTextMap(BlindGuide * guide, const char * path, unsigned long * errorLine) {
+    FILE * file = fopen(path, "r");
+    if (file == NULL) {
+        if (errorLine != NULL) {
+            *errorLine = 0;
+        }
+        return -1;
+    }
+    char line[1024];
+    unsigned long lineNumber = 0;
+    // Buffer the borders, such that connected borders can be added as chains
+    size_t numBorders = 0;
+    size_t capacity = 64;
+    double * coordinates = (double *) malloc(4 * capacity * sizeof(double));
+    enum side * goodSides = (enum side *) malloc(capacity * sizeof(enum side));
+    if (errorLine != NULL) {
+        *errorLine = 0;
+    }
+    int ok = coordinates != NULL && goodSides != NULL;
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        // Strip comments, and treat commas like spaces
+        char * c = line;
+        for (c = line; *c != '\0'; c++) {
+            if (*c == '#' || (c[0] == '/' && c[1] == '/')) {
+                *c = '\0';
+                break;
+            }
+            if (*c == ',') {
+                *c = ' ';
+            }
+        }
+        for (c = line; isspace((unsigned char) *c); c++);
+        if (*c == '\0') {
+            continue;
+        }
+        double bottomX, bottomY, topX, topY;
+        char side[16] = "RIGHT";
+        char rest[2];
+        int numFields = sscanf(line, "%lf %lf %lf %lf %15s %1s", &bottomX, &bottomY, &topX, &topY, side, rest);
+        // sscanf() also reads nan and inf, which guideAddBorders() would refuse without telling which line it was
+        if ((numFields != 4 && numFields != 5) || (strcmp(side, "LEFT") != 0 && strcmp(side, "RIGHT") != 0)
+            || !validBorderCoordinates(bottomX, bottomY, topX, topY)) {
+            if (errorLine != NULL) {
+                *errorLine = lineNumber;
+            }
+            ok = 0;
+            break;
+        }
+        if (numBorders >= capacity) {
+            // Keep the old buffers until both new ones exist, such that they are freed below either way
+            double * newCoordinates = (double *) realloc(coordinates, 8 * capacity * sizeof(double));
+            if (newCoordinates == NULL) {
+                ok = 0;
+                break;
+            }
+            coordinates = newCoordinates;
+            enum side * newGoodSides = (enum side *) realloc(goodSides, 2 * capacity * sizeof(enum side));
+            if (newGoodSides == NULL) {
+                ok = 0;
+                break;
+            }
+            goodSides = newGoodSides;
+            capacity *= 2;
+        }
+        double * border = &(coordinates[4 * numBorders]);
+        border[0] = bottomX;
+        border[1] = bottomY;
+        border[2] = topX;
+        border[3] = topY;
+        goodSides[numBorders++] = strcmp(side, "LEFT") == 0 ? LEFT : RIGHT;
+    }
+    fclose(file);
+    ok = ok && guideAddBorders(guide, numBorders, coordinates, goodSides);
+    free(coordinates);
+    free(goodSides);
+    return ok ? (long) numBorders : -1;
+}
+
+#endif
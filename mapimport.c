@@ -0,0 +1,98 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mapfile.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Converts a text map (see guideImportTextMap()) into a map file that can be loaded with guideLoadMap().
+ */
+int main(int argc, char ** argv) {
+    int withIndex = 1;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--no-index") == 0) {
+        withIndex = 0;
+        arg++;
+    }
+    if (argc - arg != 2) {
+        printf("Usage: %s [--no-index] input.txt output.map\n", argv[0]);
+        return 1;
+    }
+    const char * input = argv[arg];
+    const char * output = argv[arg + 1];
+
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    unsigned long errorLine = 0;
+    double start = now();
+    long numBorders = guideImportTextMap(&guide, input, &errorLine);
+    if (numBorders < 0) {
+        if (errorLine == 0) {
+            printf("Cannot open %s, or not enough memory\n", input);
+        } else {
+            printf("%s:%lu: expected \"bottomX bottomY topX topY [LEFT|RIGHT]\" with coordinates within %g\n", input, errorLine, MAX_COORDINATE);
+        }
+        return 1;
+    }
+    printf("Imported %ld borders (%zu chains) from %s in %.3f ms\n", numBorders, guide.chains.size, input, (now() - start) * 1e3);
+    if (!guideSaveMap(&guide, output, withIndex)) {
+        printf("Cannot write %s\n", output);
+        return 1;
+    }
+
+    // Check that the map file loads, and gives the same results as the imported map
+    BlindGuide loaded;
+    createBlindGuide(&loaded);
+    start = now();
+    if (!guideLoadMap(&loaded, output)) {
+        printf("Cannot load %s\n", output);
+        return 1;
+    }
+    printf("Wrote %s (%s index), loading it takes %.3f ms\n", output, withIndex ? "with" : "without", (now() - start) * 1e3);
+    srand(1);
+    int i = 0;
+    for (i = 0; i < 1000 && guide.borderlines.size > 0; i++) {
+        Borderline b = getBorderline(&(guide.borderlines), rand() % guide.borderlines.size);
+        double x = b.bottom.x + (rand() / (double) RAND_MAX - 0.5) * 4;
+        double y = b.bottom.y + (rand() / (double) RAND_MAX - 0.5) * 4;
+        double phi = (rand() / (double) RAND_MAX - 0.5) * 2 * PI;
+        double forceX = (rand() / (double) RAND_MAX - 0.5) * 20;
+        double forceY = (rand() / (double) RAND_MAX - 0.5) * 20;
+        if (guideGetResistance(&guide, x, y, phi, forceX, forceY, 0, NULL) != guideGetResistance(&loaded, x, y, phi, forceX, forceY, 0, NULL)) {
+            printf("The loaded map gives different results than the imported map\n");
+            return 1;
+        }
+    }
+    freeBlindGuide(&loaded);
+    freeBlindGuide(&guide);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Baked map linesMap: 2 border lines, 0 chains, grid of 64 buckets.
+ * Written by guideBakeMap() (see mapfile.h and bakedmap.h), do not edit: bake the map again instead.
+ */
+
+#ifndef BAKED_MAP_linesMap_H
+#define BAKED_MAP_linesMap_H
+
+#include "bakedmap.h"
+
+#if BAKED_MAP_FORMAT != 2
+#error "linesMap was baked for another version of bakedmap.h, bake it again"
+#endif
+
+static const struct {
+    BorderEnds ends[2];
+    unsigned char states[2];
+    BorderReal soa[14];
+    unsigned int bucketStart[65];
+    unsigned int entries[38];
+    BorderChain chains[1];
+    Coordinate vertices[4];
+} linesMapTables = {
+    {
+        {0, 1, RIGHT},
+        {2, 3, RIGHT},
+    },
+    {
+        0, 0,
+    },
+    {
+        -0x1.8p+0, 0x1.8p+0,
+        -0x1.2p+3, 0x1.2p+3,
+        0x0p+0, 0x0p+0,
+        0x1.2p+4, -0x1.2p+4,
+        0x1.948b0fcd6e9ep-9, 0x1.948b0fcd6e9ep-9,
+        0x1.2p+4, -0x1.2p+4,
+        -0x0p+0, -0x0p+0,
+    },
+    {
+        0, 2, 2, 4, 4, 6, 6, 8, 8, 8, 8, 9, 9, 9, 9, 10,
+        10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 14, 14, 16, 16, 18, 18,
+        20, 20, 22, 22, 24, 24, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28,
+        29, 29, 29, 29, 29, 30, 30, 30, 30, 32, 32, 34, 34, 36, 36, 38,
+        38,
+    },
+    {
+        0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 0, 1, 0, 1, 0, 1,
+        0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+        0, 1, 0, 1, 0, 1,
+    },
+    {
+        {0, 0, 0, 0, RIGHT, 0, 0, 0, 0},
+    },
+    {
+        {-0x1.8p+0, -0x1.2p+3},
+        {-0x1.8p+0, 0x1.2p+3},
+        {0x1.8p+0, 0x1.2p+3},
+        {0x1.8p+0, -0x1.2p+3},
+    }
+};
+
+const BakedMap linesMap = {
+    {2, linesMapTables.ends, linesMapTables.states, linesMapTables.soa,
+     64, 38, linesMapTables.bucketStart, linesMapTables.entries,
+     0, linesMapTables.chains, 4, linesMapTables.vertices},
+    0x1p+0, -0x1.8p+0, -0x1.2p+3, 0x1.8p+0, 0x1.2p+3,
+    &linesMapTables, sizeof(linesMapTables)
+};
+
+#ifndef BAKED_MAP
+#define BAKED_MAP linesMap
+#endif
+
+#endif
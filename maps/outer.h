@@ -0,0 +1,77 @@
+/*
+ * Baked map outerMap: 4 border lines, 1 chains, grid of 64 buckets.
+ * Written by guideBakeMap() (see mapfile.h and bakedmap.h), do not edit: bake the map again instead.
+ */
+
+#ifndef BAKED_MAP_outerMap_H
+#define BAKED_MAP_outerMap_H
+
+#include "bakedmap.h"
+
+#if BAKED_MAP_FORMAT != 2
+#error "outerMap was baked for another version of bakedmap.h, bake it again"
+#endif
+
+static const struct {
+    BorderEnds ends[4];
+    unsigned char states[4];
+    BorderReal soa[28];
+    unsigned int bucketStart[65];
+    unsigned int entries[44];
+    BorderChain chains[1];
+    Coordinate vertices[4];
+} outerMapTables = {
+    {
+        {0, 1, RIGHT},
+        {1, 2, RIGHT},
+        {2, 3, RIGHT},
+        {3, 0, RIGHT},
+    },
+    {
+        0, 0, 0, 0,
+    },
+    {
+        -0x1p+2, -0x1p+2, 0x1p+2, 0x1p+2,
+        -0x1.8p+2, 0x1.8p+2, 0x1.8p+2, -0x1.8p+2,
+        0x0p+0, 0x1p+3, 0x0p+0, -0x1p+3,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        0x1.c71c71c71c71cp-8, 0x1p-6, 0x1.c71c71c71c71cp-8, 0x1p-6,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        -0x0p+0, -0x1p+3, -0x0p+0, 0x1p+3,
+    },
+    {
+        0, 2, 2, 2, 2, 2, 2, 3, 3, 5, 5, 8, 8, 9, 9, 12,
+        12, 12, 15, 15, 17, 17, 18, 18, 20, 20, 21, 21, 22, 22, 22, 22,
+        22, 22, 22, 22, 22, 22, 23, 23, 24, 24, 26, 26, 27, 27, 29, 29,
+        32, 34, 34, 37, 37, 38, 38, 41, 41, 41, 41, 42, 42, 44, 44, 44,
+        44,
+    },
+    {
+        1, 3, 3, 0, 2, 0, 2, 3, 0, 0, 1, 2, 0, 2, 3, 0,
+        1, 2, 0, 2, 1, 3, 3, 1, 0, 2, 2, 0, 1, 0, 2, 3,
+        0, 2, 0, 2, 3, 2, 0, 1, 2, 1, 1, 3,
+    },
+    {
+        {0, 4, 0, 4, RIGHT, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2},
+    },
+    {
+        {-0x1p+2, -0x1.8p+2},
+        {-0x1p+2, 0x1.8p+2},
+        {0x1p+2, 0x1.8p+2},
+        {0x1p+2, -0x1.8p+2},
+    }
+};
+
+const BakedMap outerMap = {
+    {4, outerMapTables.ends, outerMapTables.states, outerMapTables.soa,
+     64, 44, outerMapTables.bucketStart, outerMapTables.entries,
+     1, outerMapTables.chains, 4, outerMapTables.vertices},
+    0x1p+0, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2,
+    &outerMapTables, sizeof(outerMapTables)
+};
+
+#ifndef BAKED_MAP
+#define BAKED_MAP outerMap
+#endif
+
+#endif
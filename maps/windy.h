@@ -0,0 +1,125 @@
+/*
+ * Baked map windyMap: 14 border lines, 3 chains, grid of 64 buckets.
+ * Written by guideBakeMap() (see mapfile.h and bakedmap.h), do not edit: bake the map again instead.
+ */
+
+#ifndef BAKED_MAP_windyMap_H
+#define BAKED_MAP_windyMap_H
+
+#include "bakedmap.h"
+
+#if BAKED_MAP_FORMAT != 2
+#error "windyMap was baked for another version of bakedmap.h, bake it again"
+#endif
+
+static const struct {
+    BorderEnds ends[14];
+    unsigned char states[14];
+    BorderReal soa[98];
+    unsigned int bucketStart[65];
+    unsigned int entries[106];
+    BorderChain chains[3];
+    Coordinate vertices[15];
+} windyMapTables = {
+    {
+        {0, 1, RIGHT},
+        {1, 2, RIGHT},
+        {2, 3, RIGHT},
+        {3, 0, RIGHT},
+        {4, 5, RIGHT},
+        {5, 6, RIGHT},
+        {6, 7, RIGHT},
+        {7, 8, RIGHT},
+        {8, 4, RIGHT},
+        {9, 10, RIGHT},
+        {10, 11, RIGHT},
+        {11, 12, RIGHT},
+        {12, 13, RIGHT},
+        {13, 14, RIGHT},
+    },
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    {
+        -0x1p+2, -0x1p+2, 0x1p+2, 0x1p+2,
+        0x1p+0, -0x1p+0, 0x0p+0, -0x1.8p+1,
+        -0x1p+1, 0x1.8p+1, 0x1p+1, 0x1.cp+1,
+        0x1.cp+1, -0x1.8p+1,
+        -0x1.8p+2, 0x1.8p+2, 0x1.8p+2, -0x1.8p+2,
+        -0x1.8p+1, -0x1p+1, 0x1p+2, 0x1p+2,
+        -0x1p+2, 0x1.8p+2, 0x0p+0, 0x0p+0,
+        -0x1.4p+2, -0x1.4p+2,
+        0x0p+0, 0x1p+3, 0x0p+0, -0x1p+3,
+        -0x1p+1, 0x1p+0, -0x1.8p+1, 0x1p+0,
+        0x1.8p+1, -0x1p+0, 0x1.8p+0, 0x0p+0,
+        -0x1.ap+2, -0x1p+0,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        0x1p+0, 0x1.8p+2, 0x0p+0, -0x1p+3,
+        0x1p+0, -0x1.8p+2, 0x0p+0, -0x1.4p+2,
+        0x0p+0, -0x1p+0,
+        0x1.c71c71c71c71cp-8, 0x1p-6, 0x1.c71c71c71c71cp-8, 0x1p-6,
+        0x1.9999999999998p-3, 0x1.bacf914c1bad1p-6, 0x1.c71c71c71c71cp-4, 0x1.f81f81f81f821p-7,
+        0x1.9999999999998p-4, 0x1.bacf914c1bad1p-6, 0x1.c71c71c71c71cp-2, 0x1.47ae147ae147bp-5,
+        0x1.83c977ab2beddp-6, 0x1.ffffffffffffep-2,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        0x1p+0, 0x1.8p+2, 0x0p+0, -0x1p+3,
+        0x1p+0, -0x1.8p+2, 0x0p+0, -0x1.4p+2,
+        0x0p+0, -0x1p+0,
+        -0x0p+0, -0x1p+3, -0x0p+0, 0x1p+3,
+        0x1p+1, -0x1p+0, 0x1.8p+1, -0x1p+0,
+        -0x1.8p+1, 0x1p+0, -0x1.8p+0, -0x0p+0,
+        0x1.ap+2, 0x1p+0,
+    },
+    {
+        0, 4, 4, 7, 7, 9, 9, 12, 12, 15, 15, 20, 20, 24, 24, 27,
+        27, 27, 30, 30, 33, 33, 37, 37, 42, 42, 44, 44, 45, 45, 47, 47,
+        50, 50, 53, 53, 57, 57, 61, 61, 64, 64, 68, 68, 70, 70, 74, 74,
+        78, 80, 80, 85, 85, 88, 88, 93, 93, 94, 94, 98, 98, 103, 103, 106,
+        106,
+    },
+    {
+        1, 3, 4, 9, 5, 7, 8, 8, 9, 3, 9, 12, 0, 2, 7, 0,
+        2, 3, 7, 13, 0, 9, 12, 13, 0, 1, 2, 0, 2, 3, 0, 1,
+        11, 2, 6, 7, 11, 0, 2, 7, 10, 11, 1, 8, 3, 5, 5, 5,
+        6, 12, 4, 5, 9, 4, 5, 8, 12, 3, 7, 9, 12, 1, 8, 9,
+        0, 2, 7, 13, 2, 7, 0, 1, 7, 9, 0, 2, 3, 13, 0, 2,
+        0, 2, 3, 11, 12, 2, 7, 11, 0, 1, 2, 7, 11, 12, 1, 6,
+        9, 10, 1, 3, 5, 5, 6, 4, 5, 8,
+    },
+    {
+        {0, 4, 0, 4, RIGHT, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2},
+        {4, 5, 4, 5, RIGHT, -0x1.8p+1, -0x1p+2, 0x1p+0, 0x1p+2},
+        {9, 6, 9, 5, RIGHT, -0x1p+2, -0x1.8p+2, 0x1.cp+1, 0x1.8p+2},
+    },
+    {
+        {-0x1p+2, -0x1.8p+2},
+        {-0x1p+2, 0x1.8p+2},
+        {0x1p+2, 0x1.8p+2},
+        {0x1p+2, -0x1.8p+2},
+        {0x1p+0, -0x1.8p+1},
+        {-0x1p+0, -0x1p+1},
+        {0x0p+0, 0x1p+2},
+        {-0x1.8p+1, 0x1p+2},
+        {-0x1p+1, -0x1p+2},
+        {0x1.8p+1, 0x1.8p+2},
+        {0x1p+1, 0x0p+0},
+        {0x1.cp+1, 0x0p+0},
+        {0x1.cp+1, -0x1.4p+2},
+        {-0x1.8p+1, -0x1.4p+2},
+        {-0x1p+2, -0x1.8p+2},
+    }
+};
+
+const BakedMap windyMap = {
+    {14, windyMapTables.ends, windyMapTables.states, windyMapTables.soa,
+     64, 106, windyMapTables.bucketStart, windyMapTables.entries,
+     3, windyMapTables.chains, 15, windyMapTables.vertices},
+    0x1p+0, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2,
+    &windyMapTables, sizeof(windyMapTables)
+};
+
+#ifndef BAKED_MAP
+#define BAKED_MAP windyMap
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Baked map zigzagMap: 12 border lines, 3 chains, grid of 64 buckets.
+ * Written by guideBakeMap() (see mapfile.h and bakedmap.h), do not edit: bake the map again instead.
+ */
+
+#ifndef BAKED_MAP_zigzagMap_H
+#define BAKED_MAP_zigzagMap_H
+
+#include "bakedmap.h"
+
+#if BAKED_MAP_FORMAT != 2
+#error "zigzagMap was baked for another version of bakedmap.h, bake it again"
+#endif
+
+static const struct {
+    BorderEnds ends[12];
+    unsigned char states[12];
+    BorderReal soa[84];
+    unsigned int bucketStart[65];
+    unsigned int entries[103];
+    BorderChain chains[3];
+    Coordinate vertices[14];
+} zigzagMapTables = {
+    {
+        {0, 1, RIGHT},
+        {1, 2, RIGHT},
+        {2, 3, RIGHT},
+        {3, 0, RIGHT},
+        {4, 5, RIGHT},
+        {5, 6, RIGHT},
+        {6, 7, RIGHT},
+        {7, 8, RIGHT},
+        {9, 10, RIGHT},
+        {10, 11, RIGHT},
+        {11, 12, RIGHT},
+        {12, 13, RIGHT},
+    },
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    {
+        -0x1p+2, -0x1p+2, 0x1p+2, 0x1p+2,
+        0x0p+0, -0x1.4p+1, -0x1p+0, -0x1.8p+1,
+        0x1p+1, -0x1p-1, 0x1p+1, 0x0p+0,
+        -0x1.8p+2, 0x1.8p+2, 0x1.8p+2, -0x1.8p+2,
+        -0x1.8p+2, -0x1.8p+1, 0x0p+0, 0x1.8p+1,
+        0x1.8p+2, 0x1.8p+1, 0x0p+0, -0x1.8p+1,
+        0x0p+0, 0x1p+3, 0x0p+0, -0x1p+3,
+        -0x1.4p+1, 0x1.8p+0, -0x1p+1, 0x1p+1,
+        -0x1.4p+1, 0x1.4p+1, -0x1p+1, 0x1.8p+1,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        0x1.8p+1, 0x1.8p+1, 0x1.8p+1, 0x1.8p+1,
+        -0x1.8p+1, -0x1.8p+1, -0x1.8p+1, -0x1.8p+1,
+        0x1.c71c71c71c71cp-8, 0x1p-6, 0x1.c71c71c71c71cp-8, 0x1p-6,
+        0x1.0c9714fbcda3bp-4, 0x1.6c16c16c16c16p-4, 0x1.3b13b13b13b14p-4, 0x1.3b13b13b13b14p-4,
+        0x1.0c9714fbcda3bp-4, 0x1.0c9714fbcda3bp-4, 0x1.3b13b13b13b14p-4, 0x1.c71c71c71c71ep-5,
+        0x1.8p+3, 0x0p+0, -0x1.8p+3, 0x0p+0,
+        0x1.8p+1, 0x1.8p+1, 0x1.8p+1, 0x1.8p+1,
+        -0x1.8p+1, -0x1.8p+1, -0x1.8p+1, -0x1.8p+1,
+        -0x0p+0, -0x1p+3, -0x0p+0, 0x1p+3,
+        0x1.4p+1, -0x1.8p+0, 0x1p+1, -0x1p+1,
+        0x1.4p+1, -0x1.4p+1, 0x1p+1, -0x1.8p+1,
+    },
+    {
+        0, 3, 3, 7, 7, 9, 9, 15, 15, 17, 17, 22, 22, 23, 23, 26,
+        26, 26, 30, 30, 32, 32, 34, 34, 37, 37, 41, 41, 44, 44, 49, 49,
+        52, 52, 54, 54, 59, 59, 63, 63, 66, 66, 68, 68, 70, 70, 73, 73,
+        76, 78, 78, 81, 81, 84, 84, 88, 88, 90, 90, 94, 94, 100, 100, 103,
+        103,
+    },
+    {
+        1, 3, 8, 4, 5, 9, 10, 5, 11, 3, 4, 4, 5, 6, 8, 0,
+        2, 0, 2, 3, 4, 5, 0, 0, 1, 2, 0, 2, 3, 11, 0, 1,
+        2, 7, 0, 2, 6, 1, 6, 7, 11, 3, 10, 11, 7, 8, 9, 9,
+        10, 9, 10, 11, 8, 8, 4, 5, 6, 10, 11, 3, 4, 5, 11, 1,
+        5, 8, 0, 2, 2, 5, 0, 1, 4, 0, 2, 3, 0, 2, 0, 2,
+        3, 2, 6, 7, 0, 1, 2, 6, 7, 11, 1, 7, 9, 10, 1, 3,
+        7, 8, 10, 11, 8, 9, 9,
+    },
+    {
+        {0, 4, 0, 4, RIGHT, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2},
+        {4, 5, 4, 4, RIGHT, -0x1.8p+1, -0x1.8p+2, 0x0p+0, 0x1.8p+2},
+        {9, 5, 8, 4, RIGHT, -0x1p-1, -0x1.8p+2, 0x1.8p+1, 0x1.8p+2},
+    },
+    {
+        {-0x1p+2, -0x1.8p+2},
+        {-0x1p+2, 0x1.8p+2},
+        {0x1p+2, 0x1.8p+2},
+        {0x1p+2, -0x1.8p+2},
+        {0x0p+0, -0x1.8p+2},
+        {-0x1.4p+1, -0x1.8p+1},
+        {-0x1p+0, 0x0p+0},
+        {-0x1.8p+1, 0x1.8p+1},
+        {-0x1p+0, 0x1.8p+2},
+        {0x1p+1, 0x1.8p+2},
+        {-0x1p-1, 0x1.8p+1},
+        {0x1p+1, 0x0p+0},
+        {0x0p+0, -0x1.8p+1},
+        {0x1.8p+1, -0x1.8p+2},
+    }
+};
+
+const BakedMap zigzagMap = {
+    {12, zigzagMapTables.ends, zigzagMapTables.states, zigzagMapTables.soa,
+     64, 103, zigzagMapTables.bucketStart, zigzagMapTables.entries,
+     3, zigzagMapTables.chains, 14, zigzagMapTables.vertices},
+    0x1p+0, -0x1p+2, -0x1.8p+2, 0x1p+2, 0x1.8p+2,
+    &zigzagMapTables, sizeof(zigzagMapTables)
+};
+
+#ifndef BAKED_MAP
+#define BAKED_MAP zigzagMap
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mapfile.h"
+#include "replay.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+/*
+ * Sets the parameter of params given as "name=value" (e.g. "radius=0.4" or "userHandedness=LEFT").
+ * Returns 1 on success, 0 when there is no parameter with that name.
+ */
+int parseParam(GuideParams * params, const char * assignment) {
+    const char * value = strchr(assignment, '=');
+    if (value == NULL) {
+        return 0;
+    }
+    char name[32];
+    size_t length = value - assignment;
+    if (length >= sizeof(name)) {
+        return 0;
+    }
+    memcpy(name, assignment, length);
+    name[length] = '\0';
+    value++;
+    int param = findParam(name);
+    if (param == PARAM_USER_HANDEDNESS) {
+        if (strcmp(value, "LEFT") != 0 && strcmp(value, "RIGHT") != 0) {
+            return 0;
+        }
+        params->userHandedness = strcmp(value, "LEFT") == 0 ? LEFT : RIGHT;
+        return 1;
+    }
+    if (param < 0) {
+        return 0;
+    }
+    char * end = NULL;
+    setParam(params, param, strtod(value, &end));
+    return end != value && *end == '\0';
+}
+
+/*
+ * Writes a log of numRecords random queries near the border lines of guide, with up to two obstacles each.
+ */
+int writeSyntheticLog(BlindGuide * guide, const char * path, unsigned long long numRecords) {
+    ReplayLogWriter writer;
+    if (!openReplayLog(&writer, path)) {
+        return 0;
+    }
+    srand(1);
+    BorderlineArray * ba = &(guide->borderlines);
+    unsigned long long i = 0;
+    for (i = 0; i < numRecords; i++) {
+        double x = randomBetween(-4, 4);
+        double y = randomBetween(-6, 6);
+        if (ba->size > 0) {
+            Borderline b = getBorderline(ba, rand() % ba->size);
+            x = b.bottom.x + randomBetween(-2, 2);
+            y = b.bottom.y + randomBetween(-2, 2);
+        }
+        double obstacles[4];
+        unsigned int numObstacles = rand() % 3;
+        unsigned int k = 0;
+        for (k = 0; k < 2 * numObstacles; k++) {
+            obstacles[k] = (k % 2 == 0 ? x : y) + randomBetween(-3, 3);
+        }
+        if (!appendReplayRecord(&writer, x, y, randomBetween(-PI, PI), randomBetween(-20, 20), randomBetween(-20, 20), numObstacles, obstacles)) {
+            closeReplayLog(&writer);
+            return 0;
+        }
+    }
+    closeReplayLog(&writer);
+    return 1;
+}
+
+/*
+ * Recomputes the resistances of a replay log (see replay.h), optionally with another map or other parameters,
+ * and prints the throughput and a summary of the results.
+ */
+int main(int argc, char ** argv) {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    GuideParams params;
+    getDefaultParams(&params);
+    size_t numThreads = 0;
+    unsigned long long numSynthetic = 0;
+    int hasMap = 0;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (arg + 1 >= argc) {
+            arg = argc;
+            break;
+        }
+        if (strcmp(argv[arg], "--threads") == 0) {
+            numThreads = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--synthetic") == 0) {
+            numSynthetic = strtoull(argv[arg + 1], NULL, 10);
+        } else if (strcmp(argv[arg], "--map") == 0) {
+            if (!guideLoadMap(&guide, argv[arg + 1])) {
+                printf("Cannot load the map file %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else if (strcmp(argv[arg], "--text") == 0) {
+            if (guideImportTextMap(&guide, argv[arg + 1], NULL) < 0) {
+                printf("Cannot import the text map %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else {
+            arg = argc;
+        }
+    }
+    for (; arg < argc && strchr(argv[arg], '=') != NULL; arg++) {
+        if (!parseParam(&params, argv[arg])) {
+            printf("Unknown parameter %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    if ((numSynthetic > 0 && argc - arg != 1) || (numSynthetic == 0 && argc - arg != 2)) {
+        printf("Usage: %s [--threads n] [--map venue.map | --text venue.txt] [name=value ...] log.bin results.bin\n", argv[0]);
+        printf("       %s --synthetic numRecords [--map venue.map | --text venue.txt] log.bin\n", argv[0]);
+        printf("The map defaults to borderCoordinates, the parameters (e.g. radius=0.4 or userHandedness=LEFT) to the defines of blindguide.h\n");
+        return 1;
+    }
+    if (!hasMap) {
+        guideInitializeBorders(&guide);
+    }
+    if (!guideSetParams(&guide, &params)) {
+        printf("Invalid parameters\n");
+        return 1;
+    }
+
+    if (numSynthetic > 0) {
+        if (!writeSyntheticLog(&guide, argv[arg], numSynthetic)) {
+            printf("Cannot write %s\n", argv[arg]);
+            return 1;
+        }
+        printf("Wrote %llu records to %s\n", numSynthetic, argv[arg]);
+        freeBlindGuide(&guide);
+        return 0;
+    }
+
+    double start = now();
+    long long numRecords = replayLog(&guide, argv[arg], argv[arg + 1], numThreads);
+    double seconds = now() - start;
+    if (numRecords < 0) {
+        printf("Cannot replay %s into %s\n", argv[arg], argv[arg + 1]);
+        return 1;
+    }
+    FILE * log = fopen(argv[arg], "rb");
+    fseek(log, 0, SEEK_END);
+    double megabytes = ftell(log) / 1e6;
+    fclose(log);
+    printf("Replayed %lld records (%.1f MB) in %.3f s: %.0f records/s, %.1f MB/s\n", numRecords, megabytes, seconds, numRecords / seconds, megabytes / seconds);
+
+    ReplayResults results;
+    if (!openReplayResults(&results, argv[arg + 1])) {
+        printf("Cannot read %s\n", argv[arg + 1]);
+        return 1;
+    }
+    unsigned long long actions[3] = {0, 0, 0};
+    double sum = 0;
+    size_t i = 0;
+    for (i = 0; i < results.numRecords; i++) {
+        actions[results.actions[i] <= STOP ? results.actions[i] : NOTHING]++;
+        sum += results.resistances[i];
+    }
+    printf("NOTHING %llu, RESIST %llu, STOP %llu, mean resistance %lf\n", actions[NOTHING], actions[RESIST], actions[STOP], results.numRecords > 0 ? sum / results.numRecords : 0.0);
+    closeReplayResults(&results);
+    freeBlindGuide(&guide);
+    return 0;
+}
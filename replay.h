@@ -0,0 +1,569 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fleet.h"
+
+// Replay logs are memory-mapped where possible, and read into memory otherwise
+#if defined(__unix__) || defined(__APPLE__)
+    #define REPLAY_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #define REPLAY_MMAP 0
+#endif
+
+// First bytes of every replay log
+#define REPLAY_LOG_MAGIC "BGLOG\r\n"
+// First bytes of every replay results file
+#define REPLAY_RESULTS_MAGIC "BGRES\r\n"
+// Version of the replay log and results file formats
+#define REPLAY_FILE_VERSION 1
+// Alignment of the columns of a results file in bytes
+#define REPLAY_FILE_ALIGNMENT 64
+// Number of records that a replay worker evaluates before looking for more work
+#define REPLAY_CHUNK_SIZE 4096
+// Time in microseconds that a replay worker waits for the scan of the log to find its next chunk
+#define REPLAY_WAIT_INTERVAL 100
+// Size in bytes of the buffer of a ReplayLogWriter
+#define REPLAY_WRITE_BUFFER (1 << 20)
+
+/*
+ * Header at the start of a replay log, which is followed by the records in the order they were written.
+ * magic: REPLAY_LOG_MAGIC
+ * version: REPLAY_FILE_VERSION
+ * recordSize: size of a ReplayRecord in bytes
+ * numRecords: number of records (filled in when the log is closed, 0 when the writer did not close it, in which case the log is scanned to count them)
+ * Replay logs are written in the native layout of the platform, so replay them on the same kind of platform.
+ */
+typedef struct ReplayLogHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int recordSize;
+    unsigned long long numRecords;
+} ReplayLogHeader;
+
+/*
+ * A query of a replay log, see getResistance() for the meaning of the fields.
+ * Every record is directly followed by its 2 * numObstacles obstacle coordinates (doubles).
+ */
+typedef struct ReplayRecord {
+    double x;
+    double y;
+    double phi;
+    double forceX;
+    double forceY;
+    unsigned int numObstacles;
+    unsigned int reserved;
+} ReplayRecord;
+
+/*
+ * Header at the start of a replay results file, which holds one column per result, where element i belongs to record i of the log:
+ * resistances: numRecords doubles at resistancesOffset
+ * actions: numRecords bytes at actionsOffset, holding the final action (see enum action)
+ * The offsets are in bytes from the start of the file, and multiples of REPLAY_FILE_ALIGNMENT.
+ */
+typedef struct ReplayResultsHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int reserved;
+    unsigned long long numRecords;
+    unsigned long long resistancesOffset;
+    unsigned long long actionsOffset;
+    unsigned long long fileSize;
+} ReplayResultsHeader;
+
+/*
+ * Writer of a replay log, which records the queries of a guide session.
+ * file: the replay log
+ * numRecords: number of records written
+ */
+typedef struct ReplayLogWriter {
+    FILE * file;
+    unsigned long long numRecords;
+} ReplayLogWriter;
+
+/*
+ * The results file of a replay, as opened by openReplayResults().
+ * numRecords: number of results
+ * resistances, actions: the columns of the file (see ReplayResultsHeader)
+ * mapping, mappingSize: the memory holding the file
+ */
+typedef struct ReplayResults {
+    size_t numRecords;
+    double * resistances;
+    unsigned char * actions;
+    void * mapping;
+    size_t mappingSize;
+} ReplayResults;
+
+/*
+ * A worker of a replay.
+ * search: scratch space for searching the border grid of the guide
+ * thread: the thread running this worker (unused for worker 0, which is the calling thread)
+ * replay: the replay this worker belongs to
+ */
+typedef struct ReplayWorker {
+    struct BorderSearch search;
+    pthread_t thread;
+    struct Replay * replay;
+} ReplayWorker;
+
+/*
+ * State of a replay, shared by its workers.
+ * guide: the guide with the map and parameters the records are evaluated with (it is not modified while replaying)
+ * records, recordsEnd: the records of the log
+ * numRecords: number of records in the log
+ * boundaries: offset (from records) of the first record of every chunk of REPLAY_CHUNK_SIZE records,
+ *             followed by the offset of the end of the last chunk, as far as the log has been scanned
+ * numBoundaries: number of valid elements in boundaries, chunk c can be evaluated once numBoundaries > c + 1
+ * scanned: set when the whole log has been scanned
+ * nextChunk: the next chunk to evaluate
+ * resistances, actions: the columns of the results
+ */
+typedef struct Replay {
+    BlindGuide * guide;
+    char * records;
+    char * recordsEnd;
+    size_t numRecords;
+    size_t * boundaries;
+    _Atomic size_t numBoundaries;
+    _Atomic int scanned;
+    _Atomic size_t nextChunk;
+    double * resistances;
+    unsigned char * actions;
+} Replay;
+
+/*
+ * Creates the replay log at path, to which the queries of a session can be appended with appendReplayRecord().
+ * Returns 1 on success, or 0 when the file cannot be created.
+ */
+int openReplayLog(ReplayLogWriter * writer, const char * path);
+
+/*
+ * Appends a query (see getResistance()) to the replay log of writer.
+ * Records are buffered, so this only waits for the file system once every REPLAY_WRITE_BUFFER bytes.
+ * Returns 1 on success, or 0 when the record cannot be written.
+ */
+int appendReplayRecord(ReplayLogWriter * writer, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Writes the remaining records of writer, fills in the number of records and closes its file.
+ */
+void closeReplayLog(ReplayLogWriter * writer);
+
+/*
+ * Recomputes the resistance and action of every record of the replay log at logPath with the map and parameters of guide,
+ * on numWorkers threads (including the calling thread, 0 to use all cores), and writes them to a results file at resultsPath.
+ * The log is memory-mapped and read once, front to back: the calling thread scans it for the boundaries of the chunks of REPLAY_CHUNK_SIZE records,
+ * which the workers evaluate as soon as they are found, writing straight into the memory-mapped columns of the results file.
+ * Gives the same results as calling guideGetResistance() for every record.
+ * Returns the number of records replayed, or -1 when the log is not a complete replay log for this platform or the results cannot be written.
+ */
+long long replayLog(BlindGuide * guide, const char * logPath, const char * resultsPath, size_t numWorkers);
+
+/*
+ * Opens the results file at path written by replayLog().
+ * Returns 1 on success, or 0 when the file cannot be read or is not a valid results file.
+ */
+int openReplayResults(ReplayResults * results, const char * path);
+
+/*
+ * Releases the results file opened by openReplayResults().
+ */
+void closeReplayResults(ReplayResults * results);
+
+
+/*
+ * Writes a log header with the given number of records at the current position of file.
+ */
+static int writeReplayLogHeader(FILE * file, unsigned long long numRecords) {
+    ReplayLogHeader header;
+    memset(&header, 0, sizeof(ReplayLogHeader));
+    memcpy(header.magic, REPLAY_LOG_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_FILE_VERSION;
+    header.recordSize = sizeof(ReplayRecord);
+    header.numRecords = numRecords;
+    return fwrite(&header, sizeof(ReplayLogHeader), 1, file) == 1;
+}
+
+int openReplayLog(ReplayLogWriter * writer, const char * path) {
+    memset(writer, 0, sizeof(ReplayLogWriter));
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return 0;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, REPLAY_WRITE_BUFFER);
+    if (!writeReplayLogHeader(writer->file, 0)) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int appendReplayRecord(ReplayLogWriter * writer, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    ReplayRecord record;
+    memset(&record, 0, sizeof(ReplayRecord));
+    record.x = x;
+    record.y = y;
+    record.phi = phi;
+    record.forceX = forceX;
+    record.forceY = forceY;
+    record.numObstacles = numObstacles;
+    if (fwrite(&record, sizeof(ReplayRecord), 1, writer->file) != 1
+            || (numObstacles > 0 && fwrite(obstacles, 2 * sizeof(double), numObstacles, writer->file) != numObstacles)) {
+        return 0;
+    }
+    writer->numRecords++;
+    return 1;
+}
+
+void closeReplayLog(ReplayLogWriter * writer) {
+    if (writer->file == NULL) {
+        return;
+    }
+    // Now that all records are written, fill in their number
+    fflush(writer->file);
+    if (fseek(writer->file, 0, SEEK_SET) == 0) {
+        writeReplayLogHeader(writer->file, writer->numRecords);
+    }
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+/*
+ * Maps the file at path into memory for reading, and stores its size in size.
+ * Returns NULL when the file cannot be read.
+ */
+static void * mapReplayFile(const char * path, size_t * size) {
+    void * mapping = NULL;
+    #if REPLAY_MMAP
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return NULL;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return NULL;
+        }
+        *size = (size_t) st.st_size;
+        mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+        // The file is read front to back, so let the kernel read ahead
+        madvise(mapping, *size, MADV_SEQUENTIAL);
+    #else
+        FILE * file = fopen(path, "rb");
+        if (file == NULL) {
+            return NULL;
+        }
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length <= 0) {
+            fclose(file);
+            return NULL;
+        }
+        *size = (size_t) length;
+        mapping = malloc(*size);
+        if (mapping == NULL || fread(mapping, 1, *size, file) != *size) {
+            free(mapping);
+            fclose(file);
+            return NULL;
+        }
+        fclose(file);
+    #endif
+    return mapping;
+}
+
+/*
+ * Releases a file mapped by mapReplayFile() or createReplayResults().
+ */
+static void releaseReplayFile(void * mapping, size_t size) {
+    #if REPLAY_MMAP
+        munmap(mapping, size);
+    #else
+        (void) size;
+        free(mapping);
+    #endif
+}
+
+/*
+ * Returns the record following the record at record, or NULL when the record at record does not fit before end.
+ */
+static char * nextReplayRecord(char * record, char * end) {
+    size_t left = end - record;
+    if (left < sizeof(ReplayRecord)) {
+        return NULL;
+    }
+    unsigned int numObstacles = ((ReplayRecord *) record)->numObstacles;
+    if (numObstacles > (left - sizeof(ReplayRecord)) / (2 * sizeof(double))) {
+        return NULL;
+    }
+    return record + sizeof(ReplayRecord) + numObstacles * 2 * sizeof(double);
+}
+
+/*
+ * Rounds offset up to a multiple of REPLAY_FILE_ALIGNMENT.
+ */
+static unsigned long long alignReplayOffset(unsigned long long offset) {
+    return (offset + REPLAY_FILE_ALIGNMENT - 1) / REPLAY_FILE_ALIGNMENT * REPLAY_FILE_ALIGNMENT;
+}
+
+/*
+ * Creates the results file at path for numRecords records, maps it into memory for writing and fills in header (which is not written yet).
+ * Returns the mapping, or NULL when the file cannot be created.
+ */
+static void * createReplayResults(const char * path, size_t numRecords, ReplayResultsHeader * header) {
+    memset(header, 0, sizeof(ReplayResultsHeader));
+    memcpy(header->magic, REPLAY_RESULTS_MAGIC, sizeof(header->magic));
+    header->version = REPLAY_FILE_VERSION;
+    header->numRecords = numRecords;
+    header->resistancesOffset = alignReplayOffset(sizeof(ReplayResultsHeader));
+    header->actionsOffset = alignReplayOffset(header->resistancesOffset + numRecords * sizeof(double));
+    header->fileSize = header->actionsOffset + numRecords;
+    void * mapping = NULL;
+    #if REPLAY_MMAP
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return NULL;
+        }
+        if (ftruncate(fd, (off_t) header->fileSize) != 0) {
+            close(fd);
+            return NULL;
+        }
+        mapping = mmap(NULL, header->fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+    #else
+        // The results are written to path once they are complete, see finishReplayResults()
+        FILE * file = fopen(path, "wb");
+        if (file == NULL) {
+            return NULL;
+        }
+        fclose(file);
+        mapping = calloc(header->fileSize, 1);
+    #endif
+    return mapping;
+}
+
+/*
+ * Writes header to the results file at path mapped at mapping, after which the file is complete, and releases the mapping.
+ * Returns 1 on success, 0 when the file cannot be written.
+ */
+static int finishReplayResults(const char * path, void * mapping, ReplayResultsHeader * header) {
+    memcpy(mapping, header, sizeof(ReplayResultsHeader));
+    int written = 1;
+    #if REPLAY_MMAP
+        (void) path;
+    #else
+        FILE * file = fopen(path, "wb");
+        written = file != NULL && fwrite(mapping, 1, header->fileSize, file) == header->fileSize;
+        if (file != NULL) {
+            written = fclose(file) == 0 && written;
+        }
+    #endif
+    releaseReplayFile(mapping, header->fileSize);
+    return written;
+}
+
+/*
+ * Evaluates chunks of the replay as worker, until all chunks have been handed out.
+ */
+static void runReplayWorker(Replay * replay, ReplayWorker * worker) {
+    struct timespec interval;
+    interval.tv_sec = 0;
+    interval.tv_nsec = REPLAY_WAIT_INTERVAL * 1000L;
+    for (;;) {
+        size_t chunk = atomic_fetch_add(&(replay->nextChunk), 1);
+        // Wait for the scan to find the end of the chunk, the chunk does not exist when the scan ends before that
+        while (atomic_load(&(replay->numBoundaries)) <= chunk + 1) {
+            if (atomic_load(&(replay->scanned)) && atomic_load(&(replay->numBoundaries)) <= chunk + 1) {
+                return;
+            }
+            nanosleep(&interval, NULL);
+        }
+        char * record = replay->records + replay->boundaries[chunk];
+        char * end = replay->records + replay->boundaries[chunk + 1];
+        size_t i = chunk * REPLAY_CHUNK_SIZE;
+        for (; record < end; i++) {
+            ReplayRecord * r = (ReplayRecord *) record;
+            double * obstacles = (double *) (record + sizeof(ReplayRecord));
+            replay->resistances[i] = guideGetResistanceWith(replay->guide, &(worker->search), r->x, r->y, r->phi, r->forceX, r->forceY, r->numObstacles, obstacles);
+            replay->actions[i] = (unsigned char) worker->search.action;
+            record += sizeof(ReplayRecord) + r->numObstacles * 2 * sizeof(double);
+        }
+    }
+}
+
+/*
+ * Main function of the worker threads of a replay.
+ */
+static void * replayThread(void * arg) {
+    ReplayWorker * worker = (ReplayWorker *) arg;
+    runReplayWorker(worker->replay, worker);
+    return NULL;
+}
+
+/*
+ * Scans the records of the replay, and publishes the boundary of every chunk as soon as it is found.
+ * Returns the number of records found.
+ */
+static size_t scanReplay(Replay * replay) {
+    char * record = replay->records;
+    size_t n = 0;
+    replay->boundaries[0] = 0;
+    atomic_store(&(replay->numBoundaries), 1);
+    while (n < replay->numRecords && (record = nextReplayRecord(record, replay->recordsEnd)) != NULL) {
+        n++;
+        if (n % REPLAY_CHUNK_SIZE == 0 || n == replay->numRecords) {
+            // Record n - 1 ends its chunk
+            size_t chunk = (n - 1) / REPLAY_CHUNK_SIZE;
+            replay->boundaries[chunk + 1] = record - replay->records;
+            atomic_store(&(replay->numBoundaries), chunk + 2);
+        }
+    }
+    atomic_store(&(replay->scanned), 1);
+    return n;
+}
+
+long long replayLog(BlindGuide * guide, const char * logPath, const char * resultsPath, size_t numWorkers) {
+    size_t size = 0;
+    char * log = (char *) mapReplayFile(logPath, &size);
+    if (log == NULL) {
+        return -1;
+    }
+    ReplayLogHeader * header = (ReplayLogHeader *) log;
+    if (size < sizeof(ReplayLogHeader) || memcmp(header->magic, REPLAY_LOG_MAGIC, sizeof(header->magic)) != 0
+            || header->version != REPLAY_FILE_VERSION || header->recordSize != sizeof(ReplayRecord)
+            || header->numRecords > (size - sizeof(ReplayLogHeader)) / sizeof(ReplayRecord)) {
+        releaseReplayFile(log, size);
+        return -1;
+    }
+
+    Replay replay;
+    memset(&replay, 0, sizeof(Replay));
+    replay.guide = guide;
+    replay.records = log + sizeof(ReplayLogHeader);
+    replay.recordsEnd = log + size;
+    replay.numRecords = header->numRecords;
+    if (replay.numRecords == 0) {
+        // The log was not closed, so count the records it holds (a record cut off at the end is left out)
+        char * record = replay.records;
+        while ((record = nextReplayRecord(record, replay.recordsEnd)) != NULL) {
+            replay.numRecords++;
+        }
+    }
+    size_t numChunks = (replay.numRecords + REPLAY_CHUNK_SIZE - 1) / REPLAY_CHUNK_SIZE;
+    replay.boundaries = (size_t *) malloc((numChunks + 1) * sizeof(size_t));
+    ReplayResultsHeader resultsHeader;
+    char * results = (char *) createReplayResults(resultsPath, replay.numRecords, &resultsHeader);
+    if (results == NULL) {
+        free(replay.boundaries);
+        releaseReplayFile(log, size);
+        return -1;
+    }
+    replay.resistances = (double *) (results + resultsHeader.resistancesOffset);
+    replay.actions = (unsigned char *) (results + resultsHeader.actionsOffset);
+    atomic_init(&(replay.numBoundaries), 0);
+    atomic_init(&(replay.scanned), 0);
+    atomic_init(&(replay.nextChunk), 0);
+
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    numWorkers = numWorkers > 0 ? numWorkers : getNumCores();
+    ReplayWorker * workers = (ReplayWorker *) calloc(numWorkers, sizeof(ReplayWorker));
+    size_t w = 0;
+    for (w = 0; w < numWorkers; w++) {
+        workers[w].replay = &replay;
+    }
+    for (w = 1; w < numWorkers; w++) {
+        pthread_create(&(workers[w].thread), NULL, replayThread, &(workers[w]));
+    }
+    // The calling thread scans the log, and evaluates chunks as well once it is done
+    size_t numFound = scanReplay(&replay);
+    runReplayWorker(&replay, &(workers[0]));
+    for (w = 0; w < numWorkers; w++) {
+        if (w > 0) {
+            pthread_join(workers[w].thread, NULL);
+        }
+        freeBorderSearch(&(workers[w].search));
+    }
+    free(workers);
+    free(replay.boundaries);
+    releaseReplayFile(log, size);
+
+    // A log that holds fewer records than its header says is incomplete, so leave the results file without a header
+    if (numFound != replay.numRecords) {
+        releaseReplayFile(results, resultsHeader.fileSize);
+        return -1;
+    }
+    return finishReplayResults(resultsPath, results, &resultsHeader) ? (long long) replay.numRecords : -1;
+}
+
+int openReplayResults(ReplayResults * results, const char * path) {
+    memset(results, 0, sizeof(ReplayResults));
+    size_t size = 0;
+    char * mapping = (char *) mapReplayFile(path, &size);
+    if (mapping == NULL) {
+        return 0;
+    }
+    ReplayResultsHeader * header = (ReplayResultsHeader *) mapping;
+    unsigned long long n = header->numRecords;
+    int valid = size >= sizeof(ReplayResultsHeader)
+        && memcmp(header->magic, REPLAY_RESULTS_MAGIC, sizeof(header->magic)) == 0
+        && header->version == REPLAY_FILE_VERSION
+        && header->fileSize == size
+        && header->resistancesOffset % REPLAY_FILE_ALIGNMENT == 0 && header->actionsOffset % REPLAY_FILE_ALIGNMENT == 0
+        && n <= size / (sizeof(double) + 1)
+        && header->resistancesOffset <= size && n * sizeof(double) <= size - header->resistancesOffset
+        && header->actionsOffset <= size && n <= size - header->actionsOffset;
+    if (!valid) {
+        releaseReplayFile(mapping, size);
+        return 0;
+    }
+    results->numRecords = n;
+    results->resistances = (double *) (mapping + header->resistancesOffset);
+    results->actions = (unsigned char *) (mapping + header->actionsOffset);
+    results->mapping = mapping;
+    results->mappingSize = size;
+    return 1;
+}
+
+void closeReplayResults(ReplayResults * results) {
+    if (results->mapping != NULL) {
+        releaseReplayFile(results->mapping, results->mappingSize);
+    }
+    memset(results, 0, sizeof(ReplayResults));
+}
+
+#endif
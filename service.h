@@ -0,0 +1,237 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include "snapshot.h"
+#include "serviceclient.h"
+
+/*
+ * A thread of a ResistanceService.
+ * service: the service of the thread
+ * index: number of the thread, it serves the client slots index, index + numThreads, ...
+ * reader: the snapshot reader of the thread (see registerSnapshotReader())
+ * thread: the thread itself
+ */
+typedef struct ServiceThread {
+    struct ResistanceService * service;
+    unsigned int index;
+    int reader;
+    pthread_t thread;
+} ServiceThread;
+
+/*
+ * A service that answers the resistance queries of other processes on the same machine (see serviceclient.h),
+ * such that the haptic controller, the planner and the logger of a robot share one map instead of each loading their own.
+ * The map is the current snapshot of a MapSnapshots structure, so the process running the service can keep updating it
+ * (see beginMapUpdate()) while the clients query it, and every client sees the same version.
+ * Clients fill their requests in place in the shared memory, and the service answers them in place (see ServiceSlot).
+ * snapshots: the map that is served
+ * name: the name of the shared memory
+ * region: the shared memory
+ * numThreads: number of threads in threads that have been started
+ * threads: the threads answering the requests
+ * caches: a BorderCache for every client slot, as every client mostly queries around its own robot
+ */
+typedef struct ResistanceService {
+    MapSnapshots * snapshots;
+    char name[256];
+    ServiceRegion * region;
+    unsigned int numThreads;
+    struct ServiceThread threads[SERVICE_MAX_THREADS];
+    BorderCache caches[SERVICE_MAX_CLIENTS];
+} ResistanceService;
+
+/*
+ * Starts a service that answers the requests of clients connecting to the shared memory with the given name (e.g. SERVICE_DEFAULT_NAME)
+ * with the current snapshot of snapshots, using numThreads threads (at most SERVICE_MAX_THREADS).
+ * A service that was left behind with the same name (e.g. by a crashed process) is replaced, and its clients see it stop.
+ * Every thread uses one reader of snapshots until the service is stopped.
+ * Returns 1 on success, or 0 when the shared memory or the threads cannot be created.
+ */
+int startResistanceService(ResistanceService * service, MapSnapshots * snapshots, const char * name, unsigned int numThreads);
+
+/*
+ * Stops the given service: the threads finish the requests they are answering, and waiting clients return NAN (or NULL).
+ * The shared memory is removed, so new clients cannot connect anymore.
+ */
+void stopResistanceService(ResistanceService * service);
+
+
+/*
+ * Answers all requests of the client in the given slot of service, with the snapshot reader of the calling thread.
+ * Returns the number of requests answered.
+ */
+static unsigned int serveServiceSlot(ResistanceService * service, int reader, unsigned int index) {
+    ServiceSlot * slot = &(service->region->slots[index]);
+    unsigned int head = atomic_load_explicit(&(slot->head), memory_order_acquire);
+    unsigned int tail = atomic_load_explicit(&(slot->tail), memory_order_relaxed);
+    if (head == tail) {
+        return 0;
+    }
+    unsigned int numServed = head - tail;
+    // The head is written by the client, so never answer more requests than the ring holds
+    if (numServed > SERVICE_RING_SIZE) {
+        numServed = SERVICE_RING_SIZE;
+    }
+    MapSnapshot * snapshot = acquireMapSnapshot(service->snapshots, reader);
+    BorderCache * cache = &(service->caches[index]);
+    keepSnapshotCache(snapshot, cache);
+    unsigned int i = 0;
+    for (i = 0; i < numServed; i++) {
+        ServiceRequest * request = &(slot->requests[(tail + i) % SERVICE_RING_SIZE]);
+        unsigned int numObstacles = request->numObstacles;
+        if (numObstacles > SERVICE_MAX_OBSTACLES) {
+            request->resistance = NAN;
+        } else {
+            request->resistance = guideGetResistanceCached(&(snapshot->guide), cache, request->x, request->y, request->phi,
+                request->forceX, request->forceY, numObstacles, request->obstacles);
+        }
+        request->version = snapshot->version;
+    }
+    releaseSnapshot(service->snapshots, reader);
+    // Hand the answers to the client before checking whether it sleeps (see waitServiceRequest())
+    atomic_store_explicit(&(slot->tail), tail + numServed, memory_order_seq_cst);
+    if (atomic_load_explicit(&(slot->waiting), memory_order_seq_cst)) {
+        serviceWake(&(slot->tail));
+    }
+    atomic_fetch_add_explicit(&(service->region->numServed), numServed, memory_order_relaxed);
+    return numServed;
+}
+
+/*
+ * Answers the requests of the client slots of a ServiceThread until the service stops, and sleeps on its doorbell when there are none.
+ */
+static void * runServiceThread(void * argument) {
+    ServiceThread * thread = (ServiceThread *) argument;
+    ResistanceService * service = thread->service;
+    ServiceRegion * region = service->region;
+    ServiceDoorbell * doorbell = &(region->doorbells[thread->index]);
+    int spin = getServiceSpin();
+    int idle = 0;
+    while (atomic_load_explicit(&(region->running), memory_order_relaxed)) {
+        unsigned int numSlots = atomic_load_explicit(&(region->numSlots), memory_order_relaxed);
+        unsigned int numServed = 0;
+        unsigned int i = 0;
+        for (i = thread->index; i < numSlots; i += region->numThreads) {
+            numServed += serveServiceSlot(service, thread->reader, i);
+        }
+        if (numServed > 0 || ++idle < spin) {
+            if (numServed > 0) {
+                idle = 0;
+            }
+            servicePause();
+            continue;
+        }
+
+        // Announce that the thread sleeps before checking the rings once more (see submitServiceRequest())
+        unsigned int value = atomic_load(&(doorbell->value));
+        atomic_store_explicit(&(doorbell->sleeping), 1, memory_order_seq_cst);
+        numSlots = atomic_load(&(region->numSlots));
+        int pending = 0;
+        for (i = thread->index; i < numSlots && !pending; i += region->numThreads) {
+            ServiceSlot * slot = &(region->slots[i]);
+            pending = atomic_load_explicit(&(slot->head), memory_order_seq_cst) != atomic_load_explicit(&(slot->tail), memory_order_relaxed);
+        }
+        if (!pending) {
+            serviceWait(&(doorbell->value), value);
+        }
+        atomic_store_explicit(&(doorbell->sleeping), 0, memory_order_relaxed);
+        idle = 0;
+    }
+    return NULL;
+}
+
+int startResistanceService(ResistanceService * service, MapSnapshots * snapshots, const char * name, unsigned int numThreads) {
+    memset(service, 0, sizeof(ResistanceService));
+    if (numThreads == 0 || numThreads > SERVICE_MAX_THREADS || strlen(name) >= sizeof(service->name)) {
+        return 0;
+    }
+    service->snapshots = snapshots;
+    strcpy(service->name, name);
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return 0;
+    }
+    if (ftruncate(fd, sizeof(ServiceRegion)) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    ServiceRegion * region = (ServiceRegion *) mmap(NULL, sizeof(ServiceRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        shm_unlink(name);
+        return 0;
+    }
+    // The new shared memory is zero filled, which makes every slot free and every ring empty
+    region->size = sizeof(ServiceRegion);
+    region->format = SERVICE_FORMAT;
+    region->pid = (int) getpid();
+    region->numThreads = numThreads;
+    atomic_store(&(region->running), 1);
+    service->region = region;
+
+    unsigned int i = 0;
+    for (i = 0; i < numThreads; i++) {
+        ServiceThread * thread = &(service->threads[i]);
+        thread->service = service;
+        thread->index = i;
+        thread->reader = registerSnapshotReader(snapshots);
+        if (thread->reader < 0 || pthread_create(&(thread->thread), NULL, runServiceThread, thread) != 0) {
+            if (thread->reader >= 0) {
+                unregisterSnapshotReader(snapshots, thread->reader);
+            }
+            service->numThreads = i;
+            stopResistanceService(service);
+            return 0;
+        }
+        service->numThreads = i + 1;
+    }
+    // Clients only connect once the magic is there, so they never see a region that is being set up
+    atomic_thread_fence(memory_order_release);
+    region->magic = SERVICE_MAGIC;
+    return 1;
+}
+
+void stopResistanceService(ResistanceService * service) {
+    ServiceRegion * region = service->region;
+    if (region == NULL) {
+        return;
+    }
+    atomic_store(&(region->running), 0);
+    unsigned int i = 0;
+    for (i = 0; i < service->numThreads; i++) {
+        atomic_fetch_add(&(region->doorbells[i].value), 1);
+        serviceWake(&(region->doorbells[i].value));
+    }
+    for (i = 0; i < service->numThreads; i++) {
+        pthread_join(service->threads[i].thread, NULL);
+        unregisterSnapshotReader(service->snapshots, service->threads[i].reader);
+    }
+    // Wake the clients that wait for an answer, they return as the service no longer runs
+    for (i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        serviceWake(&(region->slots[i].tail));
+        freeBorderCache(&(service->caches[i]));
+    }
+    shm_unlink(service->name);
+    munmap(region, sizeof(ServiceRegion));
+    service->region = NULL;
+}
+
+#endif
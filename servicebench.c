@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include "fleet.h"
+#include "service.h"
+
+// Number of short border lines in the dense area of the map
+#define NUM_DENSE_BORDERS 2000
+// Number of queries measured per client
+#define NUM_QUERIES 200000
+// Maximum number of client processes
+#define MAX_CLIENTS 3
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+unsigned long long nanoseconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+int compareLatencies(const void * a, const void * b) {
+    unsigned long long la = *(const unsigned long long *) a;
+    unsigned long long lb = *(const unsigned long long *) b;
+    return (la > lb) - (la < lb);
+}
+
+/*
+ * Latencies and results of one client, in memory shared with the benchmark process.
+ */
+typedef struct ClientResult {
+    unsigned long long latencies[NUM_QUERIES];
+    double resistances[NUM_QUERIES];
+    int connected;
+} ClientResult;
+
+/*
+ * Moves the robot at x, y a few centimeters, like between two control ticks, and draws the force of its next query from seed.
+ */
+void nextQuery(unsigned int * seed, double * x, double * y, double * forceX, double * forceY) {
+    *x = fmin(fmax(*x + (rand_r(seed) / (double) RAND_MAX - 0.5) * 0.05, -4), 4);
+    *y = fmin(fmax(*y + (rand_r(seed) / (double) RAND_MAX - 0.5) * 0.05, -6), 6);
+    *forceX = (rand_r(seed) / (double) RAND_MAX - 0.5) * 20;
+    *forceY = (rand_r(seed) / (double) RAND_MAX - 0.5) * 20;
+}
+
+// Two obstacles that every query passes along, such that the obstacles are copied like in the S-functions
+double obstacles[4] = {1.5, 2, -1, -3};
+
+/*
+ * Runs the walk of the client with the given number in process, with its own cache of guide.
+ */
+void runInProcess(BlindGuide * guide, unsigned int client, ClientResult * result) {
+    BorderCache cache;
+    memset(&cache, 0, sizeof(BorderCache));
+    unsigned int seed = client + 1;
+    double x = 0, y = 0, forceX = 0, forceY = 0;
+    int i = 0;
+    for (i = 0; i < NUM_QUERIES; i++) {
+        nextQuery(&seed, &x, &y, &forceX, &forceY);
+        unsigned long long start = nanoseconds();
+        result->resistances[i] = guideGetResistanceCached(guide, &cache, x, y, 0, forceX, forceY, 2, obstacles);
+        result->latencies[i] = nanoseconds() - start;
+    }
+    freeBorderCache(&cache);
+}
+
+/*
+ * Runs the walk of the client with the given number against the service with the given name.
+ */
+void runClient(const char * name, unsigned int client, ClientResult * result) {
+    ServiceClient connection;
+    if (!connectResistanceService(&connection, name)) {
+        return;
+    }
+    result->connected = 1;
+    unsigned int seed = client + 1;
+    double x = 0, y = 0, forceX = 0, forceY = 0;
+    int i = 0;
+    for (i = 0; i < NUM_QUERIES; i++) {
+        nextQuery(&seed, &x, &y, &forceX, &forceY);
+        unsigned long long start = nanoseconds();
+        result->resistances[i] = serviceGetResistance(&connection, x, y, 0, forceX, forceY, 2, obstacles);
+        result->latencies[i] = nanoseconds() - start;
+    }
+    disconnectResistanceService(&connection);
+}
+
+/*
+ * Prints the latencies of the first numClients results, and the number of resistances that differ from those in expected.
+ */
+void report(const char * mode, ClientResult * results, ClientResult * expected, size_t numClients) {
+    size_t numLatencies = numClients * NUM_QUERIES;
+    unsigned long long * latencies = (unsigned long long *) malloc(numLatencies * sizeof(unsigned long long));
+    size_t mismatches = 0;
+    size_t i = 0;
+    for (i = 0; i < numClients; i++) {
+        memcpy(&latencies[i * NUM_QUERIES], results[i].latencies, NUM_QUERIES * sizeof(unsigned long long));
+        int q = 0;
+        for (q = 0; q < NUM_QUERIES; q++) {
+            mismatches += results[i].resistances[q] != expected[i].resistances[q];
+        }
+    }
+    qsort(latencies, numLatencies, sizeof(unsigned long long), compareLatencies);
+    printf("%s\t%zu\t%llu\t%llu\t%llu\t%llu\t%zu\n", mode, numClients, latencies[numLatencies / 2], latencies[(numLatencies * 99) / 100],
+        latencies[(numLatencies * 999) / 1000], latencies[numLatencies - 1], mismatches);
+    free(latencies);
+}
+
+int main() {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    guideInitializeBorders(&guide);
+    srand(1);
+    // Clutter the left part of the map, like snapbench
+    int i = 0;
+    for (i = 0; i < NUM_DENSE_BORDERS; i++) {
+        double x = randomBetween(-4, -2);
+        double y = randomBetween(-6, 6);
+        guideAddBorder(&guide, x, y, x + randomBetween(-0.05, 0.05), y + randomBetween(-0.05, 0.05), RIGHT);
+    }
+    MapSnapshots snapshots;
+    if (!createMapSnapshots(&snapshots, &guide)) {
+        printf("Not enough memory for the snapshots\n");
+        return 1;
+    }
+
+    // The clients write their results in memory shared with this process
+    ClientResult * expected = (ClientResult *) calloc(MAX_CLIENTS, sizeof(ClientResult));
+    ClientResult * results = (ClientResult *) mmap(NULL, MAX_CLIENTS * sizeof(ClientResult), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (expected == NULL || results == MAP_FAILED) {
+        printf("Not enough memory for the results\n");
+        return 1;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/blindguide-bench-%d", (int) getpid());
+    static ResistanceService service;
+    if (!startResistanceService(&service, &snapshots, name, 1)) {
+        printf("Cannot create the shared memory %s\n", name);
+        return 1;
+    }
+    // Keep a core for the thread of the service
+    size_t maxClients = getNumCores() > 2 ? getNumCores() - 1 : 1;
+    if (maxClients > MAX_CLIENTS) {
+        maxClients = MAX_CLIENTS;
+    }
+
+    printf("%zu border lines, %d queries per client\n", guide.borderlines.size, NUM_QUERIES);
+    printf("mode\tclients\tp50 ns\tp99 ns\tp99.9 ns\tmax ns\tmismatches\n");
+    size_t c = 0;
+    for (c = 0; c < maxClients; c++) {
+        runInProcess(&guide, (unsigned int) c, &expected[c]);
+    }
+    report("in-process", expected, expected, 1);
+    size_t numClients = 1;
+    for (numClients = 1; numClients <= maxClients; numClients += 2) {
+        memset(results, 0, MAX_CLIENTS * sizeof(ClientResult));
+        for (c = 0; c < numClients; c++) {
+            if (fork() == 0) {
+                runClient(name, (unsigned int) c, &results[c]);
+                _exit(0);
+            }
+        }
+        for (c = 0; c < numClients; c++) {
+            wait(NULL);
+        }
+        for (c = 0; c < numClients; c++) {
+            if (!results[c].connected) {
+                printf("Client %zu cannot connect to %s\n", c, name);
+                stopResistanceService(&service);
+                return 1;
+            }
+        }
+        report("service", results, expected, numClients);
+    }
+    printf("%lu requests served\n", atomic_load(&(service.region->numServed)));
+
+    stopResistanceService(&service);
+    munmap(results, MAX_CLIENTS * sizeof(ClientResult));
+    free(expected);
+    freeMapSnapshots(&snapshots);
+    freeBlindGuide(&guide);
+    return 0;
+}
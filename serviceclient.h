@@ -0,0 +1,376 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SERVICECLIENT_H
+#define SERVICECLIENT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Waiting threads sleep on a futex where possible, and poll with short sleeps otherwise
+#ifdef __linux__
+    #define SERVICE_FUTEX 1
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#else
+    #define SERVICE_FUTEX 0
+#endif
+
+// Name of the shared memory of the service when none is given
+#define SERVICE_DEFAULT_NAME "/blindguide"
+// First bytes of the shared memory of a service
+#define SERVICE_MAGIC 0x56534742u
+// Version of the layout of the shared memory, a client only connects to a service with the same version
+#define SERVICE_FORMAT 1
+// Maximum number of clients connected to a service at the same time
+#define SERVICE_MAX_CLIENTS 64
+// Maximum number of threads of a service
+#define SERVICE_MAX_THREADS 16
+// Number of requests a client can have in flight (must be a power of two)
+#define SERVICE_RING_SIZE 16
+// Maximum number of obstacles of a request (the balls of the S-functions)
+#define SERVICE_MAX_OBSTACLES 8
+// Size in bytes of a cache line, which the client and server sides of a ring each get to themselves
+#define SERVICE_CACHE_LINE 64
+// Number of times a waiting thread polls before it goes to sleep, on machines with more than one core (with one core, polling only delays the other side)
+#define SERVICE_SPIN 20000
+// Time in nanoseconds a sleeping thread waits before checking whether the other side is still there
+#define SERVICE_TIMEOUT 10000000
+
+/*
+ * A request for one resistance, written in place in the shared memory by the client and answered in place by the service.
+ * x, y, phi, forceX, forceY, numObstacles, obstacles: the arguments of getResistance()
+ * resistance: the resistance, set by the service (NAN when numObstacles exceeds SERVICE_MAX_OBSTACLES)
+ * version: version of the map that gave the resistance, the number of map updates the service published before it (see MapSnapshot), set by the service
+ */
+typedef struct ServiceRequest {
+    double x;
+    double y;
+    double phi;
+    double forceX;
+    double forceY;
+    unsigned int numObstacles;
+    double obstacles[2 * SERVICE_MAX_OBSTACLES];
+    double resistance;
+    unsigned long version;
+} ServiceRequest;
+
+/*
+ * The ring of requests of one client. The client fills requests[head % SERVICE_RING_SIZE] and increments head,
+ * the service answers requests[tail % SERVICE_RING_SIZE] and increments tail, so a request is answered once tail has passed it.
+ * owner: process id of the client, 0 when the slot is free
+ * head: number of requests submitted by the client
+ * tail: number of requests answered by the service
+ * waiting: 1 while the client sleeps on tail
+ */
+typedef struct ServiceSlot {
+    _Alignas(SERVICE_CACHE_LINE) atomic_int owner;
+    atomic_uint head;
+    _Alignas(SERVICE_CACHE_LINE) atomic_uint tail;
+    atomic_int waiting;
+    _Alignas(SERVICE_CACHE_LINE) struct ServiceRequest requests[SERVICE_RING_SIZE];
+} ServiceSlot;
+
+/*
+ * Where a thread of the service sleeps when none of its clients has requests.
+ * value: incremented by a client that submits a request while the thread sleeps
+ * sleeping: 1 while the thread sleeps on value
+ */
+typedef struct ServiceDoorbell {
+    _Alignas(SERVICE_CACHE_LINE) atomic_uint value;
+    atomic_int sleeping;
+} ServiceDoorbell;
+
+/*
+ * The shared memory of a service.
+ * magic, format, size: SERVICE_MAGIC, SERVICE_FORMAT and the size of the structure, checked by the clients
+ * running: 1 while the service answers requests
+ * pid: process id of the service, so clients notice a service that was killed
+ * numThreads: number of threads of the service, client slot i is served by thread i % numThreads
+ * numSlots: one more than the highest slot that has been used, so the threads do not scan slots that were never used
+ * numServed: number of requests answered so far
+ * doorbells: a doorbell for every thread
+ * slots: a slot for every client
+ */
+typedef struct ServiceRegion {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t size;
+    atomic_int running;
+    int pid;
+    unsigned int numThreads;
+    atomic_uint numSlots;
+    atomic_ulong numServed;
+    struct ServiceDoorbell doorbells[SERVICE_MAX_THREADS];
+    struct ServiceSlot slots[SERVICE_MAX_CLIENTS];
+} ServiceRegion;
+
+/*
+ * A connection of a process to a service.
+ * region: the shared memory of the service
+ * slot: the slot of the client
+ * doorbell: the doorbell of the thread that serves the slot
+ * head: number of requests submitted, a copy of slot->head
+ * spin: number of times the client polls for an answer before it goes to sleep (see getServiceSpin())
+ */
+typedef struct ServiceClient {
+    ServiceRegion * region;
+    ServiceSlot * slot;
+    ServiceDoorbell * doorbell;
+    unsigned int head;
+    int spin;
+} ServiceClient;
+
+/*
+ * Connects the given client to the service with the given shared memory name (e.g. SERVICE_DEFAULT_NAME), which a service of the same SERVICE_FORMAT must have started.
+ * A client must only be used by one thread at a time, so give every thread its own client.
+ * Returns 1 on success, or 0 when there is no such service, or when all SERVICE_MAX_CLIENTS slots are in use.
+ */
+int connectResistanceService(ServiceClient * client, const char * name);
+
+/*
+ * Disconnects the given client from its service, such that its slot can be used by another client.
+ * Slots of processes that exited without disconnecting are taken over by new clients.
+ */
+void disconnectResistanceService(ServiceClient * client);
+
+/*
+ * Compute the necessary resistance like getResistance(), with the map of the service of the given client.
+ * Waits for the answer, polling SERVICE_SPIN times before going to sleep when the machine has more than one core.
+ * Returns the resistance, or NAN when the service stopped (or its process exited) or numObstacles exceeds SERVICE_MAX_OBSTACLES.
+ */
+double serviceGetResistance(ServiceClient * client, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Returns the next free request of the given client in the shared memory, to fill in place and hand to submitServiceRequest(),
+ * or NULL when SERVICE_RING_SIZE requests are still in flight.
+ * This lets a client have several requests in flight (e.g. the poses of a planner) without copying them.
+ */
+ServiceRequest * beginServiceRequest(ServiceClient * client);
+
+/*
+ * Submits the request returned by beginServiceRequest(), and wakes the service when it sleeps.
+ * Returns the ticket of the request, to wait for with waitServiceRequest().
+ */
+unsigned int submitServiceRequest(ServiceClient * client);
+
+/*
+ * Waits until the request with the given ticket has been answered, and returns it with its resistance and version set,
+ * or NULL when the service stopped (or its process exited). Requests are answered in the order they were submitted.
+ * The request stays valid until SERVICE_RING_SIZE further requests have been begun.
+ */
+ServiceRequest * waitServiceRequest(ServiceClient * client, unsigned int ticket);
+
+/*
+ * Returns the number of requests the service of the given client has answered so far.
+ */
+unsigned long getNumServed(ServiceClient * client);
+
+
+/*
+ * Sleeps while the 32 bit word at address still holds value, for at most SERVICE_TIMEOUT nanoseconds.
+ * May also return earlier, so the caller checks its condition again.
+ */
+static void serviceWait(atomic_uint * address, unsigned int value) {
+    #if SERVICE_FUTEX
+        struct timespec timeout = {0, SERVICE_TIMEOUT};
+        // Not FUTEX_PRIVATE_FLAG, as the word is shared with other processes
+        syscall(SYS_futex, (uint32_t *) address, FUTEX_WAIT, value, &timeout, NULL, 0);
+    #else
+        struct timespec pause = {0, 50000};
+        if (atomic_load(address) == value) {
+            nanosleep(&pause, NULL);
+        }
+    #endif
+}
+
+/*
+ * Wakes all threads sleeping on the 32 bit word at address (see serviceWait()).
+ */
+static void serviceWake(atomic_uint * address) {
+    #if SERVICE_FUTEX
+        syscall(SYS_futex, (uint32_t *) address, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+    #else
+        (void) address;
+    #endif
+}
+
+/*
+ * Hints the processor that the calling thread is polling.
+ */
+static void servicePause() {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+    #endif
+}
+
+/*
+ * Returns the number of times a waiting thread polls before it goes to sleep: SERVICE_SPIN, or 0 on a machine with one core.
+ */
+static int getServiceSpin() {
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SERVICE_SPIN : 0;
+}
+
+/*
+ * Returns 1 when the process with the given id no longer exists, 0 otherwise.
+ */
+static int serviceOwnerExited(int pid) {
+    return kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+int connectResistanceService(ServiceClient * client, const char * name) {
+    memset(client, 0, sizeof(ServiceClient));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t) sizeof(ServiceRegion)) {
+        close(fd);
+        return 0;
+    }
+    ServiceRegion * region = (ServiceRegion *) mmap(NULL, sizeof(ServiceRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return 0;
+    }
+    if (region->magic != SERVICE_MAGIC || region->format != SERVICE_FORMAT || region->size != sizeof(ServiceRegion)
+            || !atomic_load(&(region->running)) || serviceOwnerExited(region->pid) || region->numThreads == 0 || region->numThreads > SERVICE_MAX_THREADS) {
+        munmap(region, sizeof(ServiceRegion));
+        return 0;
+    }
+
+    // Take a free slot, or the slot of a client process that exited without disconnecting
+    int pid = (int) getpid();
+    unsigned int i = 0;
+    for (i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        int owner = atomic_load(&(region->slots[i].owner));
+        if ((owner == 0 || (owner != pid && serviceOwnerExited(owner))) && atomic_compare_exchange_strong(&(region->slots[i].owner), &owner, pid)) {
+            break;
+        }
+    }
+    if (i == SERVICE_MAX_CLIENTS) {
+        munmap(region, sizeof(ServiceRegion));
+        return 0;
+    }
+    unsigned int numSlots = atomic_load(&(region->numSlots));
+    while (numSlots <= i && !atomic_compare_exchange_weak(&(region->numSlots), &numSlots, i + 1)) {
+    }
+    client->region = region;
+    client->slot = &(region->slots[i]);
+    client->doorbell = &(region->doorbells[i % region->numThreads]);
+    // Requests the previous owner left behind are answered before the first request of this client
+    client->head = atomic_load(&(client->slot->head));
+    client->spin = getServiceSpin();
+    atomic_store(&(client->slot->waiting), 0);
+    return 1;
+}
+
+void disconnectResistanceService(ServiceClient * client) {
+    if (client->region == NULL) {
+        return;
+    }
+    atomic_store(&(client->slot->owner), 0);
+    munmap(client->region, sizeof(ServiceRegion));
+    memset(client, 0, sizeof(ServiceClient));
+}
+
+ServiceRequest * beginServiceRequest(ServiceClient * client) {
+    if (client->head - atomic_load_explicit(&(client->slot->tail), memory_order_acquire) >= SERVICE_RING_SIZE) {
+        return NULL;
+    }
+    return &(client->slot->requests[client->head % SERVICE_RING_SIZE]);
+}
+
+unsigned int submitServiceRequest(ServiceClient * client) {
+    client->head++;
+    // Publish the request before checking whether the thread sleeps: a thread that goes to sleep at the same moment
+    // checks the rings after announcing it sleeps, so either it sees this request or this client sees it sleeping
+    atomic_store_explicit(&(client->slot->head), client->head, memory_order_seq_cst);
+    if (atomic_load_explicit(&(client->doorbell->sleeping), memory_order_seq_cst)) {
+        atomic_fetch_add(&(client->doorbell->value), 1);
+        serviceWake(&(client->doorbell->value));
+    }
+    return client->head;
+}
+
+ServiceRequest * waitServiceRequest(ServiceClient * client, unsigned int ticket) {
+    ServiceSlot * slot = client->slot;
+    ServiceRequest * request = &(slot->requests[(ticket - 1) % SERVICE_RING_SIZE]);
+    // Tickets wrap around, so compare the distance instead of the tickets
+    unsigned int tail = atomic_load_explicit(&(slot->tail), memory_order_acquire);
+    int spins = 0;
+    for (spins = 0; (int) (tail - ticket) < 0 && spins < client->spin; spins++) {
+        servicePause();
+        tail = atomic_load_explicit(&(slot->tail), memory_order_acquire);
+    }
+    while ((int) (tail - ticket) < 0) {
+        if (!atomic_load(&(client->region->running)) || serviceOwnerExited(client->region->pid)) {
+            return NULL;
+        }
+        atomic_store_explicit(&(slot->waiting), 1, memory_order_seq_cst);
+        tail = atomic_load_explicit(&(slot->tail), memory_order_seq_cst);
+        if ((int) (tail - ticket) < 0) {
+            serviceWait(&(slot->tail), tail);
+            tail = atomic_load_explicit(&(slot->tail), memory_order_acquire);
+        }
+        atomic_store_explicit(&(slot->waiting), 0, memory_order_relaxed);
+    }
+    return request;
+}
+
+double serviceGetResistance(ServiceClient * client, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    if (numObstacles > SERVICE_MAX_OBSTACLES) {
+        return NAN;
+    }
+    ServiceRequest * request = beginServiceRequest(client);
+    while (request == NULL) {
+        // Requests begun with beginServiceRequest() are still in flight, wait for the oldest
+        if (waitServiceRequest(client, client->head - SERVICE_RING_SIZE + 1) == NULL) {
+            return NAN;
+        }
+        request = beginServiceRequest(client);
+    }
+    request->x = x;
+    request->y = y;
+    request->phi = phi;
+    request->forceX = forceX;
+    request->forceY = forceY;
+    request->numObstacles = numObstacles;
+    if (numObstacles > 0) {
+        memcpy(request->obstacles, obstacles, 2 * numObstacles * sizeof(double));
+    }
+    request = waitServiceRequest(client, submitServiceRequest(client));
+    return request != NULL ? request->resistance : NAN;
+}
+
+unsigned long getNumServed(ServiceClient * client) {
+    return atomic_load_explicit(&(client->region->numServed), memory_order_relaxed);
+}
+
+#endif
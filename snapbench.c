@@ -0,0 +1,199 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fleet.h"
+#include "snapshot.h"
+
+// Number of short border lines in the dense area of the map
+#define NUM_DENSE_BORDERS 2000
+// Number of queries measured per reader
+#define NUM_QUERIES 200000
+// Number of border lines the writer keeps adding (and removing again) on top of the map
+#define NUM_MOVING_BORDERS 100
+// Time in microseconds between two updates of the writer (far more often than a perception stack would)
+#define UPDATE_INTERVAL 1000
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+unsigned long long nanoseconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+int compareLatencies(const void * a, const void * b) {
+    unsigned long long la = *(const unsigned long long *) a;
+    unsigned long long lb = *(const unsigned long long *) b;
+    return (la > lb) - (la < lb);
+}
+
+/*
+ * A control loop that queries the snapshots while walking through the map.
+ */
+typedef struct Reader {
+    MapSnapshots * snapshots;
+    unsigned int seed;
+    unsigned long long latencies[NUM_QUERIES];
+    double sum;
+    pthread_t thread;
+} Reader;
+
+/*
+ * The perception stack, which keeps moving border lines until stop is set.
+ */
+typedef struct Writer {
+    MapSnapshots * snapshots;
+    atomic_int stop;
+    unsigned long numUpdates;
+    pthread_t thread;
+} Writer;
+
+void * runReader(void * argument) {
+    Reader * reader = (Reader *) argument;
+    int id = registerSnapshotReader(reader->snapshots);
+    BorderCache cache;
+    memset(&cache, 0, sizeof(BorderCache));
+    double x = 0, y = 0;
+    int i = 0;
+    for (i = 0; i < NUM_QUERIES; i++) {
+        // Move a few centimeters per step, like a robot between two control ticks
+        x = fmin(fmax(x + (rand_r(&reader->seed) / (double) RAND_MAX - 0.5) * 0.05, -4), 4);
+        y = fmin(fmax(y + (rand_r(&reader->seed) / (double) RAND_MAX - 0.5) * 0.05, -6), 6);
+        double forceX = (rand_r(&reader->seed) / (double) RAND_MAX - 0.5) * 20;
+        double forceY = (rand_r(&reader->seed) / (double) RAND_MAX - 0.5) * 20;
+        unsigned long long start = nanoseconds();
+        reader->sum += snapshotGetResistance(reader->snapshots, id, &cache, x, y, 0, forceX, forceY, 0, NULL);
+        reader->latencies[i] = nanoseconds() - start;
+    }
+    freeBorderCache(&cache);
+    unregisterSnapshotReader(reader->snapshots, id);
+    return NULL;
+}
+
+void * runWriter(void * argument) {
+    Writer * writer = (Writer *) argument;
+    BorderHandle handles[NUM_MOVING_BORDERS];
+    unsigned int seed = 7;
+    int numHandles = 0;
+    while (!atomic_load(&(writer->stop))) {
+        BlindGuide * next = beginMapUpdate(writer->snapshots);
+        if (next == NULL) {
+            break;
+        }
+        // Handles stay valid in the copy, so the border added by an earlier update can be removed from this one
+        int k = numHandles % NUM_MOVING_BORDERS;
+        if (numHandles >= NUM_MOVING_BORDERS) {
+            guideRemoveBorder(next, handles[k]);
+        }
+        double x = (rand_r(&seed) / (double) RAND_MAX - 0.5) * 8;
+        double y = (rand_r(&seed) / (double) RAND_MAX - 0.5) * 12;
+        handles[k] = guideAddBorder(next, x, y, x + 0.5, y + 0.5, RIGHT);
+        numHandles++;
+        publishMapUpdate(writer->snapshots);
+        writer->numUpdates++;
+        struct timespec interval = {0, UPDATE_INTERVAL * 1000};
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+/*
+ * Runs numReaders readers on snapshots, with a writer updating the map meanwhile when withWriter is 1, and prints their latencies.
+ */
+void measure(MapSnapshots * snapshots, size_t numReaders, int withWriter) {
+    Reader * readers = (Reader *) calloc(numReaders, sizeof(Reader));
+    Writer writer;
+    memset(&writer, 0, sizeof(Writer));
+    writer.snapshots = snapshots;
+    atomic_init(&(writer.stop), 0);
+    unsigned long long start = nanoseconds();
+    if (withWriter) {
+        pthread_create(&(writer.thread), NULL, runWriter, &writer);
+    }
+    size_t i = 0;
+    for (i = 0; i < numReaders; i++) {
+        readers[i].snapshots = snapshots;
+        readers[i].seed = (unsigned int) i + 1;
+        pthread_create(&(readers[i].thread), NULL, runReader, &readers[i]);
+    }
+    for (i = 0; i < numReaders; i++) {
+        pthread_join(readers[i].thread, NULL);
+    }
+    atomic_store(&(writer.stop), 1);
+    if (withWriter) {
+        pthread_join(writer.thread, NULL);
+    }
+    double seconds = (nanoseconds() - start) * 1e-9;
+
+    // Merge the latencies of all readers
+    size_t numLatencies = numReaders * NUM_QUERIES;
+    unsigned long long * latencies = (unsigned long long *) malloc(numLatencies * sizeof(unsigned long long));
+    for (i = 0; i < numReaders; i++) {
+        memcpy(&latencies[i * NUM_QUERIES], readers[i].latencies, NUM_QUERIES * sizeof(unsigned long long));
+    }
+    qsort(latencies, numLatencies, sizeof(unsigned long long), compareLatencies);
+    printf("%s\t%zu\t%.0f\t%llu\t%llu\t%llu\t%llu\n", withWriter ? "updating" : "static", numReaders, writer.numUpdates / seconds,
+        latencies[numLatencies / 2], latencies[(numLatencies * 99) / 100], latencies[(numLatencies * 999) / 1000], latencies[numLatencies - 1]);
+    free(latencies);
+    free(readers);
+}
+
+int main() {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    guideInitializeBorders(&guide);
+    srand(1);
+    // Clutter the left part of the map, so that the copy made for every update is not trivial
+    int i = 0;
+    for (i = 0; i < NUM_DENSE_BORDERS; i++) {
+        double x = randomBetween(-4, -2);
+        double y = randomBetween(-6, 6);
+        guideAddBorder(&guide, x, y, x + randomBetween(-0.05, 0.05), y + randomBetween(-0.05, 0.05), RIGHT);
+    }
+    MapSnapshots snapshots;
+    if (!createMapSnapshots(&snapshots, &guide)) {
+        printf("Not enough memory for the snapshots\n");
+        return 1;
+    }
+    // Keep a core for the writer
+    size_t numReaders = getNumCores() > 2 ? getNumCores() - 1 : 1;
+    if (numReaders > 4) {
+        numReaders = 4;
+    }
+
+    printf("%zu border lines, %d queries per reader\n", guide.borderlines.size, NUM_QUERIES);
+    printf("map\treaders\tupdates/s\tp50 ns\tp99 ns\tp99.9 ns\tmax ns\n");
+    measure(&snapshots, numReaders, 0);
+    measure(&snapshots, numReaders, 1);
+    printf("%lu snapshots published\n", getNumPublished(&snapshots));
+
+    freeMapSnapshots(&snapshots);
+    freeBlindGuide(&guide);
+    return 0;
+}
@@ -0,0 +1,421 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "blindguide.h"
+
+// Maximum number of readers (e.g. control loops) of a MapSnapshots structure
+#define SNAPSHOT_MAX_READERS 64
+// Maximum number of replaced snapshots that wait for their last readers, before publishing waits for them
+#define SNAPSHOT_MAX_RETIRED 8
+// Size in bytes of a cache line, which every reader gets to itself
+#define SNAPSHOT_CACHE_LINE 64
+// Number of earlier updates of which a snapshot remembers the area they changed
+#define SNAPSHOT_HISTORY 16
+
+/*
+ * Area of the map that was changed by an update.
+ * fromRevision: revision of the snapshot that was updated
+ * minX, minY, maxX, maxY: bounding box of the border lines that were added, removed, enabled, disabled or moved (both where they were and where they are)
+ */
+typedef struct SnapshotChange {
+    unsigned long fromRevision;
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+} SnapshotChange;
+
+/*
+ * A version of the map of a MapSnapshots structure.
+ * guide: the guide with the map, which readers get from acquireSnapshot()
+ * changes: the areas changed by the last numChanges updates that led to this snapshot, oldest first.
+ *          A BorderCache that was filled from an earlier snapshot is still valid when it lies outside all areas changed since,
+ *          so the control loop only refreshes its cache for updates near the robot.
+ * version: number of updates that were published before this snapshot, 0 for the first snapshot
+ */
+typedef struct MapSnapshot {
+    BlindGuide guide;
+    struct SnapshotChange changes[SNAPSHOT_HISTORY];
+    size_t numChanges;
+    unsigned long version;
+} MapSnapshot;
+
+/*
+ * A reader of a MapSnapshots structure, which announces the snapshot it is using.
+ * snapshot: the snapshot the reader is querying, NULL between queries. A snapshot is only freed when no reader announces it.
+ * used: 1 when the reader has been handed out by registerSnapshotReader(), 0 otherwise
+ */
+typedef struct SnapshotReader {
+    _Alignas(SNAPSHOT_CACHE_LINE) _Atomic(MapSnapshot *) snapshot;
+    atomic_int used;
+} SnapshotReader;
+
+/*
+ * Versions of a map that can be updated while other threads keep querying it (read-copy-update).
+ * Readers query the current snapshot without ever waiting or allocating, see snapshotGetResistance().
+ * A writer changes a copy of the current snapshot (see beginMapUpdate()), and publishes it with a single atomic pointer swap (see publishMapUpdate()).
+ * The replaced snapshot is freed by a later writer once no reader uses it anymore, so readers never see a map that changes under them.
+ * current: the snapshot new queries use
+ * readers: the readers, each on a cache line of its own
+ * retired: replaced snapshots that may still be used by a reader
+ * numRetired: number of snapshots in retired
+ * next: the snapshot being built by the writer, NULL when there is no update in progress
+ * lock: held by the writer from beginMapUpdate() until publishMapUpdate() or cancelMapUpdate(), so updates are made one at a time
+ * numPublished: number of snapshots published so far
+ */
+typedef struct MapSnapshots {
+    _Atomic(MapSnapshot *) current;
+    struct SnapshotReader readers[SNAPSHOT_MAX_READERS];
+    MapSnapshot * retired[SNAPSHOT_MAX_RETIRED];
+    size_t numRetired;
+    MapSnapshot * next;
+    pthread_mutex_t lock;
+    atomic_ulong numPublished;
+} MapSnapshots;
+
+/*
+ * Populates the given MapSnapshots structure, with a copy of the map and parameters of initial as its first snapshot (see guideCopyMap()).
+ * initial itself is not used afterwards.
+ * Returns 1 on success, or 0 when the memory is exhausted.
+ */
+int createMapSnapshots(MapSnapshots * snapshots, BlindGuide * initial);
+
+/*
+ * Frees all snapshots of the given MapSnapshots structure. No reader may use it anymore, and no update may be in progress.
+ */
+void freeMapSnapshots(MapSnapshots * snapshots);
+
+/*
+ * Returns the number of a free reader of snapshots for the calling thread, or -1 when all SNAPSHOT_MAX_READERS readers are in use.
+ * A reader must only be used by one thread at a time.
+ */
+int registerSnapshotReader(MapSnapshots * snapshots);
+
+/*
+ * Hands reader back to snapshots, such that it can be registered again.
+ */
+void unregisterSnapshotReader(MapSnapshots * snapshots, int reader);
+
+/*
+ * Returns the current snapshot of snapshots for reader, which stays valid (and unchanged) until releaseSnapshot().
+ * Never waits for a writer: when a writer publishes at the same moment, the reader simply takes the newer snapshot.
+ * The snapshot must only be queried with a BorderSearch or BorderCache of the reader (e.g. guideGetResistanceCached()), not with its own scratch space.
+ */
+BlindGuide * acquireSnapshot(MapSnapshots * snapshots, int reader);
+
+/*
+ * Marks that reader no longer uses the snapshot it acquired, such that it can be freed once it has been replaced.
+ */
+void releaseSnapshot(MapSnapshots * snapshots, int reader);
+
+/*
+ * Compute the necessary resistance like guideGetResistanceCached(), with the current snapshot of snapshots (see getResistance()).
+ * cache belongs to reader and must only be used with these snapshots. It is only refreshed when a newly published snapshot changed the map near it
+ * (or changed the parameters), so updates elsewhere do not slow down the query.
+ */
+double snapshotGetResistance(MapSnapshots * snapshots, int reader, BorderCache * cache, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Starts an update of the map of snapshots, and returns a copy of the current snapshot that the writer can change with the functions of blindguide.h
+ * (guideAddBorder(), guideRemoveBorder(), guideSetParams(), ...), or NULL when the memory is exhausted.
+ * Only one update is made at a time: another writer waits in beginMapUpdate() until this update is published or cancelled.
+ * The copy takes time proportional to the size of the map, but readers keep querying the current snapshot meanwhile.
+ */
+BlindGuide * beginMapUpdate(MapSnapshots * snapshots);
+
+/*
+ * Publishes the snapshot returned by beginMapUpdate(), such that every query from now on uses it, and ends the update.
+ * The replaced snapshot is freed as soon as no reader uses it anymore, by this or a later update.
+ * Only when SNAPSHOT_MAX_RETIRED replaced snapshots are still in use, this waits for the readers to finish their current queries.
+ */
+void publishMapUpdate(MapSnapshots * snapshots);
+
+/*
+ * Discards the snapshot returned by beginMapUpdate(), and ends the update.
+ */
+void cancelMapUpdate(MapSnapshots * snapshots);
+
+/*
+ * Frees the replaced snapshots of snapshots that no reader uses anymore. Must only be called by the writer, during an update.
+ * Returns the number of replaced snapshots that are still in use.
+ */
+size_t reclaimSnapshots(MapSnapshots * snapshots);
+
+/*
+ * Returns the number of snapshots that have been published since snapshots was created.
+ */
+unsigned long getNumPublished(MapSnapshots * snapshots);
+
+/*
+ * Returns a newly allocated snapshot with a copy of the map of src (see guideCopyMap()) and no changes, or NULL when the memory is exhausted.
+ */
+static MapSnapshot * copySnapshot(BlindGuide * src) {
+    MapSnapshot * copy = (MapSnapshot *) guideAllocate(sizeof(MapSnapshot));
+    if (copy == NULL) {
+        return NULL;
+    }
+    createBlindGuide(&(copy->guide));
+    copy->numChanges = 0;
+    copy->version = 0;
+    if (!guideCopyMap(&(copy->guide), src)) {
+        freeBlindGuide(&(copy->guide));
+        guideRelease(copy);
+        return NULL;
+    }
+    // Readers only read the snapshot, so it must not select its kernel during their first query
+    if (copy->guide.kernel == NULL) {
+        guideSelectBorderKernel(&(copy->guide), KERNEL_AUTO);
+    }
+    return copy;
+}
+
+/*
+ * Frees a snapshot returned by copySnapshot().
+ */
+static void freeSnapshot(MapSnapshot * snapshot) {
+    freeBlindGuide(&(snapshot->guide));
+    guideRelease(snapshot);
+}
+
+/*
+ * Extends the area of change with border line b.
+ */
+static void addToSnapshotChange(SnapshotChange * change, Borderline * b) {
+    change->minX = fmin(change->minX, fmin(b->bottom.x, b->top.x));
+    change->minY = fmin(change->minY, fmin(b->bottom.y, b->top.y));
+    change->maxX = fmax(change->maxX, fmax(b->bottom.x, b->top.x));
+    change->maxY = fmax(change->maxY, fmax(b->bottom.y, b->top.y));
+}
+
+/*
+ * Determines the area in which the border lines of to differ from those of from, where to is an updated copy of from (see beginMapUpdate()).
+ * Returns 1 on success, or 0 when the update may have changed the whole map (other parameters, or border lines that were taken out of the array).
+ */
+static int findSnapshotChange(BlindGuide * from, BlindGuide * to, SnapshotChange * change) {
+    change->fromRevision = from->revision;
+    change->minX = change->minY = INFINITY;
+    change->maxX = change->maxY = -INFINITY;
+    GuideParams * a = &(from->params);
+    GuideParams * b = &(to->params);
+    if (a->mass != b->mass || a->radius != b->radius || a->userRadius != b->userRadius || a->stopTime != b->stopTime || a->resistanceTime != b->resistanceTime
+            || a->obstacleRadius != b->obstacleRadius || a->backwardsResistance != b->backwardsResistance || a->userHandedness != b->userHandedness) {
+        return 0;
+    }
+    BorderlineArray * old = &(from->borderlines);
+    BorderlineArray * ba = &(to->borderlines);
+    if (ba->size < old->size) {
+        return 0;
+    }
+    size_t i = 0;
+    for (i = 0; i < ba->size; i++) {
+        Borderline bl = getBorderline(ba, (unsigned int) i);
+        if (i >= old->size) {
+            addToSnapshotChange(change, &bl);
+            continue;
+        }
+        Borderline before = getBorderline(old, (unsigned int) i);
+        if (ba->states[i] != old->states[i] || bl.bottom.x != before.bottom.x || bl.bottom.y != before.bottom.y
+                || bl.top.x != before.top.x || bl.top.y != before.top.y || bl.goodSide != before.goodSide) {
+            addToSnapshotChange(change, &before);
+            addToSnapshotChange(change, &bl);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Marks cache as filled from snapshot when it was filled from an earlier snapshot, and no update since changed the map within it.
+ */
+static void keepSnapshotCache(MapSnapshot * snapshot, BorderCache * cache) {
+    if (cache->guide == NULL || cache->guide == &(snapshot->guide)) {
+        return;
+    }
+    size_t i = 0;
+    while (i < snapshot->numChanges && snapshot->changes[i].fromRevision != cache->revision) {
+        i++;
+    }
+    if (i == snapshot->numChanges) {
+        return;
+    }
+    for (; i < snapshot->numChanges; i++) {
+        // The cache holds every border line with a point within its radius, so it stays valid when all changes lie outside its square
+        SnapshotChange * change = &(snapshot->changes[i]);
+        if (change->minX <= cache->center.x + cache->radius && change->maxX >= cache->center.x - cache->radius
+                && change->minY <= cache->center.y + cache->radius && change->maxY >= cache->center.y - cache->radius) {
+            return;
+        }
+    }
+    cache->guide = &(snapshot->guide);
+    cache->revision = snapshot->guide.revision;
+}
+
+int createMapSnapshots(MapSnapshots * snapshots, BlindGuide * initial) {
+    memset(snapshots, 0, sizeof(MapSnapshots));
+    MapSnapshot * first = copySnapshot(initial);
+    if (first == NULL) {
+        return 0;
+    }
+    int i = 0;
+    for (i = 0; i < SNAPSHOT_MAX_READERS; i++) {
+        atomic_init(&(snapshots->readers[i].snapshot), NULL);
+        atomic_init(&(snapshots->readers[i].used), 0);
+    }
+    atomic_init(&(snapshots->current), first);
+    atomic_init(&(snapshots->numPublished), 0);
+    pthread_mutex_init(&(snapshots->lock), NULL);
+    return 1;
+}
+
+void freeMapSnapshots(MapSnapshots * snapshots) {
+    size_t i = 0;
+    for (i = 0; i < snapshots->numRetired; i++) {
+        freeSnapshot(snapshots->retired[i]);
+    }
+    MapSnapshot * current = atomic_load(&(snapshots->current));
+    if (current != NULL) {
+        freeSnapshot(current);
+    }
+    pthread_mutex_destroy(&(snapshots->lock));
+    memset(snapshots, 0, sizeof(MapSnapshots));
+}
+
+int registerSnapshotReader(MapSnapshots * snapshots) {
+    int i = 0;
+    for (i = 0; i < SNAPSHOT_MAX_READERS; i++) {
+        int unused = 0;
+        if (atomic_compare_exchange_strong(&(snapshots->readers[i].used), &unused, 1)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void unregisterSnapshotReader(MapSnapshots * snapshots, int reader) {
+    atomic_store(&(snapshots->readers[reader].snapshot), NULL);
+    atomic_store(&(snapshots->readers[reader].used), 0);
+}
+
+/*
+ * Announces the current snapshot of snapshots for reader and returns it (see acquireSnapshot()).
+ */
+static MapSnapshot * acquireMapSnapshot(MapSnapshots * snapshots, int reader) {
+    _Atomic(MapSnapshot *) * announced = &(snapshots->readers[reader].snapshot);
+    MapSnapshot * snapshot = atomic_load_explicit(&(snapshots->current), memory_order_acquire);
+    for (;;) {
+        // Announce the snapshot before checking that it is still current: a writer that replaced it in between may not have seen the announcement,
+        // but then the check fails, and a writer that replaces it later sees the announcement and keeps the snapshot
+        atomic_store_explicit(announced, snapshot, memory_order_seq_cst);
+        MapSnapshot * current = atomic_load_explicit(&(snapshots->current), memory_order_seq_cst);
+        if (current == snapshot) {
+            return snapshot;
+        }
+        snapshot = current;
+    }
+}
+
+BlindGuide * acquireSnapshot(MapSnapshots * snapshots, int reader) {
+    return &(acquireMapSnapshot(snapshots, reader)->guide);
+}
+
+void releaseSnapshot(MapSnapshots * snapshots, int reader) {
+    atomic_store_explicit(&(snapshots->readers[reader].snapshot), NULL, memory_order_release);
+}
+
+double snapshotGetResistance(MapSnapshots * snapshots, int reader, BorderCache * cache, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    MapSnapshot * snapshot = acquireMapSnapshot(snapshots, reader);
+    keepSnapshotCache(snapshot, cache);
+    double resistance = guideGetResistanceCached(&(snapshot->guide), cache, x, y, phi, forceX, forceY, numObstacles, obstacles);
+    releaseSnapshot(snapshots, reader);
+    return resistance;
+}
+
+BlindGuide * beginMapUpdate(MapSnapshots * snapshots) {
+    pthread_mutex_lock(&(snapshots->lock));
+    // Only writers change the current snapshot, so it cannot be freed while the lock is held
+    MapSnapshot * current = atomic_load_explicit(&(snapshots->current), memory_order_acquire);
+    snapshots->next = copySnapshot(&(current->guide));
+    if (snapshots->next == NULL) {
+        pthread_mutex_unlock(&(snapshots->lock));
+        return NULL;
+    }
+    memcpy(snapshots->next->changes, current->changes, current->numChanges * sizeof(SnapshotChange));
+    snapshots->next->numChanges = current->numChanges;
+    return &(snapshots->next->guide);
+}
+
+void publishMapUpdate(MapSnapshots * snapshots) {
+    MapSnapshot * next = snapshots->next;
+    MapSnapshot * current = atomic_load_explicit(&(snapshots->current), memory_order_relaxed);
+    // Remember where this update changed the map, forgetting the oldest update when the history is full
+    SnapshotChange change;
+    if (!findSnapshotChange(&(current->guide), &(next->guide), &change)) {
+        next->numChanges = 0;
+    } else {
+        if (next->numChanges == SNAPSHOT_HISTORY) {
+            memmove(next->changes, next->changes + 1, (SNAPSHOT_HISTORY - 1) * sizeof(SnapshotChange));
+            next->numChanges--;
+        }
+        next->changes[next->numChanges++] = change;
+    }
+    while (snapshots->numRetired == SNAPSHOT_MAX_RETIRED && reclaimSnapshots(snapshots) == SNAPSHOT_MAX_RETIRED) {
+        sched_yield();
+    }
+    next->version = current->version + 1;
+    MapSnapshot * replaced = atomic_exchange_explicit(&(snapshots->current), next, memory_order_seq_cst);
+    snapshots->retired[snapshots->numRetired++] = replaced;
+    atomic_fetch_add_explicit(&(snapshots->numPublished), 1, memory_order_relaxed);
+    reclaimSnapshots(snapshots);
+    snapshots->next = NULL;
+    pthread_mutex_unlock(&(snapshots->lock));
+}
+
+void cancelMapUpdate(MapSnapshots * snapshots) {
+    freeSnapshot(snapshots->next);
+    snapshots->next = NULL;
+    pthread_mutex_unlock(&(snapshots->lock));
+}
+
+size_t reclaimSnapshots(MapSnapshots * snapshots) {
+    size_t kept = 0;
+    size_t i = 0;
+    for (i = 0; i < snapshots->numRetired; i++) {
+        MapSnapshot * snapshot = snapshots->retired[i];
+        int inUse = 0;
+        int r = 0;
+        for (r = 0; r < SNAPSHOT_MAX_READERS && !inUse; r++) {
+            inUse = atomic_load_explicit(&(snapshots->readers[r].snapshot), memory_order_seq_cst) == snapshot;
+        }
+        if (inUse) {
+            snapshots->retired[kept++] = snapshot;
+        } else {
+            freeSnapshot(snapshot);
+        }
+    }
+    snapshots->numRetired = kept;
+    return kept;
+}
+
+unsigned long getNumPublished(MapSnapshots * snapshots) {
+    return atomic_load_explicit(&(snapshots->numPublished), memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mapfile.h"
+#include "sweep.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+double randomBetween(double min, double max) {
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+/*
+ * Parses "name=value" into params, or "name=min:max:steps" into range (e.g. "radius=0.4" or "stopTime=0.5:2:16").
+ * userHandedness takes LEFT or RIGHT, or 0 (LEFT) and 1 (RIGHT) in a range.
+ * Returns 1 for a value, 2 for a range, and 0 when the parameter or value is unknown.
+ */
+int parseSweepParam(GuideParams * params, SweepRange * range, const char * assignment) {
+    const char * value = strchr(assignment, '=');
+    if (value == NULL) {
+        return 0;
+    }
+    char name[32];
+    size_t length = value - assignment;
+    if (length >= sizeof(name)) {
+        return 0;
+    }
+    memcpy(name, assignment, length);
+    name[length] = '\0';
+    value++;
+    int param = findParam(name);
+    if (param < 0) {
+        return 0;
+    }
+    if (param == PARAM_USER_HANDEDNESS && (strcmp(value, "LEFT") == 0 || strcmp(value, "RIGHT") == 0)) {
+        params->userHandedness = strcmp(value, "LEFT") == 0 ? LEFT : RIGHT;
+        return 1;
+    }
+    char * end = NULL;
+    double first = strtod(value, &end);
+    if (end == value) {
+        return 0;
+    }
+    if (*end == '\0') {
+        setParam(params, param, first);
+        return 1;
+    }
+    range->param = param;
+    range->min = first;
+    if (*end != ':') {
+        return 0;
+    }
+    value = end + 1;
+    range->max = strtod(value, &end);
+    if (end == value || *end != ':') {
+        return 0;
+    }
+    value = end + 1;
+    long steps = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || steps < 1) {
+        return 0;
+    }
+    range->steps = (unsigned int) steps;
+    return 2;
+}
+
+/*
+ * Adds numQueries random queries near the border lines of guide to the scenario, with up to two obstacles each.
+ */
+void addSyntheticQueries(BlindGuide * guide, SweepScenario * scenario, size_t numQueries) {
+    srand(1);
+    BorderlineArray * ba = &(guide->borderlines);
+    size_t i = 0;
+    for (i = 0; i < numQueries; i++) {
+        double x = randomBetween(-4, 4);
+        double y = randomBetween(-6, 6);
+        if (ba->size > 0) {
+            Borderline b = getBorderline(ba, rand() % ba->size);
+            x = b.bottom.x + randomBetween(-2, 2);
+            y = b.bottom.y + randomBetween(-2, 2);
+        }
+        double obstacles[4];
+        unsigned int numObstacles = rand() % 3;
+        unsigned int k = 0;
+        for (k = 0; k < 2 * numObstacles; k++) {
+            obstacles[k] = (k % 2 == 0 ? x : y) + randomBetween(-3, 3);
+        }
+        addSweepQuery(scenario, x, y, randomBetween(-PI, PI), randomBetween(-20, 20), randomBetween(-20, 20), numObstacles, obstacles);
+    }
+}
+
+/*
+ * Evaluates a grid or random sample of parameter sets on the queries of replay logs (see sweep.h),
+ * and prints the metrics of every parameter set as CSV.
+ */
+int main(int argc, char ** argv) {
+    BlindGuide guide;
+    createBlindGuide(&guide);
+    GuideParams params;
+    getDefaultParams(&params);
+    size_t numThreads = 0;
+    size_t numSamples = 0;
+    size_t numSynthetic = 0;
+    unsigned long long seed = 1;
+    int hasMap = 0;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (arg + 1 >= argc) {
+            arg = argc;
+            break;
+        }
+        if (strcmp(argv[arg], "--threads") == 0) {
+            numThreads = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--samples") == 0) {
+            numSamples = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--seed") == 0) {
+            seed = strtoull(argv[arg + 1], NULL, 10);
+        } else if (strcmp(argv[arg], "--synthetic") == 0) {
+            numSynthetic = (size_t) atol(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--map") == 0) {
+            if (!guideLoadMap(&guide, argv[arg + 1])) {
+                printf("Cannot load the map file %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else if (strcmp(argv[arg], "--text") == 0) {
+            if (guideImportTextMap(&guide, argv[arg + 1], NULL) < 0) {
+                printf("Cannot import the text map %s\n", argv[arg + 1]);
+                return 1;
+            }
+            hasMap = 1;
+        } else {
+            arg = argc;
+        }
+    }
+    SweepRange ranges[NUM_PARAMS];
+    size_t numRanges = 0;
+    for (; arg < argc && strchr(argv[arg], '=') != NULL; arg++) {
+        int parsed = numRanges < NUM_PARAMS ? parseSweepParam(&params, &ranges[numRanges], argv[arg]) : 0;
+        if (parsed == 0) {
+            printf("Invalid parameter %s\n", argv[arg]);
+            return 1;
+        }
+        numRanges += parsed == 2;
+    }
+    if (arg >= argc && numSynthetic == 0) {
+        printf("Usage: %s [--threads n] [--map venue.map | --text venue.txt] [--samples n [--seed s]] [name=value | name=min:max:steps ...] log.bin ...\n", argv[0]);
+        printf("       %s --synthetic numQueries [...] [name=value | name=min:max:steps ...]\n", argv[0]);
+        printf("Without --samples every combination of the ranges is evaluated (e.g. stopTime=0.5:2:16 resistanceTime=2:4:16 radius=0.3:0.5:5),\n");
+        printf("with --samples that many random parameter sets within the ranges. The other parameters default to the defines of blindguide.h\n");
+        return 1;
+    }
+    if (!hasMap) {
+        guideInitializeBorders(&guide);
+    }
+
+    SweepScenario scenario;
+    createSweepScenario(&scenario);
+    addSyntheticQueries(&guide, &scenario, numSynthetic);
+    for (; arg < argc; arg++) {
+        if (addSweepLog(&scenario, argv[arg]) < 0) {
+            printf("Cannot read the replay log %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    GuideParams * sets = NULL;
+    size_t numSets = numSamples > 0 ? createSweepSample(&params, numRanges, ranges, numSamples, seed, &sets)
+                                    : createSweepGrid(&params, numRanges, ranges, &sets);
+    SweepMetrics * metrics = (SweepMetrics *) malloc(numSets * sizeof(SweepMetrics));
+
+    double start = now();
+    runSweep(&guide, &scenario, numSets, sets, numThreads, metrics);
+    double seconds = now() - start;
+    fprintf(stderr, "Evaluated %zu parameter sets on %zu queries in %.3f s: %.0f queries/s\n",
+        numSets, scenario.numQueries, seconds, numSets * (double) scenario.numQueries / seconds);
+
+    int p = 0;
+    for (p = 0; p < NUM_PARAMS; p++) {
+        printf("%s,", paramNames[p]);
+    }
+    printf("valid,nothing,resist,stop,meanResistance,maxResistance,nearWall,nearWallStops,meanNearWallResistance\n");
+    size_t i = 0;
+    for (i = 0; i < numSets; i++) {
+        for (p = 0; p < NUM_PARAMS; p++) {
+            printf("%.17g,", getParam(&sets[i], p));
+        }
+        SweepMetrics * m = &metrics[i];
+        printf("%d,%llu,%llu,%llu,%.17g,%.17g,%llu,%llu,%.17g\n", m->valid, m->actions[NOTHING], m->actions[RESIST], m->actions[STOP],
+            m->meanResistance, m->maxResistance, m->numNearWall, m->nearWallStops, m->meanNearWallResistance);
+    }
+    free(metrics);
+    free(sets);
+    freeSweepScenario(&scenario);
+    freeBlindGuide(&guide);
+    return 0;
+}
@@ -0,0 +1,447 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include "replay.h"
+
+// Number of queries of a scenario that a sweep worker evaluates with one parameter set before looking for more work
+#define SWEEP_CHUNK_SIZE 4096
+// Minimum number of work items a sweep is split into, so few parameter sets with many queries still keep all cores busy
+#define SWEEP_MIN_ITEMS 1024
+// Queries within this distance in meters of a border line count as near a wall (see SweepMetrics)
+#define SWEEP_NEAR_WALL_DISTANCE 1.0
+
+/*
+ * The values a sweep tries for a single parameter: steps values evenly spaced from min to max (both included),
+ * or uniformly distributed between min and max for a random sample.
+ */
+typedef struct SweepRange {
+    enum param param;
+    double min;
+    double max;
+    unsigned int steps;
+} SweepRange;
+
+/*
+ * A query of a scenario, see getResistance() for the meaning of the fields.
+ * obstacles: offset of the 2 * numObstacles obstacle coordinates in the obstacles of the scenario
+ */
+typedef struct SweepQuery {
+    double x;
+    double y;
+    double phi;
+    double forceX;
+    double forceY;
+    unsigned int numObstacles;
+    size_t obstacles;
+} SweepQuery;
+
+/*
+ * The queries that every parameter set of a sweep is evaluated on, e.g. the trajectories of recorded sessions.
+ * queries, numQueries, capacity: the queries in the order they were added
+ * obstacles, numObstacleValues, obstaclesCapacity: the obstacle coordinates of all queries
+ */
+typedef struct SweepScenario {
+    SweepQuery * queries;
+    size_t numQueries;
+    size_t capacity;
+    double * obstacles;
+    size_t numObstacleValues;
+    size_t obstaclesCapacity;
+} SweepScenario;
+
+/*
+ * Aggregate results of a parameter set over all queries of a scenario.
+ * valid: 0 when the parameter set is invalid (see validParams()), in which case nothing was evaluated
+ * actions: number of queries per final action (see enum action)
+ * meanResistance, maxResistance: over all queries
+ * numNearWall: number of queries within SWEEP_NEAR_WALL_DISTANCE of a border line (independent of the parameters)
+ * nearWallStops: number of those queries that ended in STOP
+ * meanNearWallResistance: mean resistance of those queries
+ */
+typedef struct SweepMetrics {
+    int valid;
+    unsigned long long actions[3];
+    double meanResistance;
+    double maxResistance;
+    unsigned long long numNearWall;
+    unsigned long long nearWallStops;
+    double meanNearWallResistance;
+} SweepMetrics;
+
+/*
+ * Sums of a single work item of a sweep, combined into SweepMetrics once all items are done.
+ */
+typedef struct SweepPartial {
+    unsigned long long actions[3];
+    unsigned long long numNearWall;
+    unsigned long long nearWallStops;
+    double sum;
+    double nearWallSum;
+    double max;
+} SweepPartial;
+
+/*
+ * A worker of a sweep.
+ * search: scratch space for searching the border grid of the guide
+ * thread: the thread running this worker (unused for worker 0, which is the calling thread)
+ * sweep: the sweep this worker belongs to
+ */
+typedef struct SweepWorker {
+    struct BorderSearch search;
+    pthread_t thread;
+    struct Sweep * sweep;
+} SweepWorker;
+
+/*
+ * State of a sweep, shared by its workers.
+ * Work item i evaluates parameter set i % numSets on chunk i / numSets of the queries, so the workers evaluate the same queries
+ * with different parameters at about the same time, and the queries stay in cache.
+ * guide: the guide with the map the queries are evaluated on (it is not modified while sweeping)
+ * scenario: the queries
+ * nearWall: for every query, 1 when it is near a wall
+ * sets, numSets: the parameter sets
+ * chunkSize, numItems: number of queries per work item, and number of work items
+ * nextItem: the next work item to evaluate
+ * partials: the sums of every work item
+ */
+typedef struct Sweep {
+    BlindGuide * guide;
+    SweepScenario * scenario;
+    unsigned char * nearWall;
+    GuideParams * sets;
+    size_t numSets;
+    size_t chunkSize;
+    size_t numItems;
+    _Atomic size_t nextItem;
+    SweepPartial * partials;
+} Sweep;
+
+/*
+ * Stores in sets (allocated with malloc) every combination of the values of the given ranges, where all other parameters are those of base.
+ * The last range varies fastest. Returns the number of parameter sets.
+ */
+size_t createSweepGrid(GuideParams * base, size_t numRanges, SweepRange * ranges, GuideParams ** sets);
+
+/*
+ * Stores in sets (allocated with malloc) numSamples parameter sets with values drawn uniformly from the given ranges (ignoring their steps),
+ * where all other parameters are those of base. The same seed always gives the same sets. Returns numSamples.
+ */
+size_t createSweepSample(GuideParams * base, size_t numRanges, SweepRange * ranges, size_t numSamples, unsigned long long seed, GuideParams ** sets);
+
+/*
+ * Populates the given SweepScenario structure without queries.
+ */
+void createSweepScenario(SweepScenario * scenario);
+
+/*
+ * Frees the memory allocated to the given SweepScenario structure.
+ */
+void freeSweepScenario(SweepScenario * scenario);
+
+/*
+ * Adds a query (see getResistance()) to the scenario, the obstacles are copied.
+ */
+void addSweepQuery(SweepScenario * scenario, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles);
+
+/*
+ * Adds all records of the replay log at path (see replay.h) to the scenario.
+ * Returns the number of queries added, or -1 when the file is not a replay log for this platform.
+ */
+long long addSweepLog(SweepScenario * scenario, const char * path);
+
+/*
+ * Evaluates every query of the scenario with each of the numSets parameter sets on the map of guide, on numWorkers threads
+ * (including the calling thread, 0 to use all cores), and stores the aggregate results of set i in metrics[i].
+ * The map and its grid are shared by all workers, and every query is evaluated like guideGetResistanceWithParams().
+ * The results do not depend on the number of workers.
+ */
+void runSweep(BlindGuide * guide, SweepScenario * scenario, size_t numSets, GuideParams * sets, size_t numWorkers, SweepMetrics * metrics);
+
+
+size_t createSweepGrid(GuideParams * base, size_t numRanges, SweepRange * ranges, GuideParams ** sets) {
+    size_t numSets = 1;
+    size_t r = 0;
+    for (r = 0; r < numRanges; r++) {
+        numSets *= ranges[r].steps > 0 ? ranges[r].steps : 1;
+    }
+    *sets = (GuideParams *) malloc(numSets * sizeof(GuideParams));
+    size_t i = 0;
+    for (i = 0; i < numSets; i++) {
+        (*sets)[i] = *base;
+        // Decompose i into a step per range, with the last range as the least significant digit
+        size_t rest = i;
+        for (r = numRanges; r-- > 0;) {
+            size_t steps = ranges[r].steps > 0 ? ranges[r].steps : 1;
+            size_t step = rest % steps;
+            rest /= steps;
+            double value = steps > 1 ? ranges[r].min + (ranges[r].max - ranges[r].min) * step / (steps - 1) : ranges[r].min;
+            setParam(&((*sets)[i]), ranges[r].param, value);
+        }
+    }
+    return numSets;
+}
+
+/*
+ * Returns a pseudo random number in [0, 1) from the state, which is advanced (splitmix64).
+ */
+static double sweepRandom(uint64_t * state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+size_t createSweepSample(GuideParams * base, size_t numRanges, SweepRange * ranges, size_t numSamples, unsigned long long seed, GuideParams ** sets) {
+    *sets = (GuideParams *) malloc((numSamples > 0 ? numSamples : 1) * sizeof(GuideParams));
+    uint64_t state = seed;
+    size_t i = 0;
+    for (i = 0; i < numSamples; i++) {
+        (*sets)[i] = *base;
+        size_t r = 0;
+        for (r = 0; r < numRanges; r++) {
+            setParam(&((*sets)[i]), ranges[r].param, ranges[r].min + (ranges[r].max - ranges[r].min) * sweepRandom(&state));
+        }
+    }
+    return numSamples;
+}
+
+void createSweepScenario(SweepScenario * scenario) {
+    memset(scenario, 0, sizeof(SweepScenario));
+}
+
+void freeSweepScenario(SweepScenario * scenario) {
+    free(scenario->queries);
+    free(scenario->obstacles);
+    memset(scenario, 0, sizeof(SweepScenario));
+}
+
+void addSweepQuery(SweepScenario * scenario, double x, double y, double phi, double forceX, double forceY, unsigned int numObstacles, double * obstacles) {
+    if (scenario->numQueries == scenario->capacity) {
+        scenario->capacity = scenario->capacity > 0 ? 2 * scenario->capacity : 1024;
+        scenario->queries = (SweepQuery *) realloc(scenario->queries, scenario->capacity * sizeof(SweepQuery));
+    }
+    size_t numValues = 2 * (size_t) numObstacles;
+    if (scenario->numObstacleValues + numValues > scenario->obstaclesCapacity) {
+        while (scenario->numObstacleValues + numValues > scenario->obstaclesCapacity) {
+            scenario->obstaclesCapacity = scenario->obstaclesCapacity > 0 ? 2 * scenario->obstaclesCapacity : 1024;
+        }
+        scenario->obstacles = (double *) realloc(scenario->obstacles, scenario->obstaclesCapacity * sizeof(double));
+    }
+    SweepQuery * q = &(scenario->queries[scenario->numQueries++]);
+    q->x = x;
+    q->y = y;
+    q->phi = phi;
+    q->forceX = forceX;
+    q->forceY = forceY;
+    q->numObstacles = numObstacles;
+    q->obstacles = scenario->numObstacleValues;
+    if (numValues > 0) {
+        memcpy(scenario->obstacles + scenario->numObstacleValues, obstacles, numValues * sizeof(double));
+    }
+    scenario->numObstacleValues += numValues;
+}
+
+long long addSweepLog(SweepScenario * scenario, const char * path) {
+    size_t size = 0;
+    char * log = (char *) mapReplayFile(path, &size);
+    if (log == NULL) {
+        return -1;
+    }
+    ReplayLogHeader * header = (ReplayLogHeader *) log;
+    if (size < sizeof(ReplayLogHeader) || memcmp(header->magic, REPLAY_LOG_MAGIC, sizeof(header->magic)) != 0
+            || header->version != REPLAY_FILE_VERSION || header->recordSize != sizeof(ReplayRecord)) {
+        releaseReplayFile(log, size);
+        return -1;
+    }
+    // Like replayLog(), a log that was not closed is read up to its last complete record
+    unsigned long long numRecords = header->numRecords;
+    unsigned long long n = 0;
+    char * record = log + sizeof(ReplayLogHeader);
+    char * end = log + size;
+    char * next = NULL;
+    while ((numRecords == 0 || n < numRecords) && (next = nextReplayRecord(record, end)) != NULL) {
+        ReplayRecord * r = (ReplayRecord *) record;
+        addSweepQuery(scenario, r->x, r->y, r->phi, r->forceX, r->forceY, r->numObstacles, (double *) (record + sizeof(ReplayRecord)));
+        record = next;
+        n++;
+    }
+    releaseReplayFile(log, size);
+    return (long long) n;
+}
+
+/*
+ * Returns 1 when p lies within SWEEP_NEAR_WALL_DISTANCE of a border line of guide, 0 otherwise.
+ */
+static int isNearWall(BlindGuide * guide, BorderSearch * search, Coordinate * p) {
+    BorderlineSoA * soa = &(guide->soa);
+    int found = collectBorderCandidates(&(guide->grid), search, &(guide->borderlines), p, SWEEP_NEAR_WALL_DISTANCE);
+    size_t numIndices = found ? search->candidates.size : soa->size;
+    size_t k = 0;
+    for (k = 0; k < numIndices; k++) {
+        Coordinate closest;
+        // Disabled border lines give a NaN distance, so they are never near
+        if (distanceToBorderline(soa, found ? search->candidates.indices[k] : k, p, &closest) <= SWEEP_NEAR_WALL_DISTANCE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Evaluates work items of the sweep as worker, until all items have been handed out.
+ */
+static void runSweepWorker(Sweep * sweep, SweepWorker * worker) {
+    SweepScenario * scenario = sweep->scenario;
+    for (;;) {
+        size_t item = atomic_fetch_add(&(sweep->nextItem), 1);
+        if (item >= sweep->numItems) {
+            return;
+        }
+        GuideParams * params = &(sweep->sets[item % sweep->numSets]);
+        size_t begin = item / sweep->numSets * sweep->chunkSize;
+        size_t end = begin + sweep->chunkSize < scenario->numQueries ? begin + sweep->chunkSize : scenario->numQueries;
+        SweepPartial partial;
+        memset(&partial, 0, sizeof(SweepPartial));
+        size_t i = 0;
+        for (i = begin; i < end; i++) {
+            SweepQuery * q = &(scenario->queries[i]);
+            double resistance = guideGetResistanceWithParams(sweep->guide, &(worker->search), params, q->x, q->y, q->phi, q->forceX, q->forceY,
+                q->numObstacles, scenario->obstacles + q->obstacles);
+            enum action action = worker->search.action;
+            partial.actions[action <= STOP ? action : NOTHING]++;
+            partial.sum += resistance;
+            partial.max = resistance > partial.max ? resistance : partial.max;
+            if (sweep->nearWall[i]) {
+                partial.numNearWall++;
+                partial.nearWallStops += action == STOP;
+                partial.nearWallSum += resistance;
+            }
+        }
+        sweep->partials[item] = partial;
+    }
+}
+
+/*
+ * Main function of the worker threads of a sweep.
+ */
+static void * sweepThread(void * arg) {
+    SweepWorker * worker = (SweepWorker *) arg;
+    runSweepWorker(worker->sweep, worker);
+    return NULL;
+}
+
+void runSweep(BlindGuide * guide, SweepScenario * scenario, size_t numSets, GuideParams * sets, size_t numWorkers, SweepMetrics * metrics) {
+    memset(metrics, 0, numSets * sizeof(SweepMetrics));
+    if (numSets == 0) {
+        return;
+    }
+    if (guide->kernel == NULL) {
+        guideSelectBorderKernel(guide, KERNEL_AUTO);
+    }
+    numWorkers = numWorkers > 0 ? numWorkers : getNumCores();
+    SweepWorker * workers = (SweepWorker *) calloc(numWorkers, sizeof(SweepWorker));
+
+    // Whether a query is near a wall does not depend on the parameters, so decide it once
+    size_t numQueries = scenario->numQueries;
+    unsigned char * nearWall = (unsigned char *) malloc(numQueries > 0 ? numQueries : 1);
+    size_t i = 0;
+    for (i = 0; i < numQueries; i++) {
+        Coordinate p = createCoordinate(scenario->queries[i].x, scenario->queries[i].y);
+        nearWall[i] = (unsigned char) isNearWall(guide, &(workers[0].search), &p);
+    }
+
+    // Invalid parameter sets are left out, the valid ones are packed at the front of valid
+    GuideParams * valid = (GuideParams *) malloc(numSets * sizeof(GuideParams));
+    size_t * validSet = (size_t *) malloc(numSets * sizeof(size_t));
+    size_t numValid = 0;
+    for (i = 0; i < numSets; i++) {
+        if (validParams(&(sets[i]))) {
+            metrics[i].valid = 1;
+            validSet[numValid] = i;
+            valid[numValid++] = sets[i];
+        }
+    }
+
+    // Split the queries in fewer chunks the more parameter sets there are, but never depending on the number of workers,
+    // so the sums are always added in the same order
+    size_t numChunks = (numQueries + SWEEP_CHUNK_SIZE - 1) / SWEEP_CHUNK_SIZE;
+    size_t wanted = numValid > 0 ? (SWEEP_MIN_ITEMS + numValid - 1) / numValid : 1;
+    numChunks = numChunks < wanted ? numChunks : wanted;
+    numChunks = numChunks > 0 ? numChunks : 1;
+    Sweep sweep;
+    memset(&sweep, 0, sizeof(Sweep));
+    sweep.guide = guide;
+    sweep.scenario = scenario;
+    sweep.nearWall = nearWall;
+    sweep.sets = valid;
+    sweep.numSets = numValid;
+    sweep.chunkSize = (numQueries + numChunks - 1) / numChunks;
+    sweep.numItems = numValid > 0 && numQueries > 0 ? numValid * numChunks : 0;
+    sweep.partials = (SweepPartial *) malloc((sweep.numItems > 0 ? sweep.numItems : 1) * sizeof(SweepPartial));
+    atomic_init(&(sweep.nextItem), 0);
+
+    size_t w = 0;
+    for (w = 0; w < numWorkers; w++) {
+        workers[w].sweep = &sweep;
+    }
+    for (w = 1; w < numWorkers; w++) {
+        pthread_create(&(workers[w].thread), NULL, sweepThread, &(workers[w]));
+    }
+    runSweepWorker(&sweep, &(workers[0]));
+    for (w = 0; w < numWorkers; w++) {
+        if (w > 0) {
+            pthread_join(workers[w].thread, NULL);
+        }
+        freeBorderSearch(&(workers[w].search));
+    }
+    free(workers);
+
+    // Combine the work items of every parameter set in the order of their chunks
+    size_t item = 0;
+    for (item = 0; item < sweep.numItems; item++) {
+        SweepPartial * partial = &(sweep.partials[item]);
+        SweepMetrics * m = &(metrics[validSet[item % numValid]]);
+        int a = 0;
+        for (a = 0; a < 3; a++) {
+            m->actions[a] += partial->actions[a];
+        }
+        m->numNearWall += partial->numNearWall;
+        m->nearWallStops += partial->nearWallStops;
+        m->meanResistance += partial->sum;
+        m->meanNearWallResistance += partial->nearWallSum;
+        m->maxResistance = partial->max > m->maxResistance ? partial->max : m->maxResistance;
+    }
+    for (i = 0; i < numSets; i++) {
+        if (metrics[i].valid) {
+            metrics[i].meanResistance = numQueries > 0 ? metrics[i].meanResistance / numQueries : 0;
+            metrics[i].meanNearWallResistance = metrics[i].numNearWall > 0 ? metrics[i].meanNearWallResistance / metrics[i].numNearWall : 0;
+        }
+    }
+    free(sweep.partials);
+    free(validSet);
+    free(valid);
+    free(nearWall);
+}
+
+#endif
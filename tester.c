@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "blindguide.h"
 
 Coordinate createCoordinate(double x, double y) {
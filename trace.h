@@ -0,0 +1,176 @@
+/*
+ * Copyright 2018 Anne Kolmans, Dylan ter Veen, Jarno Brils, Ren??e van Hijfte, and Thomas Wiepking (TU/e Project Robots Everywhere 2017/2018 Q3 Group 12)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "blindguide.h"
+
+// Magic number at the start of every trace file
+#define TRACE_FILE_MAGIC "BGTRACE\n"
+// Version of the trace file format, increased whenever TraceRecord changes
+#define TRACE_FILE_VERSION 1
+// Maximum number of records that a TraceWriter moves from its ring to its file at once
+#define TRACE_WRITE_BATCH 1024
+// Time in microseconds that a TraceWriter waits before looking at its ring again when the ring is empty
+#define TRACE_WRITE_INTERVAL 1000
+
+/*
+ * Header at the start of a trace file, which is followed by the TraceRecords in the order they were written.
+ * magic: TRACE_FILE_MAGIC
+ * version: TRACE_FILE_VERSION
+ * recordSize: size of a TraceRecord in bytes
+ * dropped: number of records that were dropped because the ring was full (filled in when the writer stops)
+ * Trace files are written in the native layout of the platform, so decode them on the same kind of platform.
+ */
+typedef struct TraceFileHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int recordSize;
+    unsigned long long dropped;
+} TraceFileHeader;
+
+/*
+ * Consumer of a TraceRing that writes its records to a trace file from a separate thread,
+ * so the thread computing resistances never waits for the file system.
+ * ring: the ring to read from
+ * file: the trace file
+ * thread: the thread writing the records
+ * stop: set when the thread should write the remaining records and terminate
+ * written: number of records written to the file
+ */
+typedef struct TraceWriter {
+    TraceRing * ring;
+    FILE * file;
+    pthread_t thread;
+    _Atomic int stop;
+    unsigned long long written;
+} TraceWriter;
+
+/*
+ * Creates the trace file at path and starts a thread that writes all records of ring to it.
+ * Does not enable the ring (see setTraceEnabled()).
+ * Returns 1 on success, or 0 when the file cannot be created.
+ */
+int startTraceWriter(TraceWriter * writer, TraceRing * ring, const char * path);
+
+/*
+ * Writes the remaining records of the ring of writer, stops its thread and closes its file.
+ */
+void stopTraceWriter(TraceWriter * writer);
+
+/*
+ * Moves up to TRACE_WRITE_BATCH records from ring to file, and returns the number of records written.
+ */
+size_t drainTrace(TraceRing * ring, FILE * file);
+
+/*
+ * Reads the header of a trace file, and checks that the file can be decoded on this platform.
+ * Returns 1 on success (and stores the header in header), or 0 when the file is not a trace file of the current version.
+ */
+int readTraceHeader(FILE * file, TraceFileHeader * header);
+
+
+/*
+ * Writes a header with the given number of dropped records at the current position of file.
+ */
+static int writeTraceHeader(FILE * file, unsigned long long dropped) {
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(TraceFileHeader));
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    header.dropped = dropped;
+    return fwrite(&header, sizeof(TraceFileHeader), 1, file) == 1;
+}
+
+/*
+ * Main function of the writer thread: moves records from the ring to the file until it is stopped.
+ */
+static void * traceWriterThread(void * arg) {
+    TraceWriter * writer = (TraceWriter *) arg;
+    struct timespec interval;
+    interval.tv_sec = 0;
+    interval.tv_nsec = TRACE_WRITE_INTERVAL * 1000L;
+    while (!atomic_load(&(writer->stop))) {
+        size_t n = drainTrace(writer->ring, writer->file);
+        writer->written += n;
+        if (n == 0) {
+            nanosleep(&interval, NULL);
+        }
+    }
+    // The producer may have written more records before the writer was stopped
+    size_t n = 0;
+    while ((n = drainTrace(writer->ring, writer->file)) > 0) {
+        writer->written += n;
+    }
+    return NULL;
+}
+
+size_t drainTrace(TraceRing * ring, FILE * file) {
+    TraceRecord records[TRACE_WRITE_BATCH];
+    size_t n = readTrace(ring, records, TRACE_WRITE_BATCH);
+    return n > 0 ? fwrite(records, sizeof(TraceRecord), n, file) : 0;
+}
+
+int startTraceWriter(TraceWriter * writer, TraceRing * ring, const char * path) {
+    memset(writer, 0, sizeof(TraceWriter));
+    writer->ring = ring;
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return 0;
+    }
+    if (!writeTraceHeader(writer->file, 0)) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return 0;
+    }
+    atomic_init(&(writer->stop), 0);
+    if (pthread_create(&(writer->thread), NULL, traceWriterThread, writer) != 0) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void stopTraceWriter(TraceWriter * writer) {
+    if (writer->file == NULL) {
+        return;
+    }
+    atomic_store(&(writer->stop), 1);
+    pthread_join(writer->thread, NULL);
+    // Now that all records are written, fill in the number of dropped records
+    if (fseek(writer->file, 0, SEEK_SET) == 0) {
+        writeTraceHeader(writer->file, getTraceDropped(writer->ring));
+    }
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+int readTraceHeader(FILE * file, TraceFileHeader * header) {
+    if (fread(header, sizeof(TraceFileHeader), 1, file) != 1) {
+        return 0;
+    }
+    return memcmp(header->magic, TRACE_FILE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == TRACE_FILE_VERSION && header->recordSize == sizeof(TraceRecord);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+Coordinate createCoordinate(double x, double y) {
+    Coordinate c;
+    c.x = x;
+    c.y = y;
+    return c;
+}
+
+Borderline createBorderline(Coordinate bottom, Coordinate top, enum side goodSide) {
+    Borderline bl;
+    bl.bottom = bottom;
+    bl.top = top;
+    bl.length = createVector(top.x - bottom.x, top.y - bottom.y).length;
+    bl.goodSide = goodSide;
+    return bl;
+}
+
+Vector createVector(double x, double y) {
+    Vector v;
+    populateVector(x, y, &v);
+    return v;
+}
+
+const char * actionName(int a) {
+    return a == STOP ? "STOP" : (a == RESIST ? "RESIST" : "NOTHING");
+}
+
+const char * typeName(int type) {
+    switch (type) {
+        case TRACE_QUERY: return "query";
+        case TRACE_BORDER: return "border";
+        case TRACE_OBSTACLE: return "obstacle";
+        case TRACE_RESISTANCE: return "resistance";
+        case TRACE_RESULT: return "result";
+    }
+    return "unknown";
+}
+
+/*
+ * Prints the given record as text, in the order the decisions were made.
+ */
+void printRecord(TraceRecord * r) {
+    double * v = r->values;
+    switch (r->type) {
+        case TRACE_QUERY:
+            printf("\nQuery %llu: point (%lf, %lf), phi %lf, force (%lf, %lf), backwards resistance %lf, %u obstacles\n",
+                r->query, v[0], v[1], v[2], v[3], v[4], v[5], r->index);
+            break;
+        case TRACE_BORDER:
+            printf("  Border %u: %s, %s side%s, t: %lf, closest (%lf, %lf), distance: %lf, angle: %lf, along force: %lf\n",
+                r->index, actionName(r->action), (r->flags & TRACE_GOOD_SIDE) ? "good" : "bad", (r->flags & TRACE_USER_AREA) ? ", in user area" : "",
+                v[0], v[4], v[5], v[1], v[2], v[3]);
+            break;
+        case TRACE_OBSTACLE:
+            printf("  Obstacle %u at (%lf, %lf): %s, along force: %lf\n", r->index, v[0], v[1], actionName(r->action), v[2]);
+            break;
+        case TRACE_RESISTANCE:
+            printf("  Resistance for the nearest %s at %lf along force: %lf (so far %lf)\n",
+                (r->flags & TRACE_FROM_OBSTACLE) ? "obstacle" : "border", v[0], v[1], v[2]);
+            break;
+        case TRACE_RESULT:
+            printf("  Result: %s, resistance %lf\n", actionName(r->action), v[0]);
+            break;
+        default:
+            printf("  Unknown record type %d\n", r->type);
+    }
+}
+
+/*
+ * Decodes a trace file written by a TraceWriter (see trace.h), as text or as CSV with one line per record.
+ */
+int main(int argc, char ** argv) {
+    int csv = 0;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--csv") == 0) {
+        csv = 1;
+        arg++;
+    }
+    if (argc - arg != 1) {
+        printf("Usage: %s [--csv] trace.bin\n", argv[0]);
+        return 1;
+    }
+    FILE * file = fopen(argv[arg], "rb");
+    if (file == NULL) {
+        printf("Cannot open %s\n", argv[arg]);
+        return 1;
+    }
+    TraceFileHeader header;
+    if (!readTraceHeader(file, &header)) {
+        printf("%s is not a trace file of version %d for this platform\n", argv[arg], TRACE_FILE_VERSION);
+        fclose(file);
+        return 1;
+    }
+
+    if (csv) {
+        printf("query,type,index,action,flags,v0,v1,v2,v3,v4,v5\n");
+    }
+    TraceRecord records[TRACE_WRITE_BATCH];
+    unsigned long long numRecords = 0;
+    size_t n = 0;
+    while ((n = fread(records, sizeof(TraceRecord), TRACE_WRITE_BATCH, file)) > 0) {
+        size_t i = 0;
+        for (i = 0; i < n; i++) {
+            TraceRecord * r = &records[i];
+            if (csv) {
+                printf("%llu,%s,%u,%s,%d,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n", r->query, typeName(r->type), r->index, actionName(r->action), r->flags,
+                    r->values[0], r->values[1], r->values[2], r->values[3], r->values[4], r->values[5]);
+            } else {
+                printRecord(r);
+            }
+        }
+        numRecords += n;
+    }
+    fclose(file);
+    fprintf(stderr, "%llu records, %llu dropped\n", numRecords, header.dropped);
+    return 0;
+}